@@ -77,6 +77,11 @@ android {
         compose = true
     }
 
+    testOptions {
+        // Parsers log through android.util.Log
+        unitTests.isReturnDefaultValues = true
+    }
+
 }
 
 dependencies {
@@ -125,6 +130,8 @@ dependencies {
     testImplementation("org.mockito.kotlin:mockito-kotlin:5.1.0")
     testImplementation("org.jetbrains.kotlinx:kotlinx-coroutines-test:1.7.3")
     testImplementation("androidx.test:core:1.5.0")
+    // The android.jar org.json is a stub in unit tests
+    testImplementation("org.json:json:20231013")
     
     // AndroidTest dependencies for integration tests
     androidTestImplementation(libs.ext.junit)
@@ -18,6 +18,11 @@ mkdir -p "$ROOTFS_DIR_PATH"
 
 # Extract rootfs if directory is empty (excluding root and tmp)
 if [ -z "$(ls -A "$ROOTFS_DIR_PATH" 2>/dev/null | grep -vE '^(root|tmp)$')" ]; then
+    # Commands run by the app (ATERM_EXEC=1) must not print extraction progress into their output
+    if [ "$ATERM_EXEC" = "1" ]; then
+        echo "Error: $ROOTFS_DIR has not been extracted" >&2
+        exit 1
+    fi
     ROOTFS_FILE_PATH="$PREFIX/files/$ROOTFS_FILE"
     if [ ! -f "$ROOTFS_FILE_PATH" ]; then
         echo "Error: $ROOTFS_FILE not found at $ROOTFS_FILE_PATH"
@@ -164,6 +169,20 @@ if [ ! -f "$PREFIX/local/bin/proot" ] || [ ! -x "$PREFIX/local/bin/proot" ]; the
     exit 1
 fi
 
+# Commands run by the app without a terminal (ATERM_EXEC=1) take the place of the init script. They get the
+# rootfs search path and home and start in ATERM_EXEC_DIR, a path inside the rootfs.
+if [ "$ATERM_EXEC" = "1" ]; then
+    EXEC_SCRIPT='export PATH=/bin:/sbin:/usr/bin:/usr/sbin:/usr/share/bin:/usr/share/sbin:/usr/local/bin:/usr/local/sbin
+export HOME=/root
+cd "${ATERM_EXEC_DIR:-/}" || exit 127
+exec "$@"'
+    if [ "$USE_BUSYBOX_SH" = "true" ]; then
+        exec $LINKER $PREFIX/local/bin/proot $ARGS $SHELL_PATH sh -c "$EXEC_SCRIPT" sh "$@"
+    else
+        exec $LINKER $PREFIX/local/bin/proot $ARGS $SHELL_PATH -c "$EXEC_SCRIPT" sh "$@"
+    fi
+fi
+
 # If using busybox as shell, we need to pass 'sh' as argument
 if [ "$USE_BUSYBOX_SH" = "true" ]; then
     $LINKER $PREFIX/local/bin/proot $ARGS $SHELL_PATH sh $PREFIX/local/bin/init "$@"
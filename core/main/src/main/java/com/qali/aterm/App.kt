@@ -4,8 +4,10 @@ import android.app.Application
 import android.os.Build
 import android.os.StrictMode
 import com.github.anrwatchdog.ANRWatchDog
+import com.qali.aterm.agent.debug.TraceRecorder
 import com.rk.libcommons.application
 import com.rk.resources.Res
+import com.rk.settings.Settings
 import com.rk.update.UpdateManager
 import kotlinx.coroutines.DelicateCoroutinesApi
 import kotlinx.coroutines.Dispatchers
@@ -43,6 +45,8 @@ class App : Application() {
         //Thread.setDefaultUncaughtExceptionHandler(CrashHandler)
         ANRWatchDog().start()
 
+        TraceRecorder.enabled = Settings.trace_enabled
+
         UpdateManager().onUpdate()
 
         if (BuildConfig.DEBUG){
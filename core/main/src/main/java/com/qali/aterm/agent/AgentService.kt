@@ -198,6 +198,8 @@ object AgentService {
         toolRegistry.registerTool(DocumentationGenerationTool(workspaceRoot))
         // Intelligent error analysis tool (with toolRegistry for API access)
         toolRegistry.registerTool(IntelligentErrorAnalysisTool(workspaceRoot, toolRegistry, ollamaUrl, ollamaModel))
+        // Tools of the MCP servers configured in .gemini/settings.json
+        McpServerManager.registerTools(toolRegistry, workspaceRoot)
     }
     
     fun getClient(): AgentClient? = client
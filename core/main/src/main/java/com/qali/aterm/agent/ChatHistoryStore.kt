@@ -0,0 +1,359 @@
+package com.qali.aterm.agent
+
+import com.google.gson.Gson
+import java.io.BufferedInputStream
+import java.io.ByteArrayOutputStream
+import java.io.DataInputStream
+import java.io.DataOutputStream
+import java.io.EOFException
+import java.io.File
+import java.io.FileInputStream
+import java.io.IOException
+import java.io.RandomAccessFile
+import java.net.URLDecoder
+import java.net.URLEncoder
+import java.util.zip.CRC32
+
+/**
+ * Chat history kept as one append-only log file per session
+ *
+ * A log is a small header holding the message count followed by length-prefixed records, each
+ * carrying one message as JSON. Saving only appends records for messages that are new or changed
+ * since the last save, so its cost depends on what changed rather than on the size of the history.
+ * Records that replace a message, or truncate the history, leave dead records behind; once those
+ * outweigh the live ones the log is rewritten.
+ *
+ * The record offsets of every message are kept in memory once a log has been opened, so any page
+ * of messages can be read without parsing the rest. Listing sessions and counting their messages
+ * only reads file names and headers. A record cut short by a crash is dropped when the log is
+ * opened.
+ */
+class ChatHistoryStore(private val directory: File) {
+
+    /** In-memory index of one log; the latest record of message `i` starts at `offsets[i]` */
+    private class SessionLog(val file: File) {
+        var count = 0
+        var offsets = LongArray(INITIAL_CAPACITY)
+        var lengths = IntArray(INITIAL_CAPACITY)
+        var checksums = IntArray(INITIAL_CAPACITY)
+        /** The message each live record was written from or read as, to skip unchanged messages */
+        var known = arrayOfNulls<SerializableAgentMessage>(INITIAL_CAPACITY)
+        /** End of the last valid record */
+        var end = 0L
+        /** Bytes taken by the live records */
+        var liveBytes = 0L
+
+        fun ensureCapacity(capacity: Int) {
+            if (capacity <= offsets.size) return
+            val size = maxOf(capacity, offsets.size * 2)
+            offsets = offsets.copyOf(size)
+            lengths = lengths.copyOf(size)
+            checksums = checksums.copyOf(size)
+            known = known.copyOf(size)
+        }
+
+        fun set(index: Int, offset: Long, length: Int, checksum: Int, message: SerializableAgentMessage?) {
+            if (index < count) {
+                liveBytes -= RECORD_OVERHEAD + lengths[index]
+            } else {
+                ensureCapacity(index + 1)
+                count = index + 1
+            }
+            offsets[index] = offset
+            lengths[index] = length
+            checksums[index] = checksum
+            known[index] = message
+            liveBytes += RECORD_OVERHEAD + length
+        }
+
+        fun truncate(newCount: Int) {
+            for (i in newCount until count) {
+                liveBytes -= RECORD_OVERHEAD + lengths[i]
+                known[i] = null
+            }
+            count = newCount
+        }
+    }
+
+    /** A record written by [save], at [offset] into the appended bytes */
+    private class Written(
+        val index: Int,
+        val offset: Long,
+        val length: Int,
+        val checksum: Int,
+        val message: SerializableAgentMessage
+    )
+
+    private val gson = Gson()
+    private val logs = HashMap<String, SessionLog>()
+
+    /**
+     * Persist [messages] as the history of [sessionId], writing only what changed since the last
+     * save
+     */
+    fun save(sessionId: String, messages: List<SerializableAgentMessage>) {
+        val log = open(sessionId)
+        synchronized(log) {
+            val buffer = ByteArrayOutputStream()
+            val out = DataOutputStream(buffer)
+            val replaced = ArrayList<Written>()
+            val appended = ArrayList<Written>()
+
+            for (i in 0 until minOf(log.count, messages.size)) {
+                val message = messages[i]
+                if (log.known[i] == message) continue
+                val payload = encode(message)
+                val checksum = checksum(payload)
+                if (checksum == log.checksums[i] && payload.size == log.lengths[i]) {
+                    log.known[i] = message
+                    continue
+                }
+                replaced.add(Written(i, buffer.size().toLong(), payload.size, checksum, message))
+                writeRecord(out, TYPE_MESSAGE, i, payload, checksum)
+            }
+            val truncated = messages.size < log.count
+            if (truncated) writeRecord(out, TYPE_TRUNCATE, messages.size, EMPTY, checksum(EMPTY))
+            for (i in log.count until messages.size) {
+                val payload = encode(messages[i])
+                val checksum = checksum(payload)
+                appended.add(Written(i, buffer.size().toLong(), payload.size, checksum, messages[i]))
+                writeRecord(out, TYPE_MESSAGE, i, payload, checksum)
+            }
+            if (buffer.size() == 0) return
+
+            val start = if (log.end == 0L) HEADER_SIZE.toLong() else log.end
+            RandomAccessFile(log.file, "rw").use { raf ->
+                if (log.end == 0L) {
+                    raf.setLength(0)
+                    raf.writeInt(MAGIC)
+                    raf.writeInt(FORMAT_VERSION)
+                    raf.writeInt(0)
+                }
+                raf.seek(start)
+                raf.write(buffer.toByteArray())
+                // The header count only serves listings; opening a log always counts the records
+                raf.seek(COUNT_OFFSET)
+                raf.writeInt(messages.size)
+            }
+            log.end = start + buffer.size()
+
+            // In the order the records were written
+            for (w in replaced) log.set(w.index, start + w.offset, w.length, w.checksum, w.message)
+            if (truncated) log.truncate(messages.size)
+            for (w in appended) log.set(w.index, start + w.offset, w.length, w.checksum, w.message)
+
+            if (log.end - HEADER_SIZE - log.liveBytes > maxOf(COMPACT_MIN_DEAD_BYTES, log.liveBytes)) {
+                compact(log)
+            }
+        }
+    }
+
+    /**
+     * Up to [limit] messages of [sessionId] starting at message [offset]. Only the records of the
+     * requested page are read.
+     */
+    fun load(sessionId: String, offset: Int = 0, limit: Int = Int.MAX_VALUE): List<SerializableAgentMessage> {
+        val log = open(sessionId)
+        synchronized(log) {
+            val from = offset.coerceIn(0, log.count)
+            val to = minOf(log.count.toLong(), from.toLong() + limit.coerceAtLeast(0)).toInt()
+            if (from >= to) return emptyList()
+            val messages = ArrayList<SerializableAgentMessage>(to - from)
+            RandomAccessFile(log.file, "r").use { raf ->
+                for (i in from until to) {
+                    val message = log.known[i] ?: run {
+                        val payload = ByteArray(log.lengths[i])
+                        raf.seek(log.offsets[i] + RECORD_HEADER_SIZE)
+                        raf.readFully(payload)
+                        decode(payload).also { log.known[i] = it }
+                    }
+                    messages.add(message)
+                }
+            }
+            return messages
+        }
+    }
+
+    /**
+     * Number of messages stored for [sessionId], read from the log header if it is not open
+     */
+    fun messageCount(sessionId: String): Int {
+        synchronized(logs) { logs[sessionId] }?.let { log -> return synchronized(log) { log.count } }
+        val file = fileFor(sessionId)
+        if (!file.isFile) return 0
+        return try {
+            DataInputStream(FileInputStream(file)).use { input ->
+                if (input.readInt() != MAGIC || input.readInt() != FORMAT_VERSION) 0 else input.readInt()
+            }
+        } catch (e: IOException) {
+            0
+        }
+    }
+
+    /**
+     * Ids of all sessions with a stored history, least recently saved first
+     */
+    fun sessionIds(): List<String> {
+        val files = directory.listFiles { file -> file.isFile && file.name.endsWith(LOG_SUFFIX) } ?: return emptyList()
+        return files.sortedBy { it.lastModified() }
+            .map { URLDecoder.decode(it.name.removeSuffix(LOG_SUFFIX), "UTF-8") }
+    }
+
+    fun delete(sessionId: String) {
+        synchronized(logs) {
+            logs.remove(sessionId)
+            fileFor(sessionId).delete()
+        }
+    }
+
+    fun clear() {
+        synchronized(logs) {
+            logs.clear()
+            directory.listFiles { file -> file.name.endsWith(LOG_SUFFIX) }?.forEach { it.delete() }
+        }
+    }
+
+    /**
+     * Rewrite the log of [sessionId] with only its live records
+     */
+    internal fun compact(sessionId: String) {
+        val log = open(sessionId)
+        synchronized(log) { compact(log) }
+    }
+
+    /** Size of the log file of [sessionId] */
+    internal fun logSize(sessionId: String): Long = fileFor(sessionId).length()
+
+    private fun open(sessionId: String): SessionLog {
+        synchronized(logs) {
+            return logs.getOrPut(sessionId) {
+                directory.mkdirs()
+                SessionLog(fileFor(sessionId)).also { read(it) }
+            }
+        }
+    }
+
+    private fun fileFor(sessionId: String): File {
+        return File(directory, URLEncoder.encode(sessionId, "UTF-8") + LOG_SUFFIX)
+    }
+
+    /**
+     * Build the index of [log] from its records, dropping a damaged tail
+     */
+    private fun read(log: SessionLog) {
+        val file = log.file
+        if (!file.isFile) return
+        val fileLength = file.length()
+        var position = 0L
+        try {
+            DataInputStream(BufferedInputStream(FileInputStream(file), READ_BUFFER_SIZE)).use { input ->
+                if (input.readInt() != MAGIC || input.readInt() != FORMAT_VERSION) return@use
+                val storedCount = input.readInt()
+                position = HEADER_SIZE.toLong()
+                while (position + RECORD_OVERHEAD <= fileLength) {
+                    val length = input.readInt()
+                    val type = input.readByte().toInt()
+                    val index = input.readInt()
+                    if (length < 0 || position + RECORD_OVERHEAD + length > fileLength) break
+                    val payload = ByteArray(length)
+                    input.readFully(payload)
+                    val checksum = input.readInt()
+                    if (checksum != checksum(payload)) break
+                    when {
+                        type == TYPE_MESSAGE && index <= log.count -> log.set(index, position, length, checksum, null)
+                        type == TYPE_TRUNCATE && index <= log.count -> log.truncate(index)
+                        else -> break
+                    }
+                    position += RECORD_OVERHEAD + length
+                }
+                log.end = position
+                if (position < fileLength || storedCount != log.count) {
+                    RandomAccessFile(file, "rw").use { raf ->
+                        raf.setLength(position)
+                        raf.seek(COUNT_OFFSET)
+                        raf.writeInt(log.count)
+                    }
+                }
+            }
+        } catch (e: EOFException) {
+            log.end = 0
+        }
+        if (log.end == 0L) {
+            // Not a log this version can read; start over rather than append to it
+            log.truncate(0)
+        }
+    }
+
+    private fun compact(log: SessionLog) {
+        val temp = File(log.file.path + ".tmp")
+        val offsets = LongArray(log.count)
+        try {
+            RandomAccessFile(log.file, "r").use { source ->
+                DataOutputStream(temp.outputStream().buffered()).use { out ->
+                    out.writeInt(MAGIC)
+                    out.writeInt(FORMAT_VERSION)
+                    out.writeInt(log.count)
+                    var position = HEADER_SIZE.toLong()
+                    for (i in 0 until log.count) {
+                        val payload = ByteArray(log.lengths[i])
+                        source.seek(log.offsets[i] + RECORD_HEADER_SIZE)
+                        source.readFully(payload)
+                        offsets[i] = position
+                        writeRecord(out, TYPE_MESSAGE, i, payload, log.checksums[i])
+                        position += RECORD_OVERHEAD + payload.size
+                    }
+                }
+            }
+            if (!temp.renameTo(log.file)) {
+                temp.delete()
+                return
+            }
+        } catch (e: IOException) {
+            temp.delete()
+            return
+        }
+        System.arraycopy(offsets, 0, log.offsets, 0, log.count)
+        log.end = HEADER_SIZE + log.liveBytes
+    }
+
+    private fun encode(message: SerializableAgentMessage): ByteArray {
+        return gson.toJson(message).toByteArray(Charsets.UTF_8)
+    }
+
+    private fun decode(payload: ByteArray): SerializableAgentMessage {
+        return gson.fromJson(String(payload, Charsets.UTF_8), SerializableAgentMessage::class.java)
+    }
+
+    private fun writeRecord(out: DataOutputStream, type: Int, index: Int, payload: ByteArray, checksum: Int) {
+        out.writeInt(payload.size)
+        out.writeByte(type)
+        out.writeInt(index)
+        out.write(payload)
+        out.writeInt(checksum)
+    }
+
+    private fun checksum(payload: ByteArray): Int {
+        return CRC32().apply { update(payload) }.value.toInt()
+    }
+
+    companion object {
+        private const val MAGIC = 0x4143484C // "ACHL"
+        private const val FORMAT_VERSION = 1
+        private const val COUNT_OFFSET = 8L
+        private const val HEADER_SIZE = 12
+        /** Length, type and message index */
+        private const val RECORD_HEADER_SIZE = 9
+        /** Header plus the trailing checksum */
+        private const val RECORD_OVERHEAD = RECORD_HEADER_SIZE + 4
+
+        private const val TYPE_MESSAGE = 1
+        private const val TYPE_TRUNCATE = 2
+
+        private const val LOG_SUFFIX = ".log"
+        private const val INITIAL_CAPACITY = 16
+        private const val READ_BUFFER_SIZE = 64 * 1024
+        private const val COMPACT_MIN_DEAD_BYTES = 256 * 1024L
+
+        private val EMPTY = ByteArray(0)
+    }
+}
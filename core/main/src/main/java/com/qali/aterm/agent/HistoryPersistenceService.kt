@@ -6,6 +6,7 @@ import com.google.gson.Gson
 import com.google.gson.reflect.TypeToken
 import com.rk.libcommons.application
 import com.qali.aterm.ui.screens.agent.AgentMessage
+import java.io.File
 import java.lang.reflect.Type
 
 data class SerializableFileDiff(
@@ -64,6 +65,7 @@ object HistoryPersistenceService {
     private const val PREFS_NAME = "agent_history"
     private const val KEY_SESSIONS = "sessions"
     private const val KEY_METADATA = "session_metadata"
+    private const val HISTORY_DIRECTORY = "agent_history"
     private val gson = Gson()
     
     private val prefs: SharedPreferences
@@ -73,27 +75,17 @@ object HistoryPersistenceService {
     private val messagesType: Type = object : TypeToken<List<SerializableAgentMessage>>() {}.type
     private val metadataType: Type = object : TypeToken<Map<String, SessionMetadata>>() {}.type
     
+    private val store: ChatHistoryStore by lazy {
+        ChatHistoryStore(File(application!!.filesDir, HISTORY_DIRECTORY)).also { migrateSessions(it) }
+    }
+    
     /**
-     * Save chat history for a session
+     * Save chat history for a session. Only messages that are new or changed since the last save
+     * are written.
      */
     fun saveHistory(sessionId: String, messages: List<AgentMessage>) {
         try {
-            val serializableMessages = messages.map { SerializableAgentMessage.fromAgentMessage(it) }
-            val messagesJson = gson.toJson(serializableMessages)
-            
-            val sessionsJson = prefs.getString(KEY_SESSIONS, "{}") ?: "{}"
-            val sessions = try {
-                gson.fromJson<Map<String, String>>(sessionsJson, sessionsType) ?: emptyMap()
-            } catch (e: Exception) {
-                emptyMap()
-            }
-            
-            val updatedSessions = sessions.toMutableMap()
-            updatedSessions[sessionId] = messagesJson
-            
-            prefs.edit()
-                .putString(KEY_SESSIONS, gson.toJson(updatedSessions))
-                .apply()
+            store.save(sessionId, messages.map { SerializableAgentMessage.fromAgentMessage(it) })
         } catch (e: Exception) {
             android.util.Log.e("HistoryPersistence", "Failed to save history", e)
         }
@@ -103,29 +95,38 @@ object HistoryPersistenceService {
      * Load chat history for a session
      */
     fun loadHistory(sessionId: String): List<AgentMessage> {
+        return loadHistory(sessionId, 0, Int.MAX_VALUE)
+    }
+    
+    /**
+     * Load up to [limit] messages of a session starting at message [offset]
+     */
+    fun loadHistory(sessionId: String, offset: Int, limit: Int): List<AgentMessage> {
         return try {
-            val sessionsJson = prefs.getString(KEY_SESSIONS, "{}") ?: "{}"
-            val sessions = gson.fromJson<Map<String, String>>(sessionsJson, sessionsType) ?: emptyMap()
-            val messagesJson = sessions[sessionId] ?: return emptyList()
-            
-            val serializableMessages = gson.fromJson<List<SerializableAgentMessage>>(messagesJson, messagesType)
-                ?: return emptyList()
-            
-            serializableMessages.map { it.toAgentMessage() }
+            store.load(sessionId, offset, limit).map { it.toAgentMessage() }
         } catch (e: Exception) {
             android.util.Log.e("HistoryPersistence", "Failed to load history", e)
             emptyList()
         }
     }
     
+    /**
+     * Number of saved messages of a session, without loading them
+     */
+    fun getMessageCount(sessionId: String): Int {
+        return try {
+            store.messageCount(sessionId)
+        } catch (e: Exception) {
+            0
+        }
+    }
+    
     /**
      * Get all session IDs
      */
     fun getAllSessionIds(): List<String> {
         return try {
-            val sessionsJson = prefs.getString(KEY_SESSIONS, "{}") ?: "{}"
-            val sessions = gson.fromJson<Map<String, String>>(sessionsJson, sessionsType) ?: emptyMap()
-            sessions.keys.toList()
+            store.sessionIds()
         } catch (e: Exception) {
             emptyList()
         }
@@ -136,13 +137,7 @@ object HistoryPersistenceService {
      */
     fun deleteHistory(sessionId: String) {
         try {
-            val sessionsJson = prefs.getString(KEY_SESSIONS, "{}") ?: "{}"
-            val sessions = gson.fromJson<MutableMap<String, String>>(sessionsJson, sessionsType) ?: mutableMapOf()
-            sessions.remove(sessionId)
-            
-            prefs.edit()
-                .putString(KEY_SESSIONS, gson.toJson(sessions))
-                .apply()
+            store.delete(sessionId)
         } catch (e: Exception) {
             android.util.Log.e("HistoryPersistence", "Failed to delete history", e)
         }
@@ -153,6 +148,38 @@ object HistoryPersistenceService {
      */
     fun clearAllHistory() {
         prefs.edit().clear().apply()
+        store.clear()
+    }
+    
+    /**
+     * Move histories saved by earlier versions, as one JSON map in preferences, into the store.
+     * Sessions that fail to move stay in preferences and are tried again on the next start.
+     */
+    private fun migrateSessions(store: ChatHistoryStore) {
+        val sessionsJson = prefs.getString(KEY_SESSIONS, null) ?: return
+        val sessions = try {
+            gson.fromJson<Map<String, String>>(sessionsJson, sessionsType) ?: emptyMap()
+        } catch (e: Exception) {
+            android.util.Log.e("HistoryPersistence", "Failed to read history to migrate", e)
+            return
+        }
+        val failed = LinkedHashMap<String, String>()
+        for ((sessionId, messagesJson) in sessions) {
+            try {
+                val messages = gson.fromJson<List<SerializableAgentMessage>>(messagesJson, messagesType) ?: continue
+                // Already moved by an earlier, interrupted migration; a partly written log is completed
+                if (store.messageCount(sessionId) >= messages.size) continue
+                store.save(sessionId, messages)
+            } catch (e: Exception) {
+                android.util.Log.e("HistoryPersistence", "Failed to migrate history of $sessionId", e)
+                failed[sessionId] = messagesJson
+            }
+        }
+        if (failed.isEmpty()) {
+            prefs.edit().remove(KEY_SESSIONS).apply()
+        } else if (failed.size < sessions.size) {
+            prefs.edit().putString(KEY_SESSIONS, gson.toJson(failed)).apply()
+        }
     }
     
     /**
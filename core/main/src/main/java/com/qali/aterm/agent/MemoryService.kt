@@ -1,14 +1,32 @@
 package com.qali.aterm.agent
 
+import com.qali.aterm.agent.utils.Bm25Index
 import com.rk.libcommons.alpineHomeDir
 import java.io.File
 
 /**
  * Service for managing and summarizing memory for intent detection
+ *
+ * The memory file is parsed once and cached until its size or modification time changes, with a
+ * [Bm25Index] over the remembered items so a prompt only gets the ones relevant to the request.
  */
 object MemoryService {
     private const val MEMORY_FILENAME = "GEMINI.md"
     private const val MEMORY_SECTION_HEADER = "## Gemini Added Memories"
+    private const val MAX_MEMORY_ITEMS = 20
+    
+    /**
+     * Parsed memory file as of [length] and [modified]
+     */
+    private class Snapshot(
+        val length: Long,
+        val modified: Long,
+        val text: String,
+        val items: List<String>,
+        val index: Bm25Index<Int>
+    )
+    
+    private var snapshot: Snapshot? = null
     
     /**
      * Get memory file path
@@ -17,47 +35,65 @@ object MemoryService {
         return File(alpineHomeDir(), MEMORY_FILENAME)
     }
     
-    /**
-     * Load all memories
-     */
-    fun loadMemories(): String {
+    @Synchronized
+    private fun currentSnapshot(): Snapshot {
         val memoryFile = getMemoryFile()
-        return if (memoryFile.exists()) {
-            memoryFile.readText()
-        } else {
-            ""
-        }
+        val length = if (memoryFile.exists()) memoryFile.length() else -1L
+        val modified = if (memoryFile.exists()) memoryFile.lastModified() else -1L
+        snapshot?.let { if (it.length == length && it.modified == modified) return it }
+        
+        val text = if (length >= 0) memoryFile.readText() else ""
+        val items = parseMemoryItems(text)
+        val index = Bm25Index<Int>()
+        items.forEachIndexed { i, item -> index.put(i, listOf(item to 1f)) }
+        return Snapshot(length, modified, text, items, index).also { snapshot = it }
     }
     
     /**
-     * Get summarized memory for intent detection
-     * Extracts key facts and context from memory
+     * Memory items (lines starting with -) of the memory section, oldest first
      */
-    fun getSummarizedMemory(): String {
-        val fullMemory = loadMemories()
-        if (fullMemory.isEmpty()) {
-            return ""
-        }
-        
-        // Extract memory section
+    private fun parseMemoryItems(fullMemory: String): List<String> {
         val headerIndex = fullMemory.indexOf(MEMORY_SECTION_HEADER)
         if (headerIndex == -1) {
-            return ""
+            return emptyList()
         }
         
         val memorySection = fullMemory.substring(headerIndex)
-        val lines = memorySection.lines()
-        
-        // Extract memory items (lines starting with -)
-        val memoryItems = lines.filter { it.trim().startsWith("-") }
+        return memorySection.lines()
+            .filter { it.trim().startsWith("-") }
             .map { it.trim().removePrefix("-").trim() }
             .filter { it.isNotEmpty() }
-            .take(20) // Limit to most recent 20 items
-        
-        if (memoryItems.isEmpty()) {
+    }
+    
+    /**
+     * Load all memories
+     */
+    fun loadMemories(): String {
+        return currentSnapshot().text
+    }
+    
+    /**
+     * Get summarized memory for intent detection
+     * Extracts key facts and context from memory. With a [query], the items ranking highest for it
+     * come first and the most recent items fill the remaining room.
+     */
+    fun getSummarizedMemory(query: String? = null): String {
+        val current = currentSnapshot()
+        if (current.items.isEmpty()) {
             return ""
         }
         
+        val selected = LinkedHashSet<Int>()
+        if (query != null) {
+            current.index.search(query, MAX_MEMORY_ITEMS).forEach { selected.add(it.key) }
+        }
+        // Items are appended, so the most recent are at the end
+        var i = current.items.size - 1
+        while (selected.size < MAX_MEMORY_ITEMS && i >= 0) {
+            selected.add(i--)
+        }
+        val memoryItems = selected.map { current.items[it] }
+        
         return buildString {
             appendLine("## User Context from Memory")
             appendLine()
@@ -75,7 +111,6 @@ object MemoryService {
      * Check if memory exists
      */
     fun hasMemory(): Boolean {
-        val memoryFile = getMemoryFile()
-        return memoryFile.exists() && memoryFile.readText().contains(MEMORY_SECTION_HEADER)
+        return currentSnapshot().text.contains(MEMORY_SECTION_HEADER)
     }
 }
@@ -5,13 +5,21 @@ import com.rk.settings.Settings
 import com.qali.aterm.api.ApiProviderManager
 import com.qali.aterm.api.ApiProviderManager.KeysExhaustedException
 import com.qali.aterm.api.ApiProviderType
+import com.qali.aterm.api.HttpClientProvider
 import com.qali.aterm.agent.tools.DeclarativeTool
 import com.qali.aterm.agent.core.*
 import com.qali.aterm.agent.tools.*
 import com.qali.aterm.agent.SystemInfoService
 import com.qali.aterm.agent.MemoryService
+import com.qali.aterm.agent.client.api.ApiResponseParser
+import com.qali.aterm.agent.client.api.SseStreamReader
+import com.qali.aterm.agent.debug.TraceRecorder
+import com.termux.terminal.Tracer
 import java.io.File
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.async
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
 import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.Flow
 import kotlinx.coroutines.flow.flow
@@ -25,7 +33,6 @@ import okhttp3.RequestBody.Companion.toRequestBody
 import org.json.JSONArray
 import org.json.JSONObject
 import java.io.IOException
-import java.util.concurrent.TimeUnit
 
 /**
  * Agent Client for making API calls and handling tool execution
@@ -36,25 +43,26 @@ class AgentClient(
     private val toolRegistry: ToolRegistry,
     private val workspaceRoot: String = alpineDir().absolutePath
 ) {
-    private val client = OkHttpClient.Builder()
-        .connectTimeout(30, TimeUnit.SECONDS)
-        .readTimeout(300, TimeUnit.SECONDS)      // Increased timeout for agent mode
-        .writeTimeout(30, TimeUnit.SECONDS)
-        .build()
+    // Clients share the app-wide connection pool, so provider connections survive across turns
+    private val client = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 30,
+        readTimeoutSeconds = 300,      // Increased timeout for agent mode
+        writeTimeoutSeconds = 30
+    )
     
     // Client with longer timeout for complex requests (metadata generation can take longer)
-    private val longTimeoutClient = OkHttpClient.Builder()
-        .connectTimeout(30, TimeUnit.SECONDS)
-        .readTimeout(180, TimeUnit.SECONDS) // 3 minutes for complex metadata generation
-        .writeTimeout(60, TimeUnit.SECONDS)
-        .build()
+    private val longTimeoutClient = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 30,
+        readTimeoutSeconds = 180, // 3 minutes for complex metadata generation
+        writeTimeoutSeconds = 60
+    )
     
     // Client with 20-second timeout for Gemini API calls to prevent infinite "thinking"
-    private val geminiClient = OkHttpClient.Builder()
-        .connectTimeout(10, TimeUnit.SECONDS)
-        .readTimeout(20, TimeUnit.SECONDS) // 20 seconds hard timeout for Gemini
-        .writeTimeout(10, TimeUnit.SECONDS)
-        .build()
+    private val geminiClient = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 10,
+        readTimeoutSeconds = 20, // 20 seconds hard timeout for Gemini
+        writeTimeoutSeconds = 10
+    )
     
     private val chatHistory = mutableListOf<Content>()
     
@@ -160,63 +168,63 @@ class AgentClient(
             var finishReason: String? = null
             val toolCallsToExecute = mutableListOf<Triple<FunctionCall, ToolResult, String>>() // FunctionCall, ToolResult, callId
             
-            // Collect events to emit after API call (since callbacks aren't in coroutine context)
-            val eventsToEmit = mutableListOf<AgentEvent>()
+            // Callbacks run on the IO thread reading the response, so events are handed over through a
+            // channel and emitted here while the stream is still being read
+            val streamedEvents = Channel<AgentEvent>(Channel.UNLIMITED)
+            var hasTextContent = false
             
             // Make API call with retry
-            val result = ApiProviderManager.makeApiCallWithRetry { key ->
-                try {
-                    android.util.Log.d("AgentClient", "sendMessage: Attempting API call")
-                    kotlinx.coroutines.withContext(kotlinx.coroutines.Dispatchers.IO) {
-                        finishReason = makeApiCall(
-                            key, 
-                            model, 
-                            requestBody, 
-                            { chunk ->
-                                // Call the callback and collect event to emit later
-                                onChunk(chunk)
-                                eventsToEmit.add(AgentEvent.Chunk(chunk))
-                            }, 
-                            { functionCall ->
-                                onToolCall(functionCall)
-                                eventsToEmit.add(AgentEvent.ToolCall(functionCall))
-                                hasToolCalls = true
-                            },
-                            { toolName, args ->
-                                onToolResult(toolName, args)
-                                // Note: ToolResult event will be emitted after tool execution completes
-                            },
-                            toolCallsToExecute
-                        )
-                    }
-                    android.util.Log.d("AgentClient", "sendMessage: API call completed successfully, finishReason: $finishReason")
-                    Result.success(Unit)
-                } catch (e: KeysExhaustedException) {
-                    android.util.Log.e("AgentClient", "sendMessage: Keys exhausted", e)
-                    Result.failure(e)
-                } catch (e: Exception) {
-                    android.util.Log.e("AgentClient", "sendMessage: Exception during API call", e)
-                    android.util.Log.e("AgentClient", "sendMessage: Exception type: ${e.javaClass.simpleName}")
-                    android.util.Log.e("AgentClient", "sendMessage: Exception message: ${e.message}")
-                    if (ApiProviderManager.isRateLimitError(e)) {
-                        android.util.Log.w("AgentClient", "sendMessage: Rate limit error detected")
-                        Result.failure(e)
-                    } else {
-                        Result.failure(e)
+            val result = coroutineScope {
+                val apiCall = async(Dispatchers.IO) {
+                    try {
+                        ApiProviderManager.makeApiCallWithRetry { key ->
+                            try {
+                                android.util.Log.d("AgentClient", "sendMessage: Attempting API call")
+                                finishReason = makeApiCall(
+                                    key, 
+                                    model, 
+                                    requestBody, 
+                                    { chunk ->
+                                        onChunk(chunk)
+                                        hasTextContent = true
+                                        streamedEvents.trySend(AgentEvent.Chunk(chunk))
+                                    }, 
+                                    { functionCall ->
+                                        onToolCall(functionCall)
+                                        streamedEvents.trySend(AgentEvent.ToolCall(functionCall))
+                                        hasToolCalls = true
+                                    },
+                                    { toolName, args ->
+                                        onToolResult(toolName, args)
+                                        // Note: ToolResult event will be emitted after tool execution completes
+                                    },
+                                    toolCallsToExecute
+                                )
+                                android.util.Log.d("AgentClient", "sendMessage: API call completed successfully, finishReason: $finishReason")
+                                Result.success(Unit)
+                            } catch (e: KeysExhaustedException) {
+                                android.util.Log.e("AgentClient", "sendMessage: Keys exhausted", e)
+                                Result.failure(e)
+                            } catch (e: Exception) {
+                                android.util.Log.e("AgentClient", "sendMessage: Exception during API call", e)
+                                android.util.Log.e("AgentClient", "sendMessage: Exception type: ${e.javaClass.simpleName}")
+                                android.util.Log.e("AgentClient", "sendMessage: Exception message: ${e.message}")
+                                if (ApiProviderManager.isRateLimitError(e)) {
+                                    android.util.Log.w("AgentClient", "sendMessage: Rate limit error detected")
+                                    Result.failure(e)
+                                } else {
+                                    Result.failure(e)
+                                }
+                            }
+                        }
+                    } finally {
+                        streamedEvents.close()
                     }
                 }
-            }
-            
-            // Emit collected events (chunks and tool calls) now that we're back in coroutine context
-            if (eventsToEmit.isNotEmpty()) {
-                android.util.Log.d("AgentClient", "sendMessage: Emitting ${eventsToEmit.size} collected event(s)")
-                for (event in eventsToEmit) {
-                    android.util.Log.d("AgentClient", "sendMessage: Emitting event: ${event.javaClass.simpleName}")
+                for (event in streamedEvents) {
                     emit(event)
                 }
-                eventsToEmit.clear()
-            } else {
-                android.util.Log.d("AgentClient", "sendMessage: No events collected to emit")
+                apiCall.await()
             }
             
             if (result.isFailure) {
@@ -234,7 +242,6 @@ class AgentClient(
             // If we have text content but no finish reason, assume STOP (model finished generating text)
             if (toolCallsToExecute.isEmpty() && finishReason == null) {
                 // Check if we received any text chunks in this turn
-                val hasTextContent = eventsToEmit.any { it is AgentEvent.Chunk }
                 if (hasTextContent) {
                     android.util.Log.d("AgentClient", "sendMessage: No finish reason but has text content, assuming STOP")
                     finishReason = "STOP"
@@ -346,15 +353,15 @@ class AgentClient(
         val providerType = ApiProviderManager.selectedProvider
         val (url, convertedRequestBody, headers) = when (providerType) {
             ApiProviderType.GOOGLE -> {
-                // Google Gemini API endpoint - using standard API calls
-                val url = "https://generativelanguage.googleapis.com/v1beta/models/$model:generateContent?key=$apiKey"
+                // Google Gemini API endpoint - streamed as SSE so chunks arrive as they are generated
+                val url = "https://generativelanguage.googleapis.com/v1beta/models/$model:streamGenerateContent?alt=sse&key=$apiKey"
                 Triple(url, requestBody, emptyMap<String, String>())
             }
             ApiProviderType.OPENAI -> {
                 // OpenAI API endpoint
                 val url = "https://api.openai.com/v1/chat/completions"
                 val headers = mapOf("Authorization" to "Bearer $apiKey")
-                val convertedBody = convertRequestToOpenAI(requestBody, model)
+                val convertedBody = convertRequestToOpenAI(requestBody, model, stream = true)
                 Triple(url, convertedBody, headers)
             }
             ApiProviderType.ANTHROPIC -> {
@@ -364,7 +371,7 @@ class AgentClient(
                     "x-api-key" to apiKey,
                     "anthropic-version" to "2023-06-01"
                 )
-                val convertedBody = convertRequestToAnthropic(requestBody, model)
+                val convertedBody = convertRequestToAnthropic(requestBody, model, stream = true)
                 Triple(url, convertedBody, headers)
             }
             ApiProviderType.GPTSCRIPT -> {
@@ -416,7 +423,8 @@ class AgentClient(
                         baseUrl
                     }
                     val convertedBody = if (url.contains("ollama") || url.contains(":11434") || url.contains(":1201")) {
-                        convertRequestToOllama(requestBody, model)
+                        // The GPT Script proxy on :1201 expects a JSON reply, like the GPTSCRIPT provider
+                        convertRequestToOllama(requestBody, model, stream = !url.contains(":1201"))
                     } else {
                         requestBody // Assume Gemini-compatible format
                     }
@@ -430,7 +438,7 @@ class AgentClient(
                             else -> "http://localhost:11434"
                         }
                         val url = "$fallbackBaseUrl/api/chat"
-                        val convertedBody = convertRequestToOllama(requestBody, model)
+                        val convertedBody = convertRequestToOllama(requestBody, model, stream = true)
                         Triple(url, convertedBody, emptyMap<String, String>())
                     } else {
                         // Generic custom API - assume it's a full URL and Gemini-compatible format
@@ -440,7 +448,7 @@ class AgentClient(
             }
             else -> {
                 // For other providers, use Gemini-compatible endpoint for now
-                val url = "https://generativelanguage.googleapis.com/v1beta/models/$model:generateContent?key=$apiKey"
+                val url = "https://generativelanguage.googleapis.com/v1beta/models/$model:streamGenerateContent?alt=sse&key=$apiKey"
                 Triple(url, requestBody, emptyMap<String, String>())
             }
         }
@@ -470,6 +478,7 @@ class AgentClient(
         
         android.util.Log.d("AgentClient", "makeApiCall: Executing request...")
         val startTime = System.currentTimeMillis()
+        val traceStart = Tracer.now()
         
         // Use geminiClient for Google provider to enforce 20-second timeout
         // This prevents infinite "thinking" when Gemini API is slow or unresponsive
@@ -489,6 +498,8 @@ class AgentClient(
                 httpClient.newCall(request).execute()
             }
             
+            Tracer.completeAsync("api.response", traceStart, model)
+            
             response.use { resp ->
                 val elapsed = System.currentTimeMillis() - startTime
                 android.util.Log.d("AgentClient", "makeApiCall: Response received after ${elapsed}ms")
@@ -502,87 +513,68 @@ class AgentClient(
                     throw IOException("API call failed: ${resp.code} - $errorBody")
                 }
                 
-                android.util.Log.d("AgentClient", "makeApiCall: Reading response body...")
+                android.util.Log.d("AgentClient", "makeApiCall: Streaming response body...")
                 resp.body?.let { body ->
-                    val contentLength = body.contentLength()
-                    android.util.Log.d("AgentClient", "makeApiCall: Response body content length: $contentLength")
-                    
-                    // Read the entire body
-                    val bodyString = body.string()
-                    android.util.Log.d("AgentClient", "makeApiCall: Response body string length: ${bodyString.length}")
-                    
-                    if (bodyString.isEmpty()) {
-                        android.util.Log.w("AgentClient", "makeApiCall: Response body is empty!")
-                        return@let
+                    // Frames are parsed as they arrive so onChunk/onToolCall fire while the model is still generating
+                    val reader = SseStreamReader(body.source())
+                    var firstChunk = true
+                    val timedOnChunk: (String) -> Unit = { chunk ->
+                        if (firstChunk) {
+                            firstChunk = false
+                            Tracer.completeAsync("api.firstChunk", traceStart, model)
+                            android.util.Log.d("AgentClient", "makeApiCall: First chunk after ${System.currentTimeMillis() - startTime}ms")
+                        }
+                        onChunk(chunk)
                     }
                     
                     try {
                         // Parse response based on provider type
                         val finishReason = when (providerType) {
-                            ApiProviderType.GOOGLE -> {
-                                // Try parsing as JSON array first (standard response)
-                                if (bodyString.trim().startsWith("[")) {
-                                    android.util.Log.d("AgentClient", "makeApiCall: Detected JSON array format (standard)")
-                                    val jsonArray = JSONArray(bodyString)
-                                    android.util.Log.d("AgentClient", "makeApiCall: JSON array has ${jsonArray.length()} elements")
-                                    
-                                    var lastFinishReason: String? = null
-                                    var hasContent = false
-                                    for (i in 0 until jsonArray.length()) {
-                                        val json = jsonArray.getJSONObject(i)
-                                        android.util.Log.d("AgentClient", "makeApiCall: Processing array element $i")
-                                        val fr = processResponse(json, onChunk, onToolCall, onToolResult, toolCallsToExecute, providerType)
-                                        if (fr != null) {
-                                            lastFinishReason = fr
-                                        }
-                                        // Check if this element has content (text or function calls)
-                                        val candidates = json.optJSONArray("candidates")
-                                        if (candidates != null && candidates.length() > 0) {
-                                            val candidate = candidates.optJSONObject(0)
-                                            if (candidate != null && candidate.has("content")) {
-                                                hasContent = true
-                                            }
-                                        }
-                                    }
-                                    // If we have content but no finish reason, assume STOP
-                                    if (lastFinishReason == null && hasContent) {
-                                        android.util.Log.d("AgentClient", "makeApiCall: No finish reason in array but has content, assuming STOP")
-                                        "STOP"
-                                    } else {
-                                        lastFinishReason
-                                    }
-                                } else {
-                                    // Try parsing as SSE (Server-Sent Events) format
-                                    parseGeminiSSEResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
-                                }
-                            }
                             ApiProviderType.OPENAI -> {
-                                parseOpenAIResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                ApiResponseParser.parseOpenAIStream(
+                                    reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                ) { parseOpenAIResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute) }
                             }
                             ApiProviderType.ANTHROPIC -> {
-                                parseAnthropicResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                ApiResponseParser.parseAnthropicStream(
+                                    reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                ) { parseAnthropicResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute) }
                             }
                             ApiProviderType.GPTSCRIPT -> {
                                 // GPT Script uses Ollama-compatible response format
-                                parseOllamaResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                ApiResponseParser.parseOllamaStream(
+                                    reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                ) { parseOllamaResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute) }
                             }
                             ApiProviderType.CUSTOM -> {
                                 if (apiKey.contains("localhost") || apiKey.contains("127.0.0.1") || apiKey.contains("ollama") || apiKey.contains(":11434") || apiKey.contains(":1201")) {
-                                    parseOllamaResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                    ApiResponseParser.parseOllamaStream(
+                                        reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                    ) { parseOllamaResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute) }
                                 } else {
                                     // Generic custom - try Gemini format
-                                    parseGeminiSSEResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                    ApiResponseParser.parseGeminiStream(
+                                        reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                    ) { processResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, providerType) }
                                 }
                             }
                             else -> {
-                                // Default to Gemini format
-                                parseGeminiSSEResponse(bodyString, onChunk, onToolCall, onToolResult, toolCallsToExecute)
+                                // Gemini (SSE, or a single JSON object/array when the endpoint does not stream)
+                                ApiResponseParser.parseGeminiStream(
+                                    reader, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, ::jsonObjectToMap
+                                ) { processResponse(it, timedOnChunk, onToolCall, onToolResult, toolCallsToExecute, providerType) }
                             }
                         }
+                        android.util.Log.d("AgentClient", "makeApiCall: Stream finished after ${System.currentTimeMillis() - startTime}ms (${reader.frameCount} frames)")
+                        if (reader.frameCount == 0 && reader.unframedText.isBlank()) {
+                            android.util.Log.w("AgentClient", "makeApiCall: Response body is empty!")
+                        }
                         return finishReason
+                    } catch (e: IOException) {
+                        throw e
                     } catch (e: Exception) {
-                        android.util.Log.e("AgentClient", "makeApiCall: Failed to parse response body", e)
-                        android.util.Log.e("AgentClient", "makeApiCall: Response preview: ${bodyString.take(500)}")
+                        android.util.Log.e("AgentClient", "makeApiCall: Failed to parse response stream", e)
+                        android.util.Log.e("AgentClient", "makeApiCall: Unparsed response preview: ${reader.unframedText.take(500)}")
                         throw IOException("Failed to parse response: ${e.message}", e)
                     }
                 } ?: run {
@@ -601,73 +593,12 @@ class AgentClient(
             val elapsed = System.currentTimeMillis() - startTime
             android.util.Log.e("AgentClient", "makeApiCall: Unexpected exception after ${elapsed}ms", e)
             throw e
+        } finally {
+            Tracer.completeAsync("api.call", traceStart, model)
         }
         return null // No finish reason found
     }
     
-    /**
-     * Parse Gemini SSE response format
-     */
-    private suspend fun parseGeminiSSEResponse(
-        bodyString: String,
-        onChunk: (String) -> Unit,
-        onToolCall: (FunctionCall) -> Unit,
-        onToolResult: (String, Map<String, Any>) -> Unit,
-        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>
-    ): String? {
-        // Try parsing as SSE (Server-Sent Events) format
-        android.util.Log.d("AgentClient", "makeApiCall: Attempting SSE format parsing")
-        val lines = bodyString.lines()
-        android.util.Log.d("AgentClient", "makeApiCall: Total lines in response: ${lines.size}")
-        
-        var lineCount = 0
-        var dataLineCount = 0
-        
-        for (line in lines) {
-            lineCount++
-            val trimmedLine = line.trim()
-            
-            if (trimmedLine.isEmpty()) continue
-            
-            if (trimmedLine.startsWith("data: ")) {
-                dataLineCount++
-                val jsonStr = trimmedLine.substring(6)
-                if (jsonStr == "[DONE]" || jsonStr.isEmpty()) {
-                    android.util.Log.d("AgentClient", "makeApiCall: Received [DONE] marker")
-                    continue
-                }
-                
-                try {
-                    android.util.Log.d("AgentClient", "makeApiCall: Parsing SSE data line $dataLineCount")
-                    val json = JSONObject(jsonStr)
-                    android.util.Log.d("AgentClient", "makeApiCall: Processing SSE data line $dataLineCount")
-                    val finishReason = processResponse(json, onChunk, onToolCall, onToolResult, toolCallsToExecute, ApiProviderType.GOOGLE)
-                    if (finishReason != null) {
-                        return finishReason
-                    }
-                } catch (e: Exception) {
-                    android.util.Log.e("AgentClient", "makeApiCall: Failed to parse SSE JSON on line $dataLineCount", e)
-                    android.util.Log.e("AgentClient", "makeApiCall: JSON string: ${jsonStr.take(500)}")
-                }
-            } else if (trimmedLine.startsWith(":")) {
-                // SSE comment line, skip
-                android.util.Log.d("AgentClient", "makeApiCall: Skipping SSE comment line")
-            } else {
-                // Try parsing the whole body as a single JSON object
-                try {
-                    android.util.Log.d("AgentClient", "makeApiCall: Attempting to parse as single JSON object")
-                    val json = JSONObject(bodyString)
-                    android.util.Log.d("AgentClient", "makeApiCall: Processing single JSON object")
-                    return processResponse(json, onChunk, onToolCall, onToolResult, toolCallsToExecute, ApiProviderType.GOOGLE)
-                } catch (e: Exception) {
-                    android.util.Log.w("AgentClient", "makeApiCall: Unexpected line format: ${trimmedLine.take(100)}")
-                }
-            }
-        }
-        android.util.Log.d("AgentClient", "makeApiCall: Finished SSE parsing. Total lines: $lineCount, Data lines: $dataLineCount")
-        return null
-    }
-    
     /**
      * Parse OpenAI response format
      */
@@ -887,10 +818,10 @@ class AgentClient(
     /**
      * Convert Gemini request format to OpenAI format
      */
-    private fun convertRequestToOpenAI(geminiRequest: JSONObject, model: String): JSONObject {
+    private fun convertRequestToOpenAI(geminiRequest: JSONObject, model: String, stream: Boolean = false): JSONObject {
         val openAIRequest = JSONObject()
         openAIRequest.put("model", model)
-        openAIRequest.put("stream", false) // Standard for now
+        openAIRequest.put("stream", stream)
         
         val messages = JSONArray()
         val contents = geminiRequest.optJSONArray("contents")
@@ -995,9 +926,12 @@ class AgentClient(
     /**
      * Convert Gemini request format to Anthropic format
      */
-    private fun convertRequestToAnthropic(geminiRequest: JSONObject, model: String): JSONObject {
+    private fun convertRequestToAnthropic(geminiRequest: JSONObject, model: String, stream: Boolean = false): JSONObject {
         val anthropicRequest = JSONObject()
         anthropicRequest.put("model", model)
+        if (stream) {
+            anthropicRequest.put("stream", true)
+        }
         anthropicRequest.put("max_tokens", 4096)
         
         val messages = JSONArray()
@@ -1072,12 +1006,16 @@ class AgentClient(
         return match?.value
     }
 
-    private fun convertRequestToOllama(geminiRequest: JSONObject, model: String): JSONObject {
+    private fun convertRequestToOllama(geminiRequest: JSONObject, model: String, stream: Boolean = false): JSONObject {
         val ollamaRequest = JSONObject()
         ollamaRequest.put("model", model)
-        ollamaRequest.put("stream", false) // Standard
+        ollamaRequest.put("stream", stream)
         ollamaRequest.put("agent_mode", true)
-        ollamaRequest.put("format", "json")
+        // Only the unstreamed proxy expects a JSON reply; constraining a streamed reply to JSON
+        // would hand onChunk fragments of a JSON document instead of text and keep tool calls out
+        if (!stream) {
+            ollamaRequest.put("format", "json")
+        }
 
         val messages = JSONArray()
         val contents = geminiRequest.optJSONArray("contents")
@@ -1299,7 +1237,7 @@ class AgentClient(
                 
                 // Execute tool - already on IO dispatcher from outer withContext
                 try {
-                    invocation.execute(null, null)
+                    TraceRecorder.span("agent.tool", name) { invocation.execute(null, null) }
                 } catch (e: Exception) {
                     android.util.Log.e("AgentClient", "Error executing tool $name", e)
                     throw e
@@ -1416,7 +1354,7 @@ class AgentClient(
             append("\n")
             
             // Add memory context if available
-            val memoryContext = MemoryService.getSummarizedMemory()
+            val memoryContext = MemoryService.getSummarizedMemory(userMessage)
             if (memoryContext.isNotEmpty()) {
                 append(memoryContext)
                 append("\n")
@@ -1812,7 +1750,7 @@ class AgentClient(
         val intents = mutableListOf<IntentType>()
         
         // Load memory context for better intent detection
-        val memoryContext = MemoryService.getSummarizedMemory()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage)
         
         val debugKeywords = listOf(
             "debug", "fix", "repair", "error", "bug", "issue", "problem",
@@ -1916,7 +1854,7 @@ class AgentClient(
     @Deprecated("Use detectIntents() for multi-intent support")
     private suspend fun detectIntent(userMessage: String): IntentType {
         // Load memory context for better intent detection
-        val memoryContext = MemoryService.getSummarizedMemory()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage)
         
         val debugKeywords = listOf(
             "debug", "fix", "repair", "error", "bug", "issue", "problem",
@@ -2023,7 +1961,7 @@ class AgentClient(
      */
     private fun needsDocumentationSearch(userMessage: String): Boolean {
         val messageLower = userMessage.lowercase()
-        val memoryContext = MemoryService.getSummarizedMemory().lowercase()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage).lowercase()
         val contextLower = (userMessage + " " + memoryContext).lowercase()
         
         // Keywords indicating need for documentation/search
@@ -3477,10 +3415,7 @@ class AgentClient(
         onChunk: (String) -> Unit,
         maxWaitSeconds: Int = 30
     ): Boolean {
-        val client = OkHttpClient.Builder()
-            .connectTimeout(2, TimeUnit.SECONDS)
-            .readTimeout(2, TimeUnit.SECONDS)
-            .build()
+        val client = HttpClientProvider.newClient(connectTimeoutSeconds = 2, readTimeoutSeconds = 2)
         
         val healthPaths = listOf("/", "/health", "/api/health", "/status")
         val startTime = System.currentTimeMillis()
@@ -3960,10 +3895,7 @@ exports.$functionName = (req, res, next) => {
         emit(AgentEvent.Chunk("🧪 Testing ${endpoint.method} $url - ${endpoint.description}\n"))
         onChunk("🧪 Testing ${endpoint.method} $url - ${endpoint.description}\n")
         
-        val client = OkHttpClient.Builder()
-            .connectTimeout(5, TimeUnit.SECONDS)
-            .readTimeout(5, TimeUnit.SECONDS)
-            .build()
+        val client = HttpClientProvider.newClient(connectTimeoutSeconds = 5, readTimeoutSeconds = 5)
         
         return try {
             val requestBuilder = Request.Builder().url(url)
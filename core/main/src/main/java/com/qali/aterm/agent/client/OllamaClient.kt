@@ -4,6 +4,7 @@ import com.qali.aterm.agent.client.api.ApiResponseParser
 import com.qali.aterm.agent.core.FunctionCall
 import com.qali.aterm.agent.client.AgentEvent
 import com.qali.aterm.agent.tools.*
+import com.qali.aterm.api.HttpClientProvider
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.flow.Flow
 import kotlinx.coroutines.flow.flow
@@ -14,7 +15,6 @@ import okhttp3.RequestBody.Companion.toRequestBody
 import org.json.JSONArray
 import org.json.JSONObject
 import java.io.IOException
-import java.util.concurrent.TimeUnit
 
 class OllamaClient(
     private val toolRegistry: ToolRegistry,
@@ -23,11 +23,11 @@ class OllamaClient(
     private val model: String = "gptfree",
     private val apiKey: String? = null
 ) {
-    private val client = OkHttpClient.Builder()
-        .connectTimeout(30, TimeUnit.SECONDS)
-        .readTimeout(300, TimeUnit.SECONDS)
-        .writeTimeout(60, TimeUnit.SECONDS)
-        .build()
+    private val client = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 30,
+        readTimeoutSeconds = 300,
+        writeTimeoutSeconds = 60
+    )
     
     private val chatHistory = mutableListOf<Map<String, Any>>()
     
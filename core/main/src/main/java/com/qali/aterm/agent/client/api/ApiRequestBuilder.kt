@@ -109,8 +109,11 @@ class ApiRequestBuilder(
             append(SystemInfoService.generateSystemContext())
             append("\n")
             
-            // Add memory context if available
-            val memoryContext = MemoryService.getSummarizedMemory()
+            // Add memory context if available, ranked against the latest user request
+            val latestUserText = chatHistory.lastOrNull { it.role == "user" }
+                ?.parts?.filterIsInstance<Part.TextPart>()
+                ?.joinToString(" ") { it.text }
+            val memoryContext = MemoryService.getSummarizedMemory(latestUserText)
             if (memoryContext.isNotEmpty()) {
                 append(memoryContext)
                 append("\n")
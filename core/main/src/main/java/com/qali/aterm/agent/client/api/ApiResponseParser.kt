@@ -7,6 +7,7 @@ import com.qali.aterm.agent.core.Part
 import com.qali.aterm.agent.tools.ToolResult
 import org.json.JSONArray
 import org.json.JSONObject
+import java.io.IOException
 
 /**
  * Parses API responses from different providers
@@ -475,6 +476,324 @@ object ApiResponseParser {
         return if (done) "STOP" else null
     }
     
+    /**
+     * Parse a streamed Gemini response (`streamGenerateContent?alt=sse`)
+     * Every frame is a complete response chunk and is handed to [processChunk] as soon as it arrives.
+     * Falls back to a single JSON object or array when the endpoint did not stream.
+     */
+    suspend fun parseGeminiStream(
+        reader: SseStreamReader,
+        onChunk: (String) -> Unit,
+        onToolCall: (FunctionCall) -> Unit,
+        onToolResult: (String, Map<String, Any>) -> Unit,
+        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>,
+        jsonObjectToMap: (JSONObject) -> Map<String, Any>,
+        processChunk: suspend (JSONObject) -> String? = {
+            processGeminiResponse(it, onChunk, onToolCall, onToolResult, toolCallsToExecute, jsonObjectToMap)
+        }
+    ): String? {
+        var finishReason: String? = null
+        while (true) {
+            val event = reader.next() ?: break
+            if (event.data.isEmpty() || event.data == "[DONE]") continue
+            val json = JSONObject(event.data)
+            json.optJSONObject("error")?.let { error ->
+                throw IOException("API stream error: ${error.optInt("code")} - ${error.optString("message")}")
+            }
+            // Later chunks may only carry usage metadata, so keep the first finish reason
+            processChunk(json)?.let { if (finishReason == null) finishReason = it }
+        }
+        
+        val unframed = reader.unframedText.trim()
+        if (reader.frameCount > 0 || unframed.isEmpty()) {
+            return finishReason
+        }
+        
+        android.util.Log.d("ApiResponseParser", "Gemini response was not streamed, parsing buffered body")
+        if (!unframed.startsWith("[")) {
+            return processChunk(JSONObject(unframed))
+        }
+        val jsonArray = JSONArray(unframed)
+        var hasContent = false
+        for (i in 0 until jsonArray.length()) {
+            val json = jsonArray.getJSONObject(i)
+            processChunk(json)?.let { finishReason = it }
+            if (json.optJSONArray("candidates")?.optJSONObject(0)?.has("content") == true) {
+                hasContent = true
+            }
+        }
+        // If we have content but no finish reason, assume STOP
+        return finishReason ?: if (hasContent) "STOP" else null
+    }
+    
+    /**
+     * Parse a streamed OpenAI chat completion (`stream: true`)
+     * Text deltas are emitted immediately. Tool call names and argument fragments arrive spread over
+     * several frames keyed by index, so calls are only reported once the stream is complete.
+     */
+    fun parseOpenAIStream(
+        reader: SseStreamReader,
+        onChunk: (String) -> Unit,
+        onToolCall: (FunctionCall) -> Unit,
+        onToolResult: (String, Map<String, Any>) -> Unit,
+        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>,
+        jsonObjectToMap: (JSONObject) -> Map<String, Any>,
+        parseBuffered: (String) -> String? = {
+            parseOpenAIResponse(it, onChunk, onToolCall, onToolResult, toolCallsToExecute, jsonObjectToMap)
+        }
+    ): String? {
+        val pendingToolCalls = java.util.TreeMap<Int, PendingToolCall>()
+        var finishReason: String? = null
+        
+        while (true) {
+            val event = reader.next() ?: break
+            if (event.data == "[DONE]") break
+            if (event.data.isEmpty()) continue
+            val json = JSONObject(event.data)
+            json.optJSONObject("error")?.let { error ->
+                throw IOException("API stream error: ${error.optString("message")}")
+            }
+            val choice = json.optJSONArray("choices")?.optJSONObject(0) ?: continue
+            
+            val delta = choice.optJSONObject("delta")
+            if (delta != null) {
+                if (!delta.isNull("content")) {
+                    val content = delta.optString("content", "")
+                    if (content.isNotEmpty()) {
+                        onChunk(content)
+                    }
+                }
+                val toolCalls = delta.optJSONArray("tool_calls")
+                if (toolCalls != null) {
+                    for (i in 0 until toolCalls.length()) {
+                        val toolCall = toolCalls.getJSONObject(i)
+                        val pending = pendingToolCalls.getOrPut(toolCall.optInt("index", i)) { PendingToolCall() }
+                        if (!toolCall.isNull("id")) pending.id = toolCall.optString("id", pending.id)
+                        val function = toolCall.optJSONObject("function") ?: continue
+                        if (!function.isNull("name")) pending.name += function.optString("name", "")
+                        if (!function.isNull("arguments")) pending.arguments.append(function.optString("arguments", ""))
+                    }
+                }
+            }
+            if (!choice.isNull("finish_reason")) {
+                finishReason = choice.optString("finish_reason")
+            }
+        }
+        
+        if (reader.frameCount == 0 && reader.unframedText.isNotBlank()) {
+            android.util.Log.d("ApiResponseParser", "OpenAI response was not streamed, parsing buffered body")
+            return parseBuffered(reader.unframedText)
+        }
+        
+        for (pending in pendingToolCalls.values) {
+            if (pending.name.isEmpty()) continue
+            reportToolCall(pending.name, pending.arguments.toString(), pending.id, onToolCall, toolCallsToExecute, jsonObjectToMap)
+        }
+        
+        return when (val reason = finishReason) {
+            null -> null
+            "stop" -> "STOP"
+            "length" -> "MAX_TOKENS"
+            "tool_calls" -> null // Continue for tool calls
+            else -> reason.uppercase()
+        }
+    }
+    
+    /**
+     * Parse a streamed Anthropic message (`stream: true`)
+     * Text deltas are emitted immediately; a tool_use block is reported when its content_block_stop
+     * arrives, after its partial JSON input has been joined.
+     */
+    fun parseAnthropicStream(
+        reader: SseStreamReader,
+        onChunk: (String) -> Unit,
+        onToolCall: (FunctionCall) -> Unit,
+        onToolResult: (String, Map<String, Any>) -> Unit,
+        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>,
+        jsonObjectToMap: (JSONObject) -> Map<String, Any>,
+        parseBuffered: (String) -> String? = {
+            parseAnthropicResponse(it, onChunk, onToolCall, onToolResult, toolCallsToExecute, jsonObjectToMap)
+        }
+    ): String? {
+        val toolBlocks = mutableMapOf<Int, PendingToolCall>()
+        var stopReason: String? = null
+        
+        while (true) {
+            val event = reader.next() ?: break
+            if (event.data.isEmpty()) continue
+            val json = JSONObject(event.data)
+            val index = json.optInt("index", 0)
+            when (json.optString("type", event.event ?: "")) {
+                "content_block_start" -> {
+                    val block = json.optJSONObject("content_block") ?: continue
+                    when (block.optString("type", "")) {
+                        "text" -> {
+                            val text = block.optString("text", "")
+                            if (text.isNotEmpty()) {
+                                onChunk(text)
+                            }
+                        }
+                        "tool_use" -> {
+                            toolBlocks[index] = PendingToolCall(
+                                id = block.optString("id", ""),
+                                name = block.optString("name", "")
+                            )
+                        }
+                    }
+                }
+                "content_block_delta" -> {
+                    val delta = json.optJSONObject("delta") ?: continue
+                    when (delta.optString("type", "")) {
+                        "text_delta" -> {
+                            val text = delta.optString("text", "")
+                            if (text.isNotEmpty()) {
+                                onChunk(text)
+                            }
+                        }
+                        "input_json_delta" -> toolBlocks[index]?.arguments?.append(delta.optString("partial_json", ""))
+                    }
+                }
+                "content_block_stop" -> {
+                    val pending = toolBlocks.remove(index) ?: continue
+                    reportToolCall(pending.name, pending.arguments.toString(), pending.id, onToolCall, toolCallsToExecute, jsonObjectToMap)
+                }
+                "message_delta" -> {
+                    val delta = json.optJSONObject("delta")
+                    if (delta != null && !delta.isNull("stop_reason")) {
+                        stopReason = delta.optString("stop_reason")
+                    }
+                }
+                "error" -> {
+                    val error = json.optJSONObject("error")
+                    throw IOException("API stream error: ${error?.optString("type")} - ${error?.optString("message")}")
+                }
+                // message_start, message_stop and ping carry nothing we need
+            }
+        }
+        
+        if (reader.frameCount == 0 && reader.unframedText.isNotBlank()) {
+            android.util.Log.d("ApiResponseParser", "Anthropic response was not streamed, parsing buffered body")
+            return parseBuffered(reader.unframedText)
+        }
+        
+        return when (stopReason) {
+            null -> null
+            "max_tokens" -> "MAX_TOKENS"
+            else -> "STOP"
+        }
+    }
+    
+    /**
+     * Parse a streamed Ollama chat response (`stream: true`, newline-delimited JSON)
+     * A first line that is already `done` means the server answered in one piece, which goes through
+     * [parseBuffered] so its content cleanup still applies. Content that starts like a code block or
+     * JSON is held back instead of emitted as it arrives, and goes through [parseBuffered] as one
+     * message once the stream ends, so a wrapped reply is unwrapped however many frames it took.
+     */
+    fun parseOllamaStream(
+        reader: SseStreamReader,
+        onChunk: (String) -> Unit,
+        onToolCall: (FunctionCall) -> Unit,
+        onToolResult: (String, Map<String, Any>) -> Unit,
+        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>,
+        jsonObjectToMap: (JSONObject) -> Map<String, Any>,
+        parseBuffered: (String) -> String? = {
+            parseOllamaResponse(it, onChunk, onToolCall, onToolResult, toolCallsToExecute, jsonObjectToMap)
+        }
+    ): String? {
+        // Content not emitted yet, while it may still turn out to be wrapped
+        val held = StringBuilder()
+        var holding = true
+        var model = "gptfree"
+        var done = false
+        while (!done) {
+            val event = reader.next() ?: break
+            if (event.data.isEmpty() || event.data == "[DONE]") continue
+            val json = JSONObject(event.data)
+            if (json.has("error")) {
+                throw IOException("API stream error: ${json.optString("error")}")
+            }
+            done = json.optBoolean("done", false)
+            if (done && reader.frameCount == 1) {
+                return parseBuffered(event.data)
+            }
+            model = json.optString("model", model)
+            
+            val message = json.optJSONObject("message")
+            if (message != null) {
+                val content = message.optString("content", "")
+                if (holding) {
+                    held.append(content)
+                    val start = held.indexOfFirst { !it.isWhitespace() }
+                    if (start >= 0 && held[start] != '`' && held[start] != '{' && held[start] != '[') {
+                        holding = false
+                        onChunk(held.toString())
+                        held.setLength(0)
+                    }
+                } else if (content.isNotEmpty()) {
+                    onChunk(content)
+                }
+                val toolCalls = message.optJSONArray("tool_calls")
+                if (toolCalls != null) {
+                    for (i in 0 until toolCalls.length()) {
+                        val toolCall = toolCalls.getJSONObject(i)
+                        val function = toolCall.optJSONObject("function") ?: continue
+                        reportToolCall(
+                            function.getString("name"),
+                            function.optString("arguments", "{}"),
+                            toolCall.optString("id", ""),
+                            onToolCall,
+                            toolCallsToExecute,
+                            jsonObjectToMap
+                        )
+                    }
+                }
+            }
+        }
+        
+        if (reader.frameCount == 0 && reader.unframedText.isNotBlank()) {
+            android.util.Log.d("ApiResponseParser", "Ollama response was not streamed, parsing buffered body")
+            return parseBuffered(reader.unframedText)
+        }
+        if (held.isNotBlank()) {
+            // Tool calls were reported as they arrived, so only the content is left
+            val whole = JSONObject()
+                .put("model", model)
+                .put("message", JSONObject().put("role", "assistant").put("content", held.toString()))
+                .put("done", done)
+            return parseBuffered(whole.toString())
+        }
+        return if (done) "STOP" else null
+    }
+    
+    /**
+     * Tool call assembled from stream fragments
+     */
+    private class PendingToolCall(
+        var id: String = "",
+        var name: String = "",
+        val arguments: StringBuilder = StringBuilder()
+    )
+    
+    private fun reportToolCall(
+        name: String,
+        arguments: String,
+        id: String,
+        onToolCall: (FunctionCall) -> Unit,
+        toolCallsToExecute: MutableList<Triple<FunctionCall, ToolResult, String>>,
+        jsonObjectToMap: (JSONObject) -> Map<String, Any>
+    ) {
+        val argsMap = try {
+            if (arguments.isBlank()) emptyMap() else jsonObjectToMap(JSONObject(arguments))
+        } catch (e: Exception) {
+            android.util.Log.w("ApiResponseParser", "Could not parse arguments for tool call $name: ${arguments.take(200)}")
+            emptyMap<String, Any>()
+        }
+        val functionCall = FunctionCall(name = name, args = argsMap, id = id)
+        onToolCall(functionCall)
+        toolCallsToExecute.add(Triple(functionCall, ToolResult(llmContent = "", returnDisplay = ""), id))
+    }
+    
     /**
      * Process Gemini response (common logic for both SSE and JSON array formats)
      */
@@ -0,0 +1,107 @@
+package com.qali.aterm.agent.client.api
+
+import okio.BufferedSource
+
+/**
+ * Incremental reader for streamed API responses
+ * Pulls one frame at a time from the OkHttp [BufferedSource] so callers can react as soon as
+ * the provider flushes it, instead of waiting for the whole body.
+ *
+ * Understands two framings:
+ * - Server-Sent Events (Gemini `alt=sse`, OpenAI, Anthropic): `event:`/`data:` fields, dispatched on a blank line
+ * - Newline-delimited JSON (Ollama `stream: true`): one JSON object per line
+ *
+ * A body that is neither (a server that ignored the stream flag and returned a single, possibly
+ * pretty-printed, JSON document) is collected into [unframedText] so the caller can fall back to
+ * the buffered parsers.
+ */
+class SseStreamReader(private val source: BufferedSource) {
+
+    /**
+     * One dispatched frame. [event] is the SSE event name, null for unnamed SSE events and NDJSON lines.
+     */
+    data class Event(val event: String?, val data: String)
+
+    private enum class Mode { UNKNOWN, SSE, NDJSON, UNFRAMED }
+
+    private var mode = Mode.UNKNOWN
+    private val unframed = StringBuilder()
+
+    /** Number of frames returned by [next] so far */
+    var frameCount = 0
+        private set
+
+    /** Body text that could not be split into frames, empty when the response was streamed */
+    val unframedText: String
+        get() = unframed.toString()
+
+    /**
+     * Read the next frame, blocking until it has fully arrived. Returns null at the end of the body.
+     */
+    fun next(): Event? {
+        var eventName: String? = null
+        var data: StringBuilder? = null
+
+        while (true) {
+            val line = source.readUtf8Line()
+            if (line == null) {
+                // A final event without the trailing blank line is still dispatched
+                return data?.let { dispatch(eventName, it) }
+            }
+
+            if (mode == Mode.UNKNOWN) {
+                val trimmed = line.trim()
+                if (trimmed.isEmpty()) continue
+                mode = when {
+                    isSseField(trimmed) -> Mode.SSE
+                    trimmed.startsWith("{") && trimmed.endsWith("}") -> Mode.NDJSON
+                    else -> Mode.UNFRAMED
+                }
+            }
+
+            when (mode) {
+                Mode.NDJSON -> {
+                    val trimmed = line.trim()
+                    if (trimmed.isNotEmpty()) return dispatch(null, StringBuilder(trimmed))
+                }
+                Mode.UNFRAMED -> {
+                    unframed.append(line).append('\n')
+                    unframed.append(source.readUtf8())
+                    return null
+                }
+                else -> {
+                    if (line.isEmpty()) {
+                        if (data != null) return dispatch(eventName, data)
+                        eventName = null
+                        continue
+                    }
+                    if (line.startsWith(":")) continue
+
+                    val colon = line.indexOf(':')
+                    val field = if (colon < 0) line else line.substring(0, colon)
+                    var value = if (colon < 0) "" else line.substring(colon + 1)
+                    if (value.startsWith(" ")) value = value.substring(1)
+
+                    when (field) {
+                        "event" -> eventName = value
+                        "data" -> {
+                            if (data == null) data = StringBuilder() else data.append('\n')
+                            data.append(value)
+                        }
+                        // id and retry only matter for reconnecting EventSource clients
+                    }
+                }
+            }
+        }
+    }
+
+    private fun dispatch(eventName: String?, data: StringBuilder): Event {
+        frameCount++
+        return Event(eventName, data.toString())
+    }
+
+    private fun isSseField(line: String): Boolean {
+        return line.startsWith("data:") || line.startsWith("event:") || line.startsWith(":") ||
+            line.startsWith("id:") || line.startsWith("retry:")
+    }
+}
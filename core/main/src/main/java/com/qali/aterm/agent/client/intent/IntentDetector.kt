@@ -19,7 +19,7 @@ object IntentDetector {
         val intents = mutableListOf<IntentType>()
         
         // Load memory context for better intent detection
-        val memoryContext = MemoryService.getSummarizedMemory()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage)
         
         val debugKeywords = listOf(
             "debug", "fix", "repair", "error", "bug", "issue", "problem",
@@ -119,7 +119,7 @@ object IntentDetector {
      * Adds helpful context directly to the prompt without extra API calls
      */
     suspend fun enhanceUserIntent(userMessage: String, intent: IntentType): String {
-        val memoryContext = MemoryService.getSummarizedMemory()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage)
         
         val intentDescription = when (intent) {
             IntentType.CREATE_NEW -> "creating a new project"
@@ -155,7 +155,7 @@ object IntentDetector {
      */
     fun needsDocumentationSearch(userMessage: String): Boolean {
         val messageLower = userMessage.lowercase()
-        val memoryContext = MemoryService.getSummarizedMemory().lowercase()
+        val memoryContext = MemoryService.getSummarizedMemory(userMessage).lowercase()
         val contextLower = (userMessage + " " + memoryContext).lowercase()
         
         // Keywords indicating need for documentation/search
@@ -0,0 +1,98 @@
+package com.qali.aterm.agent.debug
+
+import com.qali.aterm.service.SessionMemoryBudget
+import com.rk.libcommons.application
+import com.termux.terminal.TerminalSession
+import com.termux.terminal.Tracer
+import java.io.File
+import java.text.SimpleDateFormat
+import java.util.Date
+import java.util.Locale
+
+/**
+ * Agent-side access to [Tracer]: spans around suspending work and export of the recorded trace and
+ * of the sessions' PTY I/O counters
+ *
+ * Exported files are Chrome trace JSON and open in chrome://tracing or ui.perfetto.dev. They show
+ * API requests, time to the first streamed chunk, tool and shell execution next to the terminal's
+ * PTY I/O, emulator appends and frames drawn.
+ */
+object TraceRecorder {
+    private const val MAX_FILES = 5
+
+    var enabled: Boolean
+        get() = Tracer.isEnabled()
+        set(value) = Tracer.setEnabled(value)
+
+    /**
+     * Run [block] as span [name]. The span may suspend and resume on another thread, so it is
+     * recorded as an async span; [detail] is shown as its argument.
+     */
+    inline fun <T> span(name: String, detail: String? = null, block: () -> T): T {
+        val start = Tracer.now()
+        try {
+            return block()
+        } finally {
+            Tracer.completeAsync(name, start, detail)
+        }
+    }
+
+    /**
+     * Write the recorded events to a new file under [directory], keeping the newest few traces
+     *
+     * @return the file written, or null if there is nowhere to write
+     */
+    fun export(directory: File? = defaultDirectory()): File? {
+        val file = newFile(directory, "trace", "json") ?: return null
+        file.bufferedWriter().use { Tracer.writeChromeTrace(it, android.os.Process.myPid()) }
+        return file
+    }
+
+    /**
+     * Write the PTY I/O counters and latency percentiles of [sessions] to a new text file, with the
+     * memory their buffers take from [allocations]
+     *
+     * @return the file written, or null if there is nowhere to write
+     */
+    fun exportIoStats(
+        sessions: Map<String, TerminalSession>,
+        allocations: Map<String, SessionMemoryBudget.Allocation> = emptyMap(),
+        directory: File? = defaultDirectory()
+    ): File? {
+        val file = newFile(directory, "pty-stats", "txt") ?: return null
+        file.bufferedWriter().use { writer ->
+            for ((id, session) in sessions) {
+                writer.write("[$id] pid ${session.pid}\n")
+                allocations[id]?.let {
+                    writer.write("buffers: ${it.bytes / 1024} KiB${if (it.transcriptCompacted) ", transcript compacted" else ""}\n")
+                }
+                writer.write(session.ioStats.format())
+                writer.write("\n")
+            }
+        }
+        return file
+    }
+
+    /**
+     * A new file under [directory] for an asciicast recording of session [sessionId], keeping the
+     * newest few recordings of the session
+     *
+     * @return the file to record to, or null if there is nowhere to write
+     */
+    fun newRecordingFile(sessionId: String, directory: File? = defaultDirectory()): File? {
+        return newFile(directory, "session-$sessionId", "cast")
+    }
+
+    private fun defaultDirectory() = application?.cacheDir?.let { File(it, "traces") }
+
+    private fun newFile(directory: File?, prefix: String, extension: String): File? {
+        val dir = directory ?: return null
+        dir.mkdirs()
+        dir.listFiles { f -> f.name.startsWith("$prefix-") && f.name.endsWith(".$extension") }
+            ?.sortedByDescending { it.name }
+            ?.drop(MAX_FILES - 1)
+            ?.forEach { it.delete() }
+        val stamp = SimpleDateFormat("yyyyMMdd-HHmmss", Locale.US).format(Date())
+        return File(dir, "$prefix-$stamp.$extension")
+    }
+}
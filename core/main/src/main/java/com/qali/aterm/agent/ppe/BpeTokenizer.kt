@@ -0,0 +1,129 @@
+package com.qali.aterm.agent.ppe
+
+import okio.BufferedSource
+import okio.ByteString
+import okio.ByteString.Companion.decodeBase64
+import okio.ByteString.Companion.encodeUtf8
+import java.io.IOException
+import java.util.regex.Pattern
+
+/**
+ * Byte-level BPE tokenizer for tiktoken rank files
+ *
+ * Text is split into pieces with the encoding's pre-tokenizer pattern, each piece is UTF-8 encoded
+ * and adjacent byte runs are merged lowest rank first until no ranked pair is left. This is the
+ * same algorithm the provider runs, so counts are exact for the loaded vocabulary.
+ */
+class BpeTokenizer(
+    val name: String,
+    private val ranks: Map<ByteString, Int>,
+    pattern: String
+) {
+    private val splitter = Pattern.compile(pattern)
+
+    val vocabularySize: Int
+        get() = ranks.size
+
+    /**
+     * Number of tokens [text] encodes to. Cheaper than [encode] because pieces that are a single
+     * vocabulary entry (most words) skip the merge loop.
+     */
+    fun countTokens(text: String): Int {
+        if (text.isEmpty()) return 0
+        var count = 0
+        val matcher = splitter.matcher(text)
+        while (matcher.find()) {
+            val piece = text.substring(matcher.start(), matcher.end()).encodeUtf8()
+            count += if (ranks.containsKey(piece)) 1 else mergeBoundaries(piece).size - 1
+        }
+        return count
+    }
+
+    fun encode(text: String): IntArray {
+        val tokens = ArrayList<Int>()
+        val matcher = splitter.matcher(text)
+        while (matcher.find()) {
+            val piece = text.substring(matcher.start(), matcher.end()).encodeUtf8()
+            val rank = ranks[piece]
+            if (rank != null) {
+                tokens.add(rank)
+                continue
+            }
+            val boundaries = mergeBoundaries(piece)
+            for (i in 0 until boundaries.size - 1) {
+                tokens.add(ranks[piece.substring(boundaries[i], boundaries[i + 1])] ?: UNKNOWN_RANK)
+            }
+        }
+        return tokens.toIntArray()
+    }
+
+    /**
+     * Merge the bytes of [piece] and return the start offsets of the resulting tokens, followed by
+     * the piece length. Pieces are short (a word, a number, a run of whitespace), so the quadratic
+     * scan for the lowest ranked pair is faster than maintaining a heap.
+     */
+    private fun mergeBoundaries(piece: ByteString): IntArray {
+        var size = piece.size + 1
+        val starts = IntArray(size) { it }
+        // pairRanks[i] is the rank of parts i and i + 1 merged, valid for i < size - 2
+        val pairRanks = IntArray(size) { Int.MAX_VALUE }
+
+        fun rankAt(i: Int): Int {
+            if (i < 0 || i + 2 >= size) return Int.MAX_VALUE
+            return ranks[piece.substring(starts[i], starts[i + 2])] ?: Int.MAX_VALUE
+        }
+
+        for (i in 0 until size - 2) {
+            pairRanks[i] = rankAt(i)
+        }
+
+        while (size > 2) {
+            var minRank = Int.MAX_VALUE
+            var minIndex = -1
+            for (i in 0 until size - 2) {
+                if (pairRanks[i] < minRank) {
+                    minRank = pairRanks[i]
+                    minIndex = i
+                }
+            }
+            if (minIndex < 0) break
+
+            // Drop the boundary between the two parts and the pair rank that started there
+            System.arraycopy(starts, minIndex + 2, starts, minIndex + 1, size - minIndex - 2)
+            if (size - minIndex - 4 > 0) {
+                System.arraycopy(pairRanks, minIndex + 2, pairRanks, minIndex + 1, size - minIndex - 4)
+            }
+            size--
+            pairRanks[size - 2] = Int.MAX_VALUE
+            pairRanks[minIndex] = rankAt(minIndex)
+            if (minIndex > 0) {
+                pairRanks[minIndex - 1] = rankAt(minIndex - 1)
+            }
+        }
+        return starts.copyOf(size)
+    }
+
+    companion object {
+        private const val UNKNOWN_RANK = -1
+
+        /**
+         * Load a tiktoken rank file: one `<base64 token> <rank>` pair per line.
+         */
+        @Throws(IOException::class)
+        fun load(name: String, source: BufferedSource, pattern: String): BpeTokenizer {
+            val ranks = HashMap<ByteString, Int>(220_000)
+            while (true) {
+                val line = source.readUtf8Line() ?: break
+                if (line.isBlank()) continue
+                val space = line.indexOf(' ')
+                val token = if (space > 0) line.substring(0, space).decodeBase64() else null
+                val rank = if (space > 0) line.substring(space + 1).trim().toIntOrNull() else null
+                if (token == null || rank == null) {
+                    throw IOException("Malformed line in $name vocabulary: ${line.take(80)}")
+                }
+                ranks[token] = rank
+            }
+            return BpeTokenizer(name, ranks, pattern)
+        }
+    }
+}
@@ -18,7 +18,7 @@ object ContextWindowManager {
         maxTokens: Int? = null
     ): List<Content> {
         val limit = maxTokens ?: PpeConfig.getMaxTokensForModel(model)
-        val estimatedTokens = estimateTokens(messages)
+        val estimatedTokens = estimateTokens(messages, model)
         
         if (estimatedTokens <= limit) {
             return messages
@@ -36,9 +36,9 @@ object ContextWindowManager {
         val recentMessages = messages.drop(1).takeLast(PpeConfig.MAX_CHAT_HISTORY_MESSAGES)
         
         // Add recent messages until we approach limit
-        var currentTokens = estimateTokens(pruned)
+        var currentTokens = estimateTokens(pruned, model)
         for (message in recentMessages.reversed()) {
-            val messageTokens = estimateTokens(listOf(message))
+            val messageTokens = TokenCounter.countTokens(message, model)
             if (currentTokens + messageTokens > limit * 0.9) { // Leave 10% buffer
                 break
             }
@@ -46,32 +46,23 @@ object ContextWindowManager {
             currentTokens += messageTokens
         }
         
-        Log.d("ContextWindowManager", "Pruned to ${pruned.size} messages, ~$currentTokens tokens")
+        Log.d("ContextWindowManager", "Pruned to ${pruned.size} messages, $currentTokens tokens")
         return pruned
     }
     
     /**
-     * Estimate token count for messages (rough approximation)
+     * Token count for messages with the model's BPE vocabulary (see [TokenCounter])
+     * Per-message counts are cached, so repeated calls on a growing history only tokenize new messages
      */
-    fun estimateTokens(messages: List<Content>): Int {
-        val totalChars = messages.sumOf { message ->
-            message.parts.sumOf { part ->
-                when (part) {
-                    is com.qali.aterm.agent.core.Part.TextPart -> part.text.length
-                    is com.qali.aterm.agent.core.Part.FunctionCallPart -> part.functionCall.toString().length
-                    is com.qali.aterm.agent.core.Part.FunctionResponsePart -> part.functionResponse.toString().length
-                    else -> 0
-                }
-            }
-        }
-        return PpeConfig.estimateTokens(totalChars.toString())
+    fun estimateTokens(messages: List<Content>, model: String? = null): Int {
+        return messages.sumOf { TokenCounter.countTokens(it, model) }
     }
     
     /**
      * Check if messages fit within token limit
      */
     fun fitsWithinLimit(messages: List<Content>, model: String): Boolean {
-        val estimatedTokens = estimateTokens(messages)
+        val estimatedTokens = estimateTokens(messages, model)
         val maxTokens = PpeConfig.getMaxTokensForModel(model)
         return estimatedTokens <= maxTokens
     }
@@ -1,7 +1,7 @@
 package com.qali.aterm.agent.ppe
 
 import android.util.Log
-import java.io.File
+import com.qali.aterm.agent.utils.WorkspaceChangeTracker
 import java.util.concurrent.ConcurrentHashMap
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
@@ -9,19 +9,31 @@ import kotlinx.coroutines.sync.withLock
 /**
  * Intelligent caching system
  * Better than Cursor AI: Smart invalidation and TTL-based expiration
+ *
+ * Workspace-derived entries record which files they depend on and the [WorkspaceChangeTracker]
+ * and generation they were computed at. They stay valid until one of those files changes, and a
+ * lookup with no changes since is a single comparison. An entry from another tracker, one released
+ * since whose generations a new tracker counts again, is stale. Without a tracker (workspace too
+ * large to watch) entries fall back to the TTL.
  */
 object IntelligentCache {
     
     private data class CacheEntry<T>(
         val data: T,
         val timestamp: Long,
-        val ttl: Long
+        val ttl: Long,
+        val generation: Long = 0,
+        /** [WorkspaceChangeTracker.id] of the tracker [generation] is from, 0 without one */
+        val trackerId: Long = 0,
+        val dependsOn: ((String) -> Boolean)? = null
     ) {
         fun isExpired(): Boolean {
             return System.currentTimeMillis() - timestamp > ttl
         }
     }
     
+    private val CODE_EXTENSIONS = setOf("js", "ts", "py", "java", "kt", "go", "rs", "cpp", "c")
+    
     private val fileStructureCache = ConcurrentHashMap<String, CacheEntry<String>>()
     private val dependencyMatrixCache = ConcurrentHashMap<String, CacheEntry<Any>>()
     private val blueprintCache = ConcurrentHashMap<String, CacheEntry<String>>()
@@ -34,34 +46,8 @@ object IntelligentCache {
         workspaceRoot: String,
         compute: suspend () -> String
     ): String {
-        val cacheKey = workspaceRoot
-        val entry = fileStructureCache[cacheKey]
-        
-        if (entry != null && !entry.isExpired()) {
-            Log.d("IntelligentCache", "Cache hit: file structure")
-            return entry.data
-        }
-        
-        // Check if workspace files changed
-        val lastModified = getWorkspaceLastModified(workspaceRoot)
-        if (entry != null && lastModified <= entry.timestamp) {
-            Log.d("IntelligentCache", "Cache valid: workspace unchanged")
-            return entry.data
-        }
-        
-        // Cache miss or expired, compute
-        Log.d("IntelligentCache", "Cache miss: computing file structure")
-        val data = compute()
-        
-        cacheMutex.withLock {
-            fileStructureCache[cacheKey] = CacheEntry(
-                data = data,
-                timestamp = System.currentTimeMillis(),
-                ttl = PpeConfig.CACHE_TTL_SECONDS * 1000
-            )
-        }
-        
-        return data
+        // The listing includes every non-ignored file and its size
+        return getOrCompute(fileStructureCache, workspaceRoot, workspaceRoot, "file structure", { true }, compute)
     }
     
     /**
@@ -71,34 +57,7 @@ object IntelligentCache {
         workspaceRoot: String,
         compute: suspend () -> Any
     ): Any {
-        val cacheKey = workspaceRoot
-        val entry = dependencyMatrixCache[cacheKey]
-        
-        if (entry != null && !entry.isExpired()) {
-            Log.d("IntelligentCache", "Cache hit: dependency matrix")
-            return entry.data
-        }
-        
-        // Check if code files changed
-        val lastModified = getCodeFilesLastModified(workspaceRoot)
-        if (entry != null && lastModified <= entry.timestamp) {
-            Log.d("IntelligentCache", "Cache valid: code files unchanged")
-            return entry.data
-        }
-        
-        // Cache miss or expired, compute
-        Log.d("IntelligentCache", "Cache miss: computing dependency matrix")
-        val data = compute()
-        
-        cacheMutex.withLock {
-            dependencyMatrixCache[cacheKey] = CacheEntry(
-                data = data,
-                timestamp = System.currentTimeMillis(),
-                ttl = PpeConfig.CACHE_TTL_SECONDS * 1000
-            )
-        }
-        
-        return data
+        return getOrCompute(dependencyMatrixCache, workspaceRoot, workspaceRoot, "dependency matrix", ::isCodeFile, compute)
     }
     
     /**
@@ -152,23 +111,49 @@ object IntelligentCache {
         Log.d("IntelligentCache", "Cleared all caches")
     }
     
-    private fun getWorkspaceLastModified(workspaceRoot: String): Long {
-        val dir = File(workspaceRoot)
-        if (!dir.exists()) return 0
+    private suspend fun <T> getOrCompute(
+        cache: ConcurrentHashMap<String, CacheEntry<T>>,
+        cacheKey: String,
+        workspaceRoot: String,
+        label: String,
+        dependsOn: (String) -> Boolean,
+        compute: suspend () -> T
+    ): T {
+        val tracker = WorkspaceChangeTracker.forWorkspace(workspaceRoot).takeIf { it.isWatching }
+        val entry = cache[cacheKey]
+        
+        if (entry != null) {
+            val valid = when {
+                tracker != null && entry.trackerId == tracker.id -> !tracker.hasChangedSince(entry.generation, dependsOn)
+                entry.trackerId != 0L -> false
+                else -> !entry.isExpired()
+            }
+            if (valid) {
+                Log.d("IntelligentCache", "Cache hit: $label")
+                return entry.data
+            }
+        }
         
-        return dir.walkTopDown()
-            .filter { it.isFile }
-            .maxOfOrNull { it.lastModified() } ?: 0
-    }
-    
-    private fun getCodeFilesLastModified(workspaceRoot: String): Long {
-        val dir = File(workspaceRoot)
-        if (!dir.exists()) return 0
+        // Read the generation first so changes made while computing invalidate the result
+        val generation = tracker?.generation ?: 0
+        Log.d("IntelligentCache", "Cache miss: computing $label")
+        val data = compute()
         
-        val codeExtensions = setOf("js", "ts", "py", "java", "kt", "go", "rs", "cpp", "c")
+        cacheMutex.withLock {
+            cache[cacheKey] = CacheEntry(
+                data = data,
+                timestamp = System.currentTimeMillis(),
+                ttl = PpeConfig.CACHE_TTL_SECONDS * 1000,
+                generation = generation,
+                trackerId = tracker?.id ?: 0,
+                dependsOn = dependsOn
+            )
+        }
         
-        return dir.walkTopDown()
-            .filter { it.isFile && codeExtensions.contains(it.extension.lowercase()) }
-            .maxOfOrNull { it.lastModified() } ?: 0
+        return data
+    }
+    
+    private fun isCodeFile(relativePath: String): Boolean {
+        return relativePath.substringAfterLast('.', "").lowercase() in CODE_EXTENSIONS
     }
 }
@@ -1,132 +1,121 @@
 package com.qali.aterm.agent.ppe
 
 import com.qali.aterm.agent.core.FunctionCall
+import com.qali.aterm.agent.tools.ToolError
+import com.qali.aterm.agent.tools.ToolErrorType
 import com.qali.aterm.agent.tools.ToolResult
-import android.util.Log
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.Deferred
 import kotlinx.coroutines.async
-import kotlinx.coroutines.awaitAll
 import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.sync.Semaphore
+import kotlinx.coroutines.sync.withPermit
 
 /**
  * Executes tools in parallel when possible
- * Better than Cursor AI: Dependency-aware parallelization
+ *
+ * Each call's [ToolAccess] (paths read and written, resource class) decides what it has to wait
+ * for: a call depends on every earlier call it conflicts with, and the calls form a DAG in
+ * submission order. A call starts as soon as its dependencies have finished and its resource
+ * class has a free slot, so one slow call only holds back the calls that actually depend on it.
  */
 object ParallelToolExecutor {
-    
+
+    /**
+     * Calls of each resource class that may run at the same time
+     */
+    val defaultConcurrencyLimits: Map<ToolAccess.ResourceClass, Int> = mapOf(
+        ToolAccess.ResourceClass.SHELL to (Runtime.getRuntime().availableProcessors() / 2).coerceAtLeast(1),
+        ToolAccess.ResourceClass.FILE_IO to 4,
+        ToolAccess.ResourceClass.NETWORK to 4
+    )
+
     /**
      * Check if two tool calls are independent (can run in parallel)
      */
-    fun areIndependent(call1: FunctionCall, call2: FunctionCall): Boolean {
-        // Tools that modify files are not independent if they touch the same file
-        if (call1.name == "write_file" && call2.name == "write_file") {
-            val file1 = call1.args["file_path"] as? String
-            val file2 = call2.args["file_path"] as? String
-            return file1 != file2
-        }
-        
-        if (call1.name == "edit" && call2.name == "edit") {
-            val file1 = call1.args["file_path"] as? String
-            val file2 = call2.args["file_path"] as? String
-            return file1 != file2
-        }
-        
-        // Read operations are always independent
-        if (call1.name == "read_file" || call2.name == "read_file") {
-            return true
-        }
-        
-        // Shell commands are independent if they don't modify the same files
-        if (call1.name == "shell" && call2.name == "shell") {
-            return true // Assume independent (could be improved)
-        }
-        
-        // Different tool types are generally independent
-        if (call1.name != call2.name) {
-            return true
+    fun areIndependent(call1: FunctionCall, call2: FunctionCall, workspaceRoot: String? = null): Boolean {
+        return !ToolAccess.of(call1, workspaceRoot).conflictsWith(ToolAccess.of(call2, workspaceRoot))
+    }
+
+    /**
+     * For each call, the indices of the earlier calls it has to wait for
+     */
+    fun buildDependencies(calls: List<FunctionCall>, workspaceRoot: String? = null): List<List<Int>> {
+        return dependenciesOf(calls.map { ToolAccess.of(it, workspaceRoot) })
+    }
+
+    private fun dependenciesOf(accesses: List<ToolAccess>): List<List<Int>> {
+        return accesses.indices.map { i ->
+            (0 until i).filter { j -> accesses[i].conflictsWith(accesses[j]) }
         }
-        
-        // Same tool, same file = not independent
-        return false
     }
-    
+
     /**
-     * Group tool calls into batches that can run in parallel
+     * Group tool calls by depth in the dependency DAG. Calls in one group are independent of each
+     * other; [executeInParallel] does not wait for whole groups, this is for reporting.
      */
-    fun groupForParallelExecution(calls: List<FunctionCall>): List<List<FunctionCall>> {
-        val groups = mutableListOf<MutableList<FunctionCall>>()
-        val processed = mutableSetOf<Int>()
-        
+    fun groupForParallelExecution(calls: List<FunctionCall>, workspaceRoot: String? = null): List<List<FunctionCall>> {
+        val dependencies = buildDependencies(calls, workspaceRoot)
+        val depth = IntArray(calls.size)
         for (i in calls.indices) {
-            if (i in processed) continue
-            
-            val group = mutableListOf<FunctionCall>()
-            group.add(calls[i])
-            processed.add(i)
-            
-            // Find other calls that can run in parallel with this one
-            for (j in (i + 1) until calls.size) {
-                if (j in processed) continue
-                
-                // Check if this call is independent of all calls in current group
-                val canAdd = group.all { areIndependent(it, calls[j]) }
-                if (canAdd) {
-                    group.add(calls[j])
-                    processed.add(j)
-                }
-            }
-            
-            groups.add(group)
+            depth[i] = dependencies[i].maxOfOrNull { depth[it] + 1 } ?: 0
         }
-        
-        return groups
+        return calls.indices.groupBy { depth[it] }.toSortedMap().values.map { group -> group.map { calls[it] } }
     }
-    
+
     /**
-     * Execute tool calls in parallel when possible
+     * Execute tool calls in parallel when possible. Results are returned in submission order.
+     * A call that throws gets an error result; the calls after it still run.
      */
     suspend fun executeInParallel(
         calls: List<FunctionCall>,
+        workspaceRoot: String? = null,
+        concurrencyLimits: Map<ToolAccess.ResourceClass, Int> = defaultConcurrencyLimits,
         executeTool: suspend (FunctionCall) -> ToolResult
     ): List<Pair<FunctionCall, ToolResult>> {
         if (calls.isEmpty()) return emptyList()
         if (calls.size == 1) {
-            return listOf(calls[0] to executeTool(calls[0]))
+            return listOf(calls[0] to executeSafely(calls[0], executeTool))
         }
-        
-        // Group calls for parallel execution
-        val groups = groupForParallelExecution(calls)
-        
-        Log.d("ParallelToolExecutor", "Grouped ${calls.size} calls into ${groups.size} parallel batches")
-        
-        val results = mutableListOf<Pair<FunctionCall, ToolResult>>()
-        
-        // Execute groups sequentially, but calls within group in parallel
-        for (group in groups) {
-            if (group.size == 1) {
-                // Single call, execute directly
-                results.add(group[0] to executeTool(group[0]))
-            } else {
-                // Multiple calls, execute in parallel
-                coroutineScope {
-                    val deferredResults = group.map { call ->
-                        async {
-                            call to executeTool(call)
-                        }
+
+        val accesses = calls.map { ToolAccess.of(it, workspaceRoot) }
+        val dependencies = dependenciesOf(accesses)
+        val slots = ToolAccess.ResourceClass.values().associateWith { resourceClass ->
+            Semaphore((concurrencyLimits[resourceClass] ?: 1).coerceAtLeast(1))
+        }
+
+        return coroutineScope {
+            val jobs = ArrayList<Deferred<ToolResult>>(calls.size)
+            for (i in calls.indices) {
+                val waitFor = dependencies[i].map { jobs[it] }
+                jobs.add(async {
+                    // Wait before taking a slot so blocked calls never hold one
+                    waitFor.forEach { it.join() }
+                    slots.getValue(accesses[i].resourceClass).withPermit {
+                        executeSafely(calls[i], executeTool)
                     }
-                    results.addAll(deferredResults.awaitAll())
-                }
+                })
             }
+            calls.mapIndexed { i, call -> call to jobs[i].await() }
         }
-        
-        // Return results in original order
-        return calls.map { call ->
-            results.find { it.first == call } ?: (call to ToolResult(
+    }
+
+    private suspend fun executeSafely(
+        call: FunctionCall,
+        executeTool: suspend (FunctionCall) -> ToolResult
+    ): ToolResult {
+        return try {
+            executeTool(call)
+        } catch (e: CancellationException) {
+            throw e
+        } catch (e: Exception) {
+            ToolResult(
                 llmContent = "Execution failed",
-                error = com.qali.aterm.agent.tools.ToolError(
-                    message = "Tool execution failed",
-                    type = com.qali.aterm.agent.tools.ToolErrorType.EXECUTION_ERROR
+                error = ToolError(
+                    message = "Tool execution failed: ${e.message}",
+                    type = ToolErrorType.EXECUTION_ERROR
                 )
-            ))
+            )
         }
     }
 }
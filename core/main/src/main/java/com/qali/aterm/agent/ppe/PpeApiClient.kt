@@ -3,6 +3,7 @@ package com.qali.aterm.agent.ppe
 import com.qali.aterm.api.ApiProviderManager
 import com.qali.aterm.api.ApiProviderManager.KeysExhaustedException
 import com.qali.aterm.api.ProviderConfig
+import com.qali.aterm.api.HttpClientProvider
 import com.qali.aterm.agent.core.*
 import com.qali.aterm.agent.client.api.ApiRequestBuilder
 import com.qali.aterm.agent.client.api.ProviderAdapter
@@ -20,7 +21,6 @@ import okhttp3.*
 import okhttp3.MediaType.Companion.toMediaType
 import okhttp3.RequestBody.Companion.toRequestBody
 import java.io.IOException
-import java.util.concurrent.TimeUnit
 
 /**
  * Extended exception that includes retry delay information for rate-limited exhausted keys
@@ -42,25 +42,25 @@ class PpeApiClient(
     private val ollamaModel: String? = null
 ) {
     // Separate client for Ollama with longer timeouts (some models are very slow, especially large models)
-    private val ollamaClient = OkHttpClient.Builder()
-        .connectTimeout(PpeConfig.OLLAMA_CONNECT_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .readTimeout(PpeConfig.OLLAMA_READ_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .writeTimeout(PpeConfig.OLLAMA_WRITE_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .build()
+    private val ollamaClient = HttpClientProvider.newClient(
+        connectTimeoutSeconds = PpeConfig.OLLAMA_CONNECT_TIMEOUT_SECONDS,
+        readTimeoutSeconds = PpeConfig.OLLAMA_READ_TIMEOUT_SECONDS,
+        writeTimeoutSeconds = PpeConfig.OLLAMA_WRITE_TIMEOUT_SECONDS
+    )
     
-    private val client = OkHttpClient.Builder()
-        .connectTimeout(PpeConfig.DEFAULT_CONNECT_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .readTimeout(PpeConfig.DEFAULT_READ_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .writeTimeout(PpeConfig.DEFAULT_WRITE_TIMEOUT_SECONDS, TimeUnit.SECONDS)
-        .build()
+    private val client = HttpClientProvider.newClient(
+        connectTimeoutSeconds = PpeConfig.DEFAULT_CONNECT_TIMEOUT_SECONDS,
+        readTimeoutSeconds = PpeConfig.DEFAULT_READ_TIMEOUT_SECONDS,
+        writeTimeoutSeconds = PpeConfig.DEFAULT_WRITE_TIMEOUT_SECONDS
+    )
     
     // Separate client for Gemini with model-specific timeouts to prevent infinite "thinking"
     // Flash/lite models: 20s, Pro models: 60s
-    private val geminiClient = OkHttpClient.Builder()
-        .connectTimeout(10, TimeUnit.SECONDS)
-        .readTimeout(60, TimeUnit.SECONDS) // 60 seconds to support pro models (actual timeout enforced at coroutine level)
-        .writeTimeout(10, TimeUnit.SECONDS)
-        .build()
+    private val geminiClient = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 10,
+        readTimeoutSeconds = 60, // 60 seconds to support pro models (actual timeout enforced at coroutine level)
+        writeTimeoutSeconds = 10
+    )
     
     /**
      * Make a non-streaming API call
@@ -161,10 +161,10 @@ class PpeApiClient(
                     val duration = System.currentTimeMillis() - startTime
                     
                     // Record API call metrics
-                    val estimatedTokens = ContextWindowManager.estimateTokens(messages) + 
+                    val estimatedTokens = ContextWindowManager.estimateTokens(messages, actualModel) + 
                                          ContextWindowManager.estimateTokens(listOf(
                                              Content(role = "model", parts = listOf(Part.TextPart(text = response.text)))
-                                         ))
+                                         ), actualModel)
                     val cost = Observability.estimateCost(actualModel, estimatedTokens)
                     Observability.recordApiCall("current-operation", estimatedTokens, cost)
                     
@@ -267,10 +267,10 @@ class PpeApiClient(
                     val response = result.getOrNull()!!
                     
                     // Record API call metrics
-                    val estimatedTokens = ContextWindowManager.estimateTokens(messages) + 
+                    val estimatedTokens = ContextWindowManager.estimateTokens(messages, actualModel) + 
                                          ContextWindowManager.estimateTokens(listOf(
                                              Content(role = "model", parts = listOf(Part.TextPart(text = response.text)))
-                                         ))
+                                         ), actualModel)
                     val cost = Observability.estimateCost(actualModel, estimatedTokens)
                     Observability.recordApiCall("current-operation", estimatedTokens, cost)
                     
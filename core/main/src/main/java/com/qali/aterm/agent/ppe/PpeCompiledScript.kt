@@ -0,0 +1,395 @@
+package com.qali.aterm.agent.ppe
+
+import com.qali.aterm.agent.ppe.models.*
+import java.io.DataInputStream
+import java.io.DataOutputStream
+import java.io.IOException
+
+/**
+ * A parsed PPE script with its message templates and control flow conditions compiled
+ *
+ * This is what [PpeScriptLoader] keeps on disk, so loading an unchanged script neither re-parses
+ * its YAML nor re-tokenises its templates. [write] and [read] use a tagged binary encoding that
+ * keeps the types of front-matter values (integers stay integers), and fail for values YAML can
+ * produce but scripts do not use, in which case the script is simply not stored.
+ */
+class PpeCompiledScript(
+    val script: PpeScript,
+    val templates: Map<String, PpeTemplateEngine.CompiledTemplate>,
+    val conditions: Map<String, PpeCondition>
+) {
+
+    /**
+     * Make the compiled templates and conditions the ones the engines use for this script's text
+     */
+    fun register() {
+        PpeTemplateEngine.register(templates)
+        PpeCondition.register(conditions)
+    }
+
+    fun write(out: DataOutputStream) {
+        writeScript(out, script)
+        out.writeInt(templates.size)
+        for ((text, template) in templates) {
+            out.writeUTF8(text)
+            writeStrings(out, template.literals)
+            out.writeInt(template.variables.size)
+            for (variable in template.variables) {
+                out.writeUTF8(variable.name)
+                writeStrings(out, variable.path)
+                writeStrings(out, variable.filters)
+            }
+        }
+        out.writeInt(conditions.size)
+        for ((text, condition) in conditions) {
+            out.writeUTF8(text)
+            writeNullable(out, condition.operator)
+            writeExpression(out, condition.left)
+            out.writeBoolean(condition.right != null)
+            condition.right?.let { writeExpression(out, it) }
+        }
+    }
+
+    companion object {
+        private const val TAG_NULL = 0
+        private const val TAG_STRING = 1
+        private const val TAG_INT = 2
+        private const val TAG_LONG = 3
+        private const val TAG_DOUBLE = 4
+        private const val TAG_BOOLEAN = 5
+        private const val TAG_MAP = 6
+        private const val TAG_LIST = 7
+
+        /**
+         * Compile every message template, instruction value and condition of [script]
+         */
+        fun compile(script: PpeScript): PpeCompiledScript {
+            val templates = LinkedHashMap<String, PpeTemplateEngine.CompiledTemplate>()
+            val conditions = LinkedHashMap<String, PpeCondition>()
+
+            fun addTemplate(text: String?) {
+                if (text != null && text !in templates) templates[text] = PpeTemplateEngine.compile(text)
+            }
+
+            fun addInstructions(instructions: List<PpeInstruction>?) {
+                instructions?.forEach { instruction ->
+                    addTemplate(instruction.args["value"] as? String)
+                    addTemplate(instruction.rawContent)
+                }
+            }
+
+            for (turn in script.turns) {
+                turn.messages.forEach { addTemplate(it.content) }
+                addInstructions(turn.instructions)
+                for (block in turn.controlFlowBlocks) {
+                    val condition = block.condition
+                    if (condition != null && block.type in setOf("if", "while", "for") && condition !in conditions) {
+                        conditions[condition] = PpeCondition.compile(condition)
+                    }
+                    addInstructions(block.thenBlock)
+                    addInstructions(block.elseBlock)
+                    addInstructions(block.doBlock)
+                    block.cases?.values?.forEach { addInstructions(it) }
+                }
+            }
+            return PpeCompiledScript(script, templates, conditions)
+        }
+
+        fun read(input: DataInputStream): PpeCompiledScript {
+            val script = readScript(input)
+            val templates = LinkedHashMap<String, PpeTemplateEngine.CompiledTemplate>()
+            repeat(input.readInt()) {
+                val text = input.readUTF8()
+                val literals = readStrings(input)
+                val variables = List(input.readInt()) {
+                    PpeTemplateEngine.Variable(input.readUTF8(), readStrings(input), readStrings(input))
+                }
+                templates[text] = PpeTemplateEngine.CompiledTemplate(literals, variables)
+            }
+            val conditions = LinkedHashMap<String, PpeCondition>()
+            repeat(input.readInt()) {
+                val text = input.readUTF8()
+                val operator = readNullable(input)
+                val left = readExpression(input)
+                val right = if (input.readBoolean()) readExpression(input) else null
+                conditions[text] = PpeCondition(operator, left, right)
+            }
+            return PpeCompiledScript(script, templates, conditions)
+        }
+
+        private fun writeScript(out: DataOutputStream, script: PpeScript) {
+            writeValue(out, script.parameters)
+            writeValue(out, script.input)
+            writeValue(out, script.output)
+            writeValue(out, script.responseFormat)
+            out.writeInt(script.turns.size)
+            for (turn in script.turns) {
+                out.writeInt(turn.messages.size)
+                turn.messages.forEach { writeMessage(out, it) }
+                writeInstructions(out, turn.instructions)
+                writeNullable(out, turn.chainTo)
+                writeValue(out, turn.chainParams)
+                out.writeInt(turn.controlFlowBlocks.size)
+                for (block in turn.controlFlowBlocks) {
+                    out.writeUTF8(block.type)
+                    writeNullable(out, block.condition)
+                    writeNullableInstructions(out, block.thenBlock)
+                    writeNullableInstructions(out, block.elseBlock)
+                    writeNullableInstructions(out, block.doBlock)
+                    out.writeInt(block.cases?.size ?: -1)
+                    block.cases?.forEach { (key, instructions) ->
+                        out.writeUTF8(key)
+                        writeInstructions(out, instructions)
+                    }
+                    writeValue(out, block.pipeChain)
+                }
+            }
+            writeValue(out, script.metadata)
+            writeNullable(out, script.sourcePath)
+            writeNullable(out, script.type)
+            writeValue(out, script.imports)
+            writeStrings(out, script.functions)
+            out.writeBoolean(script.autoRunLLMIfPromptAvailable)
+            writeValue(out, script.promptConfig)
+        }
+
+        @Suppress("UNCHECKED_CAST")
+        private fun readScript(input: DataInputStream): PpeScript {
+            val parameters = readValue(input) as Map<String, Any>
+            val scriptInput = readValue(input) as List<String>?
+            val output = readValue(input) as Map<String, Any>?
+            val responseFormat = readValue(input) as Map<String, Any>?
+            val turns = List(input.readInt()) {
+                val messages = List(input.readInt()) { readMessage(input) }
+                val instructions = readInstructions(input)
+                val chainTo = readNullable(input)
+                val chainParams = readValue(input) as Map<String, Any>?
+                val blocks = List(input.readInt()) {
+                    val type = input.readUTF8()
+                    val condition = readNullable(input)
+                    val thenBlock = readNullableInstructions(input)
+                    val elseBlock = readNullableInstructions(input)
+                    val doBlock = readNullableInstructions(input)
+                    val caseCount = input.readInt()
+                    val cases = if (caseCount < 0) null else LinkedHashMap<String, List<PpeInstruction>>().apply {
+                        repeat(caseCount) { put(input.readUTF8(), readInstructions(input)) }
+                    }
+                    val pipeChain = readValue(input) as List<String>?
+                    PpeControlFlowBlock(type, condition, thenBlock, elseBlock, doBlock, cases, pipeChain)
+                }
+                PpeTurn(messages, instructions, chainTo, chainParams, blocks)
+            }
+            return PpeScript(
+                parameters = parameters,
+                input = scriptInput,
+                output = output,
+                responseFormat = responseFormat,
+                turns = turns,
+                metadata = readValue(input) as Map<String, Any>,
+                sourcePath = readNullable(input),
+                type = readNullable(input),
+                imports = readValue(input) as List<String>?,
+                functions = readStrings(input),
+                autoRunLLMIfPromptAvailable = input.readBoolean(),
+                promptConfig = readValue(input) as Map<String, Any>?
+            )
+        }
+
+        private fun writeMessage(out: DataOutputStream, message: PpeMessage) {
+            out.writeUTF8(message.role)
+            out.writeUTF8(message.content)
+            out.writeBoolean(message.hasAiPlaceholder)
+            writeNullable(out, message.aiPlaceholderVar)
+            writeValue(out, message.aiPlaceholderParams)
+            out.writeBoolean(message.immediateFormat)
+            out.writeInt(message.scriptReplacements.size)
+            for (replacement in message.scriptReplacements) {
+                out.writeUTF8(replacement.scriptName)
+                writeValue(out, replacement.params)
+                out.writeUTF8(replacement.placeholder)
+            }
+            out.writeInt(message.instructionReplacements.size)
+            for (replacement in message.instructionReplacements) {
+                out.writeUTF8(replacement.instructionName)
+                writeValue(out, replacement.params)
+                out.writeUTF8(replacement.placeholder)
+            }
+            out.writeInt(message.regexReplacements.size)
+            for (replacement in message.regexReplacements) {
+                out.writeUTF8(replacement.pattern)
+                out.writeUTF8(replacement.options)
+                out.writeUTF8(replacement.variable)
+                writeValue(out, replacement.groupIndex)
+                writeNullable(out, replacement.groupName)
+                out.writeUTF8(replacement.placeholder)
+            }
+            writeValue(out, message.constrainedOptions)
+            writeValue(out, message.constrainedCount)
+            out.writeBoolean(message.constrainedRandom)
+        }
+
+        @Suppress("UNCHECKED_CAST")
+        private fun readMessage(input: DataInputStream): PpeMessage {
+            return PpeMessage(
+                role = input.readUTF8(),
+                content = input.readUTF8(),
+                hasAiPlaceholder = input.readBoolean(),
+                aiPlaceholderVar = readNullable(input),
+                aiPlaceholderParams = readValue(input) as Map<String, Any>?,
+                immediateFormat = input.readBoolean(),
+                scriptReplacements = List(input.readInt()) {
+                    PpeScriptReplacement(input.readUTF8(), readValue(input) as Map<String, Any>, input.readUTF8())
+                },
+                instructionReplacements = List(input.readInt()) {
+                    PpeInstructionReplacement(input.readUTF8(), readValue(input) as Map<String, Any>, input.readUTF8())
+                },
+                regexReplacements = List(input.readInt()) {
+                    PpeRegexReplacement(
+                        pattern = input.readUTF8(),
+                        options = input.readUTF8(),
+                        variable = input.readUTF8(),
+                        groupIndex = readValue(input) as Int?,
+                        groupName = readNullable(input),
+                        placeholder = input.readUTF8()
+                    )
+                },
+                constrainedOptions = readValue(input) as List<String>?,
+                constrainedCount = readValue(input) as Int?,
+                constrainedRandom = input.readBoolean()
+            )
+        }
+
+        private fun writeInstructions(out: DataOutputStream, instructions: List<PpeInstruction>) {
+            out.writeInt(instructions.size)
+            for (instruction in instructions) {
+                out.writeUTF8(instruction.name)
+                writeValue(out, instruction.args)
+                writeNullable(out, instruction.rawContent)
+            }
+        }
+
+        @Suppress("UNCHECKED_CAST")
+        private fun readInstructions(input: DataInputStream): List<PpeInstruction> {
+            return List(input.readInt()) {
+                PpeInstruction(input.readUTF8(), readValue(input) as Map<String, Any>, readNullable(input))
+            }
+        }
+
+        private fun writeNullableInstructions(out: DataOutputStream, instructions: List<PpeInstruction>?) {
+            out.writeBoolean(instructions != null)
+            instructions?.let { writeInstructions(out, it) }
+        }
+
+        private fun readNullableInstructions(input: DataInputStream): List<PpeInstruction>? {
+            return if (input.readBoolean()) readInstructions(input) else null
+        }
+
+        private fun writeExpression(out: DataOutputStream, expression: PpeExpression) {
+            when (expression) {
+                is PpeExpression.VariableRef -> {
+                    out.writeBoolean(true)
+                    writeStrings(out, expression.path)
+                }
+                is PpeExpression.Constant -> {
+                    out.writeBoolean(false)
+                    writeValue(out, expression.value)
+                }
+            }
+        }
+
+        private fun readExpression(input: DataInputStream): PpeExpression {
+            return if (input.readBoolean()) {
+                PpeExpression.VariableRef(readStrings(input))
+            } else {
+                PpeExpression.Constant(readValue(input) ?: "")
+            }
+        }
+
+        private fun writeValue(out: DataOutputStream, value: Any?) {
+            when (value) {
+                null -> out.writeByte(TAG_NULL)
+                is String -> {
+                    out.writeByte(TAG_STRING)
+                    out.writeUTF8(value)
+                }
+                is Int -> {
+                    out.writeByte(TAG_INT)
+                    out.writeInt(value)
+                }
+                is Long -> {
+                    out.writeByte(TAG_LONG)
+                    out.writeLong(value)
+                }
+                is Double -> {
+                    out.writeByte(TAG_DOUBLE)
+                    out.writeDouble(value)
+                }
+                is Boolean -> {
+                    out.writeByte(TAG_BOOLEAN)
+                    out.writeBoolean(value)
+                }
+                is Map<*, *> -> {
+                    out.writeByte(TAG_MAP)
+                    out.writeInt(value.size)
+                    for ((key, item) in value) {
+                        out.writeUTF8(key as? String ?: throw IOException("Unsupported key ${key?.javaClass}"))
+                        writeValue(out, item)
+                    }
+                }
+                is List<*> -> {
+                    out.writeByte(TAG_LIST)
+                    out.writeInt(value.size)
+                    value.forEach { writeValue(out, it) }
+                }
+                else -> throw IOException("Unsupported value ${value.javaClass}")
+            }
+        }
+
+        private fun readValue(input: DataInputStream): Any? {
+            return when (val tag = input.readByte().toInt()) {
+                TAG_NULL -> null
+                TAG_STRING -> input.readUTF8()
+                TAG_INT -> input.readInt()
+                TAG_LONG -> input.readLong()
+                TAG_DOUBLE -> input.readDouble()
+                TAG_BOOLEAN -> input.readBoolean()
+                TAG_MAP -> LinkedHashMap<String, Any?>().apply {
+                    repeat(input.readInt()) { put(input.readUTF8(), readValue(input)) }
+                }
+                TAG_LIST -> List(input.readInt()) { readValue(input) }
+                else -> throw IOException("Unknown value tag $tag")
+            }
+        }
+
+        private fun writeNullable(out: DataOutputStream, value: String?) {
+            out.writeBoolean(value != null)
+            value?.let { out.writeUTF8(it) }
+        }
+
+        private fun readNullable(input: DataInputStream): String? {
+            return if (input.readBoolean()) input.readUTF8() else null
+        }
+
+        private fun writeStrings(out: DataOutputStream, values: List<String>) {
+            out.writeInt(values.size)
+            values.forEach { out.writeUTF8(it) }
+        }
+
+        private fun readStrings(input: DataInputStream): List<String> {
+            return List(input.readInt()) { input.readUTF8() }
+        }
+
+        /** writeUTF is limited to 64KB; message contents can be longer */
+        private fun DataOutputStream.writeUTF8(value: String) {
+            val bytes = value.toByteArray(Charsets.UTF_8)
+            writeInt(bytes.size)
+            write(bytes)
+        }
+
+        private fun DataInputStream.readUTF8(): String {
+            val bytes = ByteArray(readInt())
+            readFully(bytes)
+            return String(bytes, Charsets.UTF_8)
+        }
+    }
+}
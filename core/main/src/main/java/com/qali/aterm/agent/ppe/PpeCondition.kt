@@ -0,0 +1,137 @@
+package com.qali.aterm.agent.ppe
+
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * Pre-parsed operand of a PPE condition or `$match`: a variable path or a constant
+ */
+sealed class PpeExpression {
+    abstract fun evaluate(variables: Map<String, Any>): Any
+
+    class VariableRef(val path: List<String>) : PpeExpression() {
+        override fun evaluate(variables: Map<String, Any>): Any {
+            var current: Any? = variables
+            for (part in path) {
+                current = when (current) {
+                    is Map<*, *> -> current[part]
+                    else -> null
+                }
+                if (current == null) break
+            }
+            return current ?: ""
+        }
+    }
+
+    class Constant(val value: Any) : PpeExpression() {
+        override fun evaluate(variables: Map<String, Any>): Any = value
+    }
+
+    companion object {
+        private val variablePattern = Regex("""^[a-zA-Z_][a-zA-Z0-9_.]*$""")
+
+        /**
+         * Parse [expression]; quotes are removed before deciding what it is, as before compilation
+         */
+        fun compile(expression: String): PpeExpression {
+            val trimmed = expression.trim().removeSurrounding("\"").removeSurrounding("'")
+
+            // Check if it's a variable
+            if (variablePattern.matches(trimmed)) {
+                return VariableRef(trimmed.split("."))
+            }
+
+            // Check if it's a boolean
+            if (trimmed == "true") return Constant(true)
+            if (trimmed == "false") return Constant(false)
+
+            // Check if it's a number
+            trimmed.toDoubleOrNull()?.let { return Constant(it) }
+
+            // Return as string
+            return Constant(trimmed)
+        }
+    }
+}
+
+/**
+ * Pre-parsed `$if`/`$while` condition: `a === b`, `a !== b`, `a == b`, `a != b`, `!a` or `a`
+ */
+class PpeCondition(
+    val operator: String?,
+    val left: PpeExpression,
+    val right: PpeExpression?
+) {
+    fun evaluate(variables: Map<String, Any>): Boolean {
+        return when (operator) {
+            "!==", "!=" -> left.evaluate(variables) != right!!.evaluate(variables)
+            "===", "==" -> left.evaluate(variables) == right!!.evaluate(variables)
+            "!" -> !isTruthy(left.evaluate(variables))
+            else -> isTruthy(left.evaluate(variables))
+        }
+    }
+
+    companion object {
+        private const val MAX_CACHED = 1024
+
+        // Longer operators first, so `!==` is not read as `!=` followed by `=`
+        private val COMPARISONS = listOf("!==", "===", "!=", "==")
+
+        private val conditions = ConcurrentHashMap<String, PpeCondition>()
+        private val expressions = ConcurrentHashMap<String, PpeExpression>()
+
+        fun compile(condition: String): PpeCondition {
+            val trimmed = condition.trim()
+
+            for (operator in COMPARISONS) {
+                if (trimmed.contains(operator)) {
+                    val parts = trimmed.split(operator, limit = 2)
+                    return PpeCondition(operator, PpeExpression.compile(parts[0]), PpeExpression.compile(parts[1]))
+                }
+            }
+
+            // Check for negation
+            if (trimmed.startsWith("!")) {
+                return PpeCondition("!", PpeExpression.compile(trimmed.substring(1)), null)
+            }
+
+            // Simple variable check
+            return PpeCondition(null, PpeExpression.compile(trimmed), null)
+        }
+
+        /**
+         * Compiled [condition], parsed on first use. The cache is dropped when it outgrows
+         * [MAX_CACHED], which takes generated scripts; the conditions are recompiled on demand.
+         */
+        fun of(condition: String): PpeCondition {
+            conditions[condition]?.let { return it }
+            if (conditions.size >= MAX_CACHED) conditions.clear()
+            return compile(condition).also { conditions[condition] = it }
+        }
+
+        /**
+         * Compiled `$match` [expression], parsed on first use
+         */
+        fun expression(expression: String): PpeExpression {
+            expressions[expression]?.let { return it }
+            if (expressions.size >= MAX_CACHED) expressions.clear()
+            return PpeExpression.compile(expression).also { expressions[expression] = it }
+        }
+
+        /**
+         * Keep compiled conditions of a loaded script, keyed by their source text
+         */
+        fun register(compiled: Map<String, PpeCondition>) {
+            conditions.putAll(compiled)
+        }
+
+        fun isTruthy(value: Any?): Boolean {
+            return when (value) {
+                is Boolean -> value
+                is String -> value.isNotEmpty() && value.lowercase() != "false" && value != "0"
+                is Number -> value.toDouble() != 0.0
+                null -> false
+                else -> true
+            }
+        }
+    }
+}
@@ -140,10 +140,10 @@ object PpeConfig {
     // ==================== Helper Functions ====================
     
     /**
-     * Estimate token count from text (rough approximation)
+     * Token count of text, exact once the model's BPE vocabulary is loaded (see [TokenCounter])
      */
-    fun estimateTokens(text: String): Int {
-        return (text.length / CHARS_PER_TOKEN).toInt()
+    fun estimateTokens(text: String, model: String? = null): Int {
+        return TokenCounter.countTokens(text, model)
     }
     
     /**
@@ -159,7 +159,7 @@ object PpeConfig {
      * Check if text exceeds token limit for model
      */
     fun exceedsTokenLimit(text: String, model: String): Boolean {
-        val estimatedTokens = estimateTokens(text)
+        val estimatedTokens = estimateTokens(text, model)
         val maxTokens = getMaxTokensForModel(model)
         return estimatedTokens > maxTokens
     }
@@ -8,6 +8,7 @@ import com.qali.aterm.agent.utils.AtermIgnoreManager
 import com.qali.aterm.agent.debug.DebugLogger
 import com.qali.aterm.agent.debug.ExecutionStateTracker
 import com.qali.aterm.agent.debug.BreakpointManager
+import com.qali.aterm.agent.debug.TraceRecorder
 import android.util.Log
 import org.json.JSONObject
 import org.json.JSONArray
@@ -374,6 +375,7 @@ class PpeExecutionEngine(
                             val toolResults = if (callsToExecute.isNotEmpty()) {
                                 ParallelToolExecutor.executeInParallel(
                                     calls = callsToExecute,
+                                    workspaceRoot = workspaceRoot,
                                     executeTool = { call ->
                                         toolExecutionCount++
                                         lastActivityTime = System.currentTimeMillis()
@@ -1906,7 +1908,7 @@ class PpeExecutionEngine(
         // Create invocation and execute - use unchecked cast like AgentClient does
         @Suppress("UNCHECKED_CAST")
         val invocation = (tool as com.qali.aterm.agent.tools.DeclarativeTool<Any, com.qali.aterm.agent.tools.ToolResult>).createInvocation(params)
-        val result = invocation.execute()
+        val result = TraceRecorder.span("ppe.tool", functionCall.name) { invocation.execute() }
         
         // Store result in queue for file diff extraction (FIFO)
         toolResultQueue.add(Pair(functionCall.name, result))
@@ -2074,78 +2076,17 @@ class PpeExecutionEngine(
     }
     
     /**
-     * Evaluate a condition expression
+     * Evaluate a condition expression, compiled once per condition text
      */
     private fun evaluateCondition(condition: String, variables: Map<String, Any>): Boolean {
-        // Simple condition evaluation
-        // Support: variable, !variable, variable === value, variable !== value, etc.
-        val trimmed = condition.trim()
-        
-        // Check for !==
-        if (trimmed.contains("!==")) {
-            val parts = trimmed.split("!==", limit = 2)
-            val left = evaluateExpression(parts[0].trim(), variables)
-            val right = evaluateExpression(parts[1].trim(), variables)
-            return left != right
-        }
-        
-        // Check for ===
-        if (trimmed.contains("===")) {
-            val parts = trimmed.split("===", limit = 2)
-            val left = evaluateExpression(parts[0].trim(), variables)
-            val right = evaluateExpression(parts[1].trim(), variables)
-            return left == right
-        }
-        
-        // Check for !=
-        if (trimmed.contains("!=")) {
-            val parts = trimmed.split("!=", limit = 2)
-            val left = evaluateExpression(parts[0].trim(), variables)
-            val right = evaluateExpression(parts[1].trim(), variables)
-            return left != right
-        }
-        
-        // Check for ==
-        if (trimmed.contains("==")) {
-            val parts = trimmed.split("==", limit = 2)
-            val left = evaluateExpression(parts[0].trim(), variables)
-            val right = evaluateExpression(parts[1].trim(), variables)
-            return left == right
-        }
-        
-        // Check for negation
-        if (trimmed.startsWith("!")) {
-            val expr = trimmed.substring(1).trim()
-            val value = evaluateExpression(expr, variables)
-            return !value.toBoolean()
-        }
-        
-        // Simple variable check
-        val value = evaluateExpression(trimmed, variables)
-        return value.toBoolean()
+        return PpeCondition.of(condition).evaluate(variables)
     }
     
     /**
-     * Evaluate an expression
+     * Evaluate an expression, compiled once per expression text
      */
     private fun evaluateExpression(expression: String, variables: Map<String, Any>): Any {
-        val trimmed = expression.trim().removeSurrounding("\"").removeSurrounding("'")
-        
-        // Check if it's a variable
-        if (trimmed.matches(Regex("""^[a-zA-Z_][a-zA-Z0-9_.]*$"""))) {
-            return getNestedValue(trimmed, variables) ?: ""
-        }
-        
-        // Check if it's a boolean
-        if (trimmed == "true") return true
-        if (trimmed == "false") return false
-        
-        // Check if it's a number
-        trimmed.toDoubleOrNull()?.let { return it }
-        trimmed.toIntOrNull()?.let { return it }
-        
-        // Return as string
-        return trimmed
+        return PpeCondition.expression(expression).evaluate(variables)
     }
     
     /**
@@ -2166,19 +2107,6 @@ class PpeExecutionEngine(
         return current
     }
     
-    /**
-     * Convert value to boolean
-     */
-    private fun Any.toBoolean(): Boolean {
-        return when (this) {
-            is Boolean -> this
-            is String -> this.isNotEmpty() && this.lowercase() != "false" && this != "0"
-            is Number -> this.toDouble() != 0.0
-            null -> false
-            else -> true
-        }
-    }
-    
     /**
      * Load a chained script
      */
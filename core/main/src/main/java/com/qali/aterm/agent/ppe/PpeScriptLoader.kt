@@ -1,13 +1,32 @@
 package com.qali.aterm.agent.ppe
 
 import com.qali.aterm.agent.ppe.models.PpeScript
+import com.rk.libcommons.application
+import java.io.DataInputStream
+import java.io.DataOutputStream
 import java.io.File
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
 
 /**
  * Loads and caches PPE scripts
+ *
+ * Scripts are compiled ([PpeCompiledScript]) and cached by content hash, in memory and in the
+ * app's cache directory, so a script is parsed once per version of its text rather than once per
+ * process. Editing a script changes its hash and it is parsed again on the next load.
  */
 object PpeScriptLoader {
-    private val scriptCache = mutableMapOf<String, PpeScript>()
+    private const val MAGIC = 0x50504543 // "PPEC"
+    private const val FORMAT_VERSION = 1
+    private const val MAX_STORED_SCRIPTS = 64
+    
+    private class CachedScript(val hash: String, val script: PpeScript)
+    
+    private val scriptCache = ConcurrentHashMap<String, CachedScript>()
+    
+    /** Where compiled scripts are stored; null (tests, or before the app is set up) keeps them in memory */
+    var storeDir: File? = null
+        get() = field ?: application?.cacheDir?.let { File(it, "ppe-scripts") }
     
     /**
      * Load a script from file path
@@ -17,15 +36,7 @@ object PpeScriptLoader {
         if (!file.exists()) {
             throw IllegalArgumentException("Script file not found: $filePath")
         }
-        
-        // Check cache
-        val cacheKey = file.canonicalPath
-        scriptCache[cacheKey]?.let { return it }
-        
-        // Parse and cache (use enhanced parser for full CLI features)
-        val script = PpeScriptParserEnhanced.parse(file)
-        scriptCache[cacheKey] = script
-        return script
+        return loadScript(file)
     }
     
     /**
@@ -37,12 +48,23 @@ object PpeScriptLoader {
         }
         
         // Check cache
+        val content = file.readBytes()
+        val hash = contentHash(content)
         val cacheKey = file.canonicalPath
-        scriptCache[cacheKey]?.let { return it }
+        scriptCache[cacheKey]?.let { if (it.hash == hash) return it.script }
         
-        // Parse and cache (use enhanced parser for full CLI features)
-        val script = PpeScriptParserEnhanced.parse(file)
-        scriptCache[cacheKey] = script
+        // Compiled on an earlier run, or parse and compile (use enhanced parser for full CLI features)
+        val compiled = readCompiled(hash)
+            ?: PpeCompiledScript.compile(PpeScriptParserEnhanced.parse(String(content, Charsets.UTF_8), file.absolutePath))
+                .also { writeCompiled(hash, it) }
+        compiled.register()
+        // The same text may live at several paths
+        val script = if (compiled.script.sourcePath == file.absolutePath) {
+            compiled.script
+        } else {
+            compiled.script.copy(sourcePath = file.absolutePath)
+        }
+        scriptCache[cacheKey] = CachedScript(hash, script)
         return script
     }
     
@@ -84,6 +106,61 @@ object PpeScriptLoader {
      */
     fun getCached(filePath: String): PpeScript? {
         val file = File(filePath)
-        return scriptCache[file.canonicalPath]
+        return scriptCache[file.canonicalPath]?.script
+    }
+    
+    private fun readCompiled(hash: String): PpeCompiledScript? {
+        val file = storeDir?.let { File(it, "$hash.bin") } ?: return null
+        if (!file.isFile) return null
+        return try {
+            DataInputStream(file.inputStream().buffered()).use { input ->
+                if (input.readInt() != MAGIC || input.readInt() != FORMAT_VERSION) return null
+                PpeCompiledScript.read(input)
+            }.also {
+                // Recently used scripts survive pruning
+                file.setLastModified(System.currentTimeMillis())
+            }
+        } catch (e: Exception) {
+            // Damaged or from an incompatible build: parse the script again
+            file.delete()
+            null
+        }
+    }
+    
+    private fun writeCompiled(hash: String, compiled: PpeCompiledScript) {
+        val dir = storeDir ?: return
+        val file = File(dir, "$hash.bin")
+        val temp = File(dir, "$hash.tmp")
+        try {
+            dir.mkdirs()
+            DataOutputStream(temp.outputStream().buffered()).use { out ->
+                out.writeInt(MAGIC)
+                out.writeInt(FORMAT_VERSION)
+                compiled.write(out)
+            }
+            if (!temp.renameTo(file)) temp.delete()
+        } catch (e: Exception) {
+            // Values the store cannot encode: the script is parsed again next time
+            temp.delete()
+            return
+        }
+        
+        // Every edit of a script leaves its previous version behind
+        val stored = dir.listFiles { f -> f.name.endsWith(".bin") } ?: return
+        if (stored.size > MAX_STORED_SCRIPTS) {
+            stored.sortedBy { it.lastModified() }.take(stored.size - MAX_STORED_SCRIPTS).forEach { it.delete() }
+        }
+    }
+    
+    /**
+     * Hash of the script text and the app build, since a new build may parse scripts differently
+     */
+    private fun contentHash(content: ByteArray): String {
+        val digest = MessageDigest.getInstance("SHA-1")
+        application?.applicationInfo?.sourceDir?.let { apk ->
+            digest.update(File(apk).lastModified().toString().toByteArray())
+        }
+        digest.update(content)
+        return digest.digest().joinToString("") { "%02x".format(it) }
     }
 }
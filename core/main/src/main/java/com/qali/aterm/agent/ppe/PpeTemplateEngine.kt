@@ -1,58 +1,126 @@
 package com.qali.aterm.agent.ppe
 
+import java.util.concurrent.ConcurrentHashMap
 import java.util.regex.Pattern
 
 /**
  * Simple template engine for PPE scripts
  * Supports {{variable}} syntax (Jinja2-like)
+ *
+ * Templates are compiled once into literal text and variable segments with their path and filter
+ * chain already split, so rendering the same template again is a walk over the segments. Templates
+ * of loaded scripts are registered by [PpeScriptLoader] and stay compiled; others go through a
+ * small LRU cache.
  */
 object PpeTemplateEngine {
     private val templatePattern = Pattern.compile("\\{\\{([^}]+)\\}\\}")
+    private const val MAX_CACHED_TEMPLATES = 512
+    
+    /**
+     * A `{{path | filter | ...}}` placeholder
+     */
+    class Variable(val name: String, val path: List<String>, val filters: List<String>)
+    
+    /**
+     * A template split into literal text and [Variable]s, alternating and starting with text
+     */
+    class CompiledTemplate(val literals: List<String>, val variables: List<Variable>) {
+        
+        fun render(variables: Map<String, Any>): String {
+            if (this.variables.isEmpty()) return literals[0]
+            val result = StringBuilder(literals.sumOf { it.length } + this.variables.size * 16)
+            for (i in this.variables.indices) {
+                result.append(literals[i])
+                result.append(getVariableValue(this.variables[i], variables).toString())
+            }
+            result.append(literals.last())
+            return result.toString()
+        }
+    }
+    
+    private val scriptTemplates = ConcurrentHashMap<String, CompiledTemplate>()
+    
+    private val recentTemplates = object : LinkedHashMap<String, CompiledTemplate>(64, 0.75f, true) {
+        override fun removeEldestEntry(eldest: MutableMap.MutableEntry<String, CompiledTemplate>): Boolean {
+            return size > MAX_CACHED_TEMPLATES
+        }
+    }
     
     /**
      * Render template with variables
      */
     fun render(template: String, variables: Map<String, Any>): String {
+        return compiled(template).render(variables)
+    }
+    
+    /**
+     * Compiled form of [template], from the caches when it was seen before
+     */
+    fun compiled(template: String): CompiledTemplate {
+        scriptTemplates[template]?.let { return it }
+        synchronized(recentTemplates) { recentTemplates[template] }?.let { return it }
+        val compiled = compile(template)
+        synchronized(recentTemplates) { recentTemplates[template] = compiled }
+        return compiled
+    }
+    
+    /**
+     * Keep the compiled templates of a loaded script, keyed by their source text
+     */
+    fun register(templates: Map<String, CompiledTemplate>) {
+        scriptTemplates.putAll(templates)
+    }
+    
+    /**
+     * Split [template] into literals and variables
+     */
+    fun compile(template: String): CompiledTemplate {
         val matcher = templatePattern.matcher(template)
-        val result = StringBuffer()
-        
-        while (matcher.find()) {
-            val varName = matcher.group(1).trim()
-            val value = getVariableValue(varName, variables)
-            matcher.appendReplacement(result, escapeReplacement(value.toString()))
-        }
-        matcher.appendTail(result)
+        if (!matcher.find()) return CompiledTemplate(listOf(template), emptyList())
         
-        return result.toString()
+        val literals = ArrayList<String>()
+        val variables = ArrayList<Variable>()
+        var last = 0
+        do {
+            literals.add(template.substring(last, matcher.start()))
+            variables.add(parseVariable(matcher.group(1).trim()))
+            last = matcher.end()
+        } while (matcher.find())
+        literals.add(template.substring(last))
+        return CompiledTemplate(literals, variables)
     }
     
     /**
-     * Get variable value, supporting dot notation (e.g., "user.name")
+     * Parse the inside of a placeholder, supporting filters (e.g., {{name | upper}})
      */
-    private fun getVariableValue(varName: String, variables: Map<String, Any>): Any {
-        // Handle filters (e.g., {{name | upper}})
-        val parts = varName.split("|").map { it.trim() }
-        val actualVarName = parts[0]
-        
-        // Handle dot notation
-        val value = getNestedValue(actualVarName, variables)
+    private fun parseVariable(expression: String): Variable {
+        val parts = expression.split("|").map { it.trim() }
+        val name = parts[0]
+        // Handle dot notation (e.g., "user.name")
+        return Variable(name, name.split("."), parts.drop(1).map { it.lowercase() })
+    }
+    
+    /**
+     * Get variable value, applying its filters
+     */
+    private fun getVariableValue(variable: Variable, variables: Map<String, Any>): Any {
+        val value = getNestedValue(variable.path, variables)
         
         // Apply filters if any
-        if (parts.size > 1) {
-            return applyFilters(value, parts.drop(1))
+        if (variable.filters.isNotEmpty()) {
+            return applyFilters(value, variable.filters)
         }
         
         return value ?: ""
     }
     
     /**
-     * Get nested value using dot notation
+     * Get nested value along a dot notation path
      */
-    private fun getNestedValue(path: String, variables: Map<String, Any>): Any? {
-        val parts = path.split(".")
+    private fun getNestedValue(path: List<String>, variables: Map<String, Any>): Any? {
         var current: Any? = variables
         
-        for (part in parts) {
+        for (part in path) {
             current = when (current) {
                 is Map<*, *> -> current[part]
                 else -> null
@@ -64,12 +132,12 @@ object PpeTemplateEngine {
     }
     
     /**
-     * Apply filters to value
+     * Apply filters (already lower-cased) to value
      */
     private fun applyFilters(value: Any?, filters: List<String>): Any {
         var result = value
         for (filter in filters) {
-            result = when (filter.lowercase()) {
+            result = when (filter) {
                 "upper" -> result?.toString()?.uppercase() ?: ""
                 "lower" -> result?.toString()?.lowercase() ?: ""
                 "trim" -> result?.toString()?.trim() ?: ""
@@ -79,31 +147,25 @@ object PpeTemplateEngine {
         return result ?: ""
     }
     
-    /**
-     * Escape replacement string for use in Matcher.appendReplacement
-     */
-    private fun escapeReplacement(str: String): String {
-        return str.replace("\\", "\\\\")
-            .replace("$", "\\$")
-    }
-    
     /**
      * Check if template contains variables
      */
     fun hasVariables(template: String): Boolean {
-        return templatePattern.matcher(template).find()
+        return compiled(template).variables.isNotEmpty()
     }
     
     /**
      * Extract variable names from template
      */
     fun extractVariables(template: String): List<String> {
-        val variables = mutableListOf<String>()
-        val matcher = templatePattern.matcher(template)
-        while (matcher.find()) {
-            val varName = matcher.group(1).trim().split("|")[0].trim()
-            variables.add(varName)
-        }
-        return variables.distinct()
+        return compiled(template).variables.map { it.name }.distinct()
+    }
+    
+    /**
+     * Drop every compiled template
+     */
+    fun clearCache() {
+        scriptTemplates.clear()
+        synchronized(recentTemplates) { recentTemplates.clear() }
     }
 }
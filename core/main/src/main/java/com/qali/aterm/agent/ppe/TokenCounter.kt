@@ -0,0 +1,248 @@
+package com.qali.aterm.agent.ppe
+
+import com.google.gson.Gson
+import com.qali.aterm.agent.core.Content
+import com.qali.aterm.agent.core.Part
+import com.qali.aterm.api.HttpClientProvider
+import com.rk.libcommons.application
+import okhttp3.Request
+import okio.buffer
+import okio.source
+import java.io.File
+import java.io.IOException
+import java.util.concurrent.ConcurrentHashMap
+import java.util.regex.Pattern
+
+/**
+ * Token counts for context budgeting
+ *
+ * Uses the BPE vocabulary of the model's provider when it is available (OpenAI's published
+ * tiktoken encodings; Anthropic and Gemini do not publish theirs, so cl100k_base stands in as the
+ * closest public vocabulary). Vocabularies live in `files/tokenizers`. They are only fetched from
+ * OpenAI's public storage when the user asks for it in the agent settings ([downloadVocabularies]),
+ * which show whether counts are exact ([vocabularyState]); until then counts fall back to a
+ * per-piece approximation.
+ *
+ * Counts for a [Content] are cached, so each message in a growing history is tokenized only once.
+ */
+object TokenCounter {
+
+    /**
+     * A tiktoken encoding: rank file name, download location and pre-tokenizer pattern
+     */
+    class Encoding(val name: String, val url: String, val pattern: String)
+
+    val CL100K_BASE = Encoding(
+        name = "cl100k_base",
+        url = "https://openaipublic.blob.core.windows.net/encodings/cl100k_base.tiktoken",
+        pattern = """(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+"""
+    )
+
+    val O200K_BASE = Encoding(
+        name = "o200k_base",
+        url = "https://openaipublic.blob.core.windows.net/encodings/o200k_base.tiktoken",
+        pattern = listOf(
+            """[^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]*[\p{Ll}\p{Lm}\p{Lo}\p{M}]+(?i:'s|'t|'re|'ve|'m|'ll|'d)?""",
+            """[^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}]+[\p{Ll}\p{Lm}\p{Lo}\p{M}]*(?i:'s|'t|'re|'ve|'m|'ll|'d)?""",
+            """\p{N}{1,3}""",
+            """ ?[^\s\p{L}\p{N}]+[\r\n/]*""",
+            """\s*[\r\n]+""",
+            """\s+(?!\S)""",
+            """\s+"""
+        ).joinToString("|")
+    )
+
+    /** Whether exact counts are available, for showing in the settings */
+    enum class VocabularyState { MISSING, DOWNLOADING, FAILED, READY }
+
+    /** Tokens added per message for role and separators in chat formats */
+    const val MESSAGE_OVERHEAD_TOKENS = 4
+
+    private const val MAX_CACHED_CONTENTS = 4096
+    private const val APPROXIMATE = "approximate"
+
+    private val gson = Gson()
+    private val tokenizers = ConcurrentHashMap<String, BpeTokenizer>()
+    private val unavailable = ConcurrentHashMap.newKeySet<String>()
+    private val downloads = ConcurrentHashMap<String, VocabularyState>()
+    private val approximateSplitter = Pattern.compile(CL100K_BASE.pattern)
+
+    private val contentCache = object : LinkedHashMap<Pair<String, Content>, Int>(256, 0.75f, true) {
+        override fun removeEldestEntry(eldest: MutableMap.MutableEntry<Pair<String, Content>, Int>?): Boolean {
+            return size > MAX_CACHED_CONTENTS
+        }
+    }
+
+    /**
+     * Directory holding `<encoding>.tiktoken` files. Null disables loading and downloading.
+     */
+    @Volatile
+    var vocabularyDir: File? = application?.filesDir?.let { File(it, "tokenizers") }
+
+    fun encodingForModel(model: String?): Encoding {
+        val name = model?.lowercase() ?: return CL100K_BASE
+        return when {
+            name.startsWith("gpt-4o") || name.startsWith("gpt-4.1") || name.startsWith("gpt-5") ||
+                name.startsWith("chatgpt-4o") || Regex("""^o\d""").containsMatchIn(name) -> O200K_BASE
+            else -> CL100K_BASE
+        }
+    }
+
+    /**
+     * The exact tokenizer for [model], or null while its vocabulary is not available yet
+     */
+    fun tokenizerFor(model: String?): BpeTokenizer? {
+        val encoding = encodingForModel(model)
+        tokenizers[encoding.name]?.let { return it }
+        if (encoding.name in unavailable) return null
+
+        synchronized(this) {
+            tokenizers[encoding.name]?.let { return it }
+            val file = vocabularyDir?.let { File(it, "${encoding.name}.tiktoken") }
+            if (file == null) {
+                unavailable.add(encoding.name)
+                return null
+            }
+            if (file.exists()) {
+                val tokenizer = runCatching {
+                    file.source().buffer().use { BpeTokenizer.load(encoding.name, it, encoding.pattern) }
+                }.getOrNull()
+                if (tokenizer != null) {
+                    tokenizers[encoding.name] = tokenizer
+                    return tokenizer
+                }
+                file.delete()
+            }
+            unavailable.add(encoding.name)
+            return null
+        }
+    }
+
+    /**
+     * State of the vocabularies of all encodings: [VocabularyState.READY] only when every one is
+     * there, so that counts are exact whichever model is used
+     */
+    fun vocabularyState(): VocabularyState {
+        val states = listOf(CL100K_BASE, O200K_BASE).map { encoding ->
+            val file = vocabularyDir?.let { File(it, "${encoding.name}.tiktoken") }
+            when {
+                tokenizers.containsKey(encoding.name) || file?.exists() == true -> VocabularyState.READY
+                else -> downloads[encoding.name] ?: VocabularyState.MISSING
+            }
+        }
+        return when {
+            VocabularyState.DOWNLOADING in states -> VocabularyState.DOWNLOADING
+            VocabularyState.FAILED in states -> VocabularyState.FAILED
+            VocabularyState.MISSING in states -> VocabularyState.MISSING
+            else -> VocabularyState.READY
+        }
+    }
+
+    /**
+     * Fetch the missing vocabularies in the background and call [onDone] once all downloads ended,
+     * successfully or not. Only run when the user asks for it.
+     */
+    fun downloadVocabularies(onDone: () -> Unit = {}) {
+        val dir = vocabularyDir
+        if (dir == null || application == null) {
+            onDone()
+            return
+        }
+        val missing = listOf(CL100K_BASE, O200K_BASE).filter { encoding ->
+            !tokenizers.containsKey(encoding.name) && !File(dir, "${encoding.name}.tiktoken").exists() &&
+                downloads[encoding.name] != VocabularyState.DOWNLOADING
+        }
+        if (missing.isEmpty()) {
+            onDone()
+            return
+        }
+        missing.forEach { downloads[it.name] = VocabularyState.DOWNLOADING }
+        Thread {
+            for (encoding in missing) downloadVocabulary(encoding, File(dir, "${encoding.name}.tiktoken"))
+            onDone()
+        }.start()
+    }
+
+    fun countTokens(text: String, model: String? = null): Int {
+        if (text.isEmpty()) return 0
+        return tokenizerFor(model)?.countTokens(text) ?: approximateTokens(text)
+    }
+
+    /**
+     * Token count of one message, including [MESSAGE_OVERHEAD_TOKENS]. Cached per content and encoding.
+     */
+    fun countTokens(content: Content, model: String? = null): Int {
+        val tokenizer = tokenizerFor(model)
+        val key = Pair(tokenizer?.name ?: APPROXIMATE, content)
+        synchronized(contentCache) {
+            contentCache[key]?.let { return it }
+        }
+
+        fun count(text: String) = tokenizer?.countTokens(text) ?: approximateTokens(text)
+        val tokens = MESSAGE_OVERHEAD_TOKENS + content.parts.sumOf { part ->
+            when (part) {
+                is Part.TextPart -> count(part.text)
+                is Part.FunctionCallPart -> count(part.functionCall.name) + count(gson.toJson(part.functionCall.args))
+                is Part.FunctionResponsePart -> count(part.functionResponse.name) + count(gson.toJson(part.functionResponse.response))
+            }
+        }
+
+        synchronized(contentCache) {
+            contentCache[key] = tokens
+        }
+        return tokens
+    }
+
+    fun clearCache() {
+        synchronized(contentCache) {
+            contentCache.clear()
+        }
+    }
+
+    /**
+     * Approximation used while no vocabulary is loaded: split like cl100k_base and assume common
+     * pieces of up to four bytes are one token and longer ones take a token per four bytes.
+     * Errs on the high side so pruning never overflows the real window.
+     */
+    fun approximateTokens(text: String): Int {
+        var count = 0
+        val matcher = approximateSplitter.matcher(text)
+        while (matcher.find()) {
+            var bytes = 0
+            for (i in matcher.start() until matcher.end()) {
+                val c = text[i]
+                bytes += when {
+                    c.code < 0x80 -> 1
+                    c.code < 0x800 -> 2
+                    Character.isSurrogate(c) -> 2
+                    else -> 3
+                }
+            }
+            count += 1 + (bytes - 1) / 4
+        }
+        return count
+    }
+
+    private fun downloadVocabulary(encoding: Encoding, file: File) {
+        val partFile = File(file.parentFile, "${file.name}.part")
+        try {
+            file.parentFile?.mkdirs()
+            val request = Request.Builder().url(encoding.url).build()
+            HttpClientProvider.client.newCall(request).execute().use { response ->
+                if (!response.isSuccessful) throw IOException("HTTP ${response.code}")
+                partFile.outputStream().use { out -> response.body!!.byteStream().copyTo(out) }
+            }
+            // Only publish a vocabulary that parses, then make it available to new counts
+            val tokenizer = partFile.source().buffer().use { BpeTokenizer.load(encoding.name, it, encoding.pattern) }
+            if (!partFile.renameTo(file)) throw IOException("Could not write $file")
+            tokenizers[encoding.name] = tokenizer
+            unavailable.remove(encoding.name)
+            downloads.remove(encoding.name)
+        } catch (e: Exception) {
+            android.util.Log.w("TokenCounter", "Could not fetch ${encoding.name} vocabulary: ${e.message}")
+            downloads[encoding.name] = VocabularyState.FAILED
+        } finally {
+            partFile.delete()
+        }
+    }
+}
@@ -0,0 +1,164 @@
+package com.qali.aterm.agent.ppe
+
+import com.qali.aterm.agent.core.FunctionCall
+import java.io.File
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * What a tool call reads and writes, used by [ParallelToolExecutor] to order conflicting calls
+ *
+ * Paths come from the call arguments and are resolved against the workspace root when it is
+ * known. [WORKSPACE] stands for the whole workspace. Names starting with `@` are non-file resources
+ * (agent memory, the todo list) and only conflict with the same name.
+ */
+data class ToolAccess(
+    val reads: Set<String> = emptySet(),
+    val writes: Set<String> = emptySet(),
+    val resourceClass: ResourceClass = ResourceClass.FILE_IO
+) {
+    /**
+     * Concurrency class of a call. Each class has its own limit in [ParallelToolExecutor].
+     */
+    enum class ResourceClass {
+        /** Processes started through the shell: CPU and memory heavy */
+        SHELL,
+        /** Reads and writes in the workspace */
+        FILE_IO,
+        /** Requests to remote services */
+        NETWORK
+    }
+
+    /**
+     * True when this call and [other] must not run at the same time: one of them writes something
+     * the other reads or writes.
+     */
+    fun conflictsWith(other: ToolAccess): Boolean {
+        return overlaps(writes, other.reads) || overlaps(writes, other.writes) || overlaps(reads, other.writes)
+    }
+
+    companion object {
+        const val WORKSPACE = ""
+
+        private val declarations = ConcurrentHashMap<String, (Map<String, Any>) -> ToolAccess>()
+
+        // First words of shell commands that only read the workspace; not uniq, which writes its
+        // second operand
+        private val READ_ONLY_COMMANDS = setOf(
+            "cat", "head", "tail", "less", "ls", "tree", "find", "grep", "rg", "egrep", "fgrep", "wc",
+            "du", "df", "stat", "file", "pwd", "echo", "printf", "which", "whoami", "uname",
+            "date", "diff", "cmp", "cut", "tr", "md5sum", "sha256sum", "ps", "true"
+        )
+        private val READ_ONLY_GIT = setOf("status", "log", "diff", "show", "blame", "rev-parse", "ls-files")
+        // Git commands that create, rename or delete things when given arguments other than these
+        private val LISTING_GIT = mapOf(
+            "branch" to setOf("--list", "-l", "-a", "--all", "-r", "--remotes", "-v", "-vv", "--verbose", "--show-current"),
+            "remote" to setOf("-v", "--verbose")
+        )
+        // A lone & runs the command before it in the background and starts the next one
+        private val COMMAND_SEPARATOR = Regex("""&&|\|\||[;|&\n]""")
+        // find actions that delete, run commands or write to a file
+        private val FIND_WRITING_ACTIONS = setOf("-delete", "-fprint", "-fprint0", "-fprintf", "-fls")
+
+        private val BARRIER = ToolAccess(reads = setOf(WORKSPACE), writes = setOf(WORKSPACE))
+
+        /**
+         * Declare the access of tool [name], replacing the built-in declaration if there is one.
+         * Tools without a declaration are treated as reading and writing the whole workspace.
+         */
+        fun declare(name: String, access: (args: Map<String, Any>) -> ToolAccess) {
+            declarations[name] = access
+        }
+
+        fun of(call: FunctionCall, workspaceRoot: String? = null): ToolAccess {
+            val access = declarations[call.name]?.invoke(call.args) ?: builtIn(call.name, call.args)
+            if (workspaceRoot == null) return access
+            fun resolve(path: String): String {
+                if (path == WORKSPACE || path.startsWith("@") || path.startsWith("/")) return path
+                return File(workspaceRoot, path).path
+            }
+            return access.copy(reads = access.reads.mapTo(HashSet(), ::resolve), writes = access.writes.mapTo(HashSet(), ::resolve))
+        }
+
+        private fun builtIn(name: String, args: Map<String, Any>): ToolAccess {
+            val filePath = args["file_path"] as? String
+            val dirPath = (args["dir_path"] as? String) ?: WORKSPACE
+            return when (name) {
+                "read_file", "file_structure", "language_linter", "syntax_error_detection" ->
+                    ToolAccess(reads = setOf(filePath ?: WORKSPACE))
+                "read_many_files", "analyze_architecture", "analyze_code_quality", "code_review",
+                "analyze_coverage", "analyze_project", "document_analysis", "intelligent_error_analysis" ->
+                    ToolAccess(reads = setOf(WORKSPACE))
+                "glob", "grep", "ripgrep", "ls" ->
+                    ToolAccess(reads = setOf(dirPath))
+                "write_file", "edit", "smart_edit", "sed", "syntax_fix" ->
+                    ToolAccess(writes = setOf(filePath ?: WORKSPACE))
+                "shell", "execute_command" -> {
+                    val command = args["command"] as? String
+                    if (command != null && isReadOnlyCommand(command)) {
+                        ToolAccess(reads = setOf(dirPath), resourceClass = ResourceClass.SHELL)
+                    } else {
+                        BARRIER.copy(resourceClass = ResourceClass.SHELL)
+                    }
+                }
+                "interactive_shell", "run_tests", "manage_dependencies", "profile_performance" ->
+                    BARRIER.copy(resourceClass = ResourceClass.SHELL)
+                "web_fetch", "google_web_search", "custom_web_search" ->
+                    ToolAccess(resourceClass = ResourceClass.NETWORK)
+                "memory" -> ToolAccess(writes = setOf("@memory"))
+                "write_todos" -> ToolAccess(writes = setOf("@todos"))
+                else -> BARRIER
+            }
+        }
+
+        /**
+         * Conservative check for a shell command that cannot modify files: every command in the
+         * pipeline or list is a known reader, and there is no redirection or command or process
+         * substitution.
+         */
+        internal fun isReadOnlyCommand(command: String): Boolean {
+            if (command.contains('>') || command.contains('`') || command.contains("$(") || command.contains("<(")) return false
+            return command.split(COMMAND_SEPARATOR).all { segment ->
+                val words = segment.trim().split(Regex("""\s+"""))
+                val program = words.firstOrNull()?.substringAfterLast('/') ?: return@all true
+                when (program) {
+                    "" -> true
+                    "git" -> isReadOnlyGit(words.drop(1))
+                    "find" -> words.none { it in FIND_WRITING_ACTIONS || it.startsWith("-exec") || it.startsWith("-ok") }
+                    else -> program in READ_ONLY_COMMANDS
+                }
+            }
+        }
+
+        private fun isReadOnlyGit(args: List<String>): Boolean {
+            val subcommand = args.firstOrNull() ?: return true
+            val options = args.drop(1)
+            // git diff and git log write to --output
+            if (options.any { it.startsWith("--output") }) return false
+            val listing = LISTING_GIT[subcommand] ?: return subcommand in READ_ONLY_GIT
+            return options.all { it in listing }
+        }
+
+        private fun overlaps(a: Set<String>, b: Set<String>): Boolean {
+            if (a.isEmpty() || b.isEmpty()) return false
+            return a.any { x -> b.any { y -> pathsOverlap(x, y) } }
+        }
+
+        /**
+         * Whether one path is, or lies inside, the other. A relative and an absolute path cannot
+         * be compared without the workspace root and are assumed to overlap.
+         */
+        internal fun pathsOverlap(a: String, b: String): Boolean {
+            if (a.startsWith("@") || b.startsWith("@")) return a == b
+            val x = normalize(a)
+            val y = normalize(b)
+            if (x == WORKSPACE || y == WORKSPACE) return true
+            if (x.startsWith("/") != y.startsWith("/")) return true
+            return x == y || x.startsWith("$y/") || y.startsWith("$x/")
+        }
+
+        private fun normalize(path: String): String {
+            val normalized = File(path.trim()).normalize().path.removeSuffix("/")
+            return if (normalized == ".") WORKSPACE else normalized.removePrefix("./")
+        }
+    }
+}
@@ -1,6 +1,7 @@
 package com.qali.aterm.agent.tools
 
 import com.qali.aterm.api.ApiProviderManager
+import com.qali.aterm.api.HttpClientProvider
 import com.qali.aterm.agent.client.AgentClient
 import com.qali.aterm.agent.core.*
 import com.qali.aterm.agent.core.FunctionDeclaration
@@ -19,7 +20,6 @@ import org.json.JSONObject
 import java.io.IOException
 import java.net.URLEncoder
 import java.util.Locale
-import java.util.concurrent.TimeUnit
 
 data class CustomWebSearchToolParams(
     val query: String,
@@ -72,11 +72,11 @@ class CustomWebSearchToolInvocation(
     
     override val params: CustomWebSearchToolParams = toolParams
     
-    private val httpClient = OkHttpClient.Builder()
-        .connectTimeout(15, TimeUnit.SECONDS)
-        .readTimeout(30, TimeUnit.SECONDS)
-        .writeTimeout(15, TimeUnit.SECONDS)
-        .build()
+    private val httpClient = HttpClientProvider.newClient(
+        connectTimeoutSeconds = 15,
+        readTimeoutSeconds = 30,
+        writeTimeoutSeconds = 15
+    )
     
     override fun getDescription(): String {
         return "Custom web search for: \"${params.query}\""
@@ -4,9 +4,8 @@ import com.rk.libcommons.alpineDir
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import com.qali.aterm.agent.utils.WorkspaceFileIndex
 import java.io.File
-import java.nio.file.Files
-import java.nio.file.attribute.FileTime
 import java.util.regex.Pattern
 
 data class GlobToolParams(
@@ -110,23 +109,15 @@ class GlobToolInvocation(
         if (signal?.isAborted() == true) return
         if (!dir.exists() || !dir.isDirectory) return
         
-        dir.listFiles()?.forEach { file ->
+        // Paths and times come from the shared index instead of a walk
+        for (entry in WorkspaceFileIndex.filesUnder(workspaceRoot, dir, includeIgnored = true, skipHidden = true)) {
             if (signal?.isAborted() == true) return
             
-            val relativePath = file.relativeTo(File(workspaceRoot)).path
-            val absolutePath = file.absolutePath
+            val file = File(workspaceRoot, entry.path)
+            val absolutePath = file.absoluteFile.normalize().path
             
-            if (file.isFile) {
-                if (pattern.matcher(relativePath).find() || pattern.matcher(absolutePath).find()) {
-                    val modifiedTime = try {
-                        Files.getLastModifiedTime(file.toPath()).toMillis()
-                    } catch (e: Exception) {
-                        file.lastModified()
-                    }
-                    matchingFiles.add(FileEntry(absolutePath, modifiedTime))
-                }
-            } else if (file.isDirectory && !file.name.startsWith(".")) {
-                searchFiles(file, pattern, matchingFiles, signal)
+            if (pattern.matcher(entry.path).find() || pattern.matcher(absolutePath).find()) {
+                matchingFiles.add(FileEntry(absolutePath, entry.modified))
             }
         }
     }
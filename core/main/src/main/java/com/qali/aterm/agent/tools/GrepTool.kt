@@ -1,9 +1,13 @@
 package com.qali.aterm.agent.tools
 
 import com.rk.libcommons.alpineDir
+import com.rk.settings.Settings
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import com.qali.aterm.agent.utils.NativeFileSearch
+import com.qali.aterm.agent.utils.WorkspaceFileIndex
+import com.qali.aterm.agent.utils.WorkspaceTrigramIndex
 import java.io.File
 import java.util.regex.Pattern
 
@@ -118,41 +122,58 @@ class GrepToolInvocation(
     ) {
         if (signal?.isAborted() == true) return
         
-        dir.listFiles()?.forEach { file ->
+        // Files the trigram index rules out cannot contain the pattern's literal and are not read
+        val mayMatch = if (Settings.agent_search_index) WorkspaceTrigramIndex.candidatesFor(workspaceRoot, pattern) else null
+        val files = mutableListOf<File>()
+        for (entry in WorkspaceFileIndex.filesUnder(workspaceRoot, dir, includeIgnored = true, skipHidden = true)) {
+            val file = File(workspaceRoot, entry.path).absoluteFile.normalize()
+            
+            // Check include pattern if specified
+            if (include != null && !matchesIncludePattern(file.name, include)) {
+                continue
+            }
+            
+            // Skip binary files and very large files
+            if (entry.size > 10 * 1024 * 1024) { // 10MB limit
+                continue
+            }
+            if (mayMatch != null && !mayMatch(entry)) continue
+            files.add(file)
+        }
+        
+        // Scan all files at once natively when the pattern has a literal to look for
+        val nativeMatches = NativeFileSearch.search(files.map { it.path }, pattern) { signal?.isAborted() == true }
+        if (nativeMatches != null) {
+            nativeMatches.mapTo(matches) { match ->
+                GrepMatch(
+                    filePath = files[match.fileIndex].absolutePath,
+                    lineNumber = match.lineNumber,
+                    line = match.line
+                )
+            }
+            return
+        }
+        
+        for (file in files) {
             if (signal?.isAborted() == true) return
+            // Skipped by the native search too
+            if (NativeFileSearch.isBinary(file)) continue
             
-            if (file.isDirectory) {
-                // Skip hidden directories
-                if (!file.name.startsWith(".")) {
-                    searchFiles(file, pattern, include, matches, signal)
-                }
-            } else if (file.isFile) {
-                // Check include pattern if specified
-                if (include != null && !matchesIncludePattern(file.name, include)) {
-                    return@forEach
-                }
-                
-                // Skip binary files and very large files
-                if (file.length() > 10 * 1024 * 1024) { // 10MB limit
-                    return@forEach
-                }
-                
-                try {
-                    val lines = file.readLines()
-                    lines.forEachIndexed { index, line ->
-                        if (pattern.matcher(line).find()) {
-                            matches.add(
-                                GrepMatch(
-                                    filePath = file.absolutePath,
-                                    lineNumber = index + 1,
-                                    line = line
-                                )
+            try {
+                val lines = file.readLines()
+                lines.forEachIndexed { index, line ->
+                    if (pattern.matcher(line).find()) {
+                        matches.add(
+                            GrepMatch(
+                                filePath = file.absolutePath,
+                                lineNumber = index + 1,
+                                line = line
                             )
-                        }
+                        )
                     }
-                } catch (e: Exception) {
-                    // Skip files that can't be read
                 }
+            } catch (e: Exception) {
+                // Skip files that can't be read
             }
         }
     }
@@ -29,6 +29,9 @@ data class LanguageLinterParams(
     val strict: Boolean = false // Fail on warnings too
 )
 
+/** How ShellTool reports the exit code of a failed command */
+private val EXIT_CODE = Regex("""\*\*Exit Code:\*\* (-?\d+)""")
+
 class LanguageLinterToolInvocation(
     toolParams: LanguageLinterParams,
     private val workspaceRoot: String = alpineDir().absolutePath
@@ -143,15 +146,16 @@ class LanguageLinterToolInvocation(
     }
     
     private suspend fun lintFile(file: File, language: String, strict: Boolean): List<LinterError> {
-        val errors = mutableListOf<LinterError>()
-        
-        when (language) {
-            "python" -> errors.addAll(lintPython(file))
-            "javascript", "typescript" -> errors.addAll(lintJavaScript(file, language))
-            "bash" -> errors.addAll(lintBash(file))
-            else -> {
-                // Fallback to basic syntax detection
-                errors.addAll(detectBasicErrors(file))
+        // Unchanged files are not linted again
+        val errors = LinterHost.cached(language, file, workspaceRoot) {
+            when (language) {
+                "python" -> lintPython(file)
+                "javascript", "typescript" -> lintJavaScript(file, language)
+                "bash" -> lintBash(file)
+                else -> {
+                    // Fallback to basic syntax detection
+                    LinterHost.Outcome(detectBasicErrors(file), complete = true)
+                }
             }
         }
         
@@ -163,55 +167,69 @@ class LanguageLinterToolInvocation(
         }
     }
     
-    private suspend fun lintPython(file: File): List<LinterError> {
+    private suspend fun lintPython(file: File): LinterHost.Outcome {
         val errors = mutableListOf<LinterError>()
+        var complete = false
         
         try {
+            // The warm pyflakes server answers without starting Python
+            LinterHost.lint("python", file, workspaceRoot)?.let { reply ->
+                return LinterHost.Outcome(parsePyflakesOutput(reply.text, file), complete = reply.complete)
+            }
+            
             // Try pyflakes first (lightweight, fast)
             val pyflakesResult = runLinterCommand(
                 command = listOf("pyflakes", file.absolutePath),
                 file = file
             )
-            errors.addAll(parsePyflakesOutput(pyflakesResult, file))
-            
-            // If pyflakes not available, try python -m py_compile
-            if (errors.isEmpty() && pyflakesResult.isEmpty()) {
+            complete = pyflakesResult.finished
+            if (pyflakesResult.finished) {
+                errors.addAll(parsePyflakesOutput(pyflakesResult.output, file))
+            } else {
+                // If pyflakes not available, try python -m py_compile
                 val compileResult = runLinterCommand(
                     command = listOf("python3", "-m", "py_compile", file.absolutePath),
                     file = file
                 )
-                if (compileResult.isNotEmpty() && !compileResult.contains("OK")) {
-                    errors.addAll(parsePythonCompileOutput(compileResult, file))
+                // A syntax check finds far less than pyflakes would, so it is not cached
+                complete = false
+                if (compileResult.output.isNotEmpty() && !compileResult.output.contains("OK")) {
+                    errors.addAll(parsePythonCompileOutput(compileResult.output, file))
                 }
             }
         } catch (e: Exception) {
             // If linter not available, fall back to basic detection
             android.util.Log.w("LanguageLinterTool", "Python linter not available: ${e.message}")
             errors.addAll(detectBasicErrors(file))
+            complete = false
         }
         
-        return errors
+        return LinterHost.Outcome(errors, complete)
     }
     
-    private suspend fun lintJavaScript(file: File, language: String): List<LinterError> {
+    private suspend fun lintJavaScript(file: File, language: String): LinterHost.Outcome {
         val errors = mutableListOf<LinterError>()
+        var complete = false
         
         try {
             // Try node syntax check first (more reliable, doesn't need dependencies)
-            val nodeResult = runLinterCommand(
+            val nodeCheck = runLinterCommand(
                 command = listOf("node", "--check", file.absolutePath),
                 file = file
             )
+            val nodeResult = nodeCheck.output
+            complete = nodeCheck.finished
             if (nodeResult.isNotEmpty() && !nodeResult.contains("Error:") && !nodeResult.contains("Permission denied")) {
                 errors.addAll(parseNodeCheckOutput(nodeResult, file))
             }
             
             // Try eslint if available (only if node check passed or wasn't available)
             if (errors.isEmpty() || nodeResult.contains("Permission denied") || nodeResult.contains("Error:")) {
-                val eslintResult = runLinterCommand(
+                // The warm ESLint server avoids booting npx, Node and ESLint for every file
+                val eslintResult = LinterHost.lint(language, file, workspaceRoot)?.text ?: runLinterCommand(
                     command = listOf("npx", "--yes", "eslint", "--format", "compact", file.absolutePath),
                     file = file
-                )
+                ).also { complete = complete && it.finished }.output
                 if (eslintResult.isNotEmpty() && 
                     !eslintResult.contains("No ESLint configuration") && 
                     !eslintResult.contains("Permission denied") &&
@@ -229,13 +247,15 @@ class LanguageLinterToolInvocation(
             // If linter not available, fall back to basic detection
             android.util.Log.w("LanguageLinterTool", "JavaScript linter not available: ${e.message}")
             errors.addAll(detectBasicErrors(file))
+            complete = false
         }
         
-        return errors
+        return LinterHost.Outcome(errors, complete)
     }
     
-    private suspend fun lintBash(file: File): List<LinterError> {
+    private suspend fun lintBash(file: File): LinterHost.Outcome {
         val errors = mutableListOf<LinterError>()
+        var complete = false
         
         try {
             // Use shellcheck if available
@@ -243,28 +263,46 @@ class LanguageLinterToolInvocation(
                 command = listOf("shellcheck", "-f", "gcc", file.absolutePath),
                 file = file
             )
-            if (shellcheckResult.isNotEmpty()) {
-                errors.addAll(parseShellcheckOutput(shellcheckResult, file))
+            complete = shellcheckResult.finished
+            if (shellcheckResult.finished) {
+                errors.addAll(parseShellcheckOutput(shellcheckResult.output, file))
             } else {
-                // Fallback to bash -n (syntax check)
+                // Fallback to bash -n (syntax check), which exits with 2 on a syntax error
                 val bashResult = runLinterCommand(
                     command = listOf("bash", "-n", file.absolutePath),
-                    file = file
+                    file = file,
+                    findingsExitCodes = setOf(1, 2)
                 )
-                if (bashResult.isNotEmpty()) {
-                    errors.addAll(parseBashCheckOutput(bashResult, file))
+                complete = bashResult.finished
+                if (bashResult.output.isNotEmpty()) {
+                    errors.addAll(parseBashCheckOutput(bashResult.output, file))
                 }
             }
         } catch (e: Exception) {
             // If linter not available, fall back to basic detection
             android.util.Log.w("LanguageLinterTool", "Bash linter not available: ${e.message}")
             errors.addAll(detectBasicErrors(file))
+            complete = false
         }
         
-        return errors
+        return LinterHost.Outcome(errors, complete)
     }
     
-    private suspend fun runLinterCommand(command: List<String>, file: File): String {
+    /**
+     * Output of a linter command; [finished] is false when the linter did not run to the end, as on
+     * a timeout or when the command is not installed
+     */
+    private class LinterOutput(val output: String, val finished: Boolean)
+    
+    /**
+     * Run [command] for [file]. Linters exit with 0 for a clean file and with one of
+     * [findingsExitCodes] when they report problems; any other exit means they did not finish.
+     */
+    private suspend fun runLinterCommand(
+        command: List<String>,
+        file: File,
+        findingsExitCodes: Set<Int> = setOf(1)
+    ): LinterOutput {
         return try {
             // Use ShellTool to run commands through proper rootfs environment
             val commandStr = command.joinToString(" ")
@@ -278,17 +316,25 @@ class LanguageLinterToolInvocation(
             )
             
             val result = shellTool.execute(null, null)
+            // ShellTool reports failed commands with their exit code; timeouts have -1
+            val exitCode = if (result.error == null) {
+                0
+            } else {
+                EXIT_CODE.find(result.llmContent)?.groupValues?.get(1)?.toIntOrNull()
+            }
+            val finished = exitCode == 0 || exitCode in findingsExitCodes
             
             // Return output if there was an error or if output contains useful information
-            if (result.error != null || result.llmContent.isNotEmpty()) {
+            val output = if (result.error != null || result.llmContent.isNotEmpty()) {
                 result.llmContent + if (result.error != null) "\nError: ${result.error?.message}" else ""
             } else {
                 ""
             }
+            LinterOutput(output, finished)
         } catch (e: Exception) {
             android.util.Log.d("LanguageLinterTool", "Command failed: ${command.joinToString(" ")} - ${e.message}")
             // Return error message for better debugging
-            "Error: ${e.message}\nCommand: ${command.joinToString(" ")}\nFile: ${file.absolutePath}"
+            LinterOutput("Error: ${e.message}\nCommand: ${command.joinToString(" ")}\nFile: ${file.absolutePath}", finished = false)
         }
     }
     
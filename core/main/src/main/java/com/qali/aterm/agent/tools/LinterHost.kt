@@ -0,0 +1,427 @@
+package com.qali.aterm.agent.tools
+
+import com.qali.aterm.ui.screens.terminal.RootfsCommand
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.withTimeoutOrNull
+import java.io.BufferedReader
+import java.io.File
+import java.io.IOException
+import java.io.Writer
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.LinkedBlockingQueue
+import java.util.concurrent.TimeUnit
+
+/**
+ * Long-lived linter processes for [LanguageLinterTool]
+ *
+ * Starting `npx eslint` or `pyflakes` for every file spends seconds booting the runtime and the
+ * linter before a millisecond of actual checking. The host instead keeps one server process per
+ * language and workspace: a small Python or Node script that imports the linter once, then reads
+ * file paths from stdin and prints the linter's usual output for each, followed by a marker line.
+ * Servers run inside the workspace's rootfs, launched like terminal sessions (see [RootfsCommand]),
+ * and are given paths as the rootfs sees them. Requests that arrive while the server is busy are
+ * written to it as one batch. Servers exit after a while without requests and are restarted on
+ * demand; one that could not start is not tried again for a minute. When a configuration file of
+ * the linter changes the server is told to drop the configuration it loaded.
+ *
+ * Results are also cached by file content and the linter's configuration files, so linting a file
+ * that has not changed since the last run costs a hash. Only runs in which the linter actually
+ * finished are cached; a timeout or a missing linter says nothing about the file, and a syntax check
+ * standing in for a missing linter misses most of what it would report.
+ */
+object LinterHost {
+    internal const val DONE_MARKER = "__ATERM_LINT_DONE__"
+    internal const val UNAVAILABLE_MARKER = "__ATERM_LINT_UNAVAILABLE__"
+    /** Printed before the done marker when only part of the linter's checks ran */
+    internal const val PARTIAL_MARKER = "__ATERM_LINT_PARTIAL__"
+    /** Sent instead of a path to make the server load configurations again; not answered */
+    internal const val RELOAD_MARKER = "__ATERM_LINT_RELOAD__"
+    private const val REQUEST_TIMEOUT_MS = 30_000L
+    private const val IDLE_TIMEOUT_MS = 5 * 60_000L
+    private const val RETRY_AFTER_FAILED_START_MS = 60_000L
+    private const val MAX_CACHED_RESULTS = 256
+
+    private val ESLINT_CONFIG_FILES = listOf(
+        ".eslintrc", ".eslintrc.js", ".eslintrc.cjs", ".eslintrc.json", ".eslintrc.yaml", ".eslintrc.yml",
+        "eslint.config.js", "eslint.config.mjs", "eslint.config.cjs", "eslint.config.ts", ".eslintignore",
+        "package.json", "tsconfig.json"
+    )
+
+    /** Files which change what each language's linters report, looked up from the file up to the workspace */
+    private val CONFIG_FILES = mapOf(
+        "python" to listOf("pyproject.toml", "setup.cfg", "tox.ini", ".flake8"),
+        "javascript" to ESLINT_CONFIG_FILES,
+        "typescript" to ESLINT_CONFIG_FILES,
+        "bash" to listOf(".shellcheckrc")
+    )
+
+    /**
+     * Reads paths, one per line, and reports them in pyflakes' `file:line:col: message` format.
+     * Without pyflakes only syntax errors are reported, marked as partial.
+     */
+    internal val PYTHON_SERVER = """
+import sys
+try:
+    from pyflakes.api import checkPath
+    from pyflakes.reporter import Reporter
+except Exception:
+    checkPath = None
+for line in sys.stdin:
+    path = line.rstrip('\n')
+    if path == '$RELOAD_MARKER':
+        continue
+    try:
+        if checkPath is not None:
+            checkPath(path, Reporter(sys.stdout, sys.stdout))
+        else:
+            with open(path, 'rb') as f:
+                compile(f.read(), path, 'exec')
+    except SyntaxError as e:
+        print('%s:%d:%d: %s' % (path, e.lineno or 1, e.offset or 0, e.msg))
+    except Exception:
+        pass
+    if checkPath is None:
+        print('$PARTIAL_MARKER')
+    print('$DONE_MARKER')
+    sys.stdout.flush()
+""".trimStart()
+
+    /**
+     * Reads paths, one per line, and lints them with the ESLint the project resolves, in ESLint's
+     * compact `file:line:col: level message (rule)` format. The marker follows every request, also
+     * when loading ESLint fails. ESLint instances keep the configurations they read, so they are
+     * created again after a reload.
+     */
+    internal val NODE_SERVER = """
+const readline = require('readline');
+const { createRequire } = require('module');
+const engines = new Map();
+function engineFor(file) {
+  let modulePath;
+  try {
+    modulePath = createRequire(file).resolve('eslint');
+  } catch (e) {
+    return null;
+  }
+  if (!engines.has(modulePath)) {
+    const ESLint = require(modulePath).ESLint;
+    engines.set(modulePath, ESLint ? new ESLint() : null);
+  }
+  return engines.get(modulePath);
+}
+async function lint(file) {
+  let engine;
+  try {
+    engine = engineFor(file);
+  } catch (e) {
+    engine = null;
+  }
+  if (!engine) {
+    console.log('$UNAVAILABLE_MARKER');
+    return;
+  }
+  try {
+    for (const result of await engine.lintFiles([file])) {
+      for (const m of result.messages) {
+        const level = m.severity === 2 ? 'error' : 'warning';
+        const rule = m.ruleId ? ' (' + m.ruleId + ')' : '';
+        console.log(result.filePath + ':' + (m.line || 0) + ':' + (m.column || 0) + ': ' + level + ' ' +
+          String(m.message).replace(/\s+/g, ' ') + rule);
+      }
+    }
+  } catch (e) {
+    // No configuration and similar setup problems are not lint results
+  }
+}
+let chain = Promise.resolve();
+readline.createInterface({ input: process.stdin }).on('line', (file) => {
+  if (file === '$RELOAD_MARKER') {
+    chain = chain.then(() => engines.clear());
+    return;
+  }
+  chain = chain.then(() => lint(file)).catch(() => {}).finally(() => console.log('$DONE_MARKER'));
+});
+""".trimStart()
+
+    /**
+     * Output of a server for one file; [complete] is false when the linter is missing and only a
+     * syntax check ran
+     */
+    class Reply(val text: String, val complete: Boolean)
+
+    /** Lint of [path]; [configs] maps the linter's configuration files that apply to it to their state */
+    private class Request(val path: String, val configs: Map<String, String>, val result: CompletableDeferred<Reply?>)
+
+    /**
+     * One server process and the thread feeding it
+     */
+    private class Server(val command: List<String>, val workspaceRoot: String) {
+        private val queue = LinkedBlockingQueue<Request>()
+        private var worker: Thread? = null
+        private var process: Process? = null
+        private var launched: RootfsCommand.Launch? = null
+        private var reader: BufferedReader? = null
+        private var writer: Writer? = null
+        /** Whether the running process has answered a request, so that it did start */
+        private var answered = false
+        private var failedStartAt = 0L
+        /** State of each configuration file the running process may have loaded, and those of each directory */
+        private val configStates = HashMap<String, String>()
+        private val directoryConfigs = HashMap<String, Set<String>>()
+
+        fun submit(request: Request) {
+            synchronized(this) {
+                queue.add(request)
+                if (worker == null) {
+                    worker = Thread({ run() }, "LinterHost").apply {
+                        isDaemon = true
+                        start()
+                    }
+                }
+            }
+        }
+
+        /**
+         * Kill the process; requests in flight complete without a result
+         */
+        fun restart() {
+            synchronized(this) { process }?.destroy()
+        }
+
+        private fun run() {
+            val batch = ArrayList<Request>()
+            while (true) {
+                val first = queue.poll(IDLE_TIMEOUT_MS, TimeUnit.MILLISECONDS)
+                if (first == null) {
+                    val idle = synchronized(this) {
+                        queue.isEmpty().also { idle ->
+                            if (idle) {
+                                process?.destroy()
+                                process = null
+                                worker = null
+                            }
+                        }
+                    }
+                    if (idle) return
+                    continue
+                }
+                batch.add(first)
+                queue.drainTo(batch)
+                serve(batch)
+                batch.clear()
+            }
+        }
+
+        private fun serve(batch: List<Request>) {
+            var next = 0
+            try {
+                val (input, output, paths) = synchronized(this) {
+                    if (process?.isAlive != true) launch()
+                    Triple(reader!!, writer!!, launched!!)
+                }
+                for (request in batch) {
+                    if (configChanged(request)) output.write(RELOAD_MARKER + "\n")
+                    output.write(paths.toRootfsPath(request.path) + "\n")
+                }
+                output.flush()
+                while (next < batch.size) {
+                    val text = StringBuilder()
+                    var available = true
+                    var complete = true
+                    while (true) {
+                        val line = input.readLine() ?: throw IOException("Linter server exited")
+                        when (line) {
+                            DONE_MARKER -> break
+                            UNAVAILABLE_MARKER -> available = false
+                            PARTIAL_MARKER -> complete = false
+                            else -> text.appendLine(line)
+                        }
+                    }
+                    synchronized(this) { answered = true }
+                    batch[next++].result.complete(if (available) Reply(text.toString(), complete) else null)
+                }
+            } catch (e: Exception) {
+                android.util.Log.w("LinterHost", "Linter server ${command.firstOrNull()} failed: ${e.message}")
+                synchronized(this) {
+                    // A server that exits before its first answer cannot run here, as without its runtime
+                    if (process != null && !answered) failedStartAt = System.currentTimeMillis()
+                    process?.destroy()
+                    process = null
+                }
+                while (next < batch.size) batch[next++].result.complete(null)
+            }
+        }
+
+        /**
+         * Whether a configuration file that applies to [request] was added, removed or changed
+         * since the process may have loaded it, remembering the current state
+         */
+        private fun configChanged(request: Request): Boolean {
+            val directory = File(request.path).parent ?: ""
+            val previous = directoryConfigs.put(directory, request.configs.keys)
+            var changed = previous != null && previous != request.configs.keys
+            for ((path, state) in request.configs) {
+                val known = configStates.put(path, state)
+                if (known != null && known != state) changed = true
+            }
+            return changed
+        }
+
+        /** Start the process; called with the lock held */
+        private fun launch() {
+            process = null
+            if (System.currentTimeMillis() - failedStartAt < RETRY_AFTER_FAILED_START_MS) {
+                throw IOException("Server did not start recently")
+            }
+            val launch = try {
+                launcher(command, workspaceRoot) ?: throw IOException("No extracted rootfs for $workspaceRoot")
+            } catch (e: Exception) {
+                failedStartAt = System.currentTimeMillis()
+                throw e
+            }
+            val builder = launch.processBuilder().redirectErrorStream(false)
+            builder.environment()["WORKSPACE_ROOT"] = launch.toRootfsPath(workspaceRoot)
+            val started = try {
+                builder.start()
+            } catch (e: IOException) {
+                failedStartAt = System.currentTimeMillis()
+                throw e
+            }
+            answered = false
+            // A new process has loaded no configuration yet
+            configStates.clear()
+            directoryConfigs.clear()
+            // Diagnostics would fill the pipe if nobody read them
+            Thread({ started.errorStream.use { it.copyTo(NullOutputStream) } }, "LinterHostStderr").apply {
+                isDaemon = true
+                start()
+            }
+            process = started
+            launched = launch
+            reader = started.inputStream.bufferedReader()
+            writer = started.outputStream.bufferedWriter()
+        }
+    }
+
+    private object NullOutputStream : java.io.OutputStream() {
+        override fun write(b: Int) {}
+        override fun write(b: ByteArray, off: Int, len: Int) {}
+    }
+
+    private val servers = ConcurrentHashMap<String, Server>()
+
+    /** Launch of a server command in a workspace's rootfs; replaced by tests to run servers on the host */
+    internal var launcher: (List<String>, String) -> RootfsCommand.Launch? = { command, workspaceRoot ->
+        RootfsCommand.forWorkspace(workspaceRoot, command)
+    }
+
+    /** Latest result per linter and file, valid while the content hash matches */
+    private val results = object : LinkedHashMap<String, Pair<String, List<LinterError>>>(16, 0.75f, true) {
+        override fun removeEldestEntry(eldest: MutableMap.MutableEntry<String, Pair<String, List<LinterError>>>): Boolean {
+            return size > MAX_CACHED_RESULTS
+        }
+    }
+
+    /**
+     * Output of the warm [language] server for [file], in the format of the linter's command line
+     * tool, or null when there is no server for the language, the linter is not installed for the
+     * file or the server failed
+     */
+    suspend fun lint(language: String, file: File, workspaceRoot: String): Reply? {
+        val command = serverCommand(language) ?: return null
+        val server = servers.getOrPut("$language\u0000$workspaceRoot") { Server(command, workspaceRoot) }
+        val configs = configFiles(language, file, workspaceRoot).associate { it.path to configState(it) }
+        val request = Request(file.absolutePath, configs, CompletableDeferred())
+        server.submit(request)
+        val output = withTimeoutOrNull(REQUEST_TIMEOUT_MS) { request.result.await() }
+        if (output == null && !request.result.isCompleted) {
+            // A hung server would stall every later request too
+            server.restart()
+        }
+        return output
+    }
+
+    /**
+     * Errors of one lint run; [complete] is false when a linter did not finish, so that the errors
+     * are only what a fallback could find
+     */
+    class Outcome(val errors: List<LinterError>, val complete: Boolean)
+
+    /**
+     * Errors cached for [file] linted as [language], computing them with [compute] if its content
+     * or a configuration file of the linter between it and [workspaceRoot] changed
+     */
+    suspend fun cached(
+        language: String,
+        file: File,
+        workspaceRoot: String,
+        compute: suspend () -> Outcome
+    ): List<LinterError> {
+        val stamp = try {
+            contentHash(file) + "\u0000" + configStamp(language, file, workspaceRoot)
+        } catch (e: IOException) {
+            return compute().errors
+        }
+        val key = "$language\u0000${file.absolutePath}"
+        synchronized(results) { results[key] }?.let { (cachedStamp, errors) ->
+            if (cachedStamp == stamp) return errors
+        }
+        val outcome = compute()
+        synchronized(results) {
+            if (outcome.complete) results[key] = stamp to outcome.errors else results.remove(key)
+        }
+        return outcome.errors
+    }
+
+    /**
+     * Path, size and modification time of each configuration file for [language] in the
+     * directories from [file] up to [workspaceRoot]
+     */
+    private fun configStamp(language: String, file: File, workspaceRoot: String): String {
+        return configFiles(language, file, workspaceRoot).joinToString("") { "${it.path}:${configState(it)}\n" }
+    }
+
+    /** Configuration files for [language] in the directories from [file] up to [workspaceRoot] */
+    private fun configFiles(language: String, file: File, workspaceRoot: String): List<File> {
+        val names = CONFIG_FILES[language] ?: return emptyList()
+        val root = File(workspaceRoot).absoluteFile
+        val inWorkspace = file.absolutePath.startsWith(root.path + File.separator)
+        val configs = ArrayList<File>()
+        var directory = file.absoluteFile.parentFile
+        while (directory != null) {
+            for (name in names) {
+                val config = File(directory, name)
+                if (config.isFile) configs.add(config)
+            }
+            // Outside the workspace only the file's own directory is looked at
+            if (!inWorkspace || directory == root) break
+            directory = directory.parentFile
+        }
+        return configs
+    }
+
+    private fun configState(config: File): String = "${config.length()}:${config.lastModified()}"
+
+    /** Command of the [language] server, run inside the rootfs with its search path */
+    internal fun serverCommand(language: String): List<String>? {
+        return when (language) {
+            "python" -> listOf("python3", "-u", "-c", PYTHON_SERVER)
+            "javascript", "typescript" -> listOf("node", "-e", NODE_SERVER)
+            else -> null
+        }
+    }
+
+    private fun contentHash(file: File): String {
+        val digest = MessageDigest.getInstance("SHA-1")
+        file.inputStream().use { input ->
+            val buffer = ByteArray(8192)
+            while (true) {
+                val read = input.read(buffer)
+                if (read < 0) break
+                digest.update(buffer, 0, read)
+            }
+        }
+        return digest.digest().joinToString("") { "%02x".format(it) }
+    }
+}
@@ -0,0 +1,272 @@
+package com.qali.aterm.agent.tools
+
+import com.google.gson.Gson
+import com.google.gson.JsonElement
+import com.google.gson.JsonNull
+import com.google.gson.JsonObject
+import com.google.gson.JsonParser
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import kotlinx.coroutines.withTimeoutOrNull
+import java.io.Closeable
+import java.io.IOException
+import java.io.InputStream
+import java.io.OutputStream
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicLong
+
+/**
+ * JSON-RPC client for one connection to an MCP server
+ *
+ * Messages are newline-delimited JSON, as MCP's stdio transport specifies; the same framing is
+ * used over unix sockets. Every request gets its own id and any number can be in flight: a reader
+ * thread hands each response to whoever waits for that id, so concurrent tool calls share one
+ * connection and one server process instead of starting a server per call.
+ */
+class McpClient(
+    private val input: InputStream,
+    private val output: OutputStream,
+    private val onClose: () -> Unit = {}
+) : Closeable {
+
+    /** An error response from the server */
+    class McpException(val code: Int, message: String) : IOException(message)
+
+    /** A tool as listed by `tools/list` */
+    data class ToolInfo(val name: String, val description: String, val inputSchema: JsonObject)
+
+    private val gson = Gson()
+    private val nextId = AtomicLong(1)
+    private val pending = ConcurrentHashMap<Long, CompletableDeferred<JsonElement>>()
+    private val writer = output.bufferedWriter(Charsets.UTF_8)
+
+    @Volatile
+    private var closed = false
+
+    /** Result of the last `tools/list`, until the server announces a change */
+    @Volatile
+    private var tools: List<ToolInfo>? = null
+
+    val isOpen: Boolean
+        get() = !closed
+
+    init {
+        Thread({ readLoop() }, "McpClient").apply {
+            isDaemon = true
+            start()
+        }
+    }
+
+    /**
+     * MCP handshake; must complete before other requests
+     */
+    suspend fun initialize(timeoutMs: Long = DEFAULT_TIMEOUT_MS): JsonObject {
+        val params = JsonObject().apply {
+            addProperty("protocolVersion", PROTOCOL_VERSION)
+            add("capabilities", JsonObject())
+            add("clientInfo", JsonObject().apply {
+                addProperty("name", "aterm")
+                addProperty("version", "1.0")
+            })
+        }
+        val result = request("initialize", params, timeoutMs)
+        notify("notifications/initialized", null)
+        return result as? JsonObject ?: JsonObject()
+    }
+
+    /**
+     * Tools the server offers, cached until it sends `notifications/tools/list_changed`
+     */
+    suspend fun listTools(timeoutMs: Long = DEFAULT_TIMEOUT_MS): List<ToolInfo> {
+        tools?.let { return it }
+        val listed = ArrayList<ToolInfo>()
+        var cursor: String? = null
+        do {
+            val params = cursor?.let { JsonObject().apply { addProperty("cursor", it) } }
+            val result = request("tools/list", params, timeoutMs).asJsonObject
+            result.getAsJsonArray("tools")?.forEach { element ->
+                val tool = element.asJsonObject
+                listed.add(
+                    ToolInfo(
+                        name = tool.get("name").asString,
+                        description = tool.get("description")?.takeIf { it.isJsonPrimitive }?.asString.orEmpty(),
+                        inputSchema = tool.get("inputSchema") as? JsonObject ?: JsonObject()
+                    )
+                )
+            }
+            cursor = result.get("nextCursor")?.takeIf { it.isJsonPrimitive }?.asString
+        } while (cursor != null)
+        tools = listed
+        return listed
+    }
+
+    /**
+     * Call tool [name]; the result holds `content` and possibly `isError`
+     */
+    suspend fun callTool(name: String, arguments: JsonObject, timeoutMs: Long = DEFAULT_TIMEOUT_MS): JsonObject {
+        val params = JsonObject().apply {
+            addProperty("name", name)
+            add("arguments", arguments)
+        }
+        return request("tools/call", params, timeoutMs) as? JsonObject ?: JsonObject()
+    }
+
+    /**
+     * Send request [method] and wait for its response. A request that times out or whose caller
+     * is cancelled is cancelled on the server too.
+     */
+    suspend fun request(method: String, params: JsonElement?, timeoutMs: Long = DEFAULT_TIMEOUT_MS): JsonElement {
+        val id = nextId.getAndIncrement()
+        val response = CompletableDeferred<JsonElement>()
+        pending[id] = response
+        if (closed) {
+            pending.remove(id)
+            throw IOException("MCP connection closed")
+        }
+
+        val message = JsonObject().apply {
+            addProperty("jsonrpc", "2.0")
+            addProperty("id", id)
+            addProperty("method", method)
+            params?.let { add("params", it) }
+        }
+        try {
+            withContext(Dispatchers.IO) { send(message) }
+            return withTimeoutOrNull(timeoutMs) { response.await() }
+                ?: throw IOException("MCP request $method timed out after ${timeoutMs}ms")
+        } catch (e: Exception) {
+            if (pending.remove(id) != null && !closed) {
+                sendCancelled(id, if (e is CancellationException) "Cancelled" else e.message)
+            }
+            throw e
+        }
+    }
+
+    /**
+     * Send notification [method], which has no response
+     */
+    suspend fun notify(method: String, params: JsonElement?) {
+        val message = JsonObject().apply {
+            addProperty("jsonrpc", "2.0")
+            addProperty("method", method)
+            params?.let { add("params", it) }
+        }
+        withContext(Dispatchers.IO) { send(message) }
+    }
+
+    private fun sendCancelled(id: Long, reason: String?) {
+        val message = JsonObject().apply {
+            addProperty("jsonrpc", "2.0")
+            addProperty("method", "notifications/cancelled")
+            add("params", JsonObject().apply {
+                addProperty("requestId", id)
+                reason?.let { addProperty("reason", it) }
+            })
+        }
+        try {
+            send(message)
+        } catch (e: IOException) {
+            // The connection is gone; nothing to cancel
+        }
+    }
+
+    private fun send(message: JsonObject) {
+        synchronized(writer) {
+            writer.write(gson.toJson(message))
+            writer.write("\n")
+            writer.flush()
+        }
+    }
+
+    private fun readLoop() {
+        try {
+            input.bufferedReader(Charsets.UTF_8).forEachLine { line ->
+                if (line.isNotBlank()) handle(line)
+            }
+        } catch (e: IOException) {
+            // Closed from either side
+        } finally {
+            close()
+        }
+    }
+
+    private fun handle(line: String) {
+        // Servers sometimes log to stdout; anything that is not a JSON object is not a message
+        val message = try {
+            JsonParser.parseString(line) as? JsonObject
+        } catch (e: Exception) {
+            null
+        } ?: return
+
+        val id = message.get("id")?.takeIf { !it.isJsonNull }
+        val method = message.get("method")?.takeIf { it.isJsonPrimitive }?.asString
+        if (method != null) {
+            if (id != null) answerServerRequest(id, method)
+            else if (method == "notifications/tools/list_changed") tools = null
+            return
+        }
+
+        val requestId = id?.takeIf { it.isJsonPrimitive && it.asJsonPrimitive.isNumber }?.asLong ?: return
+        val response = pending.remove(requestId) ?: return
+        val error = message.get("error") as? JsonObject
+        if (error != null) {
+            response.completeExceptionally(
+                McpException(
+                    error.get("code")?.takeIf { it.isJsonPrimitive }?.asInt ?: -32603,
+                    error.get("message")?.takeIf { it.isJsonPrimitive }?.asString ?: "MCP error"
+                )
+            )
+        } else {
+            response.complete(message.get("result") ?: JsonNull.INSTANCE)
+        }
+    }
+
+    /**
+     * Requests from the server: answer pings, decline capabilities the client did not announce
+     */
+    private fun answerServerRequest(id: JsonElement, method: String) {
+        val reply = JsonObject().apply {
+            addProperty("jsonrpc", "2.0")
+            add("id", id)
+            if (method == "ping") {
+                add("result", JsonObject())
+            } else {
+                add("error", JsonObject().apply {
+                    addProperty("code", -32601)
+                    addProperty("message", "Method not found: $method")
+                })
+            }
+        }
+        try {
+            send(reply)
+        } catch (e: IOException) {
+            // The read loop notices the closed connection
+        }
+    }
+
+    override fun close() {
+        synchronized(this) {
+            if (closed) return
+            closed = true
+        }
+        try {
+            output.close()
+        } catch (e: IOException) {
+        }
+        try {
+            input.close()
+        } catch (e: IOException) {
+        }
+        val failed = IOException("MCP connection closed")
+        pending.values.forEach { it.completeExceptionally(failed) }
+        pending.clear()
+        onClose()
+    }
+
+    companion object {
+        const val PROTOCOL_VERSION = "2024-11-05"
+        const val DEFAULT_TIMEOUT_MS = 60_000L
+    }
+}
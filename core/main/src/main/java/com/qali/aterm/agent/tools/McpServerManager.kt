@@ -0,0 +1,295 @@
+package com.qali.aterm.agent.tools
+
+import android.net.LocalSocket
+import android.net.LocalSocketAddress
+import com.google.gson.Gson
+import com.google.gson.JsonObject
+import com.google.gson.JsonParser
+import com.google.gson.reflect.TypeToken
+import com.qali.aterm.ui.screens.terminal.RootfsCommand
+import com.rk.libcommons.alpineHomeDir
+import com.rk.libcommons.application
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
+import java.io.File
+import java.io.FileOutputStream
+import java.io.IOException
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * Starts the configured MCP servers and keeps one live [McpClient] per server and workspace
+ *
+ * Servers are configured like Gemini CLI's, under `mcpServers` in `.gemini/settings.json` of the
+ * home directory or the workspace (the workspace wins):
+ *
+ *     "mcpServers": {
+ *       "files": { "command": "npx", "args": ["-y", "@modelcontextprotocol/server-filesystem", "."] },
+ *       "db": { "socket": "/run/db-mcp.sock" }
+ *     }
+ *
+ * A `command` server is started inside the workspace's rootfs, under proot like a terminal session
+ * (see [RootfsCommand]), and spoken to over its stdin and stdout; its `cwd` is a rootfs path. A
+ * `socket` server is already running and listens on a unix socket, whose path is also taken as the
+ * rootfs sees it. Either way the connection stays open across tool calls and is re-established if
+ * it drops. Servers start on their first tool call. Tool lists are kept on disk, so only a server
+ * whose tools are not known yet is started to list them, once per workspace.
+ */
+object McpServerManager {
+    private const val TAG = "McpServerManager"
+
+    data class ServerConfig(
+        val name: String,
+        val command: String? = null,
+        val args: List<String> = emptyList(),
+        val env: Map<String, String> = emptyMap(),
+        val cwd: String? = null,
+        val socket: String? = null,
+        val timeoutMs: Long = McpClient.DEFAULT_TIMEOUT_MS
+    )
+
+    private class Connection(val config: ServerConfig, val workspaceRoot: String, val client: McpClient)
+
+    private val gson = Gson()
+    private val connections = ConcurrentHashMap<String, Connection>()
+    private val connecting = ConcurrentHashMap<String, Mutex>()
+    /** Servers whose tools were listed in the background, by workspace and name */
+    private val listed = ConcurrentHashMap.newKeySet<String>()
+    private val scope = CoroutineScope(SupervisorJob() + Dispatchers.IO)
+    private val toolListType = object : TypeToken<List<McpClient.ToolInfo>>() {}.type
+
+    /**
+     * Server configurations for [workspaceRoot] by name
+     */
+    fun loadConfigs(workspaceRoot: String): Map<String, ServerConfig> {
+        val configs = LinkedHashMap<String, ServerConfig>()
+        val files = listOf(File(alpineHomeDir(), ".gemini/settings.json"), File(workspaceRoot, ".gemini/settings.json"))
+        for (file in files.distinctBy { it.absolutePath }) {
+            if (!file.isFile) continue
+            try {
+                configs.putAll(parseConfigs(file.readText()))
+            } catch (e: Exception) {
+                android.util.Log.w(TAG, "Ignoring MCP servers in ${file.path}: ${e.message}")
+            }
+        }
+        return configs
+    }
+
+    /**
+     * The `mcpServers` section of a settings file
+     */
+    fun parseConfigs(settingsJson: String): Map<String, ServerConfig> {
+        val servers = (JsonParser.parseString(settingsJson) as? JsonObject)?.getAsJsonObject("mcpServers")
+            ?: return emptyMap()
+        val configs = LinkedHashMap<String, ServerConfig>()
+        for ((name, value) in servers.entrySet()) {
+            val server = value as? JsonObject ?: continue
+            val command = server.get("command")?.takeIf { it.isJsonPrimitive }?.asString
+            val socket = server.get("socket")?.takeIf { it.isJsonPrimitive }?.asString
+            if (command == null && socket == null) continue
+            configs[name] = ServerConfig(
+                name = name,
+                command = command,
+                args = server.getAsJsonArray("args")?.map { it.asString }.orEmpty(),
+                env = server.getAsJsonObject("env")?.entrySet()?.associate { it.key to it.value.asString }.orEmpty(),
+                cwd = server.get("cwd")?.takeIf { it.isJsonPrimitive }?.asString,
+                socket = socket,
+                timeoutMs = server.get("timeout")?.takeIf { it.isJsonPrimitive }?.asLong ?: McpClient.DEFAULT_TIMEOUT_MS
+            )
+        }
+        return configs
+    }
+
+    /**
+     * Initialized client for [serverName], connecting on first use or after the connection dropped
+     */
+    suspend fun client(workspaceRoot: String, serverName: String): McpClient {
+        return connection(workspaceRoot, serverName).client
+    }
+
+    /**
+     * Timeout configured for [serverName]'s requests
+     */
+    fun timeoutMs(workspaceRoot: String, serverName: String): Long {
+        return connections[key(workspaceRoot, serverName)]?.config?.timeoutMs ?: McpClient.DEFAULT_TIMEOUT_MS
+    }
+
+    private suspend fun connection(workspaceRoot: String, serverName: String): Connection {
+        val key = key(workspaceRoot, serverName)
+        connections[key]?.takeIf { it.client.isOpen }?.let { return it }
+        return connecting.getOrPut(key) { Mutex() }.withLock {
+            connections[key]?.takeIf { it.client.isOpen }?.let { return@withLock it }
+            val config = loadConfigs(workspaceRoot)[serverName]
+                ?: throw IllegalArgumentException("MCP server '$serverName' is not configured")
+            connect(config, workspaceRoot).also { connection ->
+                connections[key] = connection
+                // Keeps the tools offered next time current with a server started by a tool call
+                scope.launch {
+                    try {
+                        writeCachedTools(config, connection.client.listTools(config.timeoutMs))
+                    } catch (e: Exception) {
+                    }
+                }
+            }
+        }
+    }
+
+    private suspend fun connect(config: ServerConfig, workspaceRoot: String): Connection {
+        val connection = withContext(Dispatchers.IO) { open(config, workspaceRoot) }
+        try {
+            connection.client.initialize(config.timeoutMs)
+        } catch (e: Exception) {
+            connection.client.close()
+            throw e
+        }
+        return connection
+    }
+
+    private fun open(config: ServerConfig, workspaceRoot: String): Connection {
+        return if (config.socket != null) {
+            val socket = LocalSocket()
+            socket.connect(LocalSocketAddress(socketPath(config.socket, workspaceRoot), LocalSocketAddress.Namespace.FILESYSTEM))
+            Connection(config, workspaceRoot, McpClient(socket.inputStream, socket.outputStream) { socket.close() })
+        } else {
+            // The configured environment is set inside the rootfs, after its search path
+            val command = if (config.env.isEmpty()) {
+                listOf(config.command!!) + config.args
+            } else {
+                listOf("env") + config.env.map { (name, value) -> "$name=$value" } + config.command!! + config.args
+            }
+            val rootfsDir = RootfsCommand.rootfsDirFor(workspaceRoot)
+                ?: throw IOException("No extracted rootfs to start MCP server '${config.name}' in")
+            val workingDir = config.cwd?.let { cwd ->
+                if (cwd.startsWith("/")) RootfsCommand.toHostPath(rootfsDir, cwd) else File(workspaceRoot, cwd).path
+            }
+            val launch = RootfsCommand.forWorkspace(workspaceRoot, command, workingDir)
+                ?: throw IOException("No extracted rootfs to start MCP server '${config.name}' in")
+            val builder = launch.processBuilder()
+            builder.environment()["WORKSPACE_ROOT"] = launch.toRootfsPath(workspaceRoot)
+            val process = builder.start()
+            // Diagnostics go to a log file instead of filling a pipe nobody reads
+            val log = stderrLog(config)
+            Thread({
+                try {
+                    process.errorStream.use { input -> FileOutputStream(log, true).use { input.copyTo(it) } }
+                } catch (e: IOException) {
+                }
+            }, "McpServerStderr").apply {
+                isDaemon = true
+                start()
+            }
+            Connection(config, workspaceRoot, McpClient(process.inputStream, process.outputStream) { process.destroy() })
+        }
+    }
+
+    /**
+     * Host path of the unix socket [socket], given as the workspace's rootfs sees it, or relative to
+     * the workspace
+     */
+    private fun socketPath(socket: String, workspaceRoot: String): String {
+        if (!socket.startsWith("/")) return File(workspaceRoot, socket).path
+        val rootfsDir = RootfsCommand.rootfsDirFor(workspaceRoot)
+            ?: throw IOException("No extracted rootfs for the socket of $socket")
+        return RootfsCommand.toHostPath(rootfsDir, socket)
+    }
+
+    private fun stderrLog(config: ServerConfig): File {
+        val dir = application?.cacheDir?.let { File(it, "mcp-logs") } ?: File(System.getProperty("java.io.tmpdir"), "mcp-logs")
+        dir.mkdirs()
+        return File(dir, "${config.name.replace(Regex("[^A-Za-z0-9_.-]"), "_")}.log")
+    }
+
+    /**
+     * Register the tools of every configured server with [registry]. Tools known from earlier
+     * sessions are registered at once and their servers start on the first tool call. A server
+     * whose tools are not known is started in the background, once per workspace, and its tools
+     * are registered when it answers.
+     */
+    fun registerTools(registry: ToolRegistry, workspaceRoot: String) {
+        val configs = try {
+            loadConfigs(workspaceRoot)
+        } catch (e: Exception) {
+            android.util.Log.w(TAG, "Could not read MCP settings: ${e.message}")
+            return
+        }
+        for (config in configs.values) {
+            val cached = readCachedTools(config)
+            if (cached != null) {
+                cached.forEach { registry.registerTool(McpTool.from(config.name, it, workspaceRoot)) }
+                continue
+            }
+            if (!listed.add(key(workspaceRoot, config.name))) continue
+            scope.launch {
+                try {
+                    val tools = client(workspaceRoot, config.name).listTools(config.timeoutMs)
+                    writeCachedTools(config, tools)
+                    tools.forEach { registry.registerTool(McpTool.from(config.name, it, workspaceRoot)) }
+                } catch (e: Exception) {
+                    android.util.Log.w(TAG, "MCP server ${config.name} failed to start: ${e.message}")
+                }
+            }
+        }
+    }
+
+    /**
+     * Close the connections of [directory] and of workspaces inside it, stopping the servers that
+     * were started for them. A later tool call connects again.
+     */
+    fun closeWorkspace(directory: String) {
+        val parent = File(directory).absoluteFile.normalize().path
+        connections.entries.removeAll { (_, connection) ->
+            val root = File(connection.workspaceRoot).absoluteFile.normalize().path
+            val inside = root == parent || root.startsWith("$parent/")
+            if (inside) connection.client.close()
+            inside
+        }
+        listed.removeAll { key ->
+            val root = File(key.substringBefore('\u0000')).absoluteFile.normalize().path
+            root == parent || root.startsWith("$parent/")
+        }
+    }
+
+    /**
+     * Close every connection and stop the servers that were started
+     */
+    fun shutdown() {
+        connections.values.forEach { it.client.close() }
+        connections.clear()
+        listed.clear()
+    }
+
+    private fun key(workspaceRoot: String, serverName: String) = "$workspaceRoot\u0000$serverName"
+
+    private fun toolCacheFile(config: ServerConfig): File? {
+        val dir = application?.cacheDir ?: return null
+        val identity = listOf(config.name, config.command.orEmpty(), config.socket.orEmpty()) + config.args
+        val digest = MessageDigest.getInstance("SHA-1").digest(identity.joinToString("\u0000").toByteArray())
+        return File(dir, "mcp-tools/${digest.joinToString("") { "%02x".format(it) }}.json")
+    }
+
+    private fun readCachedTools(config: ServerConfig): List<McpClient.ToolInfo>? {
+        val file = toolCacheFile(config)?.takeIf { it.isFile } ?: return null
+        return try {
+            gson.fromJson<List<McpClient.ToolInfo>>(file.readText(), toolListType)
+        } catch (e: Exception) {
+            null
+        }
+    }
+
+    private fun writeCachedTools(config: ServerConfig, tools: List<McpClient.ToolInfo>) {
+        val file = toolCacheFile(config) ?: return
+        try {
+            file.parentFile?.mkdirs()
+            val temp = File(file.path + ".tmp")
+            temp.writeText(gson.toJson(tools, toolListType))
+            if (!temp.renameTo(file)) temp.delete()
+        } catch (e: Exception) {
+            // Only costs the tools being offered before the server starts next time
+        }
+    }
+}
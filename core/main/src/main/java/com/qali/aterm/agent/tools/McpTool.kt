@@ -1,13 +1,18 @@
 package com.qali.aterm.agent.tools
 
+import com.google.gson.Gson
+import com.google.gson.JsonObject
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import kotlinx.coroutines.async
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.delay
 
 /**
  * MCP (Model Context Protocol) Tool support
- * This is a simplified implementation - full MCP support would require
- * MCP client/server infrastructure
+ * Each tool of a configured MCP server is offered as its own tool; calls go to the server's
+ * persistent connection held by [McpServerManager]
  */
 data class McpToolParams(
     val serverName: String,
@@ -16,7 +21,8 @@ data class McpToolParams(
 )
 
 class McpToolInvocation(
-    toolParams: McpToolParams
+    toolParams: McpToolParams,
+    private val workspaceRoot: String
 ) : ToolInvocation<McpToolParams, ToolResult> {
     
     override val params: McpToolParams = toolParams
@@ -40,30 +46,90 @@ class McpToolInvocation(
             )
         }
         
-        // MCP tool execution would require MCP client/server setup
-        // For now, return a placeholder
-        return ToolResult(
-            llmContent = "MCP tool execution requires MCP client/server infrastructure. Tool: ${params.serverName}::${params.toolName} with args: ${params.args}",
-            returnDisplay = "MCP tool execution not fully implemented",
-            error = ToolError(
-                message = "MCP infrastructure not available",
-                type = ToolErrorType.EXECUTION_ERROR
+        return try {
+            val client = McpServerManager.client(workspaceRoot, params.serverName)
+            val arguments = gson.toJsonTree(params.args).asJsonObject
+            val timeoutMs = McpServerManager.timeoutMs(workspaceRoot, params.serverName)
+            val result = coroutineScope {
+                val call = async { client.callTool(params.toolName, arguments, timeoutMs) }
+                // The signal has no callback; cancelling the call also cancels it on the server
+                while (!call.isCompleted) {
+                    if (signal?.isAborted() == true) {
+                        call.cancel()
+                        return@coroutineScope null
+                    }
+                    delay(CANCEL_POLL_MS)
+                }
+                call.await()
+            } ?: return ToolResult(
+                llmContent = "MCP tool execution cancelled",
+                returnDisplay = "Cancelled"
             )
-        )
+            
+            val text = formatContent(result)
+            if (result.get("isError")?.takeIf { it.isJsonPrimitive }?.asBoolean == true) {
+                ToolResult(
+                    llmContent = "MCP tool ${params.serverName}::${params.toolName} failed: $text",
+                    returnDisplay = "Error: ${text.lineSequence().firstOrNull().orEmpty()}",
+                    error = ToolError(
+                        message = text,
+                        type = ToolErrorType.DISCOVERED_TOOL_EXECUTION_ERROR
+                    )
+                )
+            } else {
+                ToolResult(
+                    llmContent = text,
+                    returnDisplay = "MCP ${params.serverName}::${params.toolName} completed"
+                )
+            }
+        } catch (e: Exception) {
+            ToolResult(
+                llmContent = "MCP tool ${params.serverName}::${params.toolName} could not be called: ${e.message}",
+                returnDisplay = "Error: ${e.message}",
+                error = ToolError(
+                    message = e.message ?: "MCP call failed",
+                    type = ToolErrorType.EXECUTION_ERROR
+                )
+            )
+        }
+    }
+    
+    companion object {
+        private const val CANCEL_POLL_MS = 200L
+        private val gson = Gson()
+        
+        /**
+         * Text of a `tools/call` result's content blocks; non-text blocks are described
+         */
+        fun formatContent(result: JsonObject): String {
+            val blocks = result.getAsJsonArray("content") ?: return ""
+            return blocks.mapNotNull { element ->
+                val block = element as? JsonObject ?: return@mapNotNull null
+                when (block.get("type")?.asString) {
+                    "text" -> block.get("text")?.asString
+                    "image", "audio" -> "[${block.get("type").asString}: ${block.get("mimeType")?.asString ?: "unknown type"}]"
+                    "resource" -> block.getAsJsonObject("resource")?.let { resource ->
+                        resource.get("text")?.asString ?: "[resource: ${resource.get("uri")?.asString}]"
+                    }
+                    else -> block.toString()
+                }
+            }.joinToString("\n")
+        }
     }
 }
 
 /**
- * Base class for MCP tools - can be extended when MCP client is available
+ * A tool of an MCP server, declared with the server's own input schema
  */
 open class McpTool(
     val serverName: String,
     val toolName: String,
     toolDescription: String,
-    schemaParam: FunctionParameters
+    schemaParam: FunctionParameters,
+    private val workspaceRoot: String
 ) : DeclarativeTool<McpToolParams, ToolResult>() {
     
-    override val name = "mcp_${serverName}_$toolName"
+    override val name = "mcp_${sanitize(serverName)}_${sanitize(toolName)}"
     override val displayName = "MCP: $serverName::$toolName"
     override val description: String = toolDescription
     override val parameterSchema: FunctionParameters = schemaParam
@@ -81,21 +147,64 @@ open class McpTool(
         toolName: String?,
         toolDisplayName: String?
     ): ToolInvocation<McpToolParams, ToolResult> {
-        return McpToolInvocation(params)
+        return McpToolInvocation(params, workspaceRoot)
     }
     
     override fun validateAndConvertParams(params: Map<String, Any>): McpToolParams {
-        val serverName = params["serverName"] as? String
-            ?: throw IllegalArgumentException("serverName is required")
-        val toolName = params["toolName"] as? String
-            ?: throw IllegalArgumentException("toolName is required")
-        val args = (params["args"] as? Map<*, *>)?.mapValues { it.value } as? Map<String, Any>
-            ?: emptyMap()
+        // The model calls the tool with the server's arguments; an explicit envelope also works
+        @Suppress("UNCHECKED_CAST")
+        val args = (params["args"] as? Map<String, Any>)
+            ?.takeIf { "serverName" in params || "toolName" in params }
+            ?: params
         
         return McpToolParams(
-            serverName = serverName,
-            toolName = toolName,
+            serverName = params["serverName"] as? String ?: serverName,
+            toolName = params["toolName"] as? String ?: toolName,
             args = args
         )
     }
+    
+    companion object {
+        private fun sanitize(value: String) = value.replace(Regex("[^A-Za-z0-9_-]"), "_")
+        
+        /**
+         * Tool for [tool] of [serverName]
+         */
+        fun from(serverName: String, tool: McpClient.ToolInfo, workspaceRoot: String): McpTool {
+            return McpTool(
+                serverName = serverName,
+                toolName = tool.name,
+                toolDescription = tool.description.ifEmpty { "MCP tool ${tool.name} of $serverName" },
+                schemaParam = parametersFrom(tool.inputSchema),
+                workspaceRoot = workspaceRoot
+            )
+        }
+        
+        /**
+         * Declaration parameters from a JSON Schema object
+         */
+        fun parametersFrom(schema: JsonObject): FunctionParameters {
+            val properties = schema.getAsJsonObject("properties")?.entrySet()?.mapNotNull { (key, value) ->
+                (value as? JsonObject)?.let { key to propertyFrom(it) }
+            }?.toMap().orEmpty()
+            return FunctionParameters(
+                type = "object",
+                properties = properties,
+                required = schema.getAsJsonArray("required")?.map { it.asString }.orEmpty()
+            )
+        }
+        
+        private fun propertyFrom(schema: JsonObject): PropertySchema {
+            val type = schema.get("type")?.let { type ->
+                // ["string", "null"] and similar: the first non-null type
+                if (type.isJsonArray) type.asJsonArray.map { it.asString }.firstOrNull { it != "null" } else type.asString
+            } ?: "string"
+            return PropertySchema(
+                type = type,
+                description = schema.get("description")?.takeIf { it.isJsonPrimitive }?.asString.orEmpty(),
+                enum = schema.getAsJsonArray("enum")?.filter { it.isJsonPrimitive }?.map { it.asString },
+                items = (schema.get("items") as? JsonObject)?.let { propertyFrom(it) }
+            )
+        }
+    }
 }
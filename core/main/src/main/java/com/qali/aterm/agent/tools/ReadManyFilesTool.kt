@@ -4,6 +4,7 @@ import com.rk.libcommons.alpineDir
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import com.qali.aterm.agent.utils.WorkspaceFileIndex
 import java.io.File
 import java.nio.file.FileSystems
 import java.nio.file.PathMatcher
@@ -157,37 +158,43 @@ class ReadManyFilesToolInvocation(
         if (signal?.isAborted() == true) return
         if (!dir.exists() || !dir.isDirectory) return
         
-        dir.listFiles()?.forEach { file ->
+        val excludedPaths = HashSet<String>()
+        for (entry in WorkspaceFileIndex.filesUnder(workspaceRoot, dir, includeIgnored = true)) {
             if (signal?.isAborted() == true) return
             
-            val relativePath = file.relativeTo(File(workspaceRoot)).path
+            val relativePath = entry.path
             
-            // Check exclude patterns
-            val isExcluded = excludePatterns.any { pattern ->
-                pattern.matches(relativePath)
+            // An excluded directory excludes everything below it
+            val excludedBy = relativePathAndParents(relativePath).firstOrNull { path ->
+                excludePatterns.any { pattern -> pattern.matches(path) }
             }
             
-            if (isExcluded) {
-                skippedFiles.add(relativePath to "Excluded by pattern")
-                return@forEach
+            if (excludedBy != null) {
+                if (excludedPaths.add(excludedBy)) {
+                    skippedFiles.add(excludedBy to "Excluded by pattern")
+                }
+                continue
             }
             
-            if (file.isFile) {
-                // Check include patterns
-                val matches = includePatterns.any { pattern ->
-                    pattern.matches(relativePath)
-                }
-                
-                if (matches) {
-                    filesToRead.add(file)
-                }
-            } else if (file.isDirectory) {
-                // Recursively search subdirectories
-                collectFiles(file, includePatterns, excludePatterns, filesToRead, skippedFiles, signal)
+            // Check include patterns
+            val matches = includePatterns.any { pattern ->
+                pattern.matches(relativePath)
+            }
+            
+            if (matches) {
+                filesToRead.add(File(workspaceRoot, relativePath))
             }
         }
     }
     
+    /**
+     * "a/b/c.kt" -> "a", "a/b", "a/b/c.kt", the order a directory walk would test them in
+     */
+    private fun relativePathAndParents(relativePath: String): Sequence<String> {
+        val segments = relativePath.split('/')
+        return (1..segments.size).asSequence().map { segments.subList(0, it).joinToString("/") }
+    }
+    
     private fun convertGlobToRegex(glob: String): Regex {
         // Convert glob pattern to regex
         var regex = glob
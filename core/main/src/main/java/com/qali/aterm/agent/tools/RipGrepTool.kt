@@ -1,9 +1,13 @@
 package com.qali.aterm.agent.tools
 
 import com.rk.libcommons.alpineDir
+import com.rk.settings.Settings
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import com.qali.aterm.agent.utils.NativeFileSearch
+import com.qali.aterm.agent.utils.WorkspaceFileIndex
+import com.qali.aterm.agent.utils.WorkspaceTrigramIndex
 import java.io.File
 import java.util.regex.Pattern
 
@@ -173,56 +177,92 @@ class RipGrepToolInvocation(
         if (signal?.isAborted() == true) return
         if (!dir.exists() || !dir.isDirectory) return
         
-        dir.listFiles()?.forEach { file ->
-            if (signal?.isAborted() == true) return
+        // Like rg, .atermignore is respected unless no_ignore is set
+        val entries = WorkspaceFileIndex.filesUnder(workspaceRoot, dir, includeIgnored = params.no_ignore == true, skipHidden = true)
+        // Files the trigram index rules out cannot contain the pattern's literal and are not read
+        val mayMatch = if (Settings.agent_search_index) WorkspaceTrigramIndex.candidatesFor(workspaceRoot, pattern) else null
+        val files = mutableListOf<File>()
+        for (entry in entries) {
+            val file = File(workspaceRoot, entry.path).absoluteFile.normalize()
+            
+            // Check include pattern
+            if (include != null && !matchesIncludePattern(file.name, include)) {
+                continue
+            }
             
-            if (file.isDirectory && !file.name.startsWith(".")) {
-                searchFiles(file, pattern, include, matches, beforeLines, afterLines, signal)
-            } else if (file.isFile) {
-                // Check include pattern
-                if (include != null && !matchesIncludePattern(file.name, include)) {
-                    return@forEach
+            // Skip large files
+            if (entry.size > 10 * 1024 * 1024) { // 10MB limit
+                continue
+            }
+            if (mayMatch != null && !mayMatch(entry)) continue
+            files.add(file)
+        }
+        
+        // Scan all files at once natively when the pattern has a literal to look for; only files
+        // with matches are read again, for their context lines
+        val nativeMatches = NativeFileSearch.search(files.map { it.path }, pattern, maxMatches) { signal?.isAborted() == true }
+        if (nativeMatches != null) {
+            for ((fileIndex, fileMatches) in nativeMatches.groupBy { it.fileIndex }) {
+                val file = files[fileIndex]
+                val lines = if (beforeLines > 0 || afterLines > 0) {
+                    try { file.readLines() } catch (e: Exception) { emptyList() }
+                } else {
+                    emptyList()
                 }
-                
-                // Skip large files
-                if (file.length() > 10 * 1024 * 1024) { // 10MB limit
-                    return@forEach
+                for (match in fileMatches) {
+                    val i = match.lineNumber - 1
+                    matches.add(
+                        RipGrepMatch(
+                            filePath = file.absolutePath,
+                            lineNumber = match.lineNumber,
+                            line = match.line,
+                            contextBefore = if (beforeLines > 0 && i <= lines.size) lines.subList(maxOf(0, i - beforeLines), i) else emptyList(),
+                            contextAfter = if (afterLines > 0 && i < lines.size) lines.subList(i + 1, minOf(lines.size, i + 1 + afterLines)) else emptyList()
+                        )
+                    )
                 }
-                
-                try {
-                    val lines = file.readLines()
-                    for (i in lines.indices) {
-                        if (pattern.matcher(lines[i]).find()) {
-                            val contextBefore = if (beforeLines > 0) {
-                                lines.subList(maxOf(0, i - beforeLines), i)
-                            } else {
-                                emptyList()
-                            }
-                            
-                            val contextAfter = if (afterLines > 0) {
-                                lines.subList(i + 1, minOf(lines.size, i + 1 + afterLines))
-                            } else {
-                                emptyList()
-                            }
-                            
-                            matches.add(
-                                RipGrepMatch(
-                                    filePath = file.absolutePath,
-                                    lineNumber = i + 1,
-                                    line = lines[i],
-                                    contextBefore = contextBefore,
-                                    contextAfter = contextAfter
-                                )
+            }
+            return
+        }
+        
+        for (file in files) {
+            if (signal?.isAborted() == true) return
+            // Skipped by the native search too
+            if (NativeFileSearch.isBinary(file)) continue
+            
+            try {
+                val lines = file.readLines()
+                for (i in lines.indices) {
+                    if (pattern.matcher(lines[i]).find()) {
+                        val contextBefore = if (beforeLines > 0) {
+                            lines.subList(maxOf(0, i - beforeLines), i)
+                        } else {
+                            emptyList()
+                        }
+                        
+                        val contextAfter = if (afterLines > 0) {
+                            lines.subList(i + 1, minOf(lines.size, i + 1 + afterLines))
+                        } else {
+                            emptyList()
+                        }
+                        
+                        matches.add(
+                            RipGrepMatch(
+                                filePath = file.absolutePath,
+                                lineNumber = i + 1,
+                                line = lines[i],
+                                contextBefore = contextBefore,
+                                contextAfter = contextAfter
                             )
-                            
-                            if (matches.size >= maxMatches) {
-                                return
-                            }
+                        )
+                        
+                        if (matches.size >= maxMatches) {
+                            return
                         }
                     }
-                } catch (e: Exception) {
-                    // Skip files that can't be read
                 }
+            } catch (e: Exception) {
+                // Skip files that can't be read
             }
         }
     }
@@ -8,6 +8,7 @@ import com.qali.aterm.agent.debug.DebugLogger
 import com.qali.aterm.ui.activities.terminal.MainActivity
 import com.qali.aterm.service.TabType
 import com.termux.terminal.TerminalSession
+import com.termux.terminal.Tracer
 import java.io.File
 import kotlinx.coroutines.withTimeoutOrNull
 import kotlinx.coroutines.delay
@@ -140,6 +141,7 @@ class ShellToolInvocation(
             // Use withContext to ensure we're on the right thread for process operations
             // Add timeout to prevent hanging (configurable, default 60 seconds)
             val timeoutMs = (params.timeout ?: 60) * 1000L
+            val commandStart = Tracer.now()
             val result = kotlinx.coroutines.withTimeoutOrNull(timeoutMs) {
                 kotlinx.coroutines.withContext(kotlinx.coroutines.Dispatchers.IO) {
                     try {
@@ -173,6 +175,7 @@ class ShellToolInvocation(
                             
                             // Wait for command to complete and read output
                             // Use a more efficient approach: wait for prompt to appear
+                            val traceStart = Tracer.now()
                             var output = ""
                             var attempts = 0
                             val maxAttempts = 200 // 20 seconds max (200 * 100ms)
@@ -247,6 +250,7 @@ class ShellToolInvocation(
                                 }
                             }
                             
+                            Tracer.completeAsync("shell.transcriptWait", traceStart, agentSessionId)
                             android.util.Log.d("ShellTool", "Command completed via terminal session")
                             android.util.Log.d("ShellTool", "Output length: ${output.length} characters")
                             
@@ -279,7 +283,9 @@ class ShellToolInvocation(
                             env["WORKSPACE_ROOT"] = workspaceRoot
                             env["PWD"] = finalWorkingDir.absolutePath
                             
+                            val spawnStart = Tracer.now()
                             val process = processBuilder.start()
+                            Tracer.complete("shell.spawn", spawnStart)
                             android.util.Log.d("ShellTool", "Process started successfully")
                             
                             // Read output - since redirectErrorStream(true), both stdout and stderr go to inputStream
@@ -329,6 +335,7 @@ class ShellToolInvocation(
                 Pair(-1, "Command timed out after $timeoutSeconds seconds")
             }
             
+            Tracer.completeAsync("shell.command", commandStart, params.command)
             val (exitCode, output) = result
             
             // Real-time error monitoring
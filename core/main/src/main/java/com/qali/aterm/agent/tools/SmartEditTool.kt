@@ -105,6 +105,7 @@ class SmartEditToolInvocation(
         // Write the new content
         return try {
             file.writeText(replacement.newContent)
+            com.qali.aterm.agent.utils.WorkspaceChangeTracker.notifyFileChanged(file)
             updateOutput?.invoke("Smart edit completed")
             
             ToolResult(
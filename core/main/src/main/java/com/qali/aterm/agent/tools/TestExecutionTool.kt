@@ -18,7 +18,8 @@ import kotlinx.coroutines.withContext
 data class TestExecutionToolParams(
     val testPath: String? = null, // Specific test file/class to run, or null for all tests
     val framework: String? = null, // "junit", "pytest", "npm", "gradle", "maven", or null for auto-detect
-    val projectPath: String? = null // Project root path, or null for workspace root
+    val projectPath: String? = null, // Project root path, or null for workspace root
+    val parallel: Boolean? = null // Shard test files across cores and reuse cached results; null means yes when possible
 )
 
 data class TestResult(
@@ -102,8 +103,16 @@ class TestExecutionToolInvocation(
             
             updateOutput?.invoke("▶️ Running tests with $framework...")
             
+            // Whole pytest/Jest suites run sharded, skipping files unaffected since they passed
+            val shardedResult = if (params.testPath == null && params.parallel != false &&
+                TestShardRunner.supports(framework, projectPath)) {
+                runShardedTests(projectPath, framework, updateOutput, signal)
+            } else {
+                null
+            }
+            
             // Execute tests
-            val testResult = when (framework) {
+            val testResult = shardedResult ?: when (framework) {
                 "junit", "gradle" -> runGradleTests(projectPath, params.testPath, updateOutput, signal)
                 "maven" -> runMavenTests(projectPath, params.testPath, updateOutput, signal)
                 "pytest" -> runPytestTests(projectPath, params.testPath, updateOutput, signal)
@@ -301,6 +310,14 @@ class TestExecutionToolInvocation(
         
         val outputText = output.toString()
         
+        // Prefer the JUnit XML reports Gradle and Maven write over scraping their console output
+        if (framework == "junit" || framework == "gradle" || framework == "maven") {
+            val cases = TestShardRunner.readJUnitReports(workingDir, startTime)
+            if (cases.isNotEmpty()) {
+                return@withContext toTestResult(framework, cases, duration, outputText)
+            }
+        }
+        
         // Parse test results based on framework
         val parsedResult = when (framework) {
             "gradle" -> parseGradleResults(outputText, duration)
@@ -322,6 +339,82 @@ class TestExecutionToolInvocation(
         parsedResult
     }
     
+    private suspend fun runShardedTests(
+        projectPath: File,
+        framework: String,
+        updateOutput: ((String) -> Unit)?,
+        signal: CancellationSignal?
+    ): TestResult? {
+        val runner = TestShardRunner(projectPath, if (framework == "pytest") "pytest" else "jest")
+        val run = runner.run(
+            shardCount = Runtime.getRuntime().availableProcessors(),
+            execute = { command -> captureCommand(command, projectPath, signal) },
+            onProgress = updateOutput
+        ) ?: return null
+        
+        val cases = run.units.flatMap { it.cases }
+        val output = buildString {
+            appendLine("${run.units.size} test file(s), ${run.cachedUnits} reused from cache (unchanged since they passed)")
+            append(run.output)
+        }
+        return toTestResult(framework, cases, run.durationMs, output)
+    }
+    
+    /**
+     * Run [command] and return its combined output and exit code, without streaming it
+     */
+    private suspend fun captureCommand(
+        command: String,
+        workingDir: File,
+        signal: CancellationSignal?
+    ): TestShardRunner.CommandOutput = withContext(Dispatchers.IO) {
+        val process = ProcessBuilder()
+            .command("sh", "-c", command)
+            .directory(workingDir)
+            .redirectErrorStream(true)
+            .start()
+        
+        val output = StringBuilder()
+        process.inputStream.bufferedReader().useLines { lines ->
+            for (line in lines) {
+                if (signal?.isAborted() == true) {
+                    process.destroy()
+                    throw InterruptedException("Test execution cancelled")
+                }
+                output.appendLine(line)
+            }
+        }
+        val exitCode = process.waitFor()
+        TestShardRunner.CommandOutput(output.toString(), exitCode)
+    }
+    
+    private fun toTestResult(
+        framework: String,
+        cases: List<TestShardRunner.CaseResult>,
+        duration: Long,
+        output: String
+    ): TestResult {
+        val failed = cases.filter { it.status == TestShardRunner.Status.FAILED }
+        return TestResult(
+            framework = framework,
+            totalTests = cases.size,
+            passed = cases.count { it.status == TestShardRunner.Status.PASSED },
+            failed = failed.size,
+            skipped = cases.count { it.status == TestShardRunner.Status.SKIPPED },
+            duration = duration,
+            failures = failed.map { case ->
+                TestFailure(
+                    testName = case.name,
+                    errorMessage = case.message ?: "Test failed",
+                    stackTrace = case.stackTrace,
+                    file = case.file,
+                    line = case.line
+                )
+            },
+            output = output
+        )
+    }
+    
     private fun parseGradleResults(output: String, duration: Long): TestResult {
         // Parse Gradle test output
         val totalTests = extractNumber(output, "tests? completed") ?: 0
@@ -535,6 +628,7 @@ class TestExecutionTool(
         - testPath: Specific test file/class to run (e.g., "com.example.MyTest", "test_file.py"), or null for all tests
         - framework: Test framework to use - "gradle", "maven", "pytest", "npm", or null for auto-detect
         - projectPath: Project root path, or null for workspace root
+        - parallel: For whole pytest/Jest suites, run test files in parallel shards and skip files whose code is unchanged since they passed (default true)
         
         Examples:
         - run_tests() - Run all tests (auto-detect framework)
@@ -557,6 +651,10 @@ class TestExecutionTool(
             "projectPath" to PropertySchema(
                 type = "string",
                 description = "Project root path, or omit for workspace root"
+            ),
+            "parallel" to PropertySchema(
+                type = "boolean",
+                description = "Shard whole pytest/Jest suites across cores and reuse results of unchanged passing test files. Defaults to true."
             )
         ),
         required = emptyList()
@@ -582,7 +680,8 @@ class TestExecutionTool(
         return TestExecutionToolParams(
             testPath = params["testPath"] as? String,
             framework = params["framework"] as? String,
-            projectPath = params["projectPath"] as? String
+            projectPath = params["projectPath"] as? String,
+            parallel = params["parallel"] as? Boolean
         )
     }
 }
@@ -0,0 +1,503 @@
+package com.qali.aterm.agent.tools
+
+import com.google.gson.Gson
+import com.google.gson.JsonObject
+import com.google.gson.JsonParser
+import com.google.gson.reflect.TypeToken
+import com.rk.libcommons.application
+import kotlinx.coroutines.async
+import kotlinx.coroutines.awaitAll
+import kotlinx.coroutines.coroutineScope
+import java.io.File
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
+import javax.xml.parsers.DocumentBuilderFactory
+import org.w3c.dom.Element
+
+/**
+ * Runs pytest and Jest suites as parallel shards of test files, with results read from the
+ * runners' structured reports and cached per test file
+ *
+ * Test files are discovered by the runners' naming conventions and split across one worker
+ * process per core, longest first by their last known duration. Each worker writes JUnit XML
+ * (pytest) or JSON (Jest) that is parsed into per-test outcomes instead of scraping the console.
+ *
+ * A test file whose tests all passed is cached under a hash of its own content, the project files
+ * it imports (followed transitively through relative and project-local imports) and the runner's
+ * configuration. As long as none of those change, the file is not run again, so an edit only
+ * re-runs the tests that can observe it. Failing files are always re-run.
+ */
+class TestShardRunner(
+    private val projectDir: File,
+    private val framework: String,
+    private val cacheFile: File? = defaultCacheFile(projectDir)
+) {
+    enum class Status { PASSED, FAILED, SKIPPED }
+
+    /** Outcome of one test case */
+    data class CaseResult(
+        val name: String,
+        val status: Status,
+        val message: String? = null,
+        val stackTrace: String? = null,
+        val file: String? = null,
+        val line: Int? = null,
+        val durationMs: Long = 0
+    )
+
+    /** Outcome of one test file, stored in the cache under [key] */
+    data class UnitResult(
+        val path: String,
+        val key: String,
+        val cases: List<CaseResult>,
+        val durationMs: Long
+    )
+
+    /** Output and exit code of a shard's runner process */
+    class CommandOutput(val text: String, val exitCode: Int)
+
+    /** Result of [run]: per-file outcomes and which of them came from the cache */
+    class RunResult(
+        val units: List<UnitResult>,
+        val cachedUnits: Int,
+        val output: String,
+        val durationMs: Long
+    )
+
+    private val gson = Gson()
+    private val fileHashes = HashMap<String, String>()
+
+    /**
+     * Test files of the project, as paths relative to it
+     */
+    fun discoverUnits(): List<String> {
+        val units = ArrayList<String>()
+        projectDir.walkTopDown()
+            .onEnter { dir -> dir == projectDir || (dir.name !in SKIPPED_DIRECTORIES && !dir.name.startsWith(".")) }
+            .filter { it.isFile && isTestFile(it) }
+            .forEach { units.add(it.relativeTo(projectDir).path) }
+        units.sort()
+        return units
+    }
+
+    private fun isTestFile(file: File): Boolean {
+        val name = file.name
+        return when (framework) {
+            "pytest" -> name.endsWith(".py") && (name.startsWith("test_") || name.endsWith("_test.py"))
+            else -> JS_TEST_FILE.matches(name) ||
+                (file.parentFile?.name == "__tests__" && name.substringAfterLast('.') in JS_EXTENSIONS)
+        }
+    }
+
+    /**
+     * Cache key of test file [unit]: its content, every project file it transitively imports and
+     * the runner configuration
+     */
+    fun unitKey(unit: String): String {
+        val files = sortedSetOf<String>()
+        val pending = ArrayDeque<File>()
+        pending.add(File(projectDir, unit))
+        while (pending.isNotEmpty()) {
+            val file = pending.removeFirst()
+            if (!file.isFile) continue
+            val path = file.relativeTo(projectDir).path
+            if (!files.add(path)) continue
+            val source = try {
+                file.readText()
+            } catch (e: Exception) {
+                continue
+            }
+            pending.addAll(localImports(file, source))
+        }
+        files.addAll(configFiles(File(projectDir, unit)))
+
+        val digest = MessageDigest.getInstance("SHA-1")
+        digest.update(framework.toByteArray())
+        for (path in files) {
+            digest.update(path.toByteArray())
+            digest.update(hashOf(File(projectDir, path)).toByteArray())
+        }
+        return hex(digest.digest())
+    }
+
+    /**
+     * Project files [file] imports; imports that resolve outside the project are not followed
+     */
+    private fun localImports(file: File, source: String): List<File> {
+        val dir = file.parentFile ?: projectDir
+        return if (framework == "pytest") {
+            pythonImport.findAll(source).flatMap { match ->
+                val from = match.groupValues[1]
+                val names = match.groupValues[2].ifEmpty { match.groupValues[3] }
+                if (from.isNotEmpty()) {
+                    // `from pkg import mod` may name a submodule as well as an attribute
+                    val base = resolvePythonModule(from, dir)
+                    val prefix = if (from.endsWith(".")) from else "$from."
+                    base + names.split(',').map { it.trim().substringBefore(' ') }
+                        .filter { it.isNotEmpty() && it != "*" }
+                        .flatMap { resolvePythonModule(prefix + it, dir) }
+                } else {
+                    names.split(',').map { it.trim().substringBefore(' ') }.flatMap { resolvePythonModule(it, dir) }
+                }
+            }.toList()
+        } else {
+            jsImport.findAll(source).mapNotNull { match ->
+                val specifier = match.groupValues[1]
+                JS_RESOLVE_SUFFIXES.map { File(dir, specifier + it) }.firstOrNull { it.isFile }
+            }.toList()
+        }
+    }
+
+    private fun resolvePythonModule(module: String, dir: File): List<File> {
+        if (module.isEmpty()) return emptyList()
+        val bases = if (module.startsWith(".")) {
+            // Relative import: one dot is the current package, each further dot goes up one level
+            var base: File? = dir
+            repeat(module.takeWhile { it == '.' }.length - 1) { base = base?.parentFile }
+            listOfNotNull(base)
+        } else {
+            // pytest puts the test's directory and the project root on sys.path; src layouts are common
+            listOf(dir, projectDir, File(projectDir, "src"))
+        }
+        val relative = module.trimStart('.').replace('.', '/')
+        return bases.flatMap { base ->
+            if (relative.isEmpty()) {
+                listOf(File(base, "__init__.py"))
+            } else {
+                listOf(File(base, "$relative.py"), File(base, "$relative/__init__.py"))
+            }
+        }.filter { it.isFile && it.startsWith(projectDir) }
+    }
+
+    private fun configFiles(unitFile: File): List<String> {
+        val configs = ArrayList<String>()
+        if (framework == "pytest") {
+            // conftest.py files apply to every test below them
+            var dir = unitFile.parentFile
+            while (dir != null && dir.startsWith(projectDir)) {
+                File(dir, "conftest.py").takeIf { it.isFile }?.let { configs.add(it.relativeTo(projectDir).path) }
+                if (dir == projectDir) break
+                dir = dir.parentFile
+            }
+        }
+        val names = if (framework == "pytest") PYTEST_CONFIG_FILES else JEST_CONFIG_FILES
+        names.filter { File(projectDir, it).isFile }.forEach { configs.add(it) }
+        return configs
+    }
+
+    private fun hashOf(file: File): String {
+        return fileHashes.getOrPut(file.path) {
+            val digest = MessageDigest.getInstance("SHA-1")
+            try {
+                file.inputStream().use { input ->
+                    val buffer = ByteArray(8192)
+                    while (true) {
+                        val read = input.read(buffer)
+                        if (read < 0) break
+                        digest.update(buffer, 0, read)
+                    }
+                }
+            } catch (e: Exception) {
+                // Unreadable files hash like missing ones
+            }
+            hex(digest.digest())
+        }
+    }
+
+    /**
+     * Split [units] into at most [shardCount] shards of similar total duration, longest first.
+     * Units without a known duration count as one second.
+     */
+    fun planShards(units: List<String>, durations: Map<String, Long>, shardCount: Int): List<List<String>> {
+        val count = shardCount.coerceIn(1, maxOf(1, units.size))
+        val shards = List(count) { ArrayList<String>() }
+        val loads = LongArray(count)
+        for (unit in units.sortedByDescending { durations[it] ?: DEFAULT_UNIT_DURATION_MS }) {
+            val lightest = loads.indices.minByOrNull { loads[it] }!!
+            shards[lightest].add(unit)
+            loads[lightest] += durations[unit] ?: DEFAULT_UNIT_DURATION_MS
+        }
+        return shards.filter { it.isNotEmpty() }
+    }
+
+    /**
+     * Run every discovered test file, reusing cached outcomes of unaffected passing files.
+     * [execute] runs a shell command in the project directory and returns its output and exit code.
+     * A file without test results only fails when its shard's runner failed; otherwise it simply
+     * has no tests. Returns null when there are no test files or the runner produced no report at
+     * all, for example because it is not installed.
+     */
+    suspend fun run(
+        shardCount: Int,
+        execute: suspend (command: String) -> CommandOutput,
+        onProgress: ((String) -> Unit)? = null
+    ): RunResult? {
+        val start = System.currentTimeMillis()
+        val cache = loadCache()
+        val units = discoverUnits()
+        if (units.isEmpty()) return null
+        val keys = units.associateWith { unitKey(it) }
+
+        val reused = ArrayList<UnitResult>()
+        val toRun = ArrayList<String>()
+        for (unit in units) {
+            val cached = cache[unit]
+            if (cached != null && cached.key == keys[unit]) reused.add(cached) else toRun.add(unit)
+        }
+        onProgress?.invoke("🧪 ${units.size} test file(s), ${reused.size} unchanged since they last passed")
+
+        val durations = cache.mapValues { it.value.durationMs }
+        val shards = planShards(toRun, durations, shardCount)
+        val reportDir = File(System.getProperty("java.io.tmpdir"), "aterm-tests-${System.nanoTime()}").apply { mkdirs() }
+        val output = StringBuilder()
+        val ran = try {
+            coroutineScope {
+                shards.mapIndexed { index, shard ->
+                    async {
+                        val report = File(reportDir, "shard-$index.${if (framework == "pytest") "xml" else "json"}")
+                        val shardStart = System.currentTimeMillis()
+                        val result = execute(shardCommand(shard, report))
+                        val elapsed = System.currentTimeMillis() - shardStart
+                        onProgress?.invoke("✔ Shard ${index + 1}/${shards.size} finished (${shard.size} file(s))")
+                        val cases = if (report.isFile) parseReport(report.readText()) else null
+                        Triple(shard, cases, elapsed) to result
+                    }
+                }.awaitAll()
+            }
+        } finally {
+            reportDir.deleteRecursively()
+        }
+        if (ran.isNotEmpty() && ran.all { it.first.second == null }) return null
+
+        val results = ArrayList<UnitResult>(reused)
+        for ((shardResult, process) in ran) {
+            val (shard, cases, elapsed) = shardResult
+            output.appendLine(process.text)
+            val byUnit = cases.orEmpty().groupBy { unitOf(it, shard) }
+            val perUnitDuration = elapsed / shard.size
+            val runnerFailed = cases == null || process.exitCode !in runnerExitCodes()
+            for (unit in shard) {
+                var unitCases = byUnit[unit].orEmpty()
+                if (unitCases.isEmpty()) {
+                    if (runnerFailed) {
+                        // The runner crashed or stopped before the file's tests ran
+                        unitCases = listOf(
+                            CaseResult(unit, Status.FAILED, "No test results were reported (exit code ${process.exitCode})", file = unit)
+                        )
+                    } else {
+                        output.appendLine("$unit: no tests")
+                    }
+                }
+                val measured = unitCases.sumOf { it.durationMs }.takeIf { it > 0 } ?: perUnitDuration
+                results.add(UnitResult(unit, keys.getValue(unit), unitCases, measured))
+            }
+        }
+        results.sortBy { it.path }
+
+        val passedUnits = results.filter { result -> result.cases.none { it.status == Status.FAILED } }
+        saveCache(passedUnits.associateBy { it.path })
+        return RunResult(results, reused.size, output.toString(), System.currentTimeMillis() - start)
+    }
+
+    /** Exit codes of a runner that ran every test, whether or not they passed */
+    private fun runnerExitCodes(): Set<Int> {
+        // pytest uses 5 for no tests collected
+        return if (framework == "pytest") setOf(0, 1, 5) else setOf(0, 1)
+    }
+
+    /** Test file [case] belongs to, falling back to the shard's only file */
+    private fun unitOf(case: CaseResult, shard: List<String>): String? {
+        val file = case.file ?: return shard.singleOrNull()
+        val relative = File(file).let { if (it.isAbsolute) it.relativeToOrNull(projectDir)?.path else it.path }
+        return shard.firstOrNull { it == relative } ?: shard.singleOrNull()
+    }
+
+    private fun shardCommand(shard: List<String>, report: File): String {
+        val files = shard.joinToString(" ") { shellQuote(it) }
+        return if (framework == "pytest") {
+            "python3 -m pytest -q -p no:cacheprovider -o junit_family=xunit1 --junitxml=${shellQuote(report.path)} $files"
+        } else {
+            "npx --no-install jest --ci --json --testLocationInResults --passWithNoTests --outputFile=${shellQuote(report.path)} $files"
+        }
+    }
+
+    private fun parseReport(text: String): List<CaseResult> {
+        return try {
+            if (framework == "pytest") parseJUnitXml(text) else parseJestJson(text)
+        } catch (e: Exception) {
+            emptyList()
+        }
+    }
+
+    private fun loadCache(): Map<String, UnitResult> {
+        val file = cacheFile ?: return memoryCache[projectDir.absolutePath + framework].orEmpty()
+        if (!file.isFile) return emptyMap()
+        return try {
+            gson.fromJson<Map<String, UnitResult>>(file.readText(), cacheType) ?: emptyMap()
+        } catch (e: Exception) {
+            emptyMap()
+        }
+    }
+
+    private fun saveCache(entries: Map<String, UnitResult>) {
+        val file = cacheFile
+        if (file == null) {
+            memoryCache[projectDir.absolutePath + framework] = entries
+            return
+        }
+        try {
+            file.parentFile?.mkdirs()
+            val temp = File(file.path + ".tmp")
+            temp.writeText(gson.toJson(entries))
+            if (!temp.renameTo(file)) temp.delete()
+        } catch (e: Exception) {
+            // The cache only saves time
+        }
+    }
+
+    companion object {
+        private const val DEFAULT_UNIT_DURATION_MS = 1000L
+
+        private val SKIPPED_DIRECTORIES = setOf("node_modules", "venv", "env", "__pycache__", "build", "dist", "site-packages")
+        private val JS_EXTENSIONS = setOf("js", "jsx", "ts", "tsx", "mjs", "cjs")
+        private val JS_TEST_FILE = Regex(""".+\.(test|spec)\.(js|jsx|ts|tsx|mjs|cjs)""")
+        private val JS_RESOLVE_SUFFIXES = listOf(
+            "", ".js", ".jsx", ".ts", ".tsx", ".mjs", ".cjs", ".json", "/index.js", "/index.ts", "/index.tsx"
+        )
+        private val PYTEST_CONFIG_FILES = listOf("pytest.ini", "pyproject.toml", "setup.cfg", "tox.ini")
+        private val JEST_CONFIG_FILES = listOf(
+            "package.json", "jest.config.js", "jest.config.ts", "jest.config.cjs", "jest.config.mjs",
+            "jest.config.json", "babel.config.js", "tsconfig.json"
+        )
+
+        private val pythonImport = Regex("""^[ \t]*(?:from[ \t]+([.\w]+)[ \t]+import[ \t]+\(?([^\n#)]*)|import[ \t]+([^\n#]+))""", RegexOption.MULTILINE)
+        private val jsImport = Regex("""(?:\bfrom\s*|\bimport\s*\(?\s*|\brequire\s*\(\s*)['"](\.{1,2}/[^'"]+)['"]""")
+
+        private val cacheType = object : TypeToken<Map<String, UnitResult>>() {}.type
+        private val memoryCache = ConcurrentHashMap<String, Map<String, UnitResult>>()
+
+        /**
+         * Whether [framework] can be sharded for [projectDir]. Jest is only assumed when the project
+         * depends on it, since other npm test scripts take different arguments.
+         */
+        fun supports(framework: String, projectDir: File): Boolean {
+            return when (framework) {
+                "pytest" -> true
+                "npm", "jest" -> File(projectDir, "package.json").let { it.isFile && it.readText().contains("\"jest\"") }
+                else -> false
+            }
+        }
+
+        fun defaultCacheFile(projectDir: File): File? {
+            val dir = application?.cacheDir ?: return null
+            val digest = MessageDigest.getInstance("SHA-1").digest(projectDir.absolutePath.toByteArray())
+            return File(dir, "test-results/${hex(digest)}.json")
+        }
+
+        /**
+         * Test cases of a JUnit XML report (pytest, Gradle, Maven Surefire)
+         */
+        fun parseJUnitXml(text: String): List<CaseResult> {
+            val factory = DocumentBuilderFactory.newInstance()
+            val document = factory.newDocumentBuilder().parse(text.byteInputStream())
+            val nodes = document.getElementsByTagName("testcase")
+            val cases = ArrayList<CaseResult>(nodes.length)
+            for (i in 0 until nodes.length) {
+                val case = nodes.item(i) as Element
+                val className = case.getAttribute("classname")
+                val name = if (className.isEmpty()) case.getAttribute("name") else "$className.${case.getAttribute("name")}"
+                val problem = firstChild(case, "failure") ?: firstChild(case, "error")
+                val skipped = firstChild(case, "skipped")
+                val status = when {
+                    problem != null -> Status.FAILED
+                    skipped != null -> Status.SKIPPED
+                    else -> Status.PASSED
+                }
+                cases.add(
+                    CaseResult(
+                        name = name,
+                        status = status,
+                        message = (problem ?: skipped)?.getAttribute("message")?.takeIf { it.isNotEmpty() },
+                        stackTrace = problem?.textContent?.trim()?.takeIf { it.isNotEmpty() },
+                        file = case.getAttribute("file").takeIf { it.isNotEmpty() },
+                        line = case.getAttribute("line").toIntOrNull(),
+                        durationMs = ((case.getAttribute("time").toDoubleOrNull() ?: 0.0) * 1000).toLong()
+                    )
+                )
+            }
+            return cases
+        }
+
+        private fun firstChild(element: Element, tag: String): Element? {
+            val children = element.getElementsByTagName(tag)
+            return if (children.length > 0) children.item(0) as Element else null
+        }
+
+        /**
+         * Test cases of a Jest `--json` report
+         */
+        fun parseJestJson(text: String): List<CaseResult> {
+            val root = JsonParser.parseString(text).asJsonObject
+            val cases = ArrayList<CaseResult>()
+            for (fileResult in root.getAsJsonArray("testResults") ?: return cases) {
+                val fileObject = fileResult.asJsonObject
+                val file = fileObject.get("name")?.asString
+                val assertions = fileObject.getAsJsonArray("assertionResults")
+                if (assertions == null || assertions.size() == 0) {
+                    // A file that failed to run at all has a message but no assertions
+                    val message = fileObject.get("message")?.asString.orEmpty()
+                    if (fileObject.get("status")?.asString == "failed") {
+                        cases.add(CaseResult(file ?: "unknown", Status.FAILED, message.lineSequence().firstOrNull(), message, file))
+                    }
+                    continue
+                }
+                for (assertion in assertions) {
+                    val result = assertion.asJsonObject
+                    val failures = result.getAsJsonArray("failureMessages")?.map { it.asString }.orEmpty()
+                    cases.add(
+                        CaseResult(
+                            name = result.get("fullName")?.asString ?: result.get("title")?.asString ?: "unknown",
+                            status = when (result.get("status")?.asString) {
+                                "passed" -> Status.PASSED
+                                "failed" -> Status.FAILED
+                                else -> Status.SKIPPED
+                            },
+                            message = failures.firstOrNull()?.lineSequence()?.firstOrNull(),
+                            stackTrace = failures.joinToString("\n").takeIf { it.isNotEmpty() },
+                            file = file,
+                            line = (result.get("location") as? JsonObject)?.get("line")?.asInt,
+                            durationMs = result.get("duration")?.takeIf { !it.isJsonNull }?.asLong ?: 0
+                        )
+                    )
+                }
+            }
+            return cases
+        }
+
+        /**
+         * Test cases of the JUnit XML reports Gradle or Maven wrote under [projectDir] since [since]
+         */
+        fun readJUnitReports(projectDir: File, since: Long): List<CaseResult> {
+            return projectDir.walkTopDown()
+                .onEnter { it == projectDir || (it.name != "node_modules" && !it.name.startsWith(".")) }
+                .filter { file ->
+                    file.isFile && file.name.startsWith("TEST-") && file.name.endsWith(".xml") &&
+                        // Some file systems keep modification times in whole seconds
+                        file.lastModified() >= since - 1000 &&
+                        (file.path.contains("/test-results/") || file.path.contains("/surefire-reports/"))
+                }
+                .flatMap { report ->
+                    try {
+                        parseJUnitXml(report.readText())
+                    } catch (e: Exception) {
+                        emptyList()
+                    }
+                }
+                .toList()
+        }
+
+        private fun shellQuote(value: String): String = "'" + value.replace("'", "'\\''") + "'"
+
+        private fun hex(bytes: ByteArray): String = bytes.joinToString("") { "%02x".format(it) }
+    }
+}
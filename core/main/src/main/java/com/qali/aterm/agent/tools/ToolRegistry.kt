@@ -6,22 +6,27 @@ import com.qali.aterm.agent.core.PropertySchema
 
 /**
  * Registry for managing all available tools
+ * Thread-safe, since MCP tools are registered when their server answers.
  */
 class ToolRegistry {
     private val tools = mutableMapOf<String, DeclarativeTool<*, *>>()
     
+    @Synchronized
     fun registerTool(tool: DeclarativeTool<*, *>) {
         tools[tool.name] = tool
     }
     
+    @Synchronized
     fun getTool(name: String): DeclarativeTool<*, *>? {
         return tools[name]
     }
     
+    @Synchronized
     fun getAllTools(): List<DeclarativeTool<*, *>> {
         return tools.values.toList()
     }
     
+    @Synchronized
     fun getFunctionDeclarations(): List<FunctionDeclaration> {
         return tools.values.map { it.getFunctionDeclaration() }
     }
@@ -3,12 +3,11 @@ package com.qali.aterm.agent.tools
 import com.qali.aterm.agent.core.FunctionDeclaration
 import com.qali.aterm.agent.core.FunctionParameters
 import com.qali.aterm.agent.core.PropertySchema
+import com.qali.aterm.api.HttpClientProvider
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.withContext
-import okhttp3.OkHttpClient
 import okhttp3.Request
 import java.net.URL
-import java.util.concurrent.TimeUnit
 
 data class WebFetchToolParams(
     val prompt: String
@@ -20,10 +19,7 @@ class WebFetchToolInvocation(
     
     override val params: WebFetchToolParams = toolParams
     
-    private val client = OkHttpClient.Builder()
-        .connectTimeout(10, TimeUnit.SECONDS)
-        .readTimeout(10, TimeUnit.SECONDS)
-        .build()
+    private val client = HttpClientProvider.newClient(connectTimeoutSeconds = 10, readTimeoutSeconds = 10)
     
     override fun getDescription(): String {
         val displayPrompt = if (params.prompt.length > 100) {
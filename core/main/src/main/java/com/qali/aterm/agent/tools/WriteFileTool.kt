@@ -95,6 +95,7 @@ class WriteFileToolInvocation(
             
             // Write content
             file.writeText(params.content)
+            com.qali.aterm.agent.utils.WorkspaceChangeTracker.notifyFileChanged(file)
             
             // Real-time error monitoring for file writes
             val fileWriteErrors = com.qali.aterm.agent.utils.ErrorMonitor.monitorFileWrite(
@@ -2,17 +2,29 @@ package com.qali.aterm.agent.utils
 
 import java.io.File
 import android.util.Log
+import com.google.gson.Gson
 import org.json.JSONObject
-import org.json.JSONArray
+import java.util.concurrent.ConcurrentHashMap
 
 /**
- * Agent memory system with summarization
- * Keeps memory under 80 lines and supports search/append
+ * Agent memory system with ranked retrieval
+ *
+ * Entries are appended to a per-workspace log, one JSON entry per line, and kept in an in-process
+ * cache with a [Bm25Index] over their content, category and tags. Searches and prompt context only
+ * take the best few entries, so the number of stored memories does not grow the prompt.
  */
 object AgentMemory {
     
-    private const val MAX_MEMORY_LINES = 80
-    private const val MEMORY_FILE = ".agent_memory.json"
+    /** Entries put into a prompt */
+    private const val MAX_CONTEXT_ENTRIES = 10
+    private const val MAX_SEARCH_RESULTS = 20
+    private const val MEMORY_LOG = ".agent_memory.jsonl"
+    /** Whole-file JSON written by earlier versions, imported once */
+    private const val LEGACY_MEMORY_FILE = ".agent_memory.json"
+    private const val CATEGORY_WEIGHT = 2f
+    private const val TAG_WEIGHT = 2f
+    /** Superseded lines tolerated before the log is rewritten */
+    private const val MIN_COMPACT_LINES = 64
     
     /**
      * Memory entry
@@ -34,31 +46,40 @@ object AgentMemory {
         val totalLines: Int
     )
     
+    /**
+     * Cached memory of one workspace, valid while the log has [length] and [modified]
+     */
+    private class Store(val file: File) {
+        val entries = LinkedHashMap<String, MemoryEntry>()
+        val index = Bm25Index<String>()
+        var length = -1L
+        var modified = -1L
+        var supersededLines = 0
+    }
+    
+    private val gson = Gson()
+    private val stores = ConcurrentHashMap<String, Store>()
+    
     /**
      * Load memory from file
      */
     fun loadMemory(workspaceRoot: String): MemorySummary {
-        val memoryFile = File(workspaceRoot, MEMORY_FILE)
-        if (!memoryFile.exists()) {
-            return MemorySummary(emptyList(), "", 0)
-        }
-        
-        return try {
-            val json = JSONObject(memoryFile.readText())
-            parseMemoryFromJson(json)
-        } catch (e: Exception) {
-            Log.e("AgentMemory", "Failed to load memory: ${e.message}", e)
-            MemorySummary(emptyList(), "", 0)
+        return withStore(workspaceRoot) { store ->
+            val entries = store.entries.values.sortedByDescending { it.timestamp }
+            MemorySummary(entries, buildSummary(entries), entries.sumOf { it.content.lines().size + 2 })
         }
     }
     
     /**
-     * Save memory to file
+     * Replace the stored memory with [summary]
      */
     fun saveMemory(summary: MemorySummary, workspaceRoot: String) {
-        val memoryFile = File(workspaceRoot, MEMORY_FILE)
-        val json = memoryToJson(summary)
-        memoryFile.writeText(json.toString(2))
+        withStore(workspaceRoot) { store ->
+            store.entries.clear()
+            store.index.clear()
+            summary.entries.forEach { put(store, it) }
+            rewrite(store)
+        }
     }
     
     /**
@@ -70,118 +91,132 @@ object AgentMemory {
         tags: List<String> = emptyList(),
         workspaceRoot: String
     ) {
-        val current = loadMemory(workspaceRoot)
-        val newEntry = MemoryEntry(
-            id = "mem_${System.currentTimeMillis()}",
-            timestamp = System.currentTimeMillis(),
-            category = category,
-            content = content,
-            tags = tags
-        )
-        
-        val updatedEntries = (current.entries + newEntry).sortedByDescending { it.timestamp }
-        val summarized = summarizeMemory(updatedEntries)
-        
-        saveMemory(summarized, workspaceRoot)
+        withStore(workspaceRoot) { store ->
+            val now = System.currentTimeMillis()
+            var id = "mem_$now"
+            var suffix = 1
+            while (store.entries.containsKey(id)) id = "mem_${now}_${suffix++}"
+            val newEntry = MemoryEntry(
+                id = id,
+                timestamp = now,
+                category = category,
+                content = content,
+                tags = tags
+            )
+            put(store, newEntry)
+            append(store, newEntry)
+        }
     }
     
     /**
-     * Search memory
+     * Entries most relevant to [query], best first
      */
     fun searchMemory(
         query: String,
-        workspaceRoot: String
+        workspaceRoot: String,
+        limit: Int = MAX_SEARCH_RESULTS
     ): List<MemoryEntry> {
-        val memory = loadMemory(workspaceRoot)
-        val queryLower = query.lowercase()
-        
-        return memory.entries.filter { entry ->
-            entry.content.lowercase().contains(queryLower) ||
-            entry.category.lowercase().contains(queryLower) ||
-            entry.tags.any { it.lowercase().contains(queryLower) }
+        return withStore(workspaceRoot) { store ->
+            store.index.search(query, limit).mapNotNull { store.entries[it.key] }
+        }
+    }
+    
+    private fun <T> withStore(workspaceRoot: String, block: (Store) -> T): T {
+        val store = stores.getOrPut(workspaceRoot) { Store(File(workspaceRoot, MEMORY_LOG)) }
+        synchronized(store) {
+            refresh(store, workspaceRoot)
+            return block(store)
         }
     }
     
     /**
-     * Summarize memory to keep under MAX_MEMORY_LINES
+     * Reload the cache if the log was changed by anyone else, importing the legacy file first
      */
-    private fun summarizeMemory(entries: List<MemoryEntry>): MemorySummary {
-        if (entries.isEmpty()) {
-            return MemorySummary(emptyList(), "", 0)
-        }
-        
-        // Calculate total lines
-        val totalLines = entries.sumOf { entry ->
-            entry.content.lines().size + 2 // +2 for category and tags
-        }
-        
-        // If under limit, return as-is
-        if (totalLines <= MAX_MEMORY_LINES) {
-            val summary = buildSummary(entries)
-            return MemorySummary(entries, summary, totalLines)
+    private fun refresh(store: Store, workspaceRoot: String) {
+        val file = store.file
+        if (!file.exists()) {
+            val legacy = File(workspaceRoot, LEGACY_MEMORY_FILE)
+            store.entries.clear()
+            store.index.clear()
+            store.length = 0
+            store.modified = 0
+            if (legacy.exists()) {
+                try {
+                    parseLegacyMemory(JSONObject(legacy.readText())).forEach { put(store, it) }
+                    rewrite(store)
+                } catch (e: Exception) {
+                    Log.e("AgentMemory", "Failed to import memory: ${e.message}", e)
+                }
+            }
+            return
         }
+        if (file.length() == store.length && file.lastModified() == store.modified) return
         
-        // Need to summarize - keep most recent entries and summarize older ones
-        val recentCount = MAX_MEMORY_LINES / 4 // Keep 25% as recent entries
-        val recentEntries = entries.take(recentCount)
-        val oldEntries = entries.drop(recentCount)
-        
-        // Summarize old entries
-        val summarizedOld = oldEntries.groupBy { it.category }.map { (category, categoryEntries) ->
-            val combinedContent = categoryEntries.joinToString("\n") { it.content }
-            val allTags = categoryEntries.flatMap { it.tags }.distinct()
-            
-            MemoryEntry(
-                id = "summary_${category}_${System.currentTimeMillis()}",
-                timestamp = categoryEntries.maxOfOrNull { it.timestamp } ?: System.currentTimeMillis(),
-                category = category,
-                content = summarizeContent(combinedContent, MAX_MEMORY_LINES / 2),
-                tags = allTags
-            )
+        store.entries.clear()
+        store.index.clear()
+        store.supersededLines = 0
+        try {
+            file.forEachLine { line ->
+                if (line.isBlank()) return@forEachLine
+                // A line cut short by a crash is skipped
+                val entry = try {
+                    gson.fromJson(line, MemoryEntry::class.java)
+                } catch (e: Exception) {
+                    null
+                } ?: return@forEachLine
+                if (put(store, entry)) store.supersededLines++
+            }
+        } catch (e: Exception) {
+            Log.e("AgentMemory", "Failed to load memory: ${e.message}", e)
         }
-        
-        val finalEntries = (recentEntries + summarizedOld).sortedByDescending { it.timestamp }
-        val summary = buildSummary(finalEntries)
-        val finalLines = finalEntries.sumOf { it.content.lines().size + 2 }
-        
-        return MemorySummary(finalEntries, summary, finalLines)
+        store.length = file.length()
+        store.modified = file.lastModified()
+        if (store.supersededLines > maxOf(MIN_COMPACT_LINES, store.entries.size)) rewrite(store)
     }
     
     /**
-     * Summarize content to fit within line limit
+     * Index [entry]; returns whether it replaced an entry with the same id
      */
-    private fun summarizeContent(content: String, maxLines: Int): String {
-        val lines = content.lines()
-        if (lines.size <= maxLines) {
-            return content
-        }
-        
-        // Keep first and last lines, summarize middle
-        val keepFirst = maxLines / 3
-        val keepLast = maxLines / 3
-        val summarizeMiddle = maxLines - keepFirst - keepLast
-        
-        val first = lines.take(keepFirst)
-        val last = lines.takeLast(keepLast)
-        val middle = lines.drop(keepFirst).dropLast(keepLast)
-        
-        val middleSummary = if (middle.isNotEmpty()) {
-            val middleText = middle.joinToString("\n")
-            // Simple summarization: take key sentences
-            val sentences = middleText.split(Regex("[.!?]\\s+"))
-            sentences.take(summarizeMiddle).joinToString(". ") + "."
-        } else {
-            ""
-        }
-        
-        return buildString {
-            appendLine(first.joinToString("\n"))
-            if (middleSummary.isNotEmpty()) {
-                appendLine("... [summarized] ...")
-                appendLine(middleSummary)
+    private fun put(store: Store, entry: MemoryEntry): Boolean {
+        // Gson leaves fields missing from the JSON null, whatever their declared type
+        @Suppress("SENSELESS_COMPARISON")
+        val tags = if (entry.tags == null) emptyList() else entry.tags
+        val normalized = if (tags === entry.tags) entry else entry.copy(tags = tags)
+        val replaced = store.entries.put(normalized.id, normalized) != null
+        store.index.put(
+            normalized.id,
+            listOf(
+                normalized.content to 1f,
+                normalized.category to CATEGORY_WEIGHT,
+                tags.joinToString(" ") to TAG_WEIGHT
+            )
+        )
+        return replaced
+    }
+    
+    private fun append(store: Store, entry: MemoryEntry) {
+        val file = store.file
+        file.appendText(gson.toJson(entry) + "\n")
+        store.length = file.length()
+        store.modified = file.lastModified()
+    }
+    
+    private fun rewrite(store: Store) {
+        val file = store.file
+        val temp = File(file.path + ".tmp")
+        temp.bufferedWriter().use { writer ->
+            for (entry in store.entries.values) {
+                writer.write(gson.toJson(entry))
+                writer.write("\n")
             }
-            appendLine(last.joinToString("\n"))
         }
+        if (!temp.renameTo(file)) {
+            temp.delete()
+            return
+        }
+        store.supersededLines = 0
+        store.length = file.length()
+        store.modified = file.lastModified()
     }
     
     /**
@@ -200,42 +235,9 @@ object AgentMemory {
     }
     
     /**
-     * Convert memory to JSON
-     */
-    private fun memoryToJson(summary: MemorySummary): JSONObject {
-        val json = JSONObject()
-        json.put("summary", summary.summary)
-        json.put("totalLines", summary.totalLines)
-        
-        val entriesArray = JSONArray()
-        summary.entries.forEach { entry ->
-            entriesArray.put(entryToJson(entry))
-        }
-        json.put("entries", entriesArray)
-        
-        return json
-    }
-    
-    /**
-     * Convert entry to JSON
-     */
-    private fun entryToJson(entry: MemoryEntry): JSONObject {
-        val json = JSONObject()
-        json.put("id", entry.id)
-        json.put("timestamp", entry.timestamp)
-        json.put("category", entry.category)
-        json.put("content", entry.content)
-        json.put("tags", JSONArray(entry.tags))
-        return json
-    }
-    
-    /**
-     * Parse memory from JSON
+     * Parse memory from the legacy JSON file
      */
-    private fun parseMemoryFromJson(json: JSONObject): MemorySummary {
-        val summary = json.optString("summary", "")
-        val totalLines = json.optInt("totalLines", 0)
-        
+    private fun parseLegacyMemory(json: JSONObject): List<MemoryEntry> {
         val entriesArray = json.getJSONArray("entries")
         val entries = mutableListOf<MemoryEntry>()
         
@@ -256,15 +258,16 @@ object AgentMemory {
             ))
         }
         
-        return MemorySummary(entries, summary, totalLines)
+        return entries
     }
     
     /**
-     * Get memory for context (formatted for AI)
+     * Get memory for context (formatted for AI). With a [query], only the entries ranking highest
+     * for it are included; otherwise the most recent ones.
      */
     fun getMemoryForContext(workspaceRoot: String, query: String? = null): String {
         val memory = if (query != null) {
-            val searchResults = searchMemory(query, workspaceRoot)
+            val searchResults = searchMemory(query, workspaceRoot, MAX_CONTEXT_ENTRIES)
             MemorySummary(searchResults, "", searchResults.sumOf { it.content.lines().size + 2 })
         } else {
             loadMemory(workspaceRoot)
@@ -278,7 +281,7 @@ object AgentMemory {
             appendLine("## Agent Memory")
             appendLine(memory.summary)
             appendLine()
-            memory.entries.take(10).forEach { entry ->
+            memory.entries.take(MAX_CONTEXT_ENTRIES).forEach { entry ->
                 appendLine("### ${entry.category}")
                 appendLine(entry.content.take(200)) // Limit each entry
                 if (entry.tags.isNotEmpty()) {
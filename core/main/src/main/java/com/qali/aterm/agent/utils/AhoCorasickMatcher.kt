@@ -0,0 +1,105 @@
+package com.qali.aterm.agent.utils
+
+import java.util.BitSet
+
+/**
+ * Aho-Corasick automaton finding any of a set of ASCII keywords in one pass over the text
+ *
+ * The goto and failure functions are folded into a dense transition table, so each input
+ * character costs one array lookup no matter how many keywords there are. Characters outside
+ * ASCII cannot be part of a keyword and reset the automaton to its start state.
+ */
+class AhoCorasickMatcher(keywords: List<String>, private val ignoreCase: Boolean = false) {
+
+    /** `transitions[state * ALPHABET + c]` */
+    private val transitions: IntArray
+
+    /** Keyword indexes ending at each state, including those reached through failure links */
+    private val outputs: Array<IntArray>
+
+    init {
+        val trie = ArrayList<IntArray>()
+        val ownOutputs = ArrayList<MutableList<Int>>()
+        fun newState(): Int {
+            trie.add(IntArray(ALPHABET) { -1 })
+            ownOutputs.add(ArrayList(1))
+            return trie.size - 1
+        }
+        newState()
+
+        keywords.forEachIndexed { index, keyword ->
+            require(keyword.isNotEmpty()) { "Empty keyword" }
+            var state = 0
+            for (ch in keyword) {
+                require(ch.code < ALPHABET) { "Keyword is not ASCII: $keyword" }
+                val c = fold(ch.code)
+                if (trie[state][c] < 0) trie[state][c] = newState()
+                state = trie[state][c]
+            }
+            ownOutputs[state].add(index)
+        }
+
+        // Breadth-first, so the failure target of a state is always complete before the state
+        val stateCount = trie.size
+        val table = IntArray(stateCount * ALPHABET)
+        val failure = IntArray(stateCount)
+        val merged = arrayOfNulls<IntArray>(stateCount)
+        merged[0] = ownOutputs[0].toIntArray()
+        val queue = ArrayDeque<Int>()
+        for (c in 0 until ALPHABET) {
+            val child = trie[0][c]
+            table[c] = if (child < 0) 0 else child
+            if (child > 0) {
+                failure[child] = 0
+                queue.addLast(child)
+            }
+        }
+        while (queue.isNotEmpty()) {
+            val state = queue.removeFirst()
+            merged[state] = (ownOutputs[state] + merged[failure[state]]!!.toList()).distinct().toIntArray()
+            for (c in 0 until ALPHABET) {
+                val child = trie[state][c]
+                val fallback = table[failure[state] * ALPHABET + c]
+                if (child < 0) {
+                    table[state * ALPHABET + c] = fallback
+                } else {
+                    table[state * ALPHABET + c] = child
+                    failure[child] = fallback
+                    queue.addLast(child)
+                }
+            }
+        }
+        transitions = table
+        outputs = Array(stateCount) { merged[it]!! }
+    }
+
+    /**
+     * Set the bit of every keyword occurring in `text[start, end)` in [into]. Returns whether any did.
+     */
+    fun findKeywords(text: CharSequence, start: Int = 0, end: Int = text.length, into: BitSet): Boolean {
+        var state = 0
+        var found = false
+        for (i in start until end) {
+            state = step(state, text[i])
+            val matched = outputs[state]
+            if (matched.isNotEmpty()) {
+                for (keyword in matched) into.set(keyword)
+                found = true
+            }
+        }
+        return found
+    }
+
+    private fun step(state: Int, ch: Char): Int {
+        val code = ch.code
+        return if (code < ALPHABET) transitions[state * ALPHABET + fold(code)] else 0
+    }
+
+    private fun fold(c: Int): Int {
+        return if (ignoreCase && c in 'A'.code..'Z'.code) c + ('a' - 'A') else c
+    }
+
+    companion object {
+        private const val ALPHABET = 128
+    }
+}
@@ -2,6 +2,7 @@ package com.qali.aterm.agent.utils
 
 import android.util.Log
 import java.io.File
+import java.util.concurrent.ConcurrentHashMap
 
 /**
  * Manages .atermignore file for excluding files and directories from agent scanning
@@ -9,7 +10,10 @@ import java.io.File
  */
 object AtermIgnoreManager {
     
-    private const val ATERM_IGNORE_FILE = ".atermignore"
+    const val ATERM_IGNORE_FILE = ".atermignore"
+    
+    private val patternCache = ConcurrentHashMap<String, Pair<Long, List<String>>>()
+    private val wildcardRegexes = ConcurrentHashMap<String, Regex>()
     
     /**
      * Default ignore patterns for aTerm
@@ -84,7 +88,14 @@ object AtermIgnoreManager {
      * @return true if the path should be ignored
      */
     fun shouldIgnore(filePath: String, workspaceRoot: String): Boolean {
-        val ignorePatterns = loadIgnorePatterns(workspaceRoot)
+        return shouldIgnore(filePath, cachedIgnorePatterns(workspaceRoot))
+    }
+    
+    /**
+     * Check a relative path against patterns from [loadIgnorePatterns], for callers that check
+     * many paths and load the patterns once
+     */
+    fun shouldIgnore(filePath: String, ignorePatterns: List<String>): Boolean {
         val normalizedPath = filePath.replace("\\", "/")
         
         // Check against all patterns
@@ -106,6 +117,16 @@ object AtermIgnoreManager {
         return shouldIgnore(relativePath, workspaceRoot)
     }
     
+    /**
+     * Patterns for [workspaceRoot], re-read only when .atermignore changes
+     */
+    private fun cachedIgnorePatterns(workspaceRoot: String): List<String> {
+        // lastModified() is 0 when the file does not exist
+        val modified = File(workspaceRoot, ATERM_IGNORE_FILE).lastModified()
+        patternCache[workspaceRoot]?.takeIf { it.first == modified }?.let { return it.second }
+        return loadIgnorePatterns(workspaceRoot).also { patternCache[workspaceRoot] = modified to it }
+    }
+    
     /**
      * Load ignore patterns from .atermignore file and merge with defaults
      */
@@ -148,12 +169,14 @@ object AtermIgnoreManager {
         
         // Handle wildcards
         if (normalizedPattern.contains("*")) {
-            val regex = normalizedPattern
-                .replace(".", "\\.")
-                .replace("**", "___DOUBLE_STAR___")
-                .replace("*", "[^/]*")
-                .replace("___DOUBLE_STAR___", ".*")
-                .toRegex()
+            val regex = wildcardRegexes.getOrPut(normalizedPattern) {
+                normalizedPattern
+                    .replace(".", "\\.")
+                    .replace("**", "___DOUBLE_STAR___")
+                    .replace("*", "[^/]*")
+                    .replace("___DOUBLE_STAR___", ".*")
+                    .toRegex()
+            }
             
             // Check if pattern matches path or any segment
             if (regex.matches(path)) return true
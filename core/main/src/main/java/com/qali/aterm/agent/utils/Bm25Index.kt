@@ -0,0 +1,127 @@
+package com.qali.aterm.agent.utils
+
+import java.util.PriorityQueue
+import kotlin.math.ln
+
+/**
+ * Inverted index ranking documents against a query with Okapi BM25
+ *
+ * A document is a set of weighted text fields; a term in a field of weight 2 counts as if it
+ * occurred twice, which is how tags can outrank body text. Queries only touch the posting lists
+ * of their own terms and keep the best [search] results in a bounded heap, so their cost depends
+ * on how common the query terms are rather than on the number of documents. Not thread-safe.
+ */
+class Bm25Index<K : Any> {
+
+    /** A ranked document */
+    data class Scored<K>(val key: K, val score: Double)
+
+    private class Document<K>(val key: K, val terms: Map<String, Float>, val length: Float)
+
+    private val slots = ArrayList<Document<K>?>()
+    private val slotOf = HashMap<K, Int>()
+    private val freeSlots = ArrayDeque<Int>()
+    private val postings = HashMap<String, HashMap<Int, Float>>()
+    private var totalLength = 0.0
+
+    val size: Int
+        get() = slotOf.size
+
+    /**
+     * Index [fields] (text and weight) as the document [key], replacing an earlier version
+     */
+    fun put(key: K, fields: List<Pair<String, Float>>) {
+        remove(key)
+        val terms = HashMap<String, Float>()
+        var length = 0f
+        for ((text, weight) in fields) {
+            for (term in tokenize(text)) {
+                terms[term] = (terms[term] ?: 0f) + weight
+                length += weight
+            }
+        }
+        val slot = freeSlots.removeFirstOrNull() ?: slots.size.also { slots.add(null) }
+        slots[slot] = Document(key, terms, length)
+        slotOf[key] = slot
+        for ((term, frequency) in terms) postings.getOrPut(term) { HashMap() }[slot] = frequency
+        totalLength += length
+    }
+
+    fun remove(key: K) {
+        val slot = slotOf.remove(key) ?: return
+        val document = slots[slot]!!
+        for (term in document.terms.keys) {
+            val posting = postings[term] ?: continue
+            posting.remove(slot)
+            if (posting.isEmpty()) postings.remove(term)
+        }
+        totalLength -= document.length
+        slots[slot] = null
+        freeSlots.addLast(slot)
+    }
+
+    fun clear() {
+        slots.clear()
+        slotOf.clear()
+        freeSlots.clear()
+        postings.clear()
+        totalLength = 0.0
+    }
+
+    /**
+     * The [limit] documents scoring highest for [query], best first. Documents sharing no term
+     * with the query are never returned.
+     */
+    fun search(query: String, limit: Int): List<Scored<K>> {
+        if (limit <= 0 || slotOf.isEmpty()) return emptyList()
+        val documentCount = slotOf.size
+        val averageLength = (totalLength / documentCount).coerceAtLeast(1.0)
+        val scores = HashMap<Int, Double>()
+        for (term in tokenize(query).distinct()) {
+            val posting = postings[term] ?: continue
+            val idf = ln(1.0 + (documentCount - posting.size + 0.5) / (posting.size + 0.5))
+            for ((slot, frequency) in posting) {
+                val length = slots[slot]!!.length
+                val norm = frequency * (K1 + 1) / (frequency + K1 * (1 - B + B * length / averageLength))
+                scores[slot] = (scores[slot] ?: 0.0) + idf * norm
+            }
+        }
+
+        // Min-heap of the best so far; equal scores are ordered by slot so results are stable
+        val best = PriorityQueue<Map.Entry<Int, Double>>(minOf(limit, scores.size) + 1, compareBy<Map.Entry<Int, Double>> { it.value }.thenByDescending { it.key })
+        for (entry in scores.entries) {
+            best.add(entry)
+            if (best.size > limit) best.poll()
+        }
+        val results = ArrayList<Scored<K>>(best.size)
+        while (best.isNotEmpty()) {
+            val entry = best.poll()!!
+            results.add(Scored(slots[entry.key]!!.key, entry.value))
+        }
+        results.reverse()
+        return results
+    }
+
+    companion object {
+        private const val K1 = 1.2
+        private const val B = 0.75
+
+        /**
+         * Lower-cased runs of letters and digits; single characters are too common to rank by
+         */
+        fun tokenize(text: String): List<String> {
+            val tokens = ArrayList<String>()
+            var start = -1
+            for (i in 0..text.length) {
+                val isWord = i < text.length && text[i].isLetterOrDigit()
+                if (isWord && start < 0) {
+                    start = i
+                } else if (!isWord && start >= 0) {
+                    if (i - start > 1) tokens.add(text.substring(start, i).lowercase())
+                    start = -1
+                }
+            }
+            return tokens
+        }
+    }
+}
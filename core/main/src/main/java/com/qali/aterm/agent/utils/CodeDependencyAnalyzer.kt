@@ -23,6 +23,22 @@ object CodeDependencyAnalyzer {
         val dependencies: Map<String, Set<String>> = emptyMap() // file -> set of files it depends on
     )
     
+    // Compiled once; the analyzers below run them on every line of every file
+    private val jsImportFrom = Regex("import\\s+.*?\\s+from\\s+['\"]([^'\"]+)['\"]")
+    private val jsRequire = Regex("require\\(['\"]([^'\"]+)['\"]\\)")
+    private val jsExport = Regex("export\\s+(?:default\\s+)?(?:function|class|const|let|var)?\\s*([a-zA-Z_$][a-zA-Z0-9_$]*)")
+    private val jsModuleExports = Regex("(?:module\\.)?exports\\.?([a-zA-Z_$][a-zA-Z0-9_$]*)")
+    private val jsFunction = Regex("(?:export\\s+)?(?:async\\s+)?function\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)")
+    private val jsArrowFunction = Regex("(?:export\\s+)?const\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)\\s*=\\s*(?:async\\s+)?\\(|=>")
+    private val jsClass = Regex("(?:export\\s+)?class\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)")
+    private val pyImport = Regex("import\\s+([a-zA-Z0-9_.]+)")
+    private val pyFromImport = Regex("from\\s+([a-zA-Z0-9_.]+)\\s+import")
+    private val pyFunction = Regex("def\\s+([a-zA-Z_][a-zA-Z0-9_]*)")
+    private val pyClass = Regex("class\\s+([a-zA-Z_][a-zA-Z0-9_]*)")
+    private val jvmImport = Regex("import\\s+(?:static\\s+)?([a-zA-Z0-9_.*]+)")
+    private val jvmClass = Regex("(?:public\\s+)?(?:abstract\\s+)?(?:final\\s+)?(?:class|interface|enum)\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)")
+    private val jvmFunction = Regex("(?:public|private|protected)?\\s*(?:static\\s+)?(?:fun\\s+)?([a-zA-Z_$][a-zA-Z0-9_$]*)\\s*\\(")
+    
     private val dependencyMatrix = mutableMapOf<String, DependencyMatrix>()
     private val workspaceMatrices = mutableMapOf<String, MutableMap<String, CodeMetadata>>()
     
@@ -154,15 +170,15 @@ object CodeDependencyAnalyzer {
             // Extract imports: import ... from '...' or require('...')
             when {
                 trimmed.startsWith("import ") && "'" in trimmed -> {
-                    val match = Regex("import\\s+.*?\\s+from\\s+['\"]([^'\"]+)['\"]").find(trimmed)
+                    val match = jsImportFrom.find(trimmed)
                     match?.groupValues?.get(1)?.let { imports.add(it) }
                 }
                 trimmed.startsWith("import ") && trimmed.contains("require") -> {
-                    val match = Regex("require\\(['\"]([^'\"]+)['\"]\\)").find(trimmed)
+                    val match = jsRequire.find(trimmed)
                     match?.groupValues?.get(1)?.let { imports.add(it) }
                 }
                 trimmed.contains("require(") -> {
-                    val match = Regex("require\\(['\"]([^'\"]+)['\"]\\)").find(trimmed)
+                    val match = jsRequire.find(trimmed)
                     match?.groupValues?.get(1)?.let { imports.add(it) }
                 }
             }
@@ -170,21 +186,21 @@ object CodeDependencyAnalyzer {
             // Extract exports: export ... or module.exports
             when {
                 trimmed.startsWith("export ") -> {
-                    val match = Regex("export\\s+(?:default\\s+)?(?:function|class|const|let|var)?\\s*([a-zA-Z_$][a-zA-Z0-9_$]*)").find(trimmed)
+                    val match = jsExport.find(trimmed)
                     match?.groupValues?.get(1)?.let { exports.add(it) }
                 }
                 trimmed.contains("module.exports") || trimmed.contains("exports.") -> {
-                    val match = Regex("(?:module\\.)?exports\\.?([a-zA-Z_$][a-zA-Z0-9_$]*)").find(trimmed)
+                    val match = jsModuleExports.find(trimmed)
                     match?.groupValues?.get(1)?.let { if (it.isNotEmpty()) exports.add(it) else exports.add("default") }
                 }
             }
             
             // Extract function declarations
-            Regex("(?:export\\s+)?(?:async\\s+)?function\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)").find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
-            Regex("(?:export\\s+)?const\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)\\s*=\\s*(?:async\\s+)?\\(|=>").find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
+            jsFunction.find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
+            jsArrowFunction.find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
             
             // Extract class declarations
-            Regex("(?:export\\s+)?class\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)").find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
+            jsClass.find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
         }
         
         return CodeMetadata(
@@ -211,20 +227,20 @@ object CodeDependencyAnalyzer {
             // Extract imports: import ... or from ... import ...
             when {
                 trimmed.startsWith("import ") -> {
-                    val match = Regex("import\\s+([a-zA-Z0-9_.]+)").find(trimmed)
+                    val match = pyImport.find(trimmed)
                     match?.groupValues?.get(1)?.let { imports.add(it) }
                 }
                 trimmed.startsWith("from ") -> {
-                    val match = Regex("from\\s+([a-zA-Z0-9_.]+)\\s+import").find(trimmed)
+                    val match = pyFromImport.find(trimmed)
                     match?.groupValues?.get(1)?.let { imports.add(it) }
                 }
             }
             
             // Extract function definitions
-            Regex("def\\s+([a-zA-Z_][a-zA-Z0-9_]*)").find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
+            pyFunction.find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
             
             // Extract class definitions
-            Regex("class\\s+([a-zA-Z_][a-zA-Z0-9_]*)").find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
+            pyClass.find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
         }
         
         // Python exports are typically __all__ or what's imported from the module
@@ -252,13 +268,13 @@ object CodeDependencyAnalyzer {
             val trimmed = line.trim()
             
             // Extract imports
-            Regex("import\\s+(?:static\\s+)?([a-zA-Z0-9_.*]+)").find(trimmed)?.groupValues?.get(1)?.let { imports.add(it) }
+            jvmImport.find(trimmed)?.groupValues?.get(1)?.let { imports.add(it) }
             
             // Extract class/interface declarations
-            Regex("(?:public\\s+)?(?:abstract\\s+)?(?:final\\s+)?(?:class|interface|enum)\\s+([a-zA-Z_$][a-zA-Z0-9_$]*)").find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
+            jvmClass.find(trimmed)?.groupValues?.get(1)?.let { classes.add(it) }
             
             // Extract function/method declarations
-            Regex("(?:public|private|protected)?\\s*(?:static\\s+)?(?:fun\\s+)?([a-zA-Z_$][a-zA-Z0-9_$]*)\\s*\\(").find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
+            jvmFunction.find(trimmed)?.groupValues?.get(1)?.let { functions.add(it) }
         }
         
         return CodeMetadata(
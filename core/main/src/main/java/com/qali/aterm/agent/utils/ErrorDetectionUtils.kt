@@ -37,52 +37,45 @@ object ErrorDetectionUtils {
         val detectedLanguage = ErrorPatternLibrary.detectLanguage("", errorMessage)
         val languagePatterns = ErrorPatternLibrary.getPatternsForLanguage(detectedLanguage)
         
-        // Also try generic patterns as fallback
-        val genericPatterns = ErrorPatternLibrary.getPatternsForLanguage("generic")
+        // Language-specific patterns first, then generic ones as fallback, in one pass over the message
+        val signatures = ErrorPatternLibrary.signatures(listOf(detectedLanguage, "generic"))
+        val matches = ErrorLogScanner.scan(errorMessage, signatures).sortedBy { it.signatureIndex }
         
-        // Try all patterns (language-specific first, then generic)
-        val allPatterns = languagePatterns.patterns + genericPatterns.patterns
+        // The error type and severity describe the whole message, not a single location
+        val errorType = matches.firstOrNull {
+            it.signature.kind == ErrorSignatureSet.Kind.ERROR_TYPE && it.signature.language == languagePatterns.language
+        }?.signature?.name
+        val severity by lazy {
+            ErrorSeverityClassifier.classifySeverity(
+                errorMessage = errorMessage,
+                errorType = errorType,
+                stackTraceDepth = null,
+                affectedFileCount = null
+            )
+        }
         
-        for (pattern in allPatterns) {
-            val matcher = pattern.matcher(errorMessage)
-            while (matcher.find()) {
-                try {
-                    val filePath = matcher.group(1)?.trim() ?: continue
-                    val lineNum = matcher.group(2)?.toIntOrNull()
-                    val colNum = matcher.group(3)?.toIntOrNull()
-                    val funcName = if (matcher.groupCount() >= 4) matcher.group(4) else null
-                    
-                    // Resolve relative paths
-                    val resolvedPath = resolveFilePath(filePath, workspaceRoot)
-                    if (resolvedPath != null) {
-                        // Detect error type from language-specific patterns
-                        var errorType: String? = null
-                        for ((type, pattern) in languagePatterns.errorTypePatterns) {
-                            if (pattern.matcher(errorMessage).find()) {
-                                errorType = type
-                                break
-                            }
-                        }
-                        
-                        // Classify severity based on error message and type
-                        val severity = ErrorSeverityClassifier.classifySeverity(
-                            errorMessage = errorMessage,
-                            errorType = errorType,
-                            stackTraceDepth = null,
-                            affectedFileCount = null
-                        )
-                        
-                        locations.add(ErrorLocation(
-                            filePath = resolvedPath,
-                            lineNumber = lineNum,
-                            columnNumber = colNum,
-                            functionName = funcName,
-                            severity = severity
-                        ))
-                    }
-                } catch (e: Exception) {
-                    Log.w("ErrorDetectionUtils", "Failed to parse error location: ${e.message}")
+        for (match in matches) {
+            if (match.signature.kind != ErrorSignatureSet.Kind.LOCATION) continue
+            val matcher = match.result
+            try {
+                val filePath = matcher.group(1)?.trim() ?: continue
+                val lineNum = matcher.group(2)?.toIntOrNull()
+                val colNum = matcher.group(3)?.toIntOrNull()
+                val funcName = if (matcher.groupCount() >= 4) matcher.group(4) else null
+                
+                // Resolve relative paths
+                val resolvedPath = resolveFilePath(filePath, workspaceRoot)
+                if (resolvedPath != null) {
+                    locations.add(ErrorLocation(
+                        filePath = resolvedPath,
+                        lineNumber = lineNum,
+                        columnNumber = colNum,
+                        functionName = funcName,
+                        severity = severity
+                    ))
                 }
+            } catch (e: Exception) {
+                Log.w("ErrorDetectionUtils", "Failed to parse error location: ${e.message}")
             }
         }
         
@@ -0,0 +1,247 @@
+package com.qali.aterm.agent.utils
+
+import java.io.Reader
+import java.nio.CharBuffer
+import java.util.BitSet
+import java.util.regex.MatchResult
+import java.util.regex.Pattern
+
+/**
+ * A compiled set of error signatures with a shared literal prefilter
+ *
+ * The longest literal each signature regex requires is put into one [AhoCorasickMatcher]
+ * (case-insensitively, so it only ever finds too much), and a line is only handed to the regexes
+ * whose literal occurs in it. Signatures without a usable literal run on every line. Obtain sets
+ * through [ErrorPatternLibrary.signatures], which compiles each one once.
+ *
+ * Signatures compiled with [Pattern.DOTALL] span lines, such as a rustc error and the `-->` line
+ * below it. They are prefiltered on the line they start on, so their literal must be found there.
+ */
+class ErrorSignatureSet(val signatures: List<Signature>) {
+
+    enum class Kind { LOCATION, ERROR_TYPE }
+
+    /**
+     * A signature regex of [language]. [name] is the error type for [Kind.ERROR_TYPE] signatures.
+     */
+    data class Signature(
+        val language: String,
+        val kind: Kind,
+        val name: String,
+        val pattern: Pattern
+    ) {
+        val multiLine: Boolean get() = (pattern.flags() and Pattern.DOTALL) != 0
+    }
+
+    private val matcher: AhoCorasickMatcher
+    private val keywordSignatures: Array<IntArray>
+    private val unfiltered: IntArray
+
+    init {
+        val keywords = LinkedHashMap<String, MutableList<Int>>()
+        val always = ArrayList<Int>()
+        signatures.forEachIndexed { index, signature ->
+            val literal = NativeFileSearch.requiredLiteral(signature.pattern.pattern())
+                ?.lowercase()
+                ?.takeIf { literal -> literal.all { it.code < 0x80 } }
+            if (literal == null) always.add(index) else keywords.getOrPut(literal) { ArrayList() }.add(index)
+        }
+        matcher = AhoCorasickMatcher(keywords.keys.toList(), ignoreCase = true)
+        keywordSignatures = keywords.values.map { it.toIntArray() }.toTypedArray()
+        unfiltered = always.toIntArray()
+    }
+
+    /**
+     * Set the index of every signature that may match `text[start, end)` in [into]. [keywords] is
+     * scratch space, so callers scanning many lines can reuse it.
+     */
+    fun candidates(text: CharSequence, start: Int, end: Int, keywords: BitSet, into: BitSet) {
+        keywords.clear()
+        if (matcher.findKeywords(text, start, end, keywords)) {
+            var keyword = keywords.nextSetBit(0)
+            while (keyword >= 0) {
+                for (signature in keywordSignatures[keyword]) into.set(signature)
+                keyword = keywords.nextSetBit(keyword + 1)
+            }
+        }
+        for (signature in unfiltered) into.set(signature)
+    }
+}
+
+/**
+ * Streams text through an [ErrorSignatureSet] line by line
+ *
+ * Text can be fed in chunks of any size as it is produced; only an unfinished last line is kept
+ * between chunks, so a build log is never held in memory as a whole. Lines no signature literal
+ * occurs in are not copied at all.
+ *
+ * Single-line signatures are matched against each line and reported in line order. A multi-line
+ * signature whose literal occurs in a line is matched against a window of that line and the ones
+ * after it, at most [WINDOW_LINES] lines or [WINDOW_CHARS] characters, and reported once the
+ * window is complete. Only matches starting on the first line of the window count.
+ */
+class ErrorLogScanner(
+    private val signatures: ErrorSignatureSet,
+    private val onMatch: (Match) -> Unit
+) {
+    /**
+     * A match of [signature] in [line], the [lineNumber]th line (1-based) which starts at
+     * [lineOffset] characters into the stream. For a multi-line signature [line] is the window
+     * the match was found in, its lines joined with `\n`.
+     */
+    class Match(
+        val signatureIndex: Int,
+        val signature: ErrorSignatureSet.Signature,
+        val lineNumber: Int,
+        val lineOffset: Long,
+        val line: String,
+        val result: MatchResult
+    )
+
+    private val partial = StringBuilder()
+    private var partialLength = 0L
+    private val keywords = BitSet()
+    private val candidates = BitSet()
+    private var lineNumber = 0
+    private var lineOffset = 0L
+
+    /** The text following a line on which a multi-line signature may start */
+    private class Window(
+        val signatureIndex: Int,
+        val lineNumber: Int,
+        val lineOffset: Long,
+        val firstLineLength: Int,
+        val text: StringBuilder
+    ) {
+        var lines = 1
+    }
+
+    private val windows = ArrayList<Window>()
+
+    fun feed(chunk: CharSequence) {
+        var start = 0
+        while (start < chunk.length) {
+            val newline = chunk.indexOf('\n', start)
+            if (newline < 0) {
+                appendPartial(chunk, start, chunk.length)
+                return
+            }
+            if (partialLength == 0L) {
+                scanLine(chunk, start, newline, (newline - start).toLong())
+            } else {
+                appendPartial(chunk, start, newline)
+                scanLine(partial, 0, partial.length, partialLength)
+                partial.setLength(0)
+                partialLength = 0
+            }
+            start = newline + 1
+        }
+    }
+
+    /**
+     * Scan the last line if the text did not end with a line break
+     */
+    fun finish() {
+        if (partialLength > 0) {
+            scanLine(partial, 0, partial.length, partialLength)
+            partial.setLength(0)
+            partialLength = 0
+        }
+        windows.forEach { matchWindow(it) }
+        windows.clear()
+    }
+
+    /**
+     * Feed everything [reader] produces, then [finish]
+     */
+    fun scan(reader: Reader) {
+        val buffer = CharArray(CHUNK_SIZE)
+        while (true) {
+            val read = reader.read(buffer)
+            if (read < 0) break
+            feed(CharBuffer.wrap(buffer, 0, read))
+        }
+        finish()
+    }
+
+    private fun appendPartial(text: CharSequence, start: Int, end: Int) {
+        // Overlong lines are only scanned up to the limit but still counted in full
+        val room = (MAX_LINE_LENGTH - partial.length).coerceAtLeast(0)
+        partial.append(text, start, start + minOf(room, end - start))
+        partialLength += end - start
+    }
+
+    private fun scanLine(text: CharSequence, start: Int, rawEnd: Int, length: Long) {
+        lineNumber++
+        var end = rawEnd
+        if (end > start && text[end - 1] == '\r') end--
+
+        if (windows.isNotEmpty()) extendWindows(text, start, end)
+
+        candidates.clear()
+        signatures.candidates(text, start, end, keywords, candidates)
+        var line: String? = null
+        var index = candidates.nextSetBit(0)
+        while (index >= 0) {
+            val signature = signatures.signatures[index]
+            val lineText = line ?: text.substring(start, end)
+            line = lineText
+            if (signature.multiLine) {
+                windows.add(Window(index, lineNumber, lineOffset, lineText.length, StringBuilder(lineText)))
+            } else {
+                val matcher = signature.pattern.matcher(lineText)
+                while (matcher.find()) {
+                    onMatch(Match(index, signature, lineNumber, lineOffset, lineText, matcher.toMatchResult()))
+                }
+            }
+            index = candidates.nextSetBit(index + 1)
+        }
+        lineOffset += length + 1
+    }
+
+    private fun extendWindows(text: CharSequence, start: Int, end: Int) {
+        val iterator = windows.iterator()
+        while (iterator.hasNext()) {
+            val window = iterator.next()
+            val limit = window.firstLineLength + WINDOW_CHARS
+            window.text.append('\n').append(text, start, start + minOf(end - start, limit - window.text.length - 1))
+            window.lines++
+            if (window.lines >= WINDOW_LINES || window.text.length >= limit) {
+                matchWindow(window)
+                iterator.remove()
+            }
+        }
+    }
+
+    private fun matchWindow(window: Window) {
+        val signature = signatures.signatures[window.signatureIndex]
+        val text = window.text.toString()
+        val matcher = signature.pattern.matcher(text)
+        while (matcher.find() && matcher.start() < window.firstLineLength) {
+            onMatch(Match(window.signatureIndex, signature, window.lineNumber, window.lineOffset, text, matcher.toMatchResult()))
+        }
+    }
+
+    companion object {
+        private const val CHUNK_SIZE = 64 * 1024
+        private const val MAX_LINE_LENGTH = 64 * 1024
+
+        /** Lines, the first included, a multi-line signature is matched against */
+        const val WINDOW_LINES = 20
+
+        /** Characters after the first line a multi-line signature is matched against */
+        const val WINDOW_CHARS = 4096
+
+        /**
+         * All matches of [signatures] in [text], in the order the scanner reports them
+         */
+        fun scan(text: CharSequence, signatures: ErrorSignatureSet): List<Match> {
+            val matches = ArrayList<Match>()
+            ErrorLogScanner(signatures) { matches.add(it) }.apply {
+                feed(text)
+                finish()
+            }
+            return matches
+        }
+    }
+}
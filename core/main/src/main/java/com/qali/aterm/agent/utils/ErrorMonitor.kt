@@ -33,6 +33,9 @@ object ErrorMonitor {
     private val errorBuffer = ConcurrentLinkedQueue<String>()
     private val maxBufferSize = 50 // Max lines in buffer
     
+    private val contextErrorPattern = java.util.regex.Pattern.compile("""(?:error|Error|ERROR|exception|Exception):\s*(.+?)(?:\n|$)""", 
+        java.util.regex.Pattern.CASE_INSENSITIVE)
+    
     /**
      * Detected errors
      */
@@ -134,45 +137,43 @@ object ErrorMonitor {
         
         // Detect language from output
         val language = ErrorPatternLibrary.detectLanguage("", output)
-        val patterns = ErrorPatternLibrary.getPatternsForLanguage(language)
+        val signatures = ErrorPatternLibrary.signatures(listOf(language), ErrorSignatureSet.Kind.LOCATION)
         
-        // Try all patterns
-        patterns.patterns.forEach { pattern ->
-            val matcher = pattern.matcher(output)
-            while (matcher.find()) {
-                try {
-                    val filePath = matcher.group(1)?.trim()
-                    val lineNum = matcher.group(2)?.toIntOrNull()
-                    val colNum = if (matcher.groupCount() >= 3) matcher.group(3)?.toIntOrNull() else null
-                    
-                    // Extract error message from context
-                    val errorMessage = extractErrorMessageFromContext(output, matcher.start())
-                    
-                    // Classify severity
-                    val severity = ErrorSeverityClassifier.classifySeverity(errorMessage)
-                    
-                    // Resolve file path
-                    val resolvedPath = filePath?.let { 
-                        resolveFilePath(it, workspaceRoot) 
-                    }
-                    
-                    val errorId = "error_${System.currentTimeMillis()}_${errors.size}"
-                    
-                    errors.add(
-                        ErrorEvent(
-                            errorId = errorId,
-                            errorMessage = errorMessage,
-                            source = source,
-                            severity = severity,
-                            filePath = resolvedPath,
-                            lineNumber = lineNum,
-                            rawOutput = output.substring(matcher.start().coerceAtLeast(0), 
-                                matcher.end().coerceAtMost(output.length))
-                        )
-                    )
-                } catch (e: Exception) {
-                    Log.w("ErrorMonitor", "Failed to parse error from output: ${e.message}")
+        // One pass over the output; each line only runs the patterns whose literal it contains
+        val matches = ErrorLogScanner.scan(output, signatures).sortedBy { it.signatureIndex }
+        for (match in matches) {
+            val matcher = match.result
+            try {
+                val filePath = matcher.group(1)?.trim()
+                val lineNum = matcher.group(2)?.toIntOrNull()
+                val colNum = if (matcher.groupCount() >= 3) matcher.group(3)?.toIntOrNull() else null
+                
+                // Extract error message from context
+                val errorMessage = extractErrorMessageFromContext(output, (match.lineOffset + matcher.start()).toInt())
+                
+                // Classify severity
+                val severity = ErrorSeverityClassifier.classifySeverity(errorMessage)
+                
+                // Resolve file path
+                val resolvedPath = filePath?.let { 
+                    resolveFilePath(it, workspaceRoot) 
                 }
+                
+                val errorId = "error_${System.currentTimeMillis()}_${errors.size}"
+                
+                errors.add(
+                    ErrorEvent(
+                        errorId = errorId,
+                        errorMessage = errorMessage,
+                        source = source,
+                        severity = severity,
+                        filePath = resolvedPath,
+                        lineNumber = lineNum,
+                        rawOutput = match.line.substring(matcher.start(), matcher.end())
+                    )
+                )
+            } catch (e: Exception) {
+                Log.w("ErrorMonitor", "Failed to parse error from output: ${e.message}")
             }
         }
         
@@ -283,9 +284,7 @@ object ErrorMonitor {
         val context = output.substring(start, end)
         
         // Try to extract error message
-        val errorPattern = java.util.regex.Pattern.compile("""(?:error|Error|ERROR|exception|Exception):\s*(.+?)(?:\n|$)""", 
-            java.util.regex.Pattern.CASE_INSENSITIVE)
-        val matcher = errorPattern.matcher(context)
+        val matcher = contextErrorPattern.matcher(context)
         if (matcher.find()) {
             return matcher.group(1)?.trim() ?: "Error detected"
         }
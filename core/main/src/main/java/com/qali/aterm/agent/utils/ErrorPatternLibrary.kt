@@ -1,5 +1,6 @@
 package com.qali.aterm.agent.utils
 
+import java.util.concurrent.ConcurrentHashMap
 import java.util.regex.Pattern
 
 /**
@@ -17,27 +18,76 @@ object ErrorPatternLibrary {
         val errorTypePatterns: Map<String, Pattern>
     )
     
+    private val compiledPatterns = ConcurrentHashMap<String, LanguagePattern>()
+    private val signatureSets = ConcurrentHashMap<String, ErrorSignatureSet>()
+    
     /**
-     * Get error patterns for a specific language
+     * Get error patterns for a specific language. Patterns are compiled on first use and shared.
      */
     fun getPatternsForLanguage(language: String): LanguagePattern {
+        val canonical = canonicalLanguage(language)
+        return compiledPatterns.getOrPut(canonical) {
+            when (canonical) {
+                "javascript" -> getJavaScriptPatterns()
+                "python" -> getPythonPatterns()
+                "java" -> getJavaKotlinPatterns()
+                "rust" -> getRustPatterns()
+                "go" -> getGoPatterns()
+                "cpp" -> getCppPatterns()
+                "ruby" -> getRubyPatterns()
+                "php" -> getPhpPatterns()
+                "swift" -> getSwiftPatterns()
+                "r" -> getRPatterns()
+                "scala" -> getScalaPatterns()
+                "dart" -> getDartPatterns()
+                "lua" -> getLuaPatterns()
+                "perl" -> getPerlPatterns()
+                "shell" -> getShellPatterns()
+                else -> getGenericPatterns()
+            }
+        }
+    }
+    
+    /**
+     * All patterns of [languages] as one prefiltered [ErrorSignatureSet], optionally only those of
+     * [kind]. Location patterns come first for each language, in declaration order.
+     */
+    fun signatures(languages: List<String>, kind: ErrorSignatureSet.Kind? = null): ErrorSignatureSet {
+        val canonical = languages.map { canonicalLanguage(it) }.distinct()
+        val key = canonical.joinToString(",") + "/" + (kind?.name ?: "")
+        return signatureSets.getOrPut(key) {
+            val signatures = canonical.flatMap { language ->
+                val patterns = getPatternsForLanguage(language)
+                val locations = patterns.patterns.map {
+                    ErrorSignatureSet.Signature(patterns.language, ErrorSignatureSet.Kind.LOCATION, patterns.language, it)
+                }
+                val types = patterns.errorTypePatterns.map { (type, pattern) ->
+                    ErrorSignatureSet.Signature(patterns.language, ErrorSignatureSet.Kind.ERROR_TYPE, type, pattern)
+                }
+                (locations + types).filter { kind == null || it.kind == kind }
+            }
+            ErrorSignatureSet(signatures)
+        }
+    }
+    
+    private fun canonicalLanguage(language: String): String {
         return when (language.lowercase()) {
-            "javascript", "js", "typescript", "ts", "jsx", "tsx" -> getJavaScriptPatterns()
-            "python", "py" -> getPythonPatterns()
-            "java", "kotlin", "kt" -> getJavaKotlinPatterns()
-            "rust", "rs" -> getRustPatterns()
-            "go" -> getGoPatterns()
-            "c", "cpp", "c++", "cxx" -> getCppPatterns()
-            "ruby", "rb" -> getRubyPatterns()
-            "php" -> getPhpPatterns()
-            "swift" -> getSwiftPatterns()
-            "r" -> getRPatterns()
-            "scala" -> getScalaPatterns()
-            "dart" -> getDartPatterns()
-            "lua" -> getLuaPatterns()
-            "perl", "pl" -> getPerlPatterns()
-            "shell", "bash", "sh" -> getShellPatterns()
-            else -> getGenericPatterns()
+            "javascript", "js", "typescript", "ts", "jsx", "tsx" -> "javascript"
+            "python", "py" -> "python"
+            "java", "kotlin", "kt" -> "java"
+            "rust", "rs" -> "rust"
+            "go" -> "go"
+            "c", "cpp", "c++", "cxx" -> "cpp"
+            "ruby", "rb" -> "ruby"
+            "php" -> "php"
+            "swift" -> "swift"
+            "r" -> "r"
+            "scala" -> "scala"
+            "dart" -> "dart"
+            "lua" -> "lua"
+            "perl", "pl" -> "perl"
+            "shell", "bash", "sh" -> "shell"
+            else -> "generic"
         }
     }
     
@@ -80,6 +80,7 @@ object FileCoherenceManager {
                 // Update version
                 val newVersion = file.lastModified()
                 fileVersions[file.absolutePath] = newVersion
+                WorkspaceChangeTracker.notifyFileChanged(file)
                 
                 android.util.Log.d("FileCoherenceManager", "Successfully wrote ${file.absolutePath} (version: $newVersion)")
                 true
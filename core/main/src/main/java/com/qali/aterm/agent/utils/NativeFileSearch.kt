@@ -0,0 +1,215 @@
+package com.qali.aterm.agent.utils
+
+import com.termux.terminal.FileSearcher
+import java.io.File
+import java.util.regex.Pattern
+
+/**
+ * Line search over many files backed by the native [FileSearcher]
+ *
+ * The native side only knows literals, so the longest literal every match must contain is taken
+ * from the regex ([requiredLiteral]) and used as a prefilter: files are scanned for it in
+ * parallel, and the full regex only runs on the lines that contain it. Binary files are skipped,
+ * which callers' plain Java search does too through [isBinary]. When the library is not loaded, or
+ * the regex has no usable literal, [search] returns null and callers keep their plain Java search.
+ */
+object NativeFileSearch {
+
+    /** A line of `paths[fileIndex]` matched by the regex */
+    data class LineMatch(val fileIndex: Int, val lineNumber: Int, val line: String)
+
+    /** Literals shorter than this match too many lines to be worth prefiltering */
+    private const val MIN_LITERAL_LENGTH = 2
+
+    /** Like grep and the native search, a NUL byte this near the start marks a file as binary */
+    private const val BINARY_PROBE_SIZE = 8192
+
+    private const val REGEX_META = "\\^$.|?*+()[]{}"
+
+    // Escapes that match a class of characters or a position; anything else is not understood here
+    private const val CLASS_ESCAPES = "dDwWsSbBnrtfaehHvVAzZG"
+
+    val isAvailable: Boolean by lazy {
+        try {
+            // Initializing the class loads libtermux
+            Class.forName(FileSearcher::class.java.name)
+            true
+        } catch (e: Throwable) {
+            false
+        }
+    }
+
+    /**
+     * Lines of [paths] matched by [pattern], in file order and line order. At most [maxMatches]
+     * lines are returned, the first ones in that order. Files are searched in parallel and their
+     * matches arrive interleaved, so the search runs to the end, only keeping the first
+     * [maxMatches] lines seen so far, unless [isAborted] stops it early with the lines found until
+     * then. Returns null when the native search cannot be used for [pattern].
+     */
+    fun search(
+        paths: List<String>,
+        pattern: Pattern,
+        maxMatches: Int = Int.MAX_VALUE,
+        isAborted: () -> Boolean = { false }
+    ): List<LineMatch>? {
+        val literal = literalOf(pattern) ?: return null
+        if (literal.length < MIN_LITERAL_LENGTH || !isAvailable) return null
+        if (paths.isEmpty()) return emptyList()
+
+        val ignoreCase = (pattern.flags() and Pattern.CASE_INSENSITIVE) != 0
+        val order = compareBy<LineMatch> { it.fileIndex }.thenBy { it.lineNumber }
+        val matches = ArrayList<LineMatch>()
+        // Trimmed back to the first maxMatches whenever it doubles
+        val trimAt = if (maxMatches > Int.MAX_VALUE / 2) Int.MAX_VALUE else maxOf(maxMatches * 2, 64)
+        val threads = Runtime.getRuntime().availableProcessors()
+        FileSearcher.search(
+            paths.toTypedArray(),
+            literal.toByteArray(Charsets.UTF_8),
+            ignoreCase,
+            0,
+            threads
+        ) { fileIndex, lineNumber, bytes ->
+            val line = String(bytes, Charsets.UTF_8)
+            if (pattern.matcher(line).find()) {
+                matches.add(LineMatch(fileIndex, lineNumber, line))
+                if (matches.size >= trimAt) firstMatches(matches, order, maxMatches)
+            }
+            !isAborted()
+        }
+        firstMatches(matches, order, maxMatches)
+        return matches
+    }
+
+    /** Sort [matches] and drop all but the first [count] */
+    private fun firstMatches(matches: ArrayList<LineMatch>, order: Comparator<LineMatch>, count: Int) {
+        matches.sortWith(order)
+        if (matches.size > count) matches.subList(count, matches.size).clear()
+    }
+
+    /**
+     * Whether [file] has a NUL byte near its start, which the native search takes as binary and
+     * skips; plain Java searches check this to report the same lines. Unreadable files count as
+     * binary, as neither search reports lines of them.
+     */
+    fun isBinary(file: File): Boolean {
+        return try {
+            file.inputStream().use { input ->
+                val probe = ByteArray(BINARY_PROBE_SIZE)
+                var read = 0
+                while (read < probe.size) {
+                    val n = input.read(probe, read, probe.size - read)
+                    if (n < 0) break
+                    read += n
+                }
+                (0 until read).any { probe[it] == 0.toByte() }
+            }
+        } catch (e: Exception) {
+            true
+        }
+    }
+
+    /**
+     * The literal every match of [pattern] contains, taking its flags into account. Case-insensitive
+     * patterns may only fold ASCII letters, as that is all the native comparison does.
+     */
+    internal fun literalOf(pattern: Pattern): String? {
+        val flags = pattern.flags()
+        if ((flags and Pattern.COMMENTS) != 0) return null
+        val literal = if ((flags and Pattern.LITERAL) != 0) {
+            pattern.pattern()
+        } else {
+            requiredLiteral(pattern.pattern())
+        } ?: return null
+        val unicodeCase = (flags and Pattern.CASE_INSENSITIVE) != 0 && (flags and Pattern.UNICODE_CASE) != 0
+        if (unicodeCase && literal.any { it.code >= 0x80 }) return null
+        return literal
+    }
+
+    /**
+     * The longest run of literal characters that every match of [regex] contains, or null when
+     * there is none or the regex uses syntax this does not follow (alternation at the top level,
+     * inline flags, back references). Groups and character classes end a run rather than being
+     * analysed, which is always safe.
+     */
+    internal fun requiredLiteral(regex: String): String? {
+        var best = ""
+        val run = StringBuilder()
+        fun endRun() {
+            if (run.length > best.length) best = run.toString()
+            run.setLength(0)
+        }
+
+        var depth = 0
+        var i = 0
+        while (i < regex.length) {
+            val c = regex[i]
+            when {
+                c == '\\' -> {
+                    val next = regex.getOrNull(i + 1) ?: return null
+                    when {
+                        next == 'Q' -> {
+                            val end = regex.indexOf("\\E", i + 2).let { if (it < 0) regex.length else it }
+                            if (depth == 0) run.append(regex, i + 2, end) else endRun()
+                            i = end + 2
+                            continue
+                        }
+                        next.isLetterOrDigit() -> {
+                            if (next !in CLASS_ESCAPES) return null
+                            endRun()
+                        }
+                        depth == 0 -> run.append(next)
+                    }
+                    i += 2
+                    continue
+                }
+                c == '[' -> {
+                    endRun()
+                    i = skipCharacterClass(regex, i)
+                    continue
+                }
+                c == '(' -> {
+                    // Non-capturing groups and lookarounds are skipped like any group, but inline
+                    // flags such as (?i) change how the rest of the regex matches
+                    if (regex.getOrNull(i + 1) == '?' && regex.getOrNull(i + 2)?.let { it in ":=!<>" } != true) return null
+                    endRun()
+                    depth++
+                }
+                c == ')' -> depth--
+                c == '|' -> if (depth == 0) return null
+                c == '?' || c == '*' || c == '{' -> {
+                    // The preceding character may be absent
+                    if (run.isNotEmpty()) run.setLength(run.length - 1)
+                    endRun()
+                    if (c == '{') {
+                        i = regex.indexOf('}', i).let { if (it < 0) return null else it + 1 }
+                        continue
+                    }
+                }
+                c == '+' -> endRun()
+                c in REGEX_META -> endRun()
+                depth == 0 -> run.append(c)
+            }
+            i++
+        }
+        endRun()
+        return best.ifEmpty { null }
+    }
+
+    /** Index just past the character class starting at [start] */
+    private fun skipCharacterClass(regex: String, start: Int): Int {
+        var i = start + 1
+        if (regex.getOrNull(i) == '^') i++
+        // A ']' right after the opening bracket is a literal
+        if (regex.getOrNull(i) == ']') i++
+        var depth = 1
+        while (i < regex.length && depth > 0) {
+            when (regex[i]) {
+                '\\' -> i++
+                '[' -> depth++
+                ']' -> depth--
+            }
+            i++
+        }
+        return i
+    }
+}
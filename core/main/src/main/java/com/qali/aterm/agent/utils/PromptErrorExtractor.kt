@@ -9,6 +9,26 @@ import java.util.regex.Pattern
  */
 object PromptErrorExtractor {
     
+    // Compiled once rather than on every call
+    private val explicitPattern = Pattern.compile("""(?:error|exception|failed):\s*(\w+(?:\s+\w+)?)""", Pattern.CASE_INSENSITIVE)
+    private val quotedPattern = Pattern.compile("""["']([^"']+)["']""")
+    private val errorPattern = Pattern.compile("""(?:error|exception|failed):\s*(.+?)(?:\.|$|\n)""", Pattern.CASE_INSENSITIVE)
+    private val stackPattern = Pattern.compile("""at\s+[^(]+\([^)]+\)\s*:\s*(.+)""")
+    private val filePattern = Pattern.compile("""([/\w\-\.]+\.(?:js|ts|jsx|tsx|py|java|kt|go|rs|cpp|h|hpp|json|yaml|yml))""")
+    private val inFilePattern = Pattern.compile("""(?:in|at|from|file)\s+['"]?([/\w\-\.]+\.(?:js|ts|py|java|kt))['"]?""", Pattern.CASE_INSENSITIVE)
+    private val linePattern = Pattern.compile("""(?:line|line\s*:)\s*(\d+)""", Pattern.CASE_INSENSITIVE)
+    private val fileLinePattern = Pattern.compile("""\.(?:js|ts|py|java|kt):(\d+)""")
+    private val functionPattern = Pattern.compile("""(?:function|method|fn)\s+['"]?(\w+)['"]?""", Pattern.CASE_INSENSITIVE)
+    private val inFunctionPattern = Pattern.compile("""(?:in|at)\s+(\w+)\s*(?:\(|function)""", Pattern.CASE_INSENSITIVE)
+    private val contextPatterns = listOf(
+        Pattern.compile("""(?:when|while|during)\s+(?:i\s+)?(?:was\s+)?(?:trying\s+to\s+)?(.+?)(?:\.|,|$)""", Pattern.CASE_INSENSITIVE),
+        Pattern.compile("""(?:i\s+)?(?:was\s+)?(?:trying\s+to\s+)?(.+?)(?:and\s+then|when|but)""", Pattern.CASE_INSENSITIVE)
+    )
+    private val timelinePatterns = listOf(
+        Pattern.compile("""(?:started|began|happened)\s+(?:yesterday|today|recently|a\s+week\s+ago|since)""", Pattern.CASE_INSENSITIVE),
+        Pattern.compile("""(?:always|every\s+time|sometimes|occasionally|frequently)""", Pattern.CASE_INSENSITIVE)
+    )
+    
     /**
      * Extracted error information from user prompt
      */
@@ -121,7 +141,6 @@ object PromptErrorExtractor {
         }
         
         // Try to extract from explicit error messages
-        val explicitPattern = Pattern.compile("""(?:error|exception|failed):\s*(\w+(?:\s+\w+)?)""", Pattern.CASE_INSENSITIVE)
         val matcher = explicitPattern.matcher(prompt)
         if (matcher.find()) {
             return matcher.group(1)?.trim()?.capitalize()
@@ -135,7 +154,6 @@ object PromptErrorExtractor {
      */
     private fun extractErrorMessage(prompt: String, lowerPrompt: String): String? {
         // Look for quoted error messages
-        val quotedPattern = Pattern.compile("""["']([^"']+)["']""")
         val quotedMatcher = quotedPattern.matcher(prompt)
         if (quotedMatcher.find()) {
             val quoted = quotedMatcher.group(1)
@@ -145,14 +163,12 @@ object PromptErrorExtractor {
         }
         
         // Look for "error:" or "exception:" patterns
-        val errorPattern = Pattern.compile("""(?:error|exception|failed):\s*(.+?)(?:\.|$|\n)""", Pattern.CASE_INSENSITIVE)
         val errorMatcher = errorPattern.matcher(prompt)
         if (errorMatcher.find()) {
             return errorMatcher.group(1)?.trim()
         }
         
         // Extract from stack trace patterns
-        val stackPattern = Pattern.compile("""at\s+[^(]+\([^)]+\)\s*:\s*(.+)""")
         val stackMatcher = stackPattern.matcher(prompt)
         if (stackMatcher.find()) {
             return stackMatcher.group(1)?.trim()
@@ -168,7 +184,6 @@ object PromptErrorExtractor {
         val filePaths = mutableSetOf<String>()
         
         // Pattern for file paths
-        val filePattern = Pattern.compile("""([/\w\-\.]+\.(?:js|ts|jsx|tsx|py|java|kt|go|rs|cpp|h|hpp|json|yaml|yml))""")
         val matcher = filePattern.matcher(prompt)
         while (matcher.find()) {
             val path = matcher.group(1)
@@ -178,7 +193,6 @@ object PromptErrorExtractor {
         }
         
         // Pattern for "in file.js" or "at file.js"
-        val inFilePattern = Pattern.compile("""(?:in|at|from|file)\s+['"]?([/\w\-\.]+\.(?:js|ts|py|java|kt))['"]?""", Pattern.CASE_INSENSITIVE)
         val inFileMatcher = inFilePattern.matcher(prompt)
         while (inFileMatcher.find()) {
             val path = inFileMatcher.group(1)
@@ -197,7 +211,6 @@ object PromptErrorExtractor {
         val lineNumbers = mutableSetOf<Int>()
         
         // Pattern for "line 123" or "line:123" or ":123:"
-        val linePattern = Pattern.compile("""(?:line|line\s*:)\s*(\d+)""", Pattern.CASE_INSENSITIVE)
         val matcher = linePattern.matcher(prompt)
         while (matcher.find()) {
             val lineNum = matcher.group(1)?.toIntOrNull()
@@ -207,7 +220,6 @@ object PromptErrorExtractor {
         }
         
         // Pattern for "file.js:123" or "file.js:123:45"
-        val fileLinePattern = Pattern.compile("""\.(?:js|ts|py|java|kt):(\d+)""")
         val fileLineMatcher = fileLinePattern.matcher(prompt)
         while (fileLineMatcher.find()) {
             val lineNum = fileLineMatcher.group(1)?.toIntOrNull()
@@ -226,7 +238,6 @@ object PromptErrorExtractor {
         val functionNames = mutableSetOf<String>()
         
         // Pattern for "function name" or "functionName"
-        val functionPattern = Pattern.compile("""(?:function|method|fn)\s+['"]?(\w+)['"]?""", Pattern.CASE_INSENSITIVE)
         val matcher = functionPattern.matcher(prompt)
         while (matcher.find()) {
             val funcName = matcher.group(1)
@@ -236,7 +247,6 @@ object PromptErrorExtractor {
         }
         
         // Pattern for "in functionName" or "at functionName"
-        val inFunctionPattern = Pattern.compile("""(?:in|at)\s+(\w+)\s*(?:\(|function)""", Pattern.CASE_INSENSITIVE)
         val inFunctionMatcher = inFunctionPattern.matcher(prompt)
         while (inFunctionMatcher.find()) {
             val funcName = inFunctionMatcher.group(1)
@@ -273,11 +283,6 @@ object PromptErrorExtractor {
      * Extract context (what user was doing)
      */
     private fun extractContext(prompt: String): String? {
-        val contextPatterns = listOf(
-            Pattern.compile("""(?:when|while|during)\s+(?:i\s+)?(?:was\s+)?(?:trying\s+to\s+)?(.+?)(?:\.|,|$)""", Pattern.CASE_INSENSITIVE),
-            Pattern.compile("""(?:i\s+)?(?:was\s+)?(?:trying\s+to\s+)?(.+?)(?:and\s+then|when|but)""", Pattern.CASE_INSENSITIVE)
-        )
-        
         for (pattern in contextPatterns) {
             val matcher = pattern.matcher(prompt)
             if (matcher.find()) {
@@ -295,11 +300,6 @@ object PromptErrorExtractor {
      * Extract timeline information
      */
     private fun extractTimeline(prompt: String, lowerPrompt: String): String? {
-        val timelinePatterns = listOf(
-            Pattern.compile("""(?:started|began|happened)\s+(?:yesterday|today|recently|a\s+week\s+ago|since)""", Pattern.CASE_INSENSITIVE),
-            Pattern.compile("""(?:always|every\s+time|sometimes|occasionally|frequently)""", Pattern.CASE_INSENSITIVE)
-        )
-        
         for (pattern in timelinePatterns) {
             val matcher = pattern.matcher(prompt)
             if (matcher.find()) {
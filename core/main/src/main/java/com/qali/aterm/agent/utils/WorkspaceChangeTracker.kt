@@ -0,0 +1,381 @@
+package com.qali.aterm.agent.utils
+
+import android.os.FileObserver
+import android.system.Os
+import android.util.Log
+import okio.ByteString
+import okio.HashingSink
+import okio.blackholeSink
+import okio.buffer
+import okio.source
+import java.io.File
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.CopyOnWriteArrayList
+import java.util.concurrent.atomic.AtomicLong
+
+/**
+ * Tracks file changes in a workspace from inotify events
+ *
+ * One [FileObserver] is registered per directory (inotify is not recursive) except for ignored
+ * directories such as `node_modules/` and `.git/`. Every change bumps [generation] and is kept in a
+ * bounded log, so a cache can remember the generation it was computed at and later ask
+ * [hasChangedSince] for only the paths it depends on. When nothing changed that is a single
+ * comparison.
+ *
+ * Written files are hashed, and a write that leaves the content unchanged (a save without edits,
+ * `touch`, a formatter that had nothing to do) is not reported as a change.
+ *
+ * [FileObserver] does not report a watch that could not be added, which happens once the inotify
+ * watches of the app's user run out. After registering observers the last directory watched is
+ * looked up among the watches the kernel lists for the app's inotify descriptors, which neither
+ * writes to the workspace nor waits for an event. When it is missing, or the kernel drops events or
+ * watches later on, the tracker stops and [isWatching] turns false.
+ */
+class WorkspaceChangeTracker internal constructor(val workspaceRoot: String) {
+
+    internal enum class Kind { WRITTEN, DELETED }
+
+    /** A change at [generation]; a null [path] means anything may have changed */
+    private class Change(val generation: Long, val path: String?)
+
+    private val root = File(workspaceRoot)
+    private val log = ArrayDeque<Change>()
+    private val hashes = ConcurrentHashMap<String, ByteString>()
+    private val observers = ConcurrentHashMap<String, FileObserver>()
+    private val listeners = CopyOnWriteArrayList<(String?) -> Unit>()
+
+    /**
+     * Distinguishes this tracker from one made for the same workspace after [release], whose
+     * [generation] counts from zero again
+     */
+    val id = nextId.incrementAndGet()
+
+    @Volatile
+    private var ignorePatterns: List<String> = emptyList()
+
+    @Volatile
+    private var started = false
+
+    /** Incremented on every recorded change */
+    @Volatile
+    var generation = 0L
+        private set
+
+    /**
+     * False when events are not delivered: not started, the workspace has too many directories, or
+     * watches or events were lost
+     */
+    @Volatile
+    var isWatching = false
+        private set
+
+    /**
+     * Register observers for the workspace tree. Returns false, leaving the tracker inactive, when
+     * the workspace does not exist or needs more than [MAX_WATCHED_DIRECTORIES] watches.
+     */
+    @Synchronized
+    fun start(): Boolean {
+        if (isWatching) return true
+        if (!root.isDirectory) return false
+        started = true
+        ignorePatterns = AtermIgnoreManager.loadIgnorePatterns(workspaceRoot)
+        return try {
+            isWatching = watchTree(root)
+            if (!isWatching) {
+                Log.w("WorkspaceChangeTracker", "Could not watch every directory of $workspaceRoot, not watching")
+                stop()
+            } else {
+                Log.d("WorkspaceChangeTracker", "Watching ${observers.size} directories in $workspaceRoot")
+            }
+            isWatching
+        } catch (e: Exception) {
+            Log.w("WorkspaceChangeTracker", "Could not watch $workspaceRoot: ${e.message}")
+            stop()
+            false
+        }
+    }
+
+    @Synchronized
+    fun stop() {
+        isWatching = false
+        observers.values.forEach { it.stopWatching() }
+        observers.clear()
+    }
+
+    /**
+     * Whether a path accepted by [dependsOn] (relative to the workspace, `/`-separated) was created,
+     * deleted or changed after [since]. Conservatively true when the changes since then are no
+     * longer in the log.
+     */
+    fun hasChangedSince(since: Long, dependsOn: (String) -> Boolean): Boolean {
+        if (generation == since) return false
+        synchronized(log) {
+            if (log.isEmpty() || log.first().generation > since + 1) return true
+            for (i in log.indices.reversed()) {
+                val change = log[i]
+                if (change.generation <= since) break
+                val path = change.path ?: return true
+                if (dependsOn(path)) return true
+            }
+        }
+        return false
+    }
+
+    /**
+     * Call [listener] with the relative path of every recorded change, or null when anything may
+     * have changed. Runs on the event thread, so listeners should only queue work.
+     */
+    fun addListener(listener: (String?) -> Unit) {
+        listeners.add(listener)
+    }
+
+    fun removeListener(listener: (String?) -> Unit) {
+        listeners.remove(listener)
+    }
+
+    /**
+     * Report a change made by the app itself, so caches see it without waiting for the event
+     */
+    fun notifyChanged(file: File) {
+        val relative = relativePath(file) ?: return
+        onFileEvent(relative, if (file.exists()) Kind.WRITTEN else Kind.DELETED)
+    }
+
+    internal fun onFileEvent(relativePath: String, kind: Kind) {
+        when (kind) {
+            Kind.WRITTEN -> {
+                val hash = hashOf(File(root, relativePath))
+                val previous = if (hash != null) hashes.put(relativePath, hash) else hashes.remove(relativePath)
+                if (hash != null && hash == previous) return
+            }
+            Kind.DELETED -> hashes.remove(relativePath)
+        }
+        record(relativePath)
+    }
+
+    private fun record(path: String?) {
+        synchronized(log) {
+            val change = Change(generation + 1, path)
+            if (log.size >= MAX_LOGGED_CHANGES) log.removeFirst()
+            log.addLast(change)
+            generation = change.generation
+        }
+        listeners.forEach { it(path) }
+    }
+
+    private fun hashOf(file: File): ByteString? {
+        if (!file.isFile || file.length() > MAX_HASHED_FILE_SIZE) return null
+        return try {
+            val sink = HashingSink.sha256(blackholeSink())
+            file.source().buffer().use { it.readAll(sink) }
+            sink.hash
+        } catch (e: Exception) {
+            null
+        }
+    }
+
+    private fun relativePath(file: File): String? {
+        val path = file.absoluteFile.normalize().path
+        val rootPath = root.absoluteFile.normalize().path
+        if (path == rootPath) return ""
+        if (!path.startsWith("$rootPath/")) return null
+        return path.substring(rootPath.length + 1)
+    }
+
+    private fun isIgnored(relativePath: String): Boolean {
+        return relativePath.isNotEmpty() && AtermIgnoreManager.shouldIgnore(relativePath, ignorePatterns)
+    }
+
+    /**
+     * Watch [directory] and its non-ignored subdirectories. Returns false once the watch limit is hit
+     * or a watch could not be added.
+     */
+    private fun watchTree(directory: File): Boolean {
+        val iterator = directory.walkTopDown()
+            .onEnter { dir -> relativePath(dir)?.let { !isIgnored(it) } ?: false }
+            .filter { it.isDirectory }
+            .iterator()
+        var newest: File? = null
+        while (iterator.hasNext()) {
+            val dir = iterator.next()
+            if (observers.containsKey(dir.path)) continue
+            if (observers.size >= MAX_WATCHED_DIRECTORIES) return false
+            val observer = DirectoryObserver(dir)
+            observers[dir.path] = observer
+            observer.startWatching()
+            newest = dir
+        }
+        // Watches are added in order, so once they run out the last one is among those that failed
+        val last = newest ?: return true
+        return isWatched(last) != false
+    }
+
+    /**
+     * Stop after events were lost, so caches go back to checking files themselves
+     */
+    private fun lose(reason: String) {
+        if (!isWatching) return
+        Log.w("WorkspaceChangeTracker", "$reason, not watching $workspaceRoot")
+        stop()
+        record(null)
+    }
+
+    private fun unwatchTree(directory: File) {
+        val prefix = directory.path + "/"
+        observers.entries.removeAll { (path, observer) ->
+            val match = path == directory.path || path.startsWith(prefix)
+            if (match) observer.stopWatching()
+            match
+        }
+    }
+
+    private fun handleEvent(directory: File, event: Int, name: String?) {
+        if ((event and IN_Q_OVERFLOW) != 0) {
+            // The kernel dropped events, so nothing can be ruled out from now on
+            lose("inotify event queue overflowed")
+            return
+        }
+        val mask = event and FileObserver.ALL_EVENTS
+        if (name == null) {
+            if ((mask and (FileObserver.DELETE_SELF or FileObserver.MOVE_SELF)) != 0) {
+                unwatchTree(directory)
+            } else if ((event and IN_IGNORED) != 0 && observers.containsKey(directory.path)) {
+                // A watch removed by the kernel rather than by stop() or unwatchTree()
+                if (directory.isDirectory) lose("Watch on ${directory.path} was removed") else unwatchTree(directory)
+            }
+            return
+        }
+        val file = File(directory, name)
+        val relative = relativePath(file) ?: return
+        if (relative == AtermIgnoreManager.ATERM_IGNORE_FILE) {
+            ignorePatterns = AtermIgnoreManager.loadIgnorePatterns(workspaceRoot)
+            record(null)
+            return
+        }
+        if (isIgnored(relative)) {
+            // Not a change for caches, but listeners that keep ignored entries need to see it
+            listeners.forEach { it(relative) }
+            return
+        }
+        val isDirectory = (event and IN_ISDIR) != 0
+
+        when {
+            (mask and (FileObserver.CREATE or FileObserver.MOVED_TO)) != 0 -> {
+                if (!isDirectory) {
+                    // Atomic writes arrive as a move onto the target, so hash them like a write
+                    onFileEvent(relative, Kind.WRITTEN)
+                    return
+                }
+                // A directory moved in from elsewhere arrives with its contents
+                if (isWatching && !watchTree(file)) {
+                    Log.w("WorkspaceChangeTracker", "Could not watch ${file.path}, not watching $workspaceRoot")
+                    stop()
+                }
+                file.walkTopDown()
+                    .onEnter { dir -> relativePath(dir)?.let { !isIgnored(it) } ?: false }
+                    .filter { it.isFile }
+                    .forEach { child -> relativePath(child)?.let { onFileEvent(it, Kind.WRITTEN) } }
+                record(relative)
+            }
+            (mask and (FileObserver.DELETE or FileObserver.MOVED_FROM)) != 0 -> {
+                if (isDirectory) {
+                    // The files that were inside are not known any more
+                    unwatchTree(file)
+                    hashes.keys.removeAll { it.startsWith("$relative/") }
+                    record(null)
+                } else {
+                    onFileEvent(relative, Kind.DELETED)
+                }
+            }
+            (mask and FileObserver.CLOSE_WRITE) != 0 -> onFileEvent(relative, Kind.WRITTEN)
+        }
+    }
+
+    @Suppress("DEPRECATION")
+    private inner class DirectoryObserver(private val directory: File) : FileObserver(directory.path, EVENTS) {
+        override fun onEvent(event: Int, path: String?) {
+            try {
+                handleEvent(directory, event, path)
+            } catch (e: Exception) {
+                Log.w("WorkspaceChangeTracker", "Failed to handle event in ${directory.path}: ${e.message}")
+                record(null)
+            }
+        }
+    }
+
+    companion object {
+        const val MAX_WATCHED_DIRECTORIES = 4096
+        private const val MAX_LOGGED_CHANGES = 4096
+        private const val MAX_HASHED_FILE_SIZE = 8L * 1024 * 1024
+
+        // inotify flags FileObserver passes through but does not name
+        private const val IN_ISDIR = 0x40000000
+        private const val IN_Q_OVERFLOW = 0x00004000
+        private const val IN_IGNORED = 0x00008000
+
+        private const val EVENTS = FileObserver.CREATE or FileObserver.DELETE or FileObserver.MOVED_FROM or
+            FileObserver.MOVED_TO or FileObserver.CLOSE_WRITE or FileObserver.DELETE_SELF or FileObserver.MOVE_SELF
+
+        private val trackers = ConcurrentHashMap<String, WorkspaceChangeTracker>()
+        private val nextId = AtomicLong()
+
+        /**
+         * Whether the app holds an inotify watch on [directory], going by the watches listed in
+         * `/proc/self/fdinfo` for its inotify descriptors. Null when that cannot be read.
+         */
+        private fun isWatched(directory: File): Boolean? {
+            return try {
+                val inode = Os.stat(directory.path).st_ino
+                val descriptors = File("/proc/self/fd").listFiles() ?: return null
+                descriptors.any { fd ->
+                    val target = try { Os.readlink(fd.path) } catch (e: Exception) { null }
+                    target == "anon_inode:inotify" &&
+                        inode in watchedInodes(File("/proc/self/fdinfo", fd.name).readText())
+                }
+            } catch (e: Exception) {
+                null
+            }
+        }
+
+        /**
+         * Inodes of the watches in the fdinfo of an inotify descriptor, which lists each as
+         * `inotify wd:1 ino:1a2b sdev:... mask:...` with the inode in hex
+         */
+        internal fun watchedInodes(fdinfo: String): Set<Long> {
+            return fdinfo.lineSequence()
+                .filter { it.startsWith("inotify ") }
+                .mapNotNull { line ->
+                    line.split(' ').firstOrNull { it.startsWith("ino:") }?.removePrefix("ino:")?.toLongOrNull(16)
+                }
+                .toSet()
+        }
+
+        /**
+         * Shared tracker for [workspaceRoot], started on first use. Check [isWatching] before
+         * relying on it; a workspace that was too large to watch is not walked again.
+         */
+        fun forWorkspace(workspaceRoot: String): WorkspaceChangeTracker {
+            val tracker = trackers.getOrPut(workspaceRoot) { WorkspaceChangeTracker(workspaceRoot) }
+            if (!tracker.started) tracker.start()
+            return tracker
+        }
+
+        /**
+         * Stop the trackers of [directory] and of workspaces inside it, whose files are going away
+         */
+        fun release(directory: String) {
+            trackers.keys.filter { WorkspaceFileIndex.isWithin(it, directory) }.forEach { trackers.remove(it)?.stop() }
+        }
+
+        /**
+         * Report a write or delete of [file] by the app to the tracker of the workspace holding it, if any.
+         * Trackers that are not watching pass it on too, so indexes that rescan on a timer see it at once.
+         */
+        fun notifyFileChanged(file: File) {
+            val path = file.absolutePath
+            trackers.values
+                .filter { path.startsWith(File(it.workspaceRoot).absolutePath + "/") }
+                .forEach { it.notifyChanged(file) }
+        }
+    }
+}
@@ -0,0 +1,509 @@
+package com.qali.aterm.agent.utils
+
+import com.rk.libcommons.application
+import okio.HashingSink
+import okio.blackholeSink
+import okio.buffer
+import okio.source
+import java.io.DataOutputStream
+import java.io.File
+import java.io.IOException
+import java.io.RandomAccessFile
+import java.nio.ByteBuffer
+import java.nio.channels.FileChannel
+import java.security.MessageDigest
+import java.util.TreeMap
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * Index of the files in a workspace, shared by the search and read tools
+ *
+ * Holds path, size, modification time, language and ignore status of every file, sorted by path
+ * so a directory is a contiguous range. It is built by one walk per process, kept current from
+ * [WorkspaceChangeTracker] events and saved to a compact binary file in the app cache, so tools
+ * query it instead of walking the tree on every call. Without events a query walks only the
+ * directory it asks for, and not again for [rescanAfterMs] after that.
+ *
+ * Directories matched by .atermignore (`node_modules/`, `build/`, ...) are stored as a single
+ * entry; their contents are only listed, live, for queries that ask for ignored files.
+ */
+class WorkspaceFileIndex internal constructor(
+    val workspaceRoot: String,
+    private val tracker: WorkspaceChangeTracker?,
+    private val storeFile: File?,
+    private val rescanAfterMs: Long = UNWATCHED_RESCAN_MS
+) {
+    /**
+     * One indexed path relative to the workspace root, `/`-separated. [contentHash] is 0 until
+     * requested through [contentHash].
+     */
+    data class Entry(
+        val path: String,
+        val size: Long,
+        val modified: Long,
+        val language: String?,
+        val ignored: Boolean,
+        val isDirectory: Boolean = false,
+        val contentHash: Long = 0
+    )
+
+    private val root = File(workspaceRoot)
+    private val entries = TreeMap<String, Entry>()
+    private val pending = LinkedHashSet<String>()
+    private var ignorePatterns: List<String> = emptyList()
+    private var loaded = false
+    private var needsRescan = true
+    private var dirty = false
+    private var lastSave = 0L
+
+    @Volatile
+    private var released = false
+
+    /** When directories (relative, "" for the whole workspace) were last walked */
+    private val scannedAt = HashMap<String, Long>()
+
+    private val listener: (String?) -> Unit = { path ->
+        synchronized(pending) {
+            if (path == null) needsRescan = true else pending.add(path)
+        }
+    }
+
+    init {
+        tracker?.addListener(listener)
+    }
+
+    /**
+     * Files under [directory] (relative, "" for the whole workspace), sorted by path. Ignored
+     * files are left out unless [includeIgnored] is set, and files in hidden directories below
+     * [directory] if [skipHidden] is.
+     */
+    fun files(directory: String = "", includeIgnored: Boolean = false, skipHidden: Boolean = false): List<Entry> {
+        val prefix = normalize(directory)
+        val result = ArrayList<Entry>()
+        val ignoredDirectories = ArrayList<String>()
+        synchronized(this) {
+            ensureFresh(prefix)
+            val enclosing = enclosingIgnoredDirectory(prefix)
+            if (enclosing != null) {
+                if (includeIgnored) ignoredDirectories.add(prefix)
+            } else {
+                val range = if (prefix.isEmpty()) entries else entries.subMap("$prefix/", true, "${prefix}0", false)
+                var current = range.firstEntry()
+                while (current != null) {
+                    val entry = current.value
+                    val hidden = if (skipHidden) hiddenDirectoryOf(entry, prefix) else null
+                    if (hidden != null) {
+                        // Sorted by path, so the whole hidden tree is one range to step over
+                        current = range.ceilingEntry("${hidden}0")
+                        continue
+                    }
+                    when {
+                        entry.isDirectory -> if (includeIgnored) ignoredDirectories.add(entry.path)
+                        !entry.ignored || includeIgnored -> result.add(entry)
+                    }
+                    current = range.higherEntry(entry.path)
+                }
+            }
+        }
+        // Walked outside the lock; these trees are not indexed on purpose
+        for (path in ignoredDirectories) {
+            walkFiles(File(root, path), skipHidden).forEach { file ->
+                relativePath(file)?.let { result.add(entryFor(it, file, ignored = true)) }
+            }
+        }
+        if (ignoredDirectories.isNotEmpty()) result.sortBy { it.path }
+        return result
+    }
+
+    fun entry(path: String): Entry? {
+        val relative = normalize(path)
+        synchronized(this) {
+            // Without events a single file is checked on its own rather than walked to
+            val watching = isWatching()
+            ensureFresh(if (watching) "" else null)
+            if (!watching) update(relative)
+            return entries[relative]
+        }
+    }
+
+    /**
+     * 64-bit content hash of an indexed file, computed on first request and kept until the file
+     * changes. Null for files that are not indexed.
+     */
+    fun contentHash(path: String): Long? {
+        val entry = entry(path) ?: return null
+        if (entry.isDirectory) return null
+        if (entry.contentHash != 0L) return entry.contentHash
+        val hash = hashOf(File(root, entry.path)) ?: return null
+        synchronized(this) {
+            // Only store it if the file was not changed while hashing
+            if (entries[entry.path] == entry) {
+                entries[entry.path] = entry.copy(contentHash = hash)
+                dirty = true
+            }
+        }
+        return hash
+    }
+
+    /**
+     * Drop everything and walk the workspace again on the next query
+     */
+    fun invalidate() {
+        synchronized(pending) { needsRescan = true }
+    }
+
+    /**
+     * Apply queued changes and walk [directory] if it may be out of date; null walks nothing
+     */
+    private fun ensureFresh(directory: String?) {
+        if (!loaded) {
+            loaded = true
+            load()
+        }
+        val rescan: Boolean
+        val changed: List<String>
+        synchronized(pending) {
+            rescan = needsRescan
+            needsRescan = false
+            if (rescan) pending.clear()
+            changed = pending.toList()
+            pending.clear()
+        }
+        if (rescan) {
+            scannedAt.clear()
+            ignorePatterns = AtermIgnoreManager.loadIgnorePatterns(workspaceRoot)
+        }
+        changed.forEach { update(it) }
+        if (directory != null && !isFresh(directory) && enclosingIgnoredDirectory(directory) == null) {
+            // Events keep a full walk current; without them only the directory asked for is walked
+            rescan(if (isWatching()) "" else directory)
+        }
+        if (dirty && System.currentTimeMillis() - lastSave > SAVE_INTERVAL_MS) save()
+    }
+
+    private fun isWatching(): Boolean = tracker != null && tracker.isWatching
+
+    private fun isFresh(directory: String): Boolean {
+        if (isWatching()) return scannedAt.containsKey("")
+        val now = System.currentTimeMillis()
+        var candidate = directory
+        while (true) {
+            val time = scannedAt[candidate]
+            if (time != null && now - time < rescanAfterMs) return true
+            if (candidate.isEmpty()) return false
+            candidate = candidate.substringBeforeLast('/', "")
+        }
+    }
+
+    private fun rescan(directory: String) {
+        ignorePatterns = AtermIgnoreManager.loadIgnorePatterns(workspaceRoot)
+        val range = if (directory.isEmpty()) entries else entries.subMap("$directory/", true, "${directory}0", false)
+        val previous = HashMap(range)
+        range.clear()
+        val start = File(root, directory)
+        if (start.isDirectory) {
+            start.walkTopDown()
+                .onEnter { dir ->
+                    val relative = relativePath(dir) ?: return@onEnter false
+                    if (relative.isNotEmpty() && AtermIgnoreManager.shouldIgnore(relative, ignorePatterns)) {
+                        entries[relative] = Entry(relative, 0, dir.lastModified(), null, ignored = true, isDirectory = true)
+                        false
+                    } else {
+                        true
+                    }
+                }
+                .filter { it.isFile }
+                .forEach { file ->
+                    val relative = relativePath(file) ?: return@forEach
+                    entries[relative] = reuseHash(entryFor(relative, file), previous[relative])
+                }
+        }
+        val now = System.currentTimeMillis()
+        scannedAt.entries.removeAll { (path, time) ->
+            directory.isEmpty() || path == directory || path.startsWith("$directory/") || now - time >= rescanAfterMs
+        }
+        scannedAt[directory] = now
+        dirty = true
+    }
+
+    /**
+     * Apply one change reported by the tracker
+     */
+    private fun update(path: String) {
+        if (enclosingIgnoredDirectory(path) != null && entries[path]?.isDirectory != true) return
+        // Not walked to yet, but inside a tree that is not indexed
+        if (hasIgnoredAncestor(path)) return
+        val file = File(root, path)
+        when {
+            file.isFile -> entries[path] = reuseHash(entryFor(path, file), entries[path])
+            file.isDirectory -> {
+                // Files inside a new directory are reported one by one; only ignored roots need an entry
+                if (isIgnored(path)) {
+                    entries[path] = Entry(path, 0, file.lastModified(), null, ignored = true, isDirectory = true)
+                }
+            }
+            else -> {
+                entries.remove(path)
+                entries.subMap("$path/", "${path}0").clear()
+            }
+        }
+        dirty = true
+    }
+
+    private fun entryFor(relative: String, file: File, ignored: Boolean = isIgnored(relative)): Entry {
+        return Entry(relative, file.length(), file.lastModified(), languageOf(relative), ignored)
+    }
+
+    private fun reuseHash(entry: Entry, previous: Entry?): Entry {
+        if (previous == null || previous.contentHash == 0L) return entry
+        if (previous.size != entry.size || previous.modified != entry.modified) return entry
+        return entry.copy(contentHash = previous.contentHash)
+    }
+
+    private fun isIgnored(relative: String): Boolean {
+        return AtermIgnoreManager.shouldIgnore(relative, ignorePatterns)
+    }
+
+    /**
+     * The first hidden directory on the path of [entry] below [prefix], or the entry itself if it
+     * is a hidden ignored directory
+     */
+    private fun hiddenDirectoryOf(entry: Entry, prefix: String): String? {
+        val path = entry.path
+        val end = if (entry.isDirectory) path.length else path.lastIndexOf('/')
+        var segment = if (prefix.isEmpty()) 0 else prefix.length + 1
+        while (segment < end) {
+            var next = path.indexOf('/', segment)
+            if (next < 0 || next > end) next = end
+            if (path[segment] == '.') return path.substring(0, next)
+            segment = next + 1
+        }
+        return null
+    }
+
+    private fun hasIgnoredAncestor(path: String): Boolean {
+        var parent = path.substringBeforeLast('/', "")
+        while (parent.isNotEmpty()) {
+            if (isIgnored(parent)) return true
+            parent = parent.substringBeforeLast('/', "")
+        }
+        return false
+    }
+
+    /** The ignored directory entry that [path] is in, or is itself */
+    private fun enclosingIgnoredDirectory(path: String): String? {
+        var candidate = path
+        while (candidate.isNotEmpty()) {
+            if (entries[candidate]?.isDirectory == true) return candidate
+            candidate = candidate.substringBeforeLast('/', "")
+        }
+        return null
+    }
+
+    private fun relativePath(file: File): String? {
+        val path = file.absoluteFile.normalize().path
+        val rootPath = root.absoluteFile.normalize().path
+        if (path == rootPath) return ""
+        if (!path.startsWith("$rootPath/")) return null
+        return path.substring(rootPath.length + 1)
+    }
+
+    private fun normalize(path: String): String {
+        val normalized = File(path.replace("\\", "/")).normalize().path.trim('/')
+        return if (normalized == ".") "" else normalized
+    }
+
+    private fun hashOf(file: File): Long? {
+        return try {
+            val sink = HashingSink.sha256(blackholeSink())
+            file.source().buffer().use { it.readAll(sink) }
+            // 0 means "not computed"
+            sink.hash.asByteBuffer().long.takeIf { it != 0L } ?: 1L
+        } catch (e: IOException) {
+            null
+        }
+    }
+
+    /**
+     * Entries are restored with their hashes; sizes and times are checked by the first walk.
+     */
+    private fun load() {
+        val file = storeFile ?: return
+        if (!file.isFile) return
+        try {
+            RandomAccessFile(file, "r").use { raf ->
+                val buffer = raf.channel.map(FileChannel.MapMode.READ_ONLY, 0, raf.length())
+                if (buffer.int != MAGIC || buffer.int != FORMAT_VERSION) return
+                if (readString(buffer) != root.absolutePath) return
+                val count = buffer.int
+                repeat(count) {
+                    val path = readString(buffer)
+                    val size = buffer.long
+                    val modified = buffer.long
+                    val language = LANGUAGES.getOrNull(buffer.get().toInt() - 1)
+                    val flags = buffer.get().toInt()
+                    val hash = buffer.long
+                    entries[path] = Entry(
+                        path, size, modified, language,
+                        ignored = (flags and FLAG_IGNORED) != 0,
+                        isDirectory = (flags and FLAG_DIRECTORY) != 0,
+                        contentHash = hash
+                    )
+                }
+            }
+        } catch (e: Exception) {
+            // A damaged index is rebuilt by the first walk
+            entries.clear()
+            file.delete()
+        }
+    }
+
+    /**
+     * Stop following changes and delete the store, for a workspace that is going away
+     */
+    private fun close() {
+        released = true
+        tracker?.removeListener(listener)
+        synchronized(this) { storeFile?.delete() }
+    }
+
+    private fun save() {
+        val file = storeFile ?: return
+        if (released) return
+        lastSave = System.currentTimeMillis()
+        dirty = false
+        val temp = File(file.path + ".tmp")
+        try {
+            file.parentFile?.mkdirs()
+            DataOutputStream(temp.outputStream().buffered()).use { out ->
+                out.writeInt(MAGIC)
+                out.writeInt(FORMAT_VERSION)
+                writeString(out, root.absolutePath)
+                out.writeInt(entries.size)
+                for (entry in entries.values) {
+                    writeString(out, entry.path)
+                    out.writeLong(entry.size)
+                    out.writeLong(entry.modified)
+                    out.writeByte(LANGUAGES.indexOf(entry.language) + 1)
+                    var flags = 0
+                    if (entry.ignored) flags = flags or FLAG_IGNORED
+                    if (entry.isDirectory) flags = flags or FLAG_DIRECTORY
+                    out.writeByte(flags)
+                    out.writeLong(entry.contentHash)
+                }
+            }
+            if (!temp.renameTo(file)) temp.delete()
+        } catch (e: IOException) {
+            temp.delete()
+        }
+    }
+
+    private fun readString(buffer: ByteBuffer): String {
+        val bytes = ByteArray(buffer.short.toInt() and 0xFFFF)
+        buffer.get(bytes)
+        return String(bytes, Charsets.UTF_8)
+    }
+
+    private fun writeString(out: DataOutputStream, value: String) {
+        val bytes = value.toByteArray(Charsets.UTF_8)
+        out.writeShort(bytes.size)
+        out.write(bytes)
+    }
+
+    companion object {
+        private const val MAGIC = 0x41574958 // "AWIX"
+        private const val FORMAT_VERSION = 1
+        private const val FLAG_IGNORED = 1
+        private const val FLAG_DIRECTORY = 2
+        private const val SAVE_INTERVAL_MS = 30_000L
+        // Glob, grep and read tools run back to back on the same tree within one agent step
+        private const val UNWATCHED_RESCAN_MS = 2_000L
+
+        /** Stored as a one-byte index, so only append */
+        private val LANGUAGES = listOf(
+            "kotlin", "java", "javascript", "typescript", "python", "go", "rust", "c", "cpp", "csharp",
+            "ruby", "php", "swift", "shell", "html", "css", "json", "yaml", "xml", "markdown", "sql",
+            "gradle", "dart", "lua"
+        )
+
+        private val EXTENSION_LANGUAGES = mapOf(
+            "kt" to "kotlin", "kts" to "kotlin", "java" to "java",
+            "js" to "javascript", "jsx" to "javascript", "mjs" to "javascript", "cjs" to "javascript",
+            "ts" to "typescript", "tsx" to "typescript", "py" to "python", "go" to "go", "rs" to "rust",
+            "c" to "c", "h" to "c", "cpp" to "cpp", "cc" to "cpp", "cxx" to "cpp", "hpp" to "cpp",
+            "cs" to "csharp", "rb" to "ruby", "php" to "php", "swift" to "swift",
+            "sh" to "shell", "bash" to "shell", "zsh" to "shell", "html" to "html", "htm" to "html",
+            "css" to "css", "scss" to "css", "json" to "json", "yml" to "yaml", "yaml" to "yaml",
+            "xml" to "xml", "md" to "markdown", "sql" to "sql", "gradle" to "gradle", "dart" to "dart",
+            "lua" to "lua"
+        )
+
+        private val indexes = ConcurrentHashMap<String, WorkspaceFileIndex>()
+
+        fun languageOf(path: String): String? {
+            return EXTENSION_LANGUAGES[path.substringAfterLast('/').substringAfterLast('.', "").lowercase()]
+        }
+
+        /**
+         * Files under [directory], which may be given as an absolute path. Entry paths are
+         * relative to [workspaceRoot]; a directory outside the workspace is walked live. With
+         * [skipHidden], hidden directories below [directory] are not descended into.
+         */
+        fun filesUnder(workspaceRoot: String, directory: File, includeIgnored: Boolean, skipHidden: Boolean = false): List<Entry> {
+            val root = File(workspaceRoot).absoluteFile.normalize()
+            val dir = directory.absoluteFile.normalize()
+            if (dir == root || dir.path.startsWith(root.path + "/")) {
+                return forWorkspace(workspaceRoot).files(dir.relativeTo(root).path, includeIgnored, skipHidden)
+            }
+            return walkFiles(dir, skipHidden).map { file ->
+                val relative = file.relativeTo(root).path
+                Entry(relative, file.length(), file.lastModified(), languageOf(relative), ignored = false)
+            }.toList()
+        }
+
+        private fun walkFiles(directory: File, skipHidden: Boolean): Sequence<File> {
+            return directory.walkTopDown()
+                .onEnter { dir -> !skipHidden || dir == directory || !dir.name.startsWith(".") }
+                .filter { it.isFile }
+        }
+
+        /**
+         * Drop the shared indexes of [directory] and of workspaces inside it, whose files are going
+         * away, along with their stores
+         */
+        fun release(directory: String) {
+            indexes.keys.filter { isWithin(it, directory) }.forEach { indexes.remove(it)?.close() }
+        }
+
+        /** Whether [path] is [directory] or inside it */
+        internal fun isWithin(path: String, directory: String): Boolean {
+            val normalized = File(path).absoluteFile.normalize().path
+            val parent = File(directory).absoluteFile.normalize().path
+            return normalized == parent || normalized.startsWith("$parent/")
+        }
+
+        /**
+         * Whether a path relative to a search directory passes through a hidden directory
+         */
+        fun isInHiddenDirectory(relativePath: String): Boolean {
+            return relativePath.split('/').dropLast(1).any { it.startsWith(".") && it != "." && it != ".." }
+        }
+
+        /**
+         * Shared index for [workspaceRoot], persisted under the app cache directory
+         */
+        fun forWorkspace(workspaceRoot: String): WorkspaceFileIndex {
+            return indexes.getOrPut(workspaceRoot) {
+                val storeDir = application?.cacheDir?.let { File(it, "workspace-index") }
+                val name = MessageDigest.getInstance("SHA-1")
+                    .digest(File(workspaceRoot).absolutePath.toByteArray())
+                    .joinToString("") { "%02x".format(it) }
+                WorkspaceFileIndex(
+                    workspaceRoot,
+                    WorkspaceChangeTracker.forWorkspace(workspaceRoot),
+                    storeDir?.let { File(it, "$name.idx") }
+                )
+            }
+        }
+    }
+}
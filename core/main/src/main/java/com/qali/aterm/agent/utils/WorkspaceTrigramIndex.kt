@@ -0,0 +1,391 @@
+package com.qali.aterm.agent.utils
+
+import java.io.File
+import java.util.Arrays
+import java.util.BitSet
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.ExecutorService
+import java.util.concurrent.Executors
+import java.util.concurrent.RejectedExecutionException
+import java.util.concurrent.atomic.AtomicLong
+import java.util.regex.Pattern
+
+/**
+ * Trigram index of the file contents of a workspace, used to skip files in searches
+ *
+ * For every indexed file the set of byte trigrams it contains (ASCII letters folded to lower case)
+ * is kept, with a posting list of files per trigram. A file can only contain a literal if it
+ * contains all of the literal's trigrams, so intersecting their posting lists gives the candidate
+ * files and the rest of the workspace is never read.
+ *
+ * The index is built on a background thread from [WorkspaceFileIndex] and updated per file from
+ * [WorkspaceChangeTracker] events. It never has to be complete: a file that is not indexed yet, is
+ * too large or whose size or modification time differs from when it was indexed is always a
+ * candidate, so answers stay correct while the index catches up.
+ *
+ * All indexes share one budget of postings. When a workspace needs more, the indexes of workspaces
+ * searched less recently are dropped; they are built again if searched later.
+ */
+class WorkspaceTrigramIndex internal constructor(
+    val workspaceRoot: String,
+    private val fileIndex: WorkspaceFileIndex,
+    private val tracker: WorkspaceChangeTracker?
+) {
+    /** Trigrams of a file as of [size] and [modified]; [serial] orders (re)indexing */
+    private class IndexedFile(
+        val id: Int,
+        val size: Long,
+        val modified: Long,
+        val serial: Long,
+        val trigrams: IntArray
+    )
+
+    /** Sorted file ids, mostly appended to since ids are handed out in increasing order */
+    private class PostingList {
+        var ids = IntArray(4)
+        var size = 0
+
+        fun add(id: Int) {
+            if (size == 0 || ids[size - 1] < id) {
+                if (size == ids.size) ids = ids.copyOf(size * 2)
+                ids[size++] = id
+                return
+            }
+            val index = Arrays.binarySearch(ids, 0, size, id)
+            if (index >= 0) return
+            val insert = -index - 1
+            if (size == ids.size) ids = ids.copyOf(size * 2)
+            System.arraycopy(ids, insert, ids, insert + 1, size - insert)
+            ids[insert] = id
+            size++
+        }
+
+        fun remove(id: Int) {
+            val index = Arrays.binarySearch(ids, 0, size, id)
+            if (index < 0) return
+            System.arraycopy(ids, index + 1, ids, index, size - index - 1)
+            size--
+        }
+    }
+
+    private val files = HashMap<String, IndexedFile>()
+    private val postings = HashMap<Int, PostingList>()
+    private val freeIds = ArrayDeque<Int>()
+    private var nextId = 0
+    private var serial = 0L
+    private var postingCount = 0L
+    private var closed = false
+
+    private val pending = LinkedHashSet<String>()
+    private var needsResync = true
+    private var scheduled = false
+
+    @Volatile
+    private var lastSync = 0L
+    /** When this index was last searched, to pick which index to drop when over budget */
+    @Volatile
+    private var lastUsed = System.currentTimeMillis()
+    private val executor: ExecutorService = Executors.newSingleThreadExecutor { runnable ->
+        Thread(runnable, "TrigramIndex").apply {
+            isDaemon = true
+            priority = Thread.MIN_PRIORITY
+        }
+    }
+
+    private val listener: (String?) -> Unit = { path ->
+        synchronized(pending) {
+            if (path == null) needsResync = true else pending.add(path)
+        }
+        schedule()
+    }
+
+    init {
+        tracker?.addListener(listener)
+    }
+
+    /** Number of files whose contents are indexed */
+    val indexedFileCount: Int
+        get() = synchronized(this) { files.size }
+
+    /**
+     * Predicate telling whether a file may contain [literal]. Null when the literal is too short
+     * to narrow anything down, in which case every file is a candidate.
+     */
+    fun candidates(literal: String): ((WorkspaceFileIndex.Entry) -> Boolean)? {
+        val queryTrigrams = trigramsOf(literal.toByteArray(Charsets.UTF_8))
+        if (queryTrigrams.isEmpty()) return null
+        lastUsed = System.currentTimeMillis()
+        // Without events, catch up in the background now and then; meanwhile changed files are
+        // told apart by their size and time below, and new ones are not indexed yet
+        if (tracker != null && !tracker.isWatching && System.currentTimeMillis() - lastSync > UNWATCHED_RESYNC_MS) {
+            schedule()
+        }
+
+        // The file index may be a little behind without events, so go by the file itself
+        val live = tracker == null || !tracker.isWatching
+        val matching = BitSet()
+        val querySerial: Long
+        synchronized(this) {
+            querySerial = serial
+            val lists = queryTrigrams.map { postings[it] ?: PostingList() }.sortedBy { it.size }
+            val smallest = lists.first()
+            for (i in 0 until smallest.size) {
+                val id = smallest.ids[i]
+                if (lists.all { Arrays.binarySearch(it.ids, 0, it.size, id) >= 0 }) matching.set(id)
+            }
+        }
+
+        return { entry ->
+            val indexed = synchronized(this@WorkspaceTrigramIndex) { files[entry.path] }
+            val file = if (live) File(workspaceRoot, entry.path) else null
+            indexed == null ||
+                indexed.serial > querySerial ||
+                indexed.size != (file?.length() ?: entry.size) ||
+                indexed.modified != (file?.lastModified() ?: entry.modified) ||
+                matching[indexed.id]
+        }
+    }
+
+    /**
+     * Index the workspace in the background
+     */
+    fun start() {
+        schedule()
+    }
+
+    /**
+     * Bring the index up to date on the calling thread
+     */
+    internal fun sync() {
+        val resync: Boolean
+        val paths: List<String>
+        synchronized(pending) {
+            // Without events only a full pass notices changes
+            resync = needsResync || tracker?.isWatching != true
+            needsResync = false
+            paths = pending.toList()
+            pending.clear()
+        }
+        if (resync) {
+            // The file index only walks again after a while without events; this runs in the background anyway
+            if (tracker?.isWatching != true) fileIndex.invalidate()
+            val entries = fileIndex.files()
+            val present = HashSet<String>(entries.size)
+            for (entry in entries) {
+                present.add(entry.path)
+                update(entry.path, entry)
+            }
+            synchronized(this) { files.keys.filter { it !in present } }.forEach { remove(it) }
+        } else {
+            for (path in paths) {
+                update(path, fileIndex.entry(path))
+            }
+        }
+        lastSync = System.currentTimeMillis()
+    }
+
+    /**
+     * Stop indexing, for a workspace that is going away
+     */
+    private fun close() {
+        tracker?.removeListener(listener)
+        executor.shutdownNow()
+        // A search still holding a predicate sees every file as a candidate from now on
+        synchronized(this) {
+            closed = true
+            totalPostings.addAndGet(-postingCount)
+            postingCount = 0
+            files.clear()
+            postings.clear()
+            freeIds.clear()
+        }
+    }
+
+    private fun schedule() {
+        synchronized(pending) {
+            if (scheduled) return
+            scheduled = true
+        }
+        try {
+            executor.execute {
+                synchronized(pending) { scheduled = false }
+                try {
+                    sync()
+                } catch (e: Exception) {
+                    android.util.Log.w("WorkspaceTrigramIndex", "Indexing $workspaceRoot failed: ${e.message}")
+                }
+            }
+        } catch (e: RejectedExecutionException) {
+            // Released while a search still held the index
+        }
+    }
+
+    private fun update(path: String, entry: WorkspaceFileIndex.Entry?) {
+        if (entry == null || entry.isDirectory) {
+            removeTree(path)
+            return
+        }
+        if (entry.ignored) {
+            remove(path)
+            return
+        }
+        val current = synchronized(this) { files[path] }
+        if (current != null && current.size == entry.size && current.modified == entry.modified) return
+        if (entry.size > MAX_INDEXED_FILE_SIZE) {
+            remove(path)
+            return
+        }
+        val trigrams = try {
+            val bytes = File(workspaceRoot, path).readBytes()
+            // Binary files are skipped by the searches anyway; unindexed, they stay candidates
+            if (isBinary(bytes)) null else trigramsOf(bytes)
+        } catch (e: Exception) {
+            null
+        }
+
+        // Dropping other indexes takes their locks, so it happens before taking this one
+        val fits = trigrams != null && makeRoom(this, trigrams.size)
+
+        synchronized(this) {
+            removeLocked(path)
+            if (trigrams == null || closed) return
+            // Past the budget, new files stay unindexed and are simply always searched
+            if (!fits || totalPostings.get() + trigrams.size > MAX_POSTINGS) return
+            val id = freeIds.removeFirstOrNull() ?: nextId++
+            val indexed = IndexedFile(id, entry.size, entry.modified, ++serial, trigrams)
+            files[path] = indexed
+            for (trigram in trigrams) postings.getOrPut(trigram) { PostingList() }.add(id)
+            postingCount += trigrams.size
+            totalPostings.addAndGet(trigrams.size.toLong())
+        }
+    }
+
+    private fun remove(path: String) {
+        synchronized(this) { removeLocked(path) }
+    }
+
+    /** Remove [path] or, if it was a directory, every file indexed below it */
+    private fun removeTree(path: String) {
+        synchronized(this) {
+            if (files.containsKey(path)) {
+                removeLocked(path)
+                return
+            }
+            val prefix = "$path/"
+            files.keys.filter { it.startsWith(prefix) }.forEach { removeLocked(it) }
+        }
+    }
+
+    private fun removeLocked(path: String) {
+        val indexed = files.remove(path) ?: return
+        for (trigram in indexed.trigrams) {
+            val list = postings[trigram] ?: continue
+            list.remove(indexed.id)
+            if (list.size == 0) postings.remove(trigram)
+        }
+        postingCount -= indexed.trigrams.size
+        totalPostings.addAndGet(-indexed.trigrams.size.toLong())
+        freeIds.addLast(indexed.id)
+    }
+
+    companion object {
+        private const val MAX_INDEXED_FILE_SIZE = 1L * 1024 * 1024
+        // About 4 bytes each, plus the per-file copy; shared by the indexes of all workspaces
+        private const val MAX_POSTINGS = 8_000_000L
+        private const val BINARY_PROBE_SIZE = 8192
+        private const val UNWATCHED_RESYNC_MS = 60_000L
+
+        private val indexes = ConcurrentHashMap<String, WorkspaceTrigramIndex>()
+        private val totalPostings = AtomicLong()
+
+        /**
+         * Shared index for [workspaceRoot], which starts building in the background on first use
+         */
+        fun forWorkspace(workspaceRoot: String): WorkspaceTrigramIndex {
+            return indexes.getOrPut(workspaceRoot) {
+                WorkspaceTrigramIndex(
+                    workspaceRoot,
+                    WorkspaceFileIndex.forWorkspace(workspaceRoot),
+                    WorkspaceChangeTracker.forWorkspace(workspaceRoot)
+                ).also { it.start() }
+            }
+        }
+
+        /**
+         * Drop the indexes of workspaces searched less recently than [index] until [count] more
+         * postings fit in the budget. False if they still do not fit.
+         */
+        private fun makeRoom(index: WorkspaceTrigramIndex, count: Int): Boolean {
+            while (totalPostings.get() + count > MAX_POSTINGS) {
+                val oldest = indexes.values
+                    .filter { it !== index && it.lastUsed < index.lastUsed }
+                    .minByOrNull { it.lastUsed } ?: return false
+                if (indexes.remove(oldest.workspaceRoot, oldest)) {
+                    android.util.Log.i("WorkspaceTrigramIndex", "Dropping the index of ${oldest.workspaceRoot} to stay in budget")
+                    oldest.close()
+                }
+            }
+            return true
+        }
+
+        /**
+         * Drop the shared indexes of [directory] and of workspaces inside it, whose files are going away
+         */
+        fun release(directory: String) {
+            indexes.keys.filter { WorkspaceFileIndex.isWithin(it, directory) }.forEach { indexes.remove(it)?.close() }
+        }
+
+        /**
+         * Drop all shared indexes, when searches stop using them
+         */
+        fun releaseAll() {
+            indexes.keys.toList().forEach { indexes.remove(it)?.close() }
+        }
+
+        /**
+         * Candidate predicate for a search with [pattern] in [workspaceRoot], or null when the
+         * pattern has no literal the index can use
+         */
+        fun candidatesFor(workspaceRoot: String, pattern: Pattern): ((WorkspaceFileIndex.Entry) -> Boolean)? {
+            val literal = NativeFileSearch.literalOf(pattern) ?: return null
+            return forWorkspace(workspaceRoot).candidates(literal)
+        }
+
+        /**
+         * Sorted distinct trigrams of [bytes], ASCII letters folded to lower case. Trigrams that
+         * span a line break are left out, since searches match single lines.
+         */
+        internal fun trigramsOf(bytes: ByteArray): IntArray {
+            if (bytes.size < 3) return IntArray(0)
+            val all = IntArray(bytes.size - 2)
+            var count = 0
+            var a = fold(bytes[0])
+            var b = fold(bytes[1])
+            for (i in 2 until bytes.size) {
+                val c = fold(bytes[i])
+                if (a != '\n'.code && b != '\n'.code && c != '\n'.code) {
+                    all[count++] = (a shl 16) or (b shl 8) or c
+                }
+                a = b
+                b = c
+            }
+            all.sort(0, count)
+            var distinct = 0
+            for (i in 0 until count) {
+                if (distinct == 0 || all[distinct - 1] != all[i]) all[distinct++] = all[i]
+            }
+            return all.copyOf(distinct)
+        }
+
+        private fun fold(byte: Byte): Int {
+            val value = byte.toInt() and 0xff
+            return if (value in 'A'.code..'Z'.code) value + ('a' - 'A') else value
+        }
+
+        private fun isBinary(bytes: ByteArray): Boolean {
+            val end = minOf(bytes.size, BINARY_PROBE_SIZE)
+            for (i in 0 until end) if (bytes[i] == 0.toByte()) return true
+            return false
+        }
+    }
+}
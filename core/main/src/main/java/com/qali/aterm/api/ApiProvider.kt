@@ -271,6 +271,15 @@ object ApiProviderManager {
         }
     }
     
+    // Get the URL model requests for the current provider are sent to, null if it is not known yet
+    fun getCurrentEndpointUrl(): String? {
+        return when (selectedProvider) {
+            ApiProviderType.OPENAI -> "https://api.openai.com/v1"
+            ApiProviderType.ANTHROPIC -> "https://api.anthropic.com/v1"
+            else -> getCurrentBaseUrl().ifBlank { null }
+        }
+    }
+    
     // Add API key to provider
     fun addApiKey(providerType: ApiProviderType, apiKey: ApiKey) {
         val providers = getProviders().toMutableMap()
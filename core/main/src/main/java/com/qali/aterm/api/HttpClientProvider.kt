@@ -0,0 +1,253 @@
+package com.qali.aterm.api
+
+import okhttp3.Call
+import okhttp3.Callback
+import okhttp3.Connection
+import okhttp3.ConnectionPool
+import okhttp3.Dispatcher
+import okhttp3.EventListener
+import okhttp3.Handshake
+import okhttp3.HttpUrl.Companion.toHttpUrlOrNull
+import okhttp3.OkHttpClient
+import okhttp3.Protocol
+import okhttp3.Request
+import okhttp3.Response
+import java.io.IOException
+import java.net.InetAddress
+import java.net.InetSocketAddress
+import java.net.Proxy
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.CopyOnWriteArrayList
+import java.util.concurrent.TimeUnit
+
+/**
+ * App-wide HTTP client
+ *
+ * Every HTTP caller (model clients, web tools, downloader) derives its client from [client] via
+ * [newClient], so they all share one connection pool and dispatcher. A connection that has done
+ * its TLS handshake is reused by the next call to the same host, and HTTP/2 streams to one
+ * provider are multiplexed over a single connection instead of each opening their own.
+ *
+ * Each call is timed (DNS, connect, TLS, time to first byte, transfer) and reported to
+ * [addTimingListener] listeners and [recentTimings].
+ */
+object HttpClientProvider {
+
+    /**
+     * Phase timings of one HTTP call in milliseconds. Phases that did not happen (DNS and connect on
+     * a reused connection, TLS on plain HTTP) are 0.
+     */
+    data class RequestTiming(
+        val method: String,
+        val url: String,
+        val protocol: String?,
+        val connectionReused: Boolean,
+        val dnsMs: Long,
+        val connectMs: Long,
+        val tlsMs: Long,
+        val ttfbMs: Long,
+        val transferMs: Long,
+        val totalMs: Long,
+        val success: Boolean
+    )
+
+    private const val MAX_RECENT_TIMINGS = 50
+    private const val PREWARM_INTERVAL_MS = 60_000L
+
+    private val connectionPool = ConnectionPool(16, 5, TimeUnit.MINUTES)
+
+    private val dispatcher = Dispatcher().apply {
+        maxRequests = 64
+        maxRequestsPerHost = 16
+    }
+
+    private val timingListeners = CopyOnWriteArrayList<(RequestTiming) -> Unit>()
+    private val recent = ArrayDeque<RequestTiming>()
+    private val lastPrewarm = ConcurrentHashMap<String, Long>()
+
+    /**
+     * Base client. Use [newClient] for different timeouts; derived clients keep the shared pools.
+     */
+    val client: OkHttpClient by lazy {
+        OkHttpClient.Builder()
+            .connectionPool(connectionPool)
+            .dispatcher(dispatcher)
+            .protocols(listOf(Protocol.HTTP_2, Protocol.HTTP_1_1))
+            .connectTimeout(30, TimeUnit.SECONDS)
+            .readTimeout(60, TimeUnit.SECONDS)
+            .writeTimeout(30, TimeUnit.SECONDS)
+            .retryOnConnectionFailure(true)
+            .eventListenerFactory { TimingEventListener() }
+            .build()
+    }
+
+    /**
+     * Client with its own timeouts that shares the connection pool, dispatcher and timing
+     * instrumentation of [client]. Cheap to call, but callers should still keep the result.
+     */
+    fun newClient(
+        connectTimeoutSeconds: Long = 30,
+        readTimeoutSeconds: Long = 60,
+        writeTimeoutSeconds: Long = 30
+    ): OkHttpClient {
+        return client.newBuilder()
+            .connectTimeout(connectTimeoutSeconds, TimeUnit.SECONDS)
+            .readTimeout(readTimeoutSeconds, TimeUnit.SECONDS)
+            .writeTimeout(writeTimeoutSeconds, TimeUnit.SECONDS)
+            .build()
+    }
+
+    /**
+     * Open a connection to the host of [url] in the background so the first real request skips
+     * DNS, TCP and TLS setup. Repeated calls for the same host within a minute are ignored.
+     */
+    fun prewarm(url: String) {
+        val httpUrl = url.toHttpUrlOrNull() ?: return
+        val origin = "${httpUrl.scheme}://${httpUrl.host}:${httpUrl.port}/"
+        val now = System.currentTimeMillis()
+        val last = lastPrewarm[origin]
+        if (last != null && now - last < PREWARM_INTERVAL_MS) return
+        lastPrewarm[origin] = now
+
+        val request = Request.Builder().url(origin).head().build()
+        client.newCall(request).enqueue(object : Callback {
+            override fun onFailure(call: Call, e: IOException) {
+                // A failed warm-up only means the first real request pays for the handshake
+                lastPrewarm.remove(origin)
+            }
+
+            override fun onResponse(call: Call, response: Response) {
+                response.close()
+            }
+        })
+    }
+
+    fun addTimingListener(listener: (RequestTiming) -> Unit) {
+        timingListeners.add(listener)
+    }
+
+    fun removeTimingListener(listener: (RequestTiming) -> Unit) {
+        timingListeners.remove(listener)
+    }
+
+    /** Timings of the most recent calls, oldest first */
+    fun recentTimings(): List<RequestTiming> {
+        return synchronized(recent) { recent.toList() }
+    }
+
+    private fun report(timing: RequestTiming) {
+        synchronized(recent) {
+            if (recent.size >= MAX_RECENT_TIMINGS) {
+                recent.removeFirst()
+            }
+            recent.addLast(timing)
+        }
+        for (listener in timingListeners) {
+            try {
+                listener(timing)
+            } catch (e: Exception) {
+                // Instrumentation must never break the call it observes
+            }
+        }
+    }
+
+    /**
+     * Records phase boundaries of one call. OkHttp creates one listener per call, so no locking is
+     * needed; times are nanoTime values, 0 when the phase did not occur.
+     */
+    private class TimingEventListener : EventListener() {
+        private var callStart = 0L
+        private var dnsStart = 0L
+        private var dnsEnd = 0L
+        private var connectStart = 0L
+        private var connectEnd = 0L
+        private var secureStart = 0L
+        private var secureEnd = 0L
+        private var requestStart = 0L
+        private var responseHeadersStart = 0L
+        private var responseBodyEnd = 0L
+        private var protocol: Protocol? = null
+        private var newConnection = false
+
+        override fun callStart(call: Call) {
+            callStart = System.nanoTime()
+        }
+
+        override fun dnsStart(call: Call, domainName: String) {
+            dnsStart = System.nanoTime()
+        }
+
+        override fun dnsEnd(call: Call, domainName: String, inetAddressList: List<InetAddress>) {
+            dnsEnd = System.nanoTime()
+        }
+
+        override fun connectStart(call: Call, inetSocketAddress: InetSocketAddress, proxy: Proxy) {
+            if (connectStart == 0L) connectStart = System.nanoTime()
+            newConnection = true
+        }
+
+        override fun secureConnectStart(call: Call) {
+            secureStart = System.nanoTime()
+        }
+
+        override fun secureConnectEnd(call: Call, handshake: Handshake?) {
+            secureEnd = System.nanoTime()
+        }
+
+        override fun connectEnd(call: Call, inetSocketAddress: InetSocketAddress, proxy: Proxy, protocol: Protocol?) {
+            connectEnd = System.nanoTime()
+            this.protocol = protocol
+        }
+
+        override fun connectionAcquired(call: Call, connection: Connection) {
+            protocol = connection.protocol()
+        }
+
+        override fun requestHeadersStart(call: Call) {
+            if (requestStart == 0L) requestStart = System.nanoTime()
+        }
+
+        override fun responseHeadersStart(call: Call) {
+            responseHeadersStart = System.nanoTime()
+        }
+
+        override fun responseBodyEnd(call: Call, byteCount: Long) {
+            responseBodyEnd = System.nanoTime()
+        }
+
+        override fun callEnd(call: Call) {
+            finish(call, true)
+        }
+
+        override fun callFailed(call: Call, ioe: IOException) {
+            finish(call, false)
+        }
+
+        private fun finish(call: Call, success: Boolean) {
+            val end = System.nanoTime()
+            // Phases are measured from the end of the previous one; a connect includes TLS, so TLS is subtracted
+            val tls = span(secureStart, secureEnd)
+            val bodyEnd = if (responseBodyEnd != 0L) responseBodyEnd else end
+            report(
+                RequestTiming(
+                    method = call.request().method,
+                    // Query dropped so API keys passed as ?key= never reach listeners
+                    url = call.request().url.newBuilder().query(null).build().toString(),
+                    protocol = protocol?.toString(),
+                    connectionReused = !newConnection,
+                    dnsMs = span(dnsStart, dnsEnd),
+                    connectMs = (span(connectStart, connectEnd) - tls).coerceAtLeast(0),
+                    tlsMs = tls,
+                    ttfbMs = span(requestStart, responseHeadersStart),
+                    transferMs = span(responseHeadersStart, bodyEnd),
+                    totalMs = span(callStart, end),
+                    success = success
+                )
+            )
+        }
+
+        private fun span(start: Long, end: Long): Long {
+            return if (start == 0L || end < start) 0L else TimeUnit.NANOSECONDS.toMillis(end - start)
+        }
+    }
+}
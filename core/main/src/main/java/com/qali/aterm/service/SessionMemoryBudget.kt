@@ -0,0 +1,73 @@
+package com.qali.aterm.service
+
+import android.os.SystemClock
+import com.termux.terminal.TerminalSession
+
+/**
+ * A memory budget shared by the terminal buffers of all sessions. Each session sizes its own transcript, so a dozen
+ * sessions with long scrollback could together run the app out of heap. When the buffers take more than the budget,
+ * the transcripts of sessions which are not on screen are compacted, least recently viewed first. A compacted
+ * transcript is expanded again when its session is attached to the terminal view. A session compacted less than
+ * [MIN_COMPACT_INTERVAL_MS] ago is left alone, as little of its transcript can be new.
+ */
+class SessionMemoryBudget(private val budgetBytes: Long) {
+
+    /** The memory taken by the buffers of a session, for diagnostics. */
+    data class Allocation(val bytes: Long, val transcriptCompacted: Boolean)
+
+    private val lastViewed = hashMapOf<String, Long>()
+    private val lastCompacted = hashMapOf<String, Long>()
+
+    /** Note that a session is on screen, which makes it the last to be compacted. */
+    fun onViewed(id: String) {
+        lastViewed[id] = SystemClock.uptimeMillis()
+    }
+
+    fun remove(id: String) {
+        lastViewed.remove(id)
+        lastCompacted.remove(id)
+    }
+
+    fun clear() {
+        lastViewed.clear()
+        lastCompacted.clear()
+    }
+
+    /**
+     * Compact the transcripts of sessions other than the one on screen, least recently viewed first and never viewed
+     * ones before all, until the buffers of all sessions fit in the budget. Must be called on the main thread.
+     */
+    fun enforce(sessions: Map<String, TerminalSession>, viewedId: String?, budget: Long = budgetBytes) {
+        var total = sessions.values.sumOf { it.emulator?.allocatedBytes ?: 0L }
+        if (total <= budget) return
+        val now = SystemClock.uptimeMillis()
+        val candidates = sessions.filterKeys { it != viewedId }.entries.sortedBy { lastViewed[it.key] ?: 0L }
+        for ((id, session) in candidates) {
+            if (total <= budget) break
+            val emulator = session.emulator ?: continue
+            val compactedAt = lastCompacted[id]
+            if (compactedAt != null && now - compactedAt < MIN_COMPACT_INTERVAL_MS && emulator.isTranscriptCompacted) continue
+            lastCompacted[id] = now
+            val freed = emulator.compactTranscript()
+            if (freed > 0) {
+                total -= freed
+                android.util.Log.d("SessionMemoryBudget", "Compacted transcript of session $id, freed ${freed / 1024} KiB")
+            }
+        }
+    }
+
+    fun allocations(sessions: Map<String, TerminalSession>): Map<String, Allocation> {
+        return sessions.mapValues { (_, session) ->
+            val emulator = session.emulator
+            Allocation(emulator?.allocatedBytes ?: 0L, emulator?.isTranscriptCompacted ?: false)
+        }
+    }
+
+    companion object {
+        /** How long after compacting a session it is not compacted again. */
+        const val MIN_COMPACT_INTERVAL_MS = 30_000L
+
+        /** The share of the heap limit which terminal buffers may take before background ones are compacted. */
+        fun defaultBudgetBytes() = Runtime.getRuntime().maxMemory() / 8
+    }
+}
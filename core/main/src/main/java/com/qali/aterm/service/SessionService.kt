@@ -1,24 +1,37 @@
 package com.qali.aterm.service
 
 import android.app.*
+import android.content.ComponentCallbacks2
 import android.content.Intent
 import android.content.pm.ServiceInfo
 import android.os.Binder
 import android.os.Build
+import android.os.Handler
 import android.os.IBinder
+import android.os.Looper
 import androidx.annotation.RequiresApi
 import androidx.compose.runtime.mutableStateListOf
 import androidx.compose.runtime.mutableStateMapOf
 import androidx.compose.runtime.mutableStateOf
 import androidx.core.app.NotificationCompat
+import com.qali.aterm.agent.debug.TraceRecorder
+import com.qali.aterm.agent.tools.McpServerManager
+import com.qali.aterm.agent.utils.WorkspaceChangeTracker
+import com.qali.aterm.agent.utils.WorkspaceFileIndex
+import com.qali.aterm.agent.utils.WorkspaceTrigramIndex
 import com.rk.resources.drawables
 import com.rk.resources.strings
 import com.qali.aterm.ui.activities.terminal.MainActivity
 import com.qali.aterm.ui.screens.settings.Settings
 import com.qali.aterm.ui.screens.terminal.MkSession
+import com.qali.aterm.ui.screens.terminal.RootfsClone
 import com.termux.terminal.TerminalSession
 import com.termux.terminal.TerminalSessionClient
+import com.termux.terminal.TerminalSnapshot
+import com.termux.terminal.TerminalSnapshotWriter
 import okhttp3.internal.wait
+import java.io.File
+import java.util.concurrent.Executors
 
 enum class TabType {
     TERMINAL,
@@ -37,6 +50,25 @@ class SessionService : Service() {
     private val sessionGroups = mutableMapOf<String, List<String>>()
     // Track working mode for each session (including hidden ones)
     private val sessionWorkingModes = mutableMapOf<String, Int>()
+    // Track rootfs clones owned by sessions, deleted when the session is terminated
+    private val sessionRootfsClones = mutableMapOf<String, String>()
+    // Snapshot of the startup session's screen, shown again when it is created after the process was killed
+    private val snapshotWriters = mutableMapOf<String, TerminalSnapshotWriter>()
+    private val snapshotExecutor = Executors.newSingleThreadExecutor { Thread(it, "SessionSnapshotWriter") }
+    // Ids of the snapshots an earlier process left, until the startup session is created
+    private var leftoverSnapshots: Set<String>? = null
+    // Keeps the buffers of all sessions within a share of the heap by compacting background transcripts
+    private val memoryBudget = SessionMemoryBudget(SessionMemoryBudget.defaultBudgetBytes())
+    private val housekeepingHandler = Handler(Looper.getMainLooper())
+    private val housekeepingRunnable = object : Runnable {
+        override fun run() {
+            snapshotSessions()
+            val viewedId = currentSession.value.first
+            memoryBudget.onViewed(viewedId)
+            memoryBudget.enforce(sessions, viewedId)
+            housekeepingHandler.postDelayed(this, HOUSEKEEPING_INTERVAL_MS)
+        }
+    }
 
     inner class SessionBinder : Binder() {
         fun getService():SessionService{
@@ -51,16 +83,24 @@ class SessionService : Service() {
             hiddenSessions.clear()
             sessionGroups.clear()
             sessionWorkingModes.clear()
+            sessionRootfsClones.keys.toList().forEach { deleteRootfsClone(it) }
+            snapshotWriters.keys.toList().forEach { deleteSnapshot(it) }
+            memoryBudget.clear()
             updateNotification()
         }
-        fun createSession(id: String, client: TerminalSessionClient, activity: MainActivity,workingMode:Int): TerminalSession {
-            return MkSession.createSession(activity, client, id, workingMode = workingMode).also {
+        fun createSession(id: String, client: TerminalSessionClient, activity: MainActivity,workingMode:Int, rootfsClone: String? = null): TerminalSession {
+            return MkSession.createSession(activity, client, id, workingMode = workingMode, rootfsClone = rootfsClone).also {
                 // Mark visible sessions as visible (default is true, but be explicit)
                 it.setVisible(true)
                 android.util.Log.d("SessionService", "Created visible session: $id (workingMode: $workingMode)")
+                attachSnapshot(id, it)
+                if (com.rk.settings.Settings.record_sessions) startRecording(id, it)
                 sessions[id] = it
                 sessionList[id] = workingMode
                 sessionWorkingModes[id] = workingMode // Store working mode for all sessions
+                if (rootfsClone != null) {
+                    sessionRootfsClones[id] = rootfsClone
+                }
                 updateNotification()
             }
         }
@@ -102,6 +142,26 @@ class SessionService : Service() {
         fun getSession(id: String): TerminalSession? {
             return sessions[id]
         }
+        
+        fun getSessions(): Map<String, TerminalSession> {
+            return sessions.toMap()
+        }
+
+        /** Start or stop recording the output of every session, after the setting was changed. */
+        fun setRecording(enabled: Boolean) {
+            sessions.forEach { (id, session) ->
+                if (!enabled) {
+                    session.stopRecording()
+                } else if (session.isRunning && session.recordingFile == null) {
+                    startRecording(id, session)
+                }
+            }
+        }
+
+        /** The memory taken by the buffers of each session, for diagnostics. Must be called on the main thread. */
+        fun getSessionAllocations(): Map<String, SessionMemoryBudget.Allocation> {
+            return memoryBudget.allocations(sessions)
+        }
         fun terminateSession(id: String) {
             runCatching {
                 // Terminate the main session
@@ -114,6 +174,9 @@ class SessionService : Service() {
                 sessions.remove(id)
                 sessionList.remove(id)
                 sessionWorkingModes.remove(id)
+                deleteRootfsClone(id)
+                deleteSnapshot(id)
+                memoryBudget.remove(id)
                 
                 // Also terminate associated hidden sessions
                 sessionGroups[id]?.forEach { hiddenId ->
@@ -125,6 +188,8 @@ class SessionService : Service() {
                     sessions.remove(hiddenId)
                     hiddenSessions.remove(hiddenId)
                     sessionWorkingModes.remove(hiddenId)
+                    deleteSnapshot(hiddenId)
+                    memoryBudget.remove(hiddenId)
                 }
                 sessionGroups.remove(id)
                 
@@ -138,6 +203,76 @@ class SessionService : Service() {
         }
     }
 
+    /**
+     * Delete the rootfs clone owned by a session, if any. Runs in the background since the
+     * session's proot may still be exiting and removing a large tree takes a moment.
+     */
+    private fun deleteRootfsClone(sessionId: String) {
+        val cloneId = sessionRootfsClones.remove(sessionId) ?: return
+        // Agent workspaces inside the clone would otherwise keep their indexes, watches and MCP servers
+        val cloneDir = RootfsClone.getCloneDir(cloneId).absolutePath
+        McpServerManager.closeWorkspace(cloneDir)
+        WorkspaceTrigramIndex.release(cloneDir)
+        WorkspaceFileIndex.release(cloneDir)
+        WorkspaceChangeTracker.release(cloneDir)
+        Thread {
+            runCatching { RootfsClone.deleteClone(cloneId) }
+                .onFailure { android.util.Log.w("SessionService", "Failed to delete rootfs clone $cloneId", it) }
+        }.start()
+    }
+
+    /** Record the output of a session to a new asciicast file next to the exported traces. */
+    private fun startRecording(id: String, session: TerminalSession) {
+        val file = TraceRecorder.newRecordingFile(id) ?: return
+        runCatching { session.startRecording(file) }
+            .onFailure { android.util.Log.w("SessionService", "Failed starting recording of session $id", it) }
+    }
+
+    private fun snapshotDir() = File(filesDir, "session-snapshots")
+
+    /**
+     * Show the snapshot an earlier process left for this session id, if any, and keep a snapshot of the new session
+     * from now on. The snapshot file is only read here, which takes milliseconds, the shell starts as usual.
+     *
+     * Only the session the app opens on start is restored. Other tabs and agent sessions are not recreated, and tab
+     * ids are reused for new tabs, so no snapshots are kept for them. Snapshots earlier versions left for them are
+     * deleted when the startup session is created.
+     */
+    private fun attachSnapshot(id: String, session: TerminalSession) {
+        if (!com.rk.settings.Settings.restore_sessions || id != RESTORED_SESSION_ID) return
+        val file = File(snapshotDir(), "$id.snapshot")
+        val leftover = leftoverSnapshots
+        if (leftover != null) {
+            leftoverSnapshots = null
+            if (id in leftover) {
+                runCatching { TerminalSnapshot.read(file) }
+                    .onSuccess { snapshot -> snapshot?.let { session.setRestoredSnapshot(it) } }
+                    .onFailure { android.util.Log.w("SessionService", "Failed reading snapshot of session $id", it) }
+            }
+            val stale = leftover - id
+            snapshotExecutor.execute { stale.forEach { File(snapshotDir(), "$it.snapshot").delete() } }
+        }
+        snapshotDir().mkdirs()
+        snapshotWriters[id] = TerminalSnapshotWriter(file)
+    }
+
+    /** Take snapshots of the sessions changed since the last call and write them in the background. */
+    private fun snapshotSessions() {
+        snapshotWriters.forEach { (id, writer) ->
+            val emulator = sessions[id]?.emulator ?: return@forEach
+            val snapshot = writer.takeSnapshot(emulator) ?: return@forEach
+            snapshotExecutor.execute {
+                runCatching { writer.write(snapshot) }
+                    .onFailure { android.util.Log.w("SessionService", "Failed writing snapshot of session $id", it) }
+            }
+        }
+    }
+
+    private fun deleteSnapshot(sessionId: String) {
+        val writer = snapshotWriters.remove(sessionId) ?: return
+        snapshotExecutor.execute { writer.delete() }
+    }
+
     private val binder = SessionBinder()
     private val notificationManager by lazy {
         getSystemService(NotificationManager::class.java)
@@ -149,9 +284,23 @@ class SessionService : Service() {
 
     override fun onDestroy() {
         sessions.forEach { s -> s.value.finishIfRunning() }
+        housekeepingHandler.removeCallbacks(housekeepingRunnable)
+        snapshotExecutor.shutdown()
+        McpServerManager.shutdown()
         super.onDestroy()
     }
 
+    override fun onTrimMemory(level: Int) {
+        super.onTrimMemory(level)
+        // Once in the background the process may be killed at any time, so save the latest screens now
+        if (level >= ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN) snapshotSessions()
+        // Memory is short, so compact every transcript that is not on screen
+        if (level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_LOW || level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL
+            || level >= ComponentCallbacks2.TRIM_MEMORY_BACKGROUND) {
+            memoryBudget.enforce(sessions, currentSession.value.first, budget = 0)
+        }
+    }
+
     override fun onCreate() {
         super.onCreate()
         if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
@@ -164,6 +313,23 @@ class SessionService : Service() {
         } else {
             startForeground(1, notification)
         }
+
+        housekeepingHandler.postDelayed(housekeepingRunnable, HOUSEKEEPING_INTERVAL_MS)
+        // Clones of sessions that died with an earlier process are not owned by anyone any more
+        RootfsClone.deleteOrphanedClones(sessionRootfsClones.values.toSet())
+        if (com.rk.settings.Settings.agent_sandbox_rootfs) {
+            // The next agent session then takes a clone without waiting for the copy
+            RootfsClone.prepareSpareForWorkingMode(com.rk.settings.Settings.working_Mode)
+        }
+        if (!com.rk.settings.Settings.restore_sessions) {
+            snapshotExecutor.execute { snapshotDir().deleteRecursively() }
+        } else {
+            leftoverSnapshots = snapshotDir().list()
+                ?.filter { it.endsWith(".snapshot") }
+                ?.map { it.removeSuffix(".snapshot") }
+                ?.toSet()
+                .orEmpty()
+        }
     }
 
 
@@ -171,6 +337,7 @@ class SessionService : Service() {
         when (intent?.action) {
             "ACTION_EXIT" -> {
                 sessions.forEach { s -> s.value.finishIfRunning() }
+                snapshotWriters.keys.toList().forEach { deleteSnapshot(it) }
                 stopSelf()
             }
         }
@@ -207,6 +374,12 @@ class SessionService : Service() {
 
     private val CHANNEL_ID = "session_service_channel"
 
+    private companion object {
+        const val HOUSEKEEPING_INTERVAL_MS = 2000L
+        // The session the terminal screen opens on start, see currentSession
+        const val RESTORED_SESSION_ID = "main"
+    }
+
     @RequiresApi(Build.VERSION_CODES.O)
     private fun createNotificationChannel() {
         val channel = NotificationChannel(
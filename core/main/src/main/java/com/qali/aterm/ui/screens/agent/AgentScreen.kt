@@ -36,6 +36,7 @@ import androidx.compose.ui.unit.sp
 import com.qali.aterm.api.ApiProviderManager
 import com.qali.aterm.api.ApiProviderManager.KeysExhaustedException
 import com.qali.aterm.api.ApiProviderType
+import com.qali.aterm.api.HttpClientProvider
 import com.qali.aterm.agent.AgentService
 import com.qali.aterm.agent.HistoryPersistenceService
 import com.qali.aterm.agent.SessionMetadata
@@ -1928,6 +1929,13 @@ fun AgentScreen(
         }
     }
     
+    // Open the connection to the model provider while the user is still typing the first prompt
+    LaunchedEffect(Unit) {
+        withContext(Dispatchers.IO) {
+            ApiProviderManager.getCurrentEndpointUrl()?.let { HttpClientProvider.prewarm(it) }
+        }
+    }
+    
     // Ensure agent session exists when AgentScreen opens
     // This creates the hidden terminal session for the agent if it doesn't exist
     LaunchedEffect(sessionId) {
@@ -1966,7 +1974,40 @@ fun AgentScreen(
                         override fun logStackTrace(tag: String?, e: Exception?) {}
                     }
                     
-                    val agentSession = mainActivity.sessionBinder!!.createSession(agentSessionId, agentClient, mainActivity, workingMode)
+                    // Give the agent its own copy of the rootfs so its experiments don't touch the user's environment
+                    val rootfsClone = if (Settings.agent_sandbox_rootfs) {
+                        val rootfsFileName = com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsFileName(workingMode)
+                        val baseDirName = com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsDirName(rootfsFileName)
+                        // Without a spare copied ahead of time the whole rootfs is copied now
+                        if (!com.qali.aterm.ui.screens.terminal.RootfsClone.isSpareReady(baseDirName)) {
+                            com.rk.libcommons.toast("Copying the rootfs for the sandboxed agent session, this can take a few minutes")
+                        }
+                        withContext(Dispatchers.IO) {
+                            runCatching {
+                                com.qali.aterm.ui.screens.terminal.RootfsClone.createClone(baseDirName, agentSessionId)
+                            }.onFailure {
+                                android.util.Log.w("AgentScreen", "Rootfs clone failed, agent will share the rootfs: ${it.message}")
+                            }.getOrNull()
+                        }
+                    } else {
+                        null
+                    }
+                    if (rootfsClone != null) {
+                        // A workspace inside the base rootfs moves to the same place inside the clone
+                        val baseRootfs = com.rk.libcommons.getRootfsDirForSession(sessionId, workingMode)
+                        val workspace = File(workspaceRoot)
+                        if (workspace.startsWith(baseRootfs)) {
+                            workspaceRoot = rootfsClone.resolve(workspace.relativeTo(baseRootfs)).absolutePath
+                        }
+                    }
+                    
+                    val agentSession = mainActivity.sessionBinder!!.createSession(
+                        agentSessionId,
+                        agentClient,
+                        mainActivity,
+                        workingMode,
+                        rootfsClone = rootfsClone?.let { agentSessionId }
+                    )
                     // Mark as hidden/headless - this prevents UI operations like text selection
                     agentSession.setVisible(false)
                     android.util.Log.d("AgentScreen", "Created hidden agent session: $agentSessionId with working mode: $workingMode")
@@ -2018,9 +2059,13 @@ fun AgentScreen(
         val loadedHistory = HistoryPersistenceService.loadHistory(sessionId)
         val loadedMetadata = HistoryPersistenceService.loadSessionMetadata(sessionId)
         
-        // Restore workspace directory
+        // Restore workspace directory, unless it was a rootfs clone which has been deleted since
         loadedMetadata?.workspaceRoot?.let {
-            workspaceRoot = it
+            if (File(it).isDirectory && !com.qali.aterm.ui.screens.terminal.RootfsClone.isDeletedClonePath(it)) {
+                workspaceRoot = it
+            } else {
+                android.util.Log.w("AgentScreen", "Saved workspace $it is gone, keeping $workspaceRoot")
+            }
         }
         
         if (loadedHistory.isNotEmpty()) {
@@ -2384,6 +2429,7 @@ fun AgentScreen(
                                             var chunkCount: Int = 0,
                                             var toolCallCount: Int = 0,
                                             var toolResultCount: Int = 0,
+                                            var firstChunkTime: Long = 0L,
                                             var doneEventReceived: Boolean = false
                                         )
                                         val execState = ExecutionState()
@@ -2637,6 +2683,11 @@ fun AgentScreen(
                                                             }
                                                             is AgentEvent.Chunk -> {
                                                                 execState.chunkCount++
+                                                                if (execState.firstChunkTime == 0L) {
+                                                                    // Chunks are streamed from the provider, so this is the real time to first token
+                                                                    execState.firstChunkTime = eventTime
+                                                                    android.util.Log.d("AgentScreen", "Time to first token: ${timeSinceStart}ms")
+                                                                }
                                                                 android.util.Log.d("AgentScreen", "Processing Chunk event (count: ${execState.chunkCount}, size: ${event.text.length})")
                                                                 withContext(Dispatchers.Main) {
                                                                     currentResponseText += event.text
@@ -3161,7 +3212,7 @@ fun AgentScreen(
                                 items(allSessionIds.size) { index ->
                                     val savedSessionId = allSessionIds[index]
                                     val metadata = sessionMetadataMap[savedSessionId]
-                                    val messageCount = HistoryPersistenceService.loadHistory(savedSessionId).size
+                                    val messageCount = HistoryPersistenceService.getMessageCount(savedSessionId)
                                     
                                     Card(
                                         onClick = {
@@ -3641,7 +3692,7 @@ fun AgentScreen(
                         LazyColumn {
                             items(allSessionIds) { savedSessionId ->
                                 val metadata = sessionMetadataMap[savedSessionId]
-                                val sessionHistory = HistoryPersistenceService.loadHistory(savedSessionId)
+                                val sessionMessageCount = HistoryPersistenceService.getMessageCount(savedSessionId)
                                 Card(
                                     modifier = Modifier
                                         .fillMaxWidth()
@@ -3700,7 +3751,7 @@ fun AgentScreen(
                                         }
                                         Spacer(modifier = Modifier.height(4.dp))
                                         Text(
-                                            text = "Messages: ${sessionHistory.size}",
+                                            text = "Messages: $sessionMessageCount",
                                             style = MaterialTheme.typography.bodySmall,
                                             color = MaterialTheme.colorScheme.onSurfaceVariant
                                         )
@@ -295,6 +295,10 @@ fun Customization(modifier: Modifier = Modifier) {
             SettingsToggle(label = "Vibrate", description = "Virtual keypad vibration", showSwitch = true, default = Settings.vibrate, sideEffect = {
                 Settings.vibrate = it
             })
+
+            SettingsToggle(label = "Restore sessions", description = "Show the last screen of each session after Android closed aTerm", showSwitch = true, default = Settings.restore_sessions, sideEffect = {
+                Settings.restore_sessions = it
+            })
         }
 
         PreferenceGroup {
@@ -18,8 +18,6 @@ import com.qali.aterm.ui.screens.terminal.TerminalScreen
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
-import okhttp3.OkHttpClient
-import okhttp3.Request
 import java.io.File
 import java.net.UnknownHostException
 
@@ -104,8 +102,9 @@ private suspend fun setupEnvironment(
             filesToDownload.forEach { file ->
                 val outputFile = file.outputFile.apply { parentFile?.mkdirs() }
                 if (!outputFile.exists()) {
-                    downloadFile(file.url, outputFile) { downloaded, total ->
-                        runOnUiThread { onProgress(completedFiles, totalFiles, downloaded.toFloat() / total) }
+                    // Progress is already delivered on the main thread
+                    downloadRootfs(file.url, outputFile) { downloaded, total ->
+                        onProgress(completedFiles, totalFiles, downloaded.toFloat() / total)
                     }
                 }
                 completedFiles++
@@ -120,32 +119,50 @@ private suspend fun setupEnvironment(
     }
 }
 
-private suspend fun downloadFile(url: String, outputFile: File, onProgress: (Long, Long) -> Unit) {
-    withContext(Dispatchers.IO) {
-        OkHttpClient().newCall(Request.Builder().url(url).build()).execute().use { response ->
-            if (!response.isSuccessful) throw Exception("Failed to download file: ${response.code}")
-
-            val body = response.body ?: throw Exception("Empty response body")
-            val totalBytes = body.contentLength()
-            var downloadedBytes = 0L
-
-            outputFile.outputStream().use { output ->
-                body.byteStream().use { input ->
-                    val buffer = ByteArray(8 * 1024)
-                    var bytesRead: Int
-                    while (input.read(buffer).also { bytesRead = it } != -1) {
-                        output.write(buffer, 0, bytesRead)
-                        downloadedBytes += bytesRead
-                        withContext(Dispatchers.Main) { onProgress(downloadedBytes, totalBytes) }
-                    }
-                }
-            }
-        }
+private val rangedDownloader by lazy { RangedDownloader() }
+
+private suspend fun downloadFile(
+    url: String,
+    outputFile: File,
+    expectedSha256: String? = null,
+    sink: java.io.OutputStream? = null,
+    onProgress: (Long, Long) -> Unit
+) {
+    rangedDownloader.download(url, outputFile, expectedSha256, sink) { downloaded, total ->
+        runOnUiThread { onProgress(downloaded, total) }
     }
 }
 
+/**
+ * Download a rootfs (or its proot/talloc dependencies). Tarballs are verified against the checksum published
+ * next to them when there is one, and extracted into their rootfs directory while downloading so the first
+ * session doesn't have to.
+ */
 suspend fun downloadRootfs(url: String, outputFile: File, onProgress: (Long, Long) -> Unit) {
-    downloadFile(url, outputFile, onProgress)
+    val isTarball = outputFile.name.endsWith(".tar.gz") || outputFile.name.endsWith(".tar")
+    if (!isTarball) {
+        downloadFile(url, outputFile, onProgress = onProgress)
+        outputFile.setExecutable(true, false)
+        return
+    }
+
+    val expectedSha256 = rangedDownloader.fetchPublishedSha256(url)
+    val rootfsDir = localDir().child(Rootfs.getRootfsDirName(outputFile.name))
+    val extractor = if (StreamingTarExtractor.needsExtraction(rootfsDir)) {
+        StreamingTarExtractor(rootfsDir, gzip = outputFile.name.endsWith(".gz"))
+    } else {
+        null
+    }
+
+    var succeeded = false
+    try {
+        downloadFile(url, outputFile, expectedSha256, extractor, onProgress)
+        succeeded = true
+    } finally {
+        withContext(Dispatchers.IO + kotlinx.coroutines.NonCancellable) {
+            extractor?.finish(succeeded, if (succeeded) outputFile.length() else -1)
+        }
+    }
     outputFile.setExecutable(true, false)
 }
 
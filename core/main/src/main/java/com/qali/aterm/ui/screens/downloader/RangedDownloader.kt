@@ -0,0 +1,344 @@
+package com.qali.aterm.ui.screens.downloader
+
+import com.google.gson.Gson
+import com.qali.aterm.api.HttpClientProvider
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.currentCoroutineContext
+import kotlinx.coroutines.ensureActive
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.withContext
+import kotlinx.coroutines.withTimeoutOrNull
+import okhttp3.OkHttpClient
+import okhttp3.Protocol
+import okhttp3.Request
+import java.io.File
+import java.io.IOException
+import java.io.OutputStream
+import java.io.RandomAccessFile
+import java.nio.ByteBuffer
+import java.nio.channels.FileChannel
+import java.security.MessageDigest
+
+/**
+ * Download engine for large files such as rootfs tarballs.
+ *
+ * When the server supports `Range` requests the file is split into segments that are fetched over parallel
+ * connections and written in place into `<output>.part`. Segment progress is persisted next to it in
+ * `<output>.part.json`, so an interrupted download resumes where it stopped as long as the remote file (by ETag or
+ * Last-Modified) is unchanged. Servers without range support get a single sequential stream.
+ *
+ * Independently of the segment order, the file is consumed front to back as soon as a contiguous prefix is on disk:
+ * the bytes are fed to a SHA-256 digest and to an optional [OutputStream] sink (used to extract the tarball while it is
+ * still downloading). The output file only appears once the whole file is present and the checksum matched.
+ */
+class RangedDownloader(
+    // HTTP/1.1 so segments get separate connections instead of being multiplexed onto one HTTP/2 connection
+    private val client: OkHttpClient = HttpClientProvider.client.newBuilder().protocols(listOf(Protocol.HTTP_1_1)).build(),
+    private val maxSegments: Int = 4,
+    private val minSegmentSize: Long = 4L * 1024 * 1024
+) {
+    class ChecksumMismatchException(expected: String, actual: String) :
+        IOException("SHA-256 mismatch: expected $expected, got $actual")
+
+    private data class RemoteInfo(val length: Long, val acceptsRanges: Boolean, val validator: String?)
+
+    private data class SegmentState(val start: Long, val end: Long, var downloaded: Long) {
+        val position: Long get() = start + downloaded
+        val isComplete: Boolean get() = position > end
+    }
+
+    private data class DownloadState(
+        val url: String,
+        val validator: String?,
+        val length: Long,
+        val segments: List<SegmentState>
+    )
+
+    private val gson = Gson()
+
+    /**
+     * Download [url] into [outputFile].
+     *
+     * @param expectedSha256 hex digest to verify against, or null to skip verification.
+     * @param sink receives the file contents in order while downloading; it is not closed by this call.
+     * @param onProgress called with (downloaded, total) from a background thread, at most every [PROGRESS_INTERVAL_MS].
+     * Total is -1 if the server did not report a length.
+     * @return the hex SHA-256 of the downloaded file.
+     */
+    suspend fun download(
+        url: String,
+        outputFile: File,
+        expectedSha256: String? = null,
+        sink: OutputStream? = null,
+        onProgress: (Long, Long) -> Unit = { _, _ -> }
+    ): String = withContext(Dispatchers.IO) {
+        val partFile = File(outputFile.path + ".part")
+        val stateFile = File(outputFile.path + ".part.json")
+        val remote = probe(url)
+
+        val digest = if (remote.acceptsRanges && remote.length > 0) {
+            val state = loadState(stateFile)?.takeIf {
+                it.url == url && it.length == remote.length && it.validator == remote.validator && partFile.exists()
+            } ?: newState(url, remote)
+            downloadSegments(url, state, partFile, stateFile, sink, onProgress)
+        } else {
+            stateFile.delete()
+            downloadSequential(url, partFile, sink, onProgress)
+        }
+
+        val actual = digest.toHex()
+        if (expectedSha256 != null && !expectedSha256.equals(actual, ignoreCase = true)) {
+            partFile.delete()
+            stateFile.delete()
+            throw ChecksumMismatchException(expectedSha256.lowercase(), actual)
+        }
+
+        outputFile.delete()
+        if (!partFile.renameTo(outputFile)) {
+            throw IOException("Failed to move ${partFile.name} to ${outputFile.name}")
+        }
+        stateFile.delete()
+        actual
+    }
+
+    /**
+     * Look up a published SHA-256 for [url]: either a `<url>.sha256` sidecar (Alpine) or a `SHA256SUMS` file in the
+     * same directory (Ubuntu). Returns null if neither exists.
+     */
+    suspend fun fetchPublishedSha256(url: String): String? = withContext(Dispatchers.IO) {
+        val fileName = url.substringAfterLast('/')
+        val candidates = listOf("$url.sha256", url.substringBeforeLast('/') + "/SHA256SUMS")
+        for (candidate in candidates) {
+            val text = runCatching {
+                client.newCall(Request.Builder().url(candidate).build()).execute().use { response ->
+                    if (response.isSuccessful) response.body?.string() else null
+                }
+            }.getOrNull() ?: continue
+
+            for (line in text.lineSequence()) {
+                val parts = line.trim().split(Regex("\\s+"), limit = 2)
+                if (parts.isEmpty() || !SHA256_HEX.matches(parts[0])) continue
+                val name = parts.getOrNull(1)?.removePrefix("*")
+                if (name == null || name == fileName) return@withContext parts[0].lowercase()
+            }
+        }
+        null
+    }
+
+    private fun probe(url: String): RemoteInfo {
+        val request = Request.Builder().url(url).header("Range", "bytes=0-0").build()
+        client.newCall(request).execute().use { response ->
+            if (!response.isSuccessful) throw IOException("Failed to download file: ${response.code}")
+            val validator = response.header("ETag") ?: response.header("Last-Modified")
+            if (response.code == 206) {
+                val length = response.header("Content-Range")?.substringAfterLast('/')?.toLongOrNull() ?: -1L
+                return RemoteInfo(length, length > 0, validator)
+            }
+            return RemoteInfo(response.body?.contentLength() ?: -1L, false, validator)
+        }
+    }
+
+    private fun newState(url: String, remote: RemoteInfo): DownloadState {
+        val count = ((remote.length + minSegmentSize - 1) / minSegmentSize).coerceIn(1L, maxSegments.toLong()).toInt()
+        val size = remote.length / count
+        val segments = (0 until count).map { index ->
+            val start = index * size
+            val end = if (index == count - 1) remote.length - 1 else start + size - 1
+            SegmentState(start, end, 0)
+        }
+        return DownloadState(url, remote.validator, remote.length, segments)
+    }
+
+    private fun loadState(stateFile: File): DownloadState? {
+        if (!stateFile.exists()) return null
+        return runCatching { gson.fromJson(stateFile.readText(), DownloadState::class.java) }.getOrNull()
+    }
+
+    private fun saveState(state: DownloadState, stateFile: File) {
+        val json = synchronized(state) { gson.toJson(state) }
+        val temp = File(stateFile.path + ".tmp")
+        temp.writeText(json)
+        temp.renameTo(stateFile)
+    }
+
+    private suspend fun downloadSegments(
+        url: String,
+        state: DownloadState,
+        partFile: File,
+        stateFile: File,
+        sink: OutputStream?,
+        onProgress: (Long, Long) -> Unit
+    ): MessageDigest {
+        val digest = MessageDigest.getInstance("SHA-256")
+        val written = Channel<Unit>(Channel.CONFLATED)
+
+        RandomAccessFile(partFile, "rw").use { raf ->
+            if (raf.length() != state.length) raf.setLength(state.length)
+            val channel = raf.channel
+            saveState(state, stateFile)
+
+            try {
+                consumeSegments(url, state, partFile, stateFile, channel, written, digest, sink, onProgress)
+            } finally {
+                // Record whatever arrived so a failed or cancelled download resumes from here
+                channel.force(false)
+                saveState(state, stateFile)
+            }
+        }
+        return digest
+    }
+
+    private suspend fun consumeSegments(
+        url: String,
+        state: DownloadState,
+        partFile: File,
+        stateFile: File,
+        channel: FileChannel,
+        written: Channel<Unit>,
+        digest: MessageDigest,
+        sink: OutputStream?,
+        onProgress: (Long, Long) -> Unit
+    ) = coroutineScope {
+        state.segments.filter { !it.isComplete }.forEach { segment ->
+            launch(Dispatchers.IO) { downloadSegment(url, state, segment, channel, written) }
+        }
+
+        // Consume the contiguous prefix in order while the segments are still arriving
+        RandomAccessFile(partFile, "r").use { reader ->
+            val buffer = ByteArray(COPY_BUFFER_SIZE)
+            var consumed = 0L
+            var lastSave = System.currentTimeMillis()
+            var lastProgress = 0L
+            while (consumed < state.length) {
+                val available = contiguousEnd(state)
+                reader.seek(consumed)
+                while (consumed < available) {
+                    ensureActive()
+                    val n = reader.read(buffer, 0, minOf(buffer.size.toLong(), available - consumed).toInt())
+                    if (n < 0) throw IOException("Unexpected end of ${partFile.name}")
+                    digest.update(buffer, 0, n)
+                    sink?.write(buffer, 0, n)
+                    consumed += n
+                }
+
+                val now = System.currentTimeMillis()
+                if (now - lastProgress >= PROGRESS_INTERVAL_MS || consumed == state.length) {
+                    onProgress(downloadedBytes(state), state.length)
+                    lastProgress = now
+                }
+                if (now - lastSave >= STATE_SAVE_INTERVAL_MS) {
+                    // Make sure the bytes are on disk before recording them as downloaded
+                    channel.force(false)
+                    saveState(state, stateFile)
+                    lastSave = now
+                }
+                if (consumed < state.length) {
+                    withTimeoutOrNull(STATE_SAVE_INTERVAL_MS) { written.receive() }
+                }
+            }
+        }
+    }
+
+    private suspend fun downloadSegment(
+        url: String,
+        state: DownloadState,
+        segment: SegmentState,
+        channel: FileChannel,
+        written: Channel<Unit>
+    ) {
+        val request = Request.Builder()
+            .url(url)
+            .header("Range", "bytes=${segment.position}-${segment.end}")
+            .apply { state.validator?.let { header("If-Range", it) } }
+            .build()
+
+        client.newCall(request).execute().use { response ->
+            if (response.code != 206) {
+                // A 200 here means the remote file changed (If-Range failed) or ranges stopped being honoured
+                throw IOException("Server did not honour range request: ${response.code}")
+            }
+            val source = response.body?.source() ?: throw IOException("Empty response body")
+            val buffer = ByteBuffer.allocate(COPY_BUFFER_SIZE)
+            while (!segment.isComplete) {
+                currentCoroutineContext().ensureActive()
+                buffer.clear()
+                val remaining = segment.end - segment.position + 1
+                if (remaining < buffer.capacity()) buffer.limit(remaining.toInt())
+                val n = source.read(buffer)
+                if (n < 0) throw IOException("Connection closed at byte ${segment.position}")
+                buffer.flip()
+                var position = segment.position
+                while (buffer.hasRemaining()) {
+                    position += channel.write(buffer, position)
+                }
+                synchronized(state) { segment.downloaded += n }
+                written.trySend(Unit)
+            }
+        }
+        written.trySend(Unit)
+    }
+
+    private suspend fun downloadSequential(
+        url: String,
+        partFile: File,
+        sink: OutputStream?,
+        onProgress: (Long, Long) -> Unit
+    ): MessageDigest {
+        val digest = MessageDigest.getInstance("SHA-256")
+        client.newCall(Request.Builder().url(url).build()).execute().use { response ->
+            if (!response.isSuccessful) throw IOException("Failed to download file: ${response.code}")
+            val body = response.body ?: throw IOException("Empty response body")
+            val totalBytes = body.contentLength()
+            var downloadedBytes = 0L
+            var lastProgress = 0L
+
+            partFile.outputStream().use { output ->
+                body.byteStream().use { input ->
+                    val buffer = ByteArray(COPY_BUFFER_SIZE)
+                    while (true) {
+                        currentCoroutineContext().ensureActive()
+                        val n = input.read(buffer)
+                        if (n < 0) break
+                        output.write(buffer, 0, n)
+                        digest.update(buffer, 0, n)
+                        sink?.write(buffer, 0, n)
+                        downloadedBytes += n
+
+                        val now = System.currentTimeMillis()
+                        if (now - lastProgress >= PROGRESS_INTERVAL_MS) {
+                            onProgress(downloadedBytes, totalBytes)
+                            lastProgress = now
+                        }
+                    }
+                }
+            }
+            onProgress(downloadedBytes, totalBytes)
+        }
+        return digest
+    }
+
+    private fun contiguousEnd(state: DownloadState): Long = synchronized(state) {
+        var end = 0L
+        for (segment in state.segments) {
+            if (segment.start > end) break
+            end = segment.position
+            if (!segment.isComplete) break
+        }
+        end
+    }
+
+    private fun downloadedBytes(state: DownloadState): Long = synchronized(state) {
+        state.segments.sumOf { it.downloaded }
+    }
+
+    private fun MessageDigest.toHex(): String = digest().joinToString("") { "%02x".format(it) }
+
+    companion object {
+        private const val COPY_BUFFER_SIZE = 64 * 1024
+        private const val PROGRESS_INTERVAL_MS = 100L
+        private const val STATE_SAVE_INTERVAL_MS = 500L
+        private val SHA256_HEX = Regex("^[0-9a-fA-F]{64}$")
+    }
+}
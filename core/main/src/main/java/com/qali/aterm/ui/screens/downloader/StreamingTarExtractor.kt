@@ -0,0 +1,260 @@
+package com.qali.aterm.ui.screens.downloader
+
+import android.util.Log
+import java.io.ByteArrayOutputStream
+import java.io.File
+import java.io.IOException
+import java.io.OutputStream
+import java.util.zip.DataFormatException
+import java.util.zip.Inflater
+
+/**
+ * Extracts a rootfs tarball while it is being downloaded by piping the bytes into the system `tar`.
+ *
+ * Extraction goes to a staging directory next to [targetDir] and is only moved into place by [finish] once the
+ * download succeeded, so the init scripts never see a half-extracted rootfs (they extract on their own when the
+ * target directory is empty). If `tar` fails or exits early, writes are discarded and [finish] reports failure;
+ * the download itself is not affected. Like the init scripts, which ignore tar's status, exit 1 after the whole
+ * archive was read counts as success: on Android it only means that some entries such as hard links to system
+ * files could not be created. That the whole archive was read is not taken from tar, which exits with 1 for a
+ * truncated archive too: every downloaded byte must have been fed to it, and [TarEndScanner] must have seen the
+ * end-of-archive marker in what was fed. Gzip is therefore decompressed here rather than by tar.
+ */
+internal class StreamingTarExtractor(private val targetDir: File, gzip: Boolean) : OutputStream() {
+    private val stagingDir = File(targetDir.parentFile, ".${targetDir.name}.extracting")
+    private val logFile = File(targetDir.parentFile, ".${targetDir.name}.extract.log")
+    private val process: Process?
+    private val stdin: OutputStream?
+    private val scanner = TarEndScanner()
+    private val decoder = if (gzip) GzipStreamDecoder(::feedTar) else null
+
+    /** Bytes of the download taken in so far */
+    private var fedBytes = 0L
+
+    @Volatile
+    var failed = false
+        private set
+    private var finished = false
+
+    init {
+        stagingDir.deleteRecursively()
+        stagingDir.mkdirs()
+        process = runCatching {
+            ProcessBuilder(
+                "tar", "-xf", "-", "-C", stagingDir.absolutePath,
+                "--no-same-owner", "--no-same-permissions"
+            ).redirectErrorStream(true)
+                .redirectOutput(ProcessBuilder.Redirect.to(logFile))
+                .start()
+        }.getOrNull()
+        stdin = process?.outputStream?.buffered(64 * 1024)
+        failed = process == null
+    }
+
+    override fun write(b: Int) {
+        write(byteArrayOf(b.toByte()), 0, 1)
+    }
+
+    override fun write(b: ByteArray, off: Int, len: Int) {
+        if (failed) return
+        try {
+            if (decoder != null) decoder.update(b, off, len) else feedTar(b, off, len)
+            fedBytes += len
+        } catch (e: IOException) {
+            // tar exited (e.g. unsupported archive); fall back to extraction by the init script
+            failed = true
+        } catch (e: DataFormatException) {
+            failed = true
+        }
+    }
+
+    private fun feedTar(b: ByteArray, off: Int, len: Int) {
+        scanner.update(b, off, len)
+        stdin!!.write(b, off, len)
+    }
+
+    /**
+     * Close the pipe and wait for tar. If [downloadSucceeded], all [downloadedBytes] were fed to tar up to the end of
+     * the archive and tar exited with 0 or with the 1 of entries it could not create, the extracted tree is moved
+     * into [targetDir]; otherwise the staging directory is removed.
+     *
+     * @return whether [targetDir] now holds the extracted rootfs.
+     */
+    fun finish(downloadSucceeded: Boolean, downloadedBytes: Long = -1): Boolean {
+        if (finished) return false
+        finished = true
+        runCatching { stdin?.close() }
+        if (!downloadSucceeded) process?.destroy()
+        val exitCode = runCatching { process?.waitFor() }.getOrNull()
+        if (downloadSucceeded && exitCode != 0) {
+            val output = runCatching { logFile.readText() }.getOrDefault("")
+            Log.w(TAG, "tar exited with $exitCode: ${output.takeLast(MAX_LOGGED_OUTPUT)}")
+        }
+        logFile.delete()
+
+        val complete = downloadSucceeded && !failed && fedBytes == downloadedBytes && scanner.sawEnd
+        if (downloadSucceeded && !complete) {
+            Log.w(TAG, "Archive not fed whole: $fedBytes of $downloadedBytes bytes, end marker seen: ${scanner.sawEnd}")
+        }
+        val extracted = complete && (exitCode == 0 || exitCode == 1) && looksLikeRootfs(stagingDir)
+        if (extracted) {
+            targetDir.mkdirs()
+            stagingDir.listFiles()?.forEach { entry ->
+                val destination = File(targetDir, entry.name)
+                // Placeholder dirs such as root/ may have been created before extraction
+                if (destination.isDirectory && destination.list().isNullOrEmpty()) destination.delete()
+                if (!entry.renameTo(destination)) entry.deleteRecursively()
+            }
+        }
+        stagingDir.deleteRecursively()
+        return extracted
+    }
+
+    override fun close() {
+        finish(downloadSucceeded = false)
+    }
+
+    companion object {
+        private const val TAG = "StreamingTarExtractor"
+        private const val MAX_LOGGED_OUTPUT = 4096
+
+        /**
+         * Whether [dir] still needs extracting, using the same rule as the init scripts: empty apart from
+         * the `root` and `tmp` directories created by the app.
+         */
+        fun needsExtraction(dir: File): Boolean {
+            return dir.list()?.none { it != "root" && it != "tmp" } ?: true
+        }
+
+        private fun looksLikeRootfs(dir: File): Boolean {
+            return File(dir, "usr").isDirectory || File(dir, "bin").exists() || File(dir, "etc").isDirectory
+        }
+    }
+}
+
+/**
+ * Follows a tar stream from header to header to see its end-of-archive marker: two zero blocks where the next
+ * header would be. Zero blocks inside file contents are skipped with the contents, so they do not count.
+ */
+internal class TarEndScanner {
+    private val block = ByteArray(BLOCK_SIZE)
+    private var filled = 0
+    private var skipBytes = 0L
+    private var zeroBlocks = 0
+
+    var sawEnd = false
+        private set
+
+    fun update(b: ByteArray, off: Int, len: Int) {
+        var i = off
+        val end = off + len
+        while (i < end && !sawEnd) {
+            if (skipBytes > 0) {
+                val n = minOf(skipBytes, (end - i).toLong()).toInt()
+                i += n
+                skipBytes -= n
+                continue
+            }
+            val n = minOf(BLOCK_SIZE - filled, end - i)
+            System.arraycopy(b, i, block, filled, n)
+            filled += n
+            i += n
+            if (filled == BLOCK_SIZE) {
+                filled = 0
+                onHeader()
+            }
+        }
+    }
+
+    private fun onHeader() {
+        if (block.all { it == 0.toByte() }) {
+            if (++zeroBlocks == 2) sawEnd = true
+            return
+        }
+        zeroBlocks = 0
+        val size = entrySize()
+        skipBytes = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE
+    }
+
+    /** The size field: octal digits, or big-endian binary when its first byte has the high bit set */
+    private fun entrySize(): Long {
+        if (block[SIZE_OFFSET].toInt() and 0x80 != 0) {
+            var size = 0L
+            for (i in SIZE_OFFSET + 1 until SIZE_OFFSET + SIZE_LENGTH) size = (size shl 8) or (block[i].toLong() and 0xff)
+            return size
+        }
+        var size = 0L
+        for (i in SIZE_OFFSET until SIZE_OFFSET + SIZE_LENGTH) {
+            val c = block[i].toInt().toChar()
+            if (c in '0'..'7') size = size * 8 + (c - '0') else if (c != ' ' || size != 0L) break
+        }
+        return size
+    }
+
+    private companion object {
+        const val BLOCK_SIZE = 512
+        const val SIZE_OFFSET = 124
+        const val SIZE_LENGTH = 12
+    }
+}
+
+/**
+ * Decompresses a gzip stream pushed to it in pieces, handing the output to [output]. Only the first member is read;
+ * what follows it is ignored.
+ */
+internal class GzipStreamDecoder(private val output: (ByteArray, Int, Int) -> Unit) {
+    private val inflater = Inflater(true)
+    private val buffer = ByteArray(64 * 1024)
+    private var header: ByteArrayOutputStream? = ByteArrayOutputStream()
+
+    fun update(b: ByteArray, off: Int, len: Int) {
+        val pending = header
+        if (pending != null) {
+            pending.write(b, off, len)
+            val bytes = pending.toByteArray()
+            val headerLength = headerLength(bytes) ?: return
+            header = null
+            inflate(bytes, headerLength, bytes.size - headerLength)
+        } else {
+            inflate(b, off, len)
+        }
+    }
+
+    private fun inflate(b: ByteArray, off: Int, len: Int) {
+        if (inflater.finished() || len == 0) return
+        inflater.setInput(b, off, len)
+        while (!inflater.finished() && !inflater.needsInput()) {
+            val n = inflater.inflate(buffer)
+            if (n > 0) output(buffer, 0, n) else if (inflater.needsDictionary()) throw DataFormatException("Preset dictionary")
+        }
+    }
+
+    /** Length of the gzip header at the start of [bytes], or null when more bytes are needed for it */
+    private fun headerLength(bytes: ByteArray): Int? {
+        if (bytes.size < 10) return null
+        if (bytes[0] != 0x1f.toByte() || bytes[1] != 0x8b.toByte() || bytes[2] != 8.toByte()) {
+            throw IOException("Not a gzip stream")
+        }
+        val flags = bytes[3].toInt()
+        var position = 10
+        if (flags and FEXTRA != 0) {
+            if (bytes.size < position + 2) return null
+            position += 2 + ((bytes[position].toInt() and 0xff) or ((bytes[position + 1].toInt() and 0xff) shl 8))
+        }
+        for (flag in intArrayOf(FNAME, FCOMMENT)) {
+            if (flags and flag == 0) continue
+            while (position < bytes.size && bytes[position] != 0.toByte()) position++
+            if (position >= bytes.size) return null
+            position++
+        }
+        if (flags and FHCRC != 0) position += 2
+        return position.takeIf { it <= bytes.size }
+    }
+
+    private companion object {
+        const val FHCRC = 2
+        const val FEXTRA = 4
+        const val FNAME = 8
+        const val FCOMMENT = 16
+    }
+}
@@ -5,6 +5,9 @@ import androidx.compose.material3.*
 import androidx.compose.runtime.*
 import androidx.compose.ui.Modifier
 import androidx.compose.ui.unit.dp
+import com.qali.aterm.agent.ppe.TokenCounter
+import com.qali.aterm.agent.utils.WorkspaceTrigramIndex
+import com.qali.aterm.ui.screens.terminal.RootfsClone
 import com.rk.components.compose.preferences.base.PreferenceGroup
 import com.rk.settings.Settings
 
@@ -13,6 +16,9 @@ import com.rk.settings.Settings
 fun AgentSettings() {
     var useApiSearch by remember { mutableStateOf(Settings.use_api_search) }
     var recursiveCurls by remember { mutableStateOf(Settings.custom_search_recursive_curls) }
+    var sandboxRootfs by remember { mutableStateOf(Settings.agent_sandbox_rootfs) }
+    var searchIndex by remember { mutableStateOf(Settings.agent_search_index) }
+    var vocabularyState by remember { mutableStateOf(TokenCounter.vocabularyState()) }
     
     PreferenceGroup(heading = "Agent Settings") {
         SettingsCard(
@@ -69,5 +75,99 @@ fun AgentSettings() {
                 onClick = { /* No action needed, slider handles interaction */ }
             )
         }
+        
+        SettingsCard(
+            title = { Text("Sandboxed Rootfs") },
+            description = { 
+                Text(
+                    if (sandboxRootfs) {
+                        "Agent sessions run in a disposable copy of the rootfs. A copy is prepared in the background ahead of time, which takes the storage of the rootfs twice over. Nothing the agent changes affects your terminal."
+                    } else {
+                        "Agent sessions share the rootfs with your terminal sessions."
+                    }
+                )
+            },
+            startWidget = {
+                Switch(
+                    checked = sandboxRootfs,
+                    onCheckedChange = {
+                        sandboxRootfs = it
+                        setSandboxRootfs(it)
+                    }
+                )
+            },
+            onClick = {
+                sandboxRootfs = !sandboxRootfs
+                setSandboxRootfs(sandboxRootfs)
+            }
+        )
+
+        SettingsCard(
+            title = { Text("Search Index") },
+            description = { 
+                Text(
+                    if (searchIndex) {
+                        "Agent searches skip files that cannot match, using an index of the workspace kept in memory and built in the background."
+                    } else {
+                        "Agent searches read every file."
+                    }
+                )
+            },
+            startWidget = {
+                Switch(
+                    checked = searchIndex,
+                    onCheckedChange = {
+                        searchIndex = it
+                        setSearchIndex(it)
+                    }
+                )
+            },
+            onClick = {
+                searchIndex = !searchIndex
+                setSearchIndex(searchIndex)
+            }
+        )
+
+        SettingsCard(
+            title = { Text("Exact Token Counts") },
+            description = {
+                Text(
+                    when (vocabularyState) {
+                        TokenCounter.VocabularyState.READY ->
+                            "Context usage is counted with the published OpenAI tokenizer vocabularies."
+                        TokenCounter.VocabularyState.DOWNLOADING ->
+                            "Downloading the tokenizer vocabularies (about 6 MB)..."
+                        TokenCounter.VocabularyState.FAILED ->
+                            "Download failed, context usage is approximated. Tap to try again."
+                        TokenCounter.VocabularyState.MISSING ->
+                            "Context usage is approximated. Tap to download the OpenAI tokenizer vocabularies (about 6 MB from openaipublic.blob.core.windows.net) for exact counts."
+                    }
+                )
+            },
+            onClick = {
+                if (vocabularyState != TokenCounter.VocabularyState.READY) {
+                    TokenCounter.downloadVocabularies { vocabularyState = TokenCounter.vocabularyState() }
+                    vocabularyState = TokenCounter.vocabularyState()
+                }
+            }
+        )
+    }
+}
+
+/** Save the setting and copy a spare rootfs ahead of the next agent session, or remove the spares */
+private fun setSandboxRootfs(enabled: Boolean) {
+    Settings.agent_sandbox_rootfs = enabled
+    if (enabled) {
+        RootfsClone.prepareSpareForWorkingMode(Settings.working_Mode)
+    } else {
+        RootfsClone.discardSpares()
+    }
+}
+
+/** Save the setting and free the memory of the indexes once searches stop using them */
+private fun setSearchIndex(enabled: Boolean) {
+    Settings.agent_search_index = enabled
+    if (!enabled) {
+        WorkspaceTrigramIndex.releaseAll()
     }
 }
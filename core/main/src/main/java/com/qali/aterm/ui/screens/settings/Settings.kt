@@ -29,8 +29,10 @@ import androidx.navigation.NavController
 import com.rk.components.compose.preferences.base.PreferenceGroup
 import com.rk.components.compose.preferences.base.PreferenceLayout
 import com.rk.components.compose.preferences.base.PreferenceTemplate
+import com.rk.libcommons.toast
 import com.rk.resources.strings
 import com.rk.settings.Settings
+import com.qali.aterm.agent.debug.TraceRecorder
 import com.qali.aterm.ui.activities.terminal.MainActivity
 import com.qali.aterm.ui.components.SettingsToggle
 import com.qali.aterm.ui.routes.MainActivityRoutes
@@ -370,5 +372,66 @@ fun Settings(modifier: Modifier = Modifier,navController: NavController,mainActi
         
         // Rootfs Settings
         RootfsSettings(mainActivity = mainActivity, navController = navController)
+        
+        PreferenceGroup(heading = "Debugging") {
+            val scope = rememberCoroutineScope()
+            SettingsToggle(
+                label = "Record performance trace",
+                description = "Record API, tool, PTY and rendering timings",
+                default = Settings.trace_enabled,
+                sideEffect = {
+                    Settings.trace_enabled = it
+                    TraceRecorder.enabled = it
+                }
+            )
+
+            SettingsToggle(
+                label = "Record sessions",
+                description = "Save the output of each session as an asciicast to replay offline",
+                default = Settings.record_sessions,
+                sideEffect = {
+                    Settings.record_sessions = it
+                    mainActivity.sessionBinder?.setRecording(it)
+                }
+            )
+            
+            SettingsCard(
+                title = { Text("Export trace") },
+                description = { Text("Save recorded timings as a Chrome trace for Perfetto") },
+                endWidget = {
+                    Icon(imageVector = Icons.Default.Download, contentDescription = null, modifier = Modifier.padding(16.dp))
+                },
+                onClick = {
+                    scope.launch(Dispatchers.IO) {
+                        try {
+                            val file = TraceRecorder.export()
+                            toast(file?.let { "Trace saved to ${it.absolutePath}" } ?: "Trace could not be saved")
+                        } catch (e: Exception) {
+                            toast(e)
+                        }
+                    }
+                }
+            )
+            
+            SettingsCard(
+                title = { Text("Export terminal I/O stats") },
+                description = { Text("Save bytes, reads, stalls, output latency and buffer memory of each session") },
+                endWidget = {
+                    Icon(imageVector = Icons.Default.Download, contentDescription = null, modifier = Modifier.padding(16.dp))
+                },
+                onClick = {
+                    val sessions = mainActivity.sessionBinder?.getSessions().orEmpty()
+                    val allocations = mainActivity.sessionBinder?.getSessionAllocations().orEmpty()
+                    scope.launch(Dispatchers.IO) {
+                        try {
+                            val file = TraceRecorder.exportIoStats(sessions, allocations)
+                            toast(file?.let { "Stats saved to ${it.absolutePath}" } ?: "Stats could not be saved")
+                        } catch (e: Exception) {
+                            toast(e)
+                        }
+                    }
+                }
+            )
+        }
     }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 package com.qali.aterm.ui.screens.terminal
 
+import android.content.Context
 import android.os.Environment
 import com.rk.libcommons.alpineDir
 import com.rk.libcommons.alpineHomeDir
@@ -24,34 +25,13 @@ import java.io.FileOutputStream
 
 object MkSession {
     fun createSession(
-        activity: MainActivity, sessionClient: TerminalSessionClient, session_id: String,workingMode:Int
+        activity: MainActivity, sessionClient: TerminalSessionClient, session_id: String,workingMode:Int,
+        rootfsClone: String? = null
     ): TerminalSession {
         with(activity) {
-            val envVariables = mapOf(
-                "ANDROID_ART_ROOT" to System.getenv("ANDROID_ART_ROOT"),
-                "ANDROID_DATA" to System.getenv("ANDROID_DATA"),
-                "ANDROID_I18N_ROOT" to System.getenv("ANDROID_I18N_ROOT"),
-                "ANDROID_ROOT" to System.getenv("ANDROID_ROOT"),
-                "ANDROID_RUNTIME_ROOT" to System.getenv("ANDROID_RUNTIME_ROOT"),
-                "ANDROID_TZDATA_ROOT" to System.getenv("ANDROID_TZDATA_ROOT"),
-                "BOOTCLASSPATH" to System.getenv("BOOTCLASSPATH"),
-                "DEX2OATBOOTCLASSPATH" to System.getenv("DEX2OATBOOTCLASSPATH"),
-                "EXTERNAL_STORAGE" to System.getenv("EXTERNAL_STORAGE")
-            )
-
             val workingDir = pendingCommand?.workingDir ?: alpineHomeDir().path
 
-            val initFileName = when (workingMode) {
-                WorkingMode.UBUNTU -> "init-host-ubuntu.sh"
-                else -> "init-host.sh"
-            }
-            val initFile: File = localBinDir().child(initFileName.replace(".sh", ""))
-
-            if (initFile.exists().not()){
-                initFile.createFileIfNot()
-                initFile.writeText(assets.open(initFileName).bufferedReader().use { it.readText() })
-            }
-
+            val initFile: File = hostInitFile(activity, workingMode)
 
             // Get rootfs filename for current working mode
             val rootfsFileName = com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsFileName(workingMode)
@@ -60,14 +40,11 @@ object MkSession {
             val customInitScript = com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsInitScript(rootfsFileName)
             val distroType = com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsDistroType(rootfsFileName)
             
-            // Determine rootfs directory name based on rootfs file
-            val rootfsDirName = when {
-                rootfsFileName == "ubuntu.tar.gz" -> "ubuntu"
-                rootfsFileName == "alpine.tar.gz" -> "alpine"
-                else -> {
-                    // For custom rootfs, use the filename without extension as directory name
-                    rootfsFileName.substringBeforeLast(".").lowercase().replace(" ", "_")
-                }
+            // Determine rootfs directory name based on rootfs file, or the clone created for this session
+            val rootfsDirName = if (rootfsClone != null) {
+                RootfsClone.getRootfsDirName(rootfsClone)
+            } else {
+                com.qali.aterm.ui.screens.terminal.Rootfs.getRootfsDirName(rootfsFileName)
             }
             
             // Determine which init script to use
@@ -110,6 +87,75 @@ object MkSession {
                 writeText(initScriptContent)
             }
 
+            val env = hostEnvironment(activity, session_id, rootfsFileName, rootfsDirName, workingMode)
+
+            pendingCommand?.env?.let {
+                env.addAll(it)
+            }
+
+            val args: Array<String>
+
+            val shell = if (pendingCommand == null) {
+                args = when (workingMode) {
+                    WorkingMode.ALPINE, WorkingMode.UBUNTU -> arrayOf("-c",initFile.absolutePath)
+                    else -> arrayOf()
+                }
+                "/system/bin/sh"
+            } else{
+                args = pendingCommand!!.args
+                pendingCommand!!.shell
+            }
+
+            pendingCommand = null
+            return TerminalSession(
+                shell,
+                workingDir,
+                args,
+                env.toTypedArray(),
+                TerminalEmulator.DEFAULT_TERMINAL_TRANSCRIPT_ROWS,
+                sessionClient,
+            )
+        }
+
+    }
+
+    /**
+     * The init-host script for [workingMode], written from the assets when it is missing or an update changed it
+     */
+    fun hostInitFile(context: Context, workingMode: Int): File {
+        val initFileName = when (workingMode) {
+            WorkingMode.UBUNTU -> "init-host-ubuntu.sh"
+            else -> "init-host.sh"
+        }
+        val initFile: File = localBinDir().child(initFileName.replace(".sh", ""))
+        val content = context.assets.open(initFileName).bufferedReader().use { it.readText() }
+        if (initFile.exists().not() || initFile.readText() != content) {
+            initFile.createFileIfNot()
+            initFile.writeText(content)
+        }
+        return initFile
+    }
+
+    /**
+     * Environment the init-host script expects, for the rootfs extracted from [rootfsFileName] into
+     * `local/<rootfsDirName>`. [sessionId] names proot's temporary directory.
+     */
+    fun hostEnvironment(
+        context: Context, sessionId: String, rootfsFileName: String, rootfsDirName: String, workingMode: Int
+    ): MutableList<String> {
+        with(context) {
+            val envVariables = mapOf(
+                "ANDROID_ART_ROOT" to System.getenv("ANDROID_ART_ROOT"),
+                "ANDROID_DATA" to System.getenv("ANDROID_DATA"),
+                "ANDROID_I18N_ROOT" to System.getenv("ANDROID_I18N_ROOT"),
+                "ANDROID_ROOT" to System.getenv("ANDROID_ROOT"),
+                "ANDROID_RUNTIME_ROOT" to System.getenv("ANDROID_RUNTIME_ROOT"),
+                "ANDROID_TZDATA_ROOT" to System.getenv("ANDROID_TZDATA_ROOT"),
+                "BOOTCLASSPATH" to System.getenv("BOOTCLASSPATH"),
+                "DEX2OATBOOTCLASSPATH" to System.getenv("DEX2OATBOOTCLASSPATH"),
+                "EXTERNAL_STORAGE" to System.getenv("EXTERNAL_STORAGE")
+            )
+
             val env = mutableListOf(
                 "PATH=${System.getenv("PATH")}:/sbin:${localBinDir().absolutePath}",
                 "HOME=/sdcard",
@@ -126,7 +172,7 @@ object MkSession {
                 "PKG=${packageName}",
                 "RISH_APPLICATION_ID=${packageName}",
                 "PKG_PATH=${applicationInfo.sourceDir}",
-                "PROOT_TMP_DIR=${getTempDir().child(session_id).also { if (it.exists().not()){it.mkdirs()} }}",
+                "PROOT_TMP_DIR=${getTempDir().child(sessionId).also { if (it.exists().not()){it.mkdirs()} }}",
                 "TMPDIR=${getTempDir().absolutePath}",
                 "ROOTFS_FILE=$rootfsFileName",
                 "ROOTFS_DIR=$rootfsDirName",
@@ -141,9 +187,6 @@ object MkSession {
                 env.add("PROOT_LOADER=${applicationInfo.nativeLibraryDir}/libproot-loader.so")
             }
 
-
-
-
             env.addAll(envVariables.map { "${it.key}=${it.value}" })
 
             localDir().child("stat").apply {
@@ -158,33 +201,7 @@ object MkSession {
                 }
             }
 
-            pendingCommand?.env?.let {
-                env.addAll(it)
-            }
-
-            val args: Array<String>
-
-            val shell = if (pendingCommand == null) {
-                args = when (workingMode) {
-                    WorkingMode.ALPINE, WorkingMode.UBUNTU -> arrayOf("-c",initFile.absolutePath)
-                    else -> arrayOf()
-                }
-                "/system/bin/sh"
-            } else{
-                args = pendingCommand!!.args
-                pendingCommand!!.shell
-            }
-
-            pendingCommand = null
-            return TerminalSession(
-                shell,
-                workingDir,
-                args,
-                env.toTypedArray(),
-                TerminalEmulator.DEFAULT_TERMINAL_TRANSCRIPT_ROWS,
-                sessionClient,
-            )
+            return env
         }
-
     }
-}
\ No newline at end of file
+}
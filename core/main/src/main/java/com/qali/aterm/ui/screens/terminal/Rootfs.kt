@@ -136,6 +136,20 @@ object Rootfs {
         }
     }
     
+    /**
+     * Get the directory (relative to the local dir) a rootfs file is extracted into
+     */
+    fun getRootfsDirName(rootfsFileName: String): String {
+        return when (rootfsFileName) {
+            "ubuntu.tar.gz" -> "ubuntu"
+            "alpine.tar.gz" -> "alpine"
+            else -> {
+                // For custom rootfs, use the filename without extension as directory name
+                rootfsFileName.substringBeforeLast(".").lowercase().replace(" ", "_")
+            }
+        }
+    }
+    
     /**
      * Get the distro type for a rootfs
      */
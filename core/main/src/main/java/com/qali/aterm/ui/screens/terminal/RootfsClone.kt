@@ -0,0 +1,269 @@
+package com.qali.aterm.ui.screens.terminal
+
+import com.rk.libcommons.child
+import com.rk.libcommons.localDir
+import com.rk.settings.Settings
+import com.termux.terminal.FileTreeCloner
+import java.io.File
+import java.io.IOException
+import java.util.concurrent.ExecutionException
+import java.util.concurrent.Executors
+import java.util.concurrent.Future
+
+/**
+ * Disposable clones of an extracted rootfs.
+ *
+ * A clone is a copy of the base rootfs under `local/clones/<id>` in which every file has its own inode, so nothing a
+ * session does to its files reaches the base or other clones. Files are reflinked where the filesystem supports it,
+ * which shares their data until written, and copied otherwise. The trees in [SKIPPED_PATHS] only hold caches, logs
+ * and temporary files, so the clone gets their directories without the files.
+ *
+ * Android's app storage (ext4, f2fs) has no reflinks, so a clone is a full copy and takes as long as copying the
+ * rootfs. proot has no union filesystem to layer writes over a shared base, so instead one spare clone per base is
+ * copied ahead of time in the background ([prepareSpare]). [createClone] renames the spare into place when it is still
+ * current and starts the next one, and only copies while the caller waits when no spare is ready. The spare costs the
+ * storage of one more copy.
+ *
+ * Sessions use a clone by passing `ROOTFS_DIR=clones/<id>` to the init script (see [MkSession]).
+ */
+object RootfsClone {
+    private const val CLONES_DIR = "clones"
+    /** Prefix of clones being deleted, which are no longer listed and whose ids are free again. */
+    private const val DELETED_PREFIX = ".deleted-"
+    /** Prefix of the spare clone of a base, followed by the base's directory name. */
+    private const val SPARE_PREFIX = ".spare-"
+    /** Prefix of spares still being copied. */
+    private const val BUILDING_PREFIX = ".building-"
+
+    /**
+     * Paths relative to the rootfs whose modification times tell whether packages were installed or configuration
+     * changed in the base since a spare was copied.
+     */
+    private val BASE_STAMP_PATHS = arrayOf("etc", "lib/apk/db/installed", "var/lib/dpkg/status", "var/lib/pacman/local")
+
+    /** Copies spares one at a time, so they do not compete with each other for the disk. */
+    private val spareExecutor = Executors.newSingleThreadExecutor { Thread(it, "RootfsCloneSpare").apply { isDaemon = true } }
+    /** Spare copies queued or running, by base directory name. */
+    private val pendingSpares = HashMap<String, Future<*>>()
+    /** Names of the spare directories this process is copying into. */
+    private val building = HashSet<String>()
+
+    /** Paths relative to the rootfs whose directories are cloned without their files. */
+    private val SKIPPED_PATHS = arrayOf("tmp", "var/tmp", "var/cache", "var/log")
+
+    fun clonesDir(): File {
+        return localDir().child(CLONES_DIR).also {
+            if (!it.exists()) {
+                it.mkdirs()
+            }
+        }
+    }
+
+    fun getCloneDir(cloneId: String): File = clonesDir().child(cloneId)
+
+    /**
+     * Directory name of a clone relative to `$PREFIX/local`, as expected in the `ROOTFS_DIR` env variable.
+     */
+    fun getRootfsDirName(cloneId: String): String = "$CLONES_DIR/$cloneId"
+
+    fun cloneExists(cloneId: String): Boolean {
+        return getCloneDir(cloneId).child("bin").exists() || getCloneDir(cloneId).child("usr").exists()
+    }
+
+    /** Ids of the clones in use; spares and clones being deleted are not listed. */
+    fun listClones(): List<String> {
+        return clonesDir().listFiles()?.filter { it.isDirectory && !it.name.startsWith(".") }?.map { it.name }
+            ?: emptyList()
+    }
+
+    /**
+     * Whether [path] is in a clone which no longer exists, as a workspace saved by a session whose clone was deleted
+     * since. Paths outside the clones directory are not clones and give false.
+     */
+    fun isDeletedClonePath(path: String): Boolean {
+        val relative = File(path).absoluteFile.relativeToOrNull(clonesDir().absoluteFile) ?: return false
+        val cloneId = relative.invariantSeparatorsPath.substringBefore('/')
+        return cloneId.isEmpty() || cloneId.startsWith(".") || !cloneExists(cloneId)
+    }
+
+    /**
+     * Delete the clones that are not in [liveCloneIds], left behind by sessions of a process that was killed. They are
+     * renamed away right away, so new clones may reuse their ids, and removed by a background thread.
+     */
+    fun deleteOrphanedClones(liveCloneIds: Set<String>) {
+        listClones().filter { it !in liveCloneIds }.forEach { cloneId ->
+            getCloneDir(cloneId).renameTo(clonesDir().child("$DELETED_PREFIX$cloneId-${System.nanoTime()}"))
+        }
+        // Spares whose copy was cut short by the process dying
+        val abandoned = clonesDir().listFiles()?.filter { it.name.startsWith(BUILDING_PREFIX) }.orEmpty()
+        synchronized(this) { abandoned.filter { it.name !in building } }.forEach { dir ->
+            dir.renameTo(clonesDir().child("$DELETED_PREFIX${dir.name.removePrefix(".")}"))
+        }
+        val deleted = clonesDir().listFiles()?.filter { it.name.startsWith(DELETED_PREFIX) }.orEmpty()
+        if (deleted.isEmpty()) return
+        Thread {
+            deleted.forEach { dir ->
+                runCatching { FileTreeCloner.removeTree(dir.absolutePath) }
+                    .onFailure { android.util.Log.w("RootfsClone", "Failed to delete orphaned clone ${dir.name}", it) }
+            }
+        }.start()
+    }
+
+    /**
+     * Whether [createClone] for [baseDirName] can take a spare instead of copying the rootfs. A spare still being
+     * copied is not ready; [createClone] waits for it.
+     */
+    fun isSpareReady(baseDirName: String): Boolean {
+        val pending = synchronized(this) { pendingSpares[baseDirName] }
+        return (pending == null || pending.isDone) && spareIsCurrent(baseDirName)
+    }
+
+    /**
+     * Start copying a spare clone of `local/<baseDirName>` in the background, unless one is current or on its way.
+     */
+    fun prepareSpare(baseDirName: String) {
+        synchronized(this) {
+            if (pendingSpares[baseDirName]?.isDone == false) return
+            pendingSpares[baseDirName] = spareExecutor.submit {
+                try {
+                    // Turned off while this waited for an earlier copy
+                    if (!Settings.agent_sandbox_rootfs) return@submit
+                    if (!spareIsCurrent(baseDirName)) buildSpare(baseDirName)
+                } catch (e: IOException) {
+                    android.util.Log.w("RootfsClone", "Failed to prepare a spare clone of $baseDirName: ${e.message}")
+                }
+            }
+        }
+    }
+
+    /** Start copying a spare of the rootfs sessions of [workingMode] use. */
+    fun prepareSpareForWorkingMode(workingMode: Int) {
+        prepareSpare(Rootfs.getRootfsDirName(Rootfs.getRootfsFileName(workingMode)))
+    }
+
+    /** Remove the spares, once sandboxed agent sessions are turned off. */
+    fun discardSpares() {
+        synchronized(this) {
+            clonesDir().listFiles()?.filter { it.name.startsWith(SPARE_PREFIX) }?.forEach { spare ->
+                if (spare.isDirectory) discard(spare) else spare.delete()
+            }
+        }
+    }
+
+    /**
+     * Create a clone of the extracted rootfs in `local/<baseDirName>`. A current spare is renamed into place; otherwise
+     * this waits for the spare being copied or copies the rootfs, which can take minutes, so call it off the main
+     * thread. Either way the next spare is then prepared in the background. An existing clone with the same id is
+     * replaced.
+     *
+     * @throws IOException if the base rootfs has not been extracted yet or the clone could not be written.
+     */
+    @Throws(IOException::class)
+    fun createClone(baseDirName: String, cloneId: String): File {
+        val baseDir = localDir().child(baseDirName)
+        if (!baseDir.child("bin").exists() && !baseDir.child("usr").exists()) {
+            throw IOException("Rootfs $baseDirName has not been extracted yet")
+        }
+
+        val cloneDir = getCloneDir(cloneId)
+        deleteClone(cloneId)
+
+        try {
+            if (takeSpare(baseDirName, cloneDir)) {
+                android.util.Log.d("RootfsClone", "Took the spare clone of $baseDirName as ${getRootfsDirName(cloneId)}")
+                return cloneDir
+            }
+            cloneDir.mkdirs()
+            copyTree(baseDir, cloneDir, getRootfsDirName(cloneId))
+        } catch (e: IOException) {
+            runCatching { deleteClone(cloneId) }
+            throw e
+        } finally {
+            prepareSpare(baseDirName)
+        }
+        return cloneDir
+    }
+
+    /** Rename the spare of [baseDirName] to [cloneDir] after waiting for one being copied; false if none is current. */
+    private fun takeSpare(baseDirName: String, cloneDir: File): Boolean {
+        val pending = synchronized(this) { pendingSpares[baseDirName] }
+        try {
+            pending?.get()
+        } catch (e: ExecutionException) {
+        } catch (e: InterruptedException) {
+            Thread.currentThread().interrupt()
+            return false
+        }
+        synchronized(this) {
+            if (!spareIsCurrent(baseDirName)) return false
+            val spare = clonesDir().child("$SPARE_PREFIX$baseDirName")
+            if (!spare.renameTo(cloneDir)) return false
+            stampFile(baseDirName).delete()
+            return true
+        }
+    }
+
+    private fun buildSpare(baseDirName: String) {
+        val baseDir = localDir().child(baseDirName)
+        if (!baseDir.child("bin").exists() && !baseDir.child("usr").exists()) return
+        val stamp = baseStamp(baseDir)
+        val name = "$BUILDING_PREFIX$baseDirName-${System.nanoTime()}"
+        val target = clonesDir().child(name)
+        synchronized(this) { building.add(name) }
+        try {
+            target.mkdirs()
+            copyTree(baseDir, target, "spare of $baseDirName")
+            synchronized(this) {
+                val spare = clonesDir().child("$SPARE_PREFIX$baseDirName")
+                discard(spare)
+                if (!target.renameTo(spare)) throw IOException("Could not rename $name to ${spare.name}")
+                stampFile(baseDirName).writeText(stamp)
+            }
+        } catch (e: IOException) {
+            discard(target)
+            throw e
+        } finally {
+            synchronized(this) { building.remove(name) }
+        }
+    }
+
+    private fun copyTree(baseDir: File, target: File, description: String) {
+        val startTime = System.currentTimeMillis()
+        val stats = FileTreeCloner.cloneTree(baseDir.absolutePath, target.absolutePath, SKIPPED_PATHS)
+        android.util.Log.d(
+            "RootfsClone",
+            "Cloned ${baseDir.name} to $description in ${System.currentTimeMillis() - startTime}ms (${stats[0]} reflinked, ${stats[1]} copied)"
+        )
+    }
+
+    /** Whether the spare of [baseDirName] exists and was copied from the base as it is now. */
+    private fun spareIsCurrent(baseDirName: String): Boolean {
+        val spare = clonesDir().child("$SPARE_PREFIX$baseDirName")
+        val stamp = stampFile(baseDirName)
+        if (!spare.isDirectory || !stamp.isFile) return false
+        return runCatching { stamp.readText() }.getOrNull() == baseStamp(localDir().child(baseDirName))
+    }
+
+    private fun stampFile(baseDirName: String): File = clonesDir().child("$SPARE_PREFIX$baseDirName.stamp")
+
+    private fun baseStamp(baseDir: File): String {
+        return BASE_STAMP_PATHS.joinToString(",") { path -> baseDir.child(path).lastModified().toString() }
+    }
+
+    /** Rename [dir] away and remove it in the background. */
+    private fun discard(dir: File) {
+        if (!dir.exists()) return
+        val deleted = clonesDir().child("$DELETED_PREFIX${dir.name.removePrefix(".")}-${System.nanoTime()}")
+        val victim = if (dir.renameTo(deleted)) deleted else dir
+        Thread {
+            runCatching { FileTreeCloner.removeTree(victim.absolutePath) }
+                .onFailure { android.util.Log.w("RootfsClone", "Failed to delete ${victim.name}", it) }
+        }.start()
+    }
+
+    /** Delete a clone. Its files are its own, so the base rootfs is unaffected. */
+    @Throws(IOException::class)
+    fun deleteClone(cloneId: String) {
+        FileTreeCloner.removeTree(getCloneDir(cloneId).absolutePath)
+    }
+}
@@ -0,0 +1,141 @@
+package com.qali.aterm.ui.screens.terminal
+
+import com.rk.libcommons.application
+import com.rk.libcommons.localDir
+import com.rk.settings.Settings
+import java.io.File
+import java.util.concurrent.atomic.AtomicInteger
+
+/**
+ * Programs the app runs inside a rootfs without a terminal, such as linter and MCP servers.
+ *
+ * They are launched like terminal sessions, through the init-host script with the environment of [MkSession], so
+ * they run under the same proot with the same binds. `ATERM_EXEC=1` makes the script run the given command with the
+ * rootfs search path in place of the distro's init script. A workspace in `local/<rootfs>` or in a clone
+ * (`local/clones/<id>`) runs in that rootfs, any other in the rootfs of the current working mode. Shared storage and
+ * the app's directories are bound into the rootfs under their own paths, so paths there need no mapping.
+ */
+object RootfsCommand {
+    /** Guest paths the init-host script binds to the same host path */
+    private val BOUND_PATHS = arrayOf(
+        "/sdcard", "/storage", "/data", "/dev", "/proc", "/sys",
+        "/apex", "/odm", "/product", "/system", "/system_ext", "/vendor"
+    )
+
+    /** Numbers the proot temporary directories of launches, which the app clears when it starts */
+    private val launches = AtomicInteger()
+
+    /**
+     * A command ready to start; [toRootfsPath] and [toHostPath] translate paths between the app and the command
+     */
+    class Launch(val command: List<String>, val environment: List<String>, val rootfsDir: File) {
+        fun toRootfsPath(hostPath: String): String = toRootfsPath(rootfsDir, hostPath)
+
+        fun toHostPath(path: String): String = toHostPath(rootfsDir, path)
+
+        /** A builder with exactly the launch environment, like the one a terminal session gets */
+        fun processBuilder(): ProcessBuilder {
+            val builder = ProcessBuilder(command)
+            val env = builder.environment()
+            env.clear()
+            for (variable in environment) {
+                val separator = variable.indexOf('=')
+                if (separator > 0) env[variable.substring(0, separator)] = variable.substring(separator + 1)
+            }
+            return builder
+        }
+    }
+
+    /**
+     * Launch of [command] in the rootfs of [workspaceRoot], starting in [workingDir] (a host path, by default the
+     * workspace). Null when there is no application context or that rootfs has not been extracted, so callers can
+     * fall back without paying for a launch that cannot work.
+     */
+    fun forWorkspace(workspaceRoot: String, command: List<String>, workingDir: String? = null): Launch? {
+        val context = application ?: return null
+        val rootfsDir = rootfsDirFor(workspaceRoot) ?: return null
+        val workingMode = Settings.working_Mode
+        val environment = MkSession.hostEnvironment(
+            context,
+            "exec-${launches.incrementAndGet()}",
+            Rootfs.getRootfsFileName(workingMode),
+            rootfsDir.relativeTo(localDir()).invariantSeparatorsPath,
+            workingMode
+        )
+        return build(MkSession.hostInitFile(context, workingMode), environment, rootfsDir, command, workingDir ?: workspaceRoot)
+    }
+
+    /**
+     * The rootfs commands for [workspaceRoot] run in: the extracted rootfs or clone containing it, otherwise the
+     * rootfs of the current working mode. Null when that has not been extracted.
+     */
+    fun rootfsDirFor(workspaceRoot: String): File? {
+        if (application == null) return null
+        val rootfsDirName = rootfsDirName(localDir(), workspaceRoot)
+            ?: Rootfs.getRootfsDirName(Rootfs.getRootfsFileName(Settings.working_Mode))
+        return File(localDir(), rootfsDirName).takeIf { isExtracted(it) }
+    }
+
+    /**
+     * Launch of [command] through [hostInit] in [rootfsDir], given the session environment [hostEnvironment]
+     */
+    fun build(
+        hostInit: File,
+        hostEnvironment: List<String>,
+        rootfsDir: File,
+        command: List<String>,
+        workingDir: String
+    ): Launch {
+        val environment = hostEnvironment + listOf(
+            "ATERM_EXEC=1",
+            "ATERM_EXEC_DIR=${toRootfsPath(rootfsDir, workingDir)}"
+        )
+        return Launch(listOf("/system/bin/sh", hostInit.absolutePath) + command, environment, rootfsDir)
+    }
+
+    /**
+     * Rootfs directory, relative to [localDir], of the extracted rootfs or clone containing [path], or null when the
+     * path is in none
+     */
+    fun rootfsDirName(localDir: File, path: String): String? {
+        val local = localDir.absoluteFile.normalize().path
+        val target = File(path).absoluteFile.normalize().path
+        if (!target.startsWith("$local/")) return null
+        val segments = target.substring(local.length + 1).split('/')
+        val name = when (segments[0]) {
+            // Not rootfs directories but the app's own files
+            "bin", "lib" -> return null
+            "clones" -> segments.getOrNull(1)?.let { "clones/$it" } ?: return null
+            else -> segments[0]
+        }
+        return name.takeIf { isExtracted(File(localDir, it)) }
+    }
+
+    /** The path under which the rootfs in [rootfsDir] sees the host path [hostPath] */
+    fun toRootfsPath(rootfsDir: File, hostPath: String): String {
+        val root = rootfsDir.absoluteFile.normalize().path
+        val target = File(hostPath).absoluteFile.normalize().path
+        return when {
+            target == root -> "/"
+            target.startsWith("$root/") -> target.substring(root.length)
+            else -> target
+        }
+    }
+
+    /** The host path of [path] as seen in the rootfs in [rootfsDir]; relative paths are returned as they are */
+    fun toHostPath(rootfsDir: File, path: String): String {
+        if (!path.startsWith("/")) return path
+        val normalized = File(path).normalize().path
+        fun under(prefix: String) = normalized == prefix || normalized.startsWith("$prefix/")
+        return when {
+            // Bound to the rootfs' own tmp
+            under("/dev/shm") -> File(rootfsDir, "tmp" + normalized.removePrefix("/dev/shm")).path
+            BOUND_PATHS.any { under(it) } -> normalized
+            else -> File(rootfsDir, normalized.removePrefix("/")).path
+        }
+    }
+
+    private fun isExtracted(rootfsDir: File): Boolean {
+        return File(rootfsDir, "bin").exists() || File(rootfsDir, "usr").exists()
+    }
+}
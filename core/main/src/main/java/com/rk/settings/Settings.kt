@@ -113,6 +113,31 @@ object Settings {
         get() = Preference.getInt(key = "custom_search_recursive_curls", default = 3)
         set(value) = Preference.setInt(key = "custom_search_recursive_curls", value.coerceIn(1, 8))
 
+    // Run agent sessions in a disposable clone of the rootfs
+    var agent_sandbox_rootfs
+        get() = Preference.getBoolean(key = "agent_sandbox_rootfs", default = false)
+        set(value) = Preference.setBoolean(key = "agent_sandbox_rootfs", value)
+
+    // Skip files that cannot match in agent searches, using an in-memory trigram index of the workspace
+    var agent_search_index
+        get() = Preference.getBoolean(key = "agent_search_index", default = true)
+        set(value) = Preference.setBoolean(key = "agent_search_index", value)
+
+    // Keep snapshots of session screens to show again after the process was killed
+    var restore_sessions
+        get() = Preference.getBoolean(key = "restore_sessions", default = true)
+        set(value) = Preference.setBoolean(key = "restore_sessions", value)
+
+    // Record spans and counters for performance traces
+    var trace_enabled
+        get() = Preference.getBoolean(key = "trace_enabled", default = false)
+        set(value) = Preference.setBoolean(key = "trace_enabled", value)
+
+    // Record the output of sessions as asciicast files
+    var record_sessions
+        get() = Preference.getBoolean(key = "record_sessions", default = false)
+        set(value) = Preference.setBoolean(key = "record_sessions", value)
+
 }
 
 object Preference {
@@ -0,0 +1,145 @@
+package com.qali.aterm.agent
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.io.RandomAccessFile
+import java.nio.file.Files
+
+/**
+ * Unit tests for ChatHistoryStore
+ * Tests appending, replacing and truncating, paged loading, compaction and damaged logs
+ */
+class ChatHistoryStoreTest {
+
+    private lateinit var tempDir: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("chat-history-test").toFile()
+    }
+
+    @After
+    fun tearDown() {
+        tempDir.deleteRecursively()
+    }
+
+    private fun message(n: Int, text: String = "message $n") =
+        SerializableAgentMessage(text = text, isUser = n % 2 == 0, timestamp = 1000L + n)
+
+    @Test
+    fun testSaveAndReload() {
+        val messages = (0 until 5).map { message(it) }
+        ChatHistoryStore(tempDir).save("session", messages)
+
+        val reopened = ChatHistoryStore(tempDir)
+        assertEquals(messages, reopened.load("session"))
+        assertEquals(5, reopened.messageCount("session"))
+        assertEquals(listOf("session"), reopened.sessionIds())
+    }
+
+    @Test
+    fun testSavingAgainOnlyAppendsNewMessages() {
+        val store = ChatHistoryStore(tempDir)
+        val messages = (0 until 3).map { message(it) }
+        store.save("session", messages)
+        val size = store.logSize("session")
+
+        store.save("session", messages)
+        assertEquals(size, store.logSize("session"))
+
+        store.save("session", messages + message(3))
+        val appended = store.logSize("session") - size
+        assertTrue(appended in 1 until size)
+        assertEquals(messages + message(3), ChatHistoryStore(tempDir).load("session"))
+    }
+
+    @Test
+    fun testChangedMessageIsReplaced() {
+        val store = ChatHistoryStore(tempDir)
+        val messages = (0 until 3).map { message(it) }
+        store.save("session", messages)
+
+        val updated = messages.toMutableList().apply { set(1, get(1).copy(viewed = true)) }
+        store.save("session", updated)
+
+        assertEquals(updated, ChatHistoryStore(tempDir).load("session"))
+    }
+
+    @Test
+    fun testTruncateThenAppend() {
+        val store = ChatHistoryStore(tempDir)
+        store.save("session", (0 until 4).map { message(it) })
+        val shorter = listOf(message(0), message(9, "replacement"))
+        store.save("session", shorter)
+
+        assertEquals(shorter, store.load("session"))
+        val reopened = ChatHistoryStore(tempDir)
+        assertEquals(2, reopened.messageCount("session"))
+        assertEquals(shorter, reopened.load("session"))
+    }
+
+    @Test
+    fun testPagedLoad() {
+        val messages = (0 until 10).map { message(it) }
+        ChatHistoryStore(tempDir).save("session", messages)
+
+        val store = ChatHistoryStore(tempDir)
+        assertEquals(messages.subList(3, 6), store.load("session", 3, 3))
+        assertEquals(messages.subList(8, 10), store.load("session", 8, 5))
+        assertTrue(store.load("session", 12, 5).isEmpty())
+    }
+
+    @Test
+    fun testCompactionKeepsLiveMessages() {
+        val store = ChatHistoryStore(tempDir)
+        var messages = listOf(message(0), message(1))
+        // A streamed reply rewrites its last message many times
+        for (n in 0 until 400) {
+            messages = listOf(messages[0], message(1, "reply ".repeat(n + 1)))
+            store.save("session", messages)
+        }
+        store.compact("session")
+
+        val lastRecord = messages[1].text.length + messages[0].text.length
+        assertTrue(store.logSize("session") < lastRecord + 1024)
+        assertEquals(messages, ChatHistoryStore(tempDir).load("session"))
+
+        store.save("session", messages + message(2))
+        assertEquals(messages + message(2), ChatHistoryStore(tempDir).load("session"))
+    }
+
+    @Test
+    fun testTornRecordIsDropped() {
+        val messages = (0 until 3).map { message(it) }
+        val store = ChatHistoryStore(tempDir)
+        store.save("session", messages)
+        val file = tempDir.listFiles()!!.single()
+        RandomAccessFile(file, "rw").use { it.setLength(it.length() - 3) }
+
+        val reopened = ChatHistoryStore(tempDir)
+        assertEquals(messages.take(2), reopened.load("session"))
+        reopened.save("session", messages)
+        assertEquals(messages, ChatHistoryStore(tempDir).load("session"))
+    }
+
+    @Test
+    fun testSessionIdsAndDelete() {
+        val store = ChatHistoryStore(tempDir)
+        store.save("a/b", listOf(message(0)))
+        store.save("second", listOf(message(0), message(1)))
+
+        assertEquals(setOf("a/b", "second"), store.sessionIds().toSet())
+        assertEquals(2, ChatHistoryStore(tempDir).messageCount("second"))
+
+        store.delete("a/b")
+        assertEquals(listOf("second"), store.sessionIds())
+        assertTrue(store.load("a/b").isEmpty())
+
+        store.clear()
+        assertTrue(store.sessionIds().isEmpty())
+        assertEquals(0, store.messageCount("second"))
+    }
+}
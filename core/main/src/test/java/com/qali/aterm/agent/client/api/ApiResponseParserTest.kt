@@ -0,0 +1,61 @@
+package com.qali.aterm.agent.client.api
+
+import okio.Buffer
+import org.json.JSONObject
+import org.junit.Assert.*
+import org.junit.Test
+
+/**
+ * Unit tests for ApiResponseParser
+ * Tests how streamed Ollama content is emitted and unwrapped
+ */
+class ApiResponseParserTest {
+
+    private fun parseOllama(vararg frames: String): Pair<String?, List<String>> {
+        val chunks = ArrayList<String>()
+        val reader = SseStreamReader(Buffer().writeUtf8(frames.joinToString("") { "$it\n" }))
+        val finishReason = ApiResponseParser.parseOllamaStream(
+            reader, { chunks.add(it) }, {}, { _, _ -> }, mutableListOf(), { emptyMap() }
+        )
+        return finishReason to chunks
+    }
+
+    private fun frame(content: String, done: Boolean): String {
+        return JSONObject()
+            .put("model", "llama3")
+            .put("message", JSONObject().put("role", "assistant").put("content", content))
+            .put("done", done)
+            .toString()
+    }
+
+    @Test
+    fun testTextIsEmittedAsItArrives() {
+        val (finishReason, chunks) = parseOllama(frame("Hel", false), frame("lo", false), frame("", true))
+        assertEquals("STOP", finishReason)
+        assertEquals(listOf("Hel", "lo"), chunks)
+    }
+
+    @Test
+    fun testWrappedContentIsUnwrappedAcrossFrames() {
+        val (finishReason, chunks) = parseOllama(
+            frame("\n```js", false),
+            frame("on\n{\"action\": \"wr", false),
+            frame("ite\", \"path\": \"a.txt\"}\n``", false),
+            frame("`", false),
+            frame("", true)
+        )
+        assertEquals("STOP", finishReason)
+        assertEquals(1, chunks.size)
+        assertFalse(chunks[0].contains("```"))
+        val json = JSONObject(chunks[0])
+        assertEquals("write", json.getString("action"))
+        assertEquals("a.txt", json.getString("path"))
+    }
+
+    @Test
+    fun testHeldContentOfUnfinishedStreamIsEmitted() {
+        val (finishReason, chunks) = parseOllama(frame("{\"a\": ", false), frame("1}", false))
+        assertNull(finishReason)
+        assertEquals(1, JSONObject(chunks.single()).getInt("a"))
+    }
+}
@@ -0,0 +1,77 @@
+package com.qali.aterm.agent.client.api
+
+import okio.Buffer
+import org.junit.Assert.*
+import org.junit.Test
+
+/**
+ * Unit tests for SseStreamReader
+ * Tests SSE framing, NDJSON lines and the fallback for bodies that were not streamed
+ */
+class SseStreamReaderTest {
+
+    private fun readerFor(body: String) = SseStreamReader(Buffer().writeUtf8(body))
+
+    @Test
+    fun testSseEventsAreSplitOnBlankLines() {
+        val reader = readerFor(
+            ": keep-alive\n" +
+            "event: content_block_delta\n" +
+            "data: {\"a\":1}\n" +
+            "\n" +
+            "data: {\"b\":2}\n" +
+            "\n" +
+            "data: [DONE]\n" +
+            "\n"
+        )
+
+        assertEquals(SseStreamReader.Event("content_block_delta", "{\"a\":1}"), reader.next())
+        assertEquals(SseStreamReader.Event(null, "{\"b\":2}"), reader.next())
+        assertEquals(SseStreamReader.Event(null, "[DONE]"), reader.next())
+        assertNull(reader.next())
+        assertEquals(3, reader.frameCount)
+        assertEquals("", reader.unframedText)
+    }
+
+    @Test
+    fun testMultiLineDataAndMissingTrailingBlankLine() {
+        val reader = readerFor("data: first\r\ndata:second\r\n")
+
+        assertEquals(SseStreamReader.Event(null, "first\nsecond"), reader.next())
+        assertNull(reader.next())
+    }
+
+    @Test
+    fun testNdjsonLines() {
+        val reader = readerFor(
+            "{\"message\":{\"content\":\"Hel\"},\"done\":false}\n" +
+            "\n" +
+            "{\"message\":{\"content\":\"lo\"},\"done\":true}\n"
+        )
+
+        assertEquals("{\"message\":{\"content\":\"Hel\"},\"done\":false}", reader.next()?.data)
+        assertEquals("{\"message\":{\"content\":\"lo\"},\"done\":true}", reader.next()?.data)
+        assertNull(reader.next())
+        assertEquals(2, reader.frameCount)
+    }
+
+    @Test
+    fun testUnframedBodyIsCollected() {
+        val body = "[{\n  \"candidates\": []\n}]\n"
+        val reader = readerFor(body)
+
+        assertNull(reader.next())
+        assertEquals(0, reader.frameCount)
+        assertEquals(body, reader.unframedText)
+    }
+
+    @Test
+    fun testEventsAreReadIncrementally() {
+        val buffer = Buffer().writeUtf8("data: one\n\n")
+        val reader = SseStreamReader(buffer)
+
+        assertEquals("one", reader.next()?.data)
+        buffer.writeUtf8("data: two\n\n")
+        assertEquals("two", reader.next()?.data)
+    }
+}
@@ -0,0 +1,107 @@
+package com.qali.aterm.agent.ppe
+
+import com.qali.aterm.agent.core.*
+import okio.Buffer
+import okio.ByteString.Companion.encodeUtf8
+import org.junit.Assert.*
+import org.junit.Test
+
+/**
+ * Unit tests for BpeTokenizer and TokenCounter
+ * Tests rank-ordered merging, rank file loading, cached per-message counts and that vocabularies
+ * are only fetched on request
+ */
+class BpeTokenizerTest {
+
+    private fun tokenizer(): BpeTokenizer {
+        val file = StringBuilder()
+        for (b in 0 until 256) {
+            file.append(okio.ByteString.of(b.toByte()).base64()).append(' ').append(b).append('\n')
+        }
+        listOf("he" to 256, "ll" to 257, "llo" to 258, "hello" to 259, "el" to 300).forEach { (token, rank) ->
+            file.append(token.encodeUtf8().base64()).append(' ').append(rank).append('\n')
+        }
+        return BpeTokenizer.load("test", Buffer().writeUtf8(file.toString()), TokenCounter.CL100K_BASE.pattern)
+    }
+
+    @Test
+    fun testWholePieceIsOneToken() {
+        val tokenizer = tokenizer()
+        assertEquals(261, tokenizer.vocabularySize)
+        assertArrayEquals(intArrayOf(259), tokenizer.encode("hello"))
+        assertEquals(1, tokenizer.countTokens("hello"))
+    }
+
+    @Test
+    fun testMergesFollowRankOrder() {
+        val tokenizer = tokenizer()
+        // he (256) merges before el (300), then ll, llo and hello; x stays a single byte
+        assertArrayEquals(intArrayOf(259, 'x'.code), tokenizer.encode("hellox"))
+        // The leading space is part of the pre-tokenized piece but has no merges
+        assertArrayEquals(intArrayOf(' '.code, 259), tokenizer.encode(" hello"))
+        // "he" outranks "el", so "helx" never forms "el"; without an "h" in front it does
+        assertArrayEquals(intArrayOf(256, 'l'.code, 'x'.code), tokenizer.encode("helx"))
+        assertArrayEquals(intArrayOf('x'.code, 300, 'x'.code), tokenizer.encode("xelx"))
+        assertEquals(tokenizer.encode("hello world, 12345!").size, tokenizer.countTokens("hello world, 12345!"))
+    }
+
+    @Test
+    fun testMultiByteCharacters() {
+        val tokenizer = tokenizer()
+        // Unmerged multi-byte characters cost one token per UTF-8 byte
+        assertEquals(3, tokenizer.countTokens("€"))
+        assertEquals(0, tokenizer.countTokens(""))
+    }
+
+    @Test
+    fun testApproximationWithoutVocabulary() {
+        TokenCounter.vocabularyDir = null
+        assertEquals(0, TokenCounter.countTokens(""))
+        assertEquals(1, TokenCounter.countTokens("word"))
+        assertEquals(3, TokenCounter.countTokens("a b c"))
+        assertTrue(TokenCounter.countTokens("x".repeat(400)) >= 100)
+    }
+
+    @Test
+    fun testMissingVocabularyIsNotFetchedImplicitly() {
+        val dir = java.nio.file.Files.createTempDirectory("tokenizers").toFile()
+        try {
+            TokenCounter.vocabularyDir = dir
+            assertNull(TokenCounter.tokenizerFor("gpt-4o"))
+            assertEquals(3, TokenCounter.countTokens("a b c", "gpt-4"))
+            // Downloads only start from the settings
+            assertTrue(dir.list()!!.isEmpty())
+            assertEquals(TokenCounter.VocabularyState.MISSING, TokenCounter.vocabularyState())
+        } finally {
+            TokenCounter.vocabularyDir = null
+            dir.deleteRecursively()
+        }
+    }
+
+    @Test
+    fun testContentCountsAreCached() {
+        TokenCounter.vocabularyDir = null
+        TokenCounter.clearCache()
+        val content = Content(
+            role = "model",
+            parts = listOf(
+                Part.TextPart(text = "Reading the file now."),
+                Part.FunctionCallPart(FunctionCall(name = "read_file", args = mapOf("path" to "src/main.kt")))
+            )
+        )
+
+        val first = TokenCounter.countTokens(content)
+        assertTrue(first > TokenCounter.MESSAGE_OVERHEAD_TOKENS)
+        assertEquals(first, TokenCounter.countTokens(content.copy()))
+        assertEquals(first * 2, ContextWindowManager.estimateTokens(listOf(content, content)))
+    }
+
+    @Test
+    fun testEncodingForModel() {
+        assertEquals("o200k_base", TokenCounter.encodingForModel("gpt-4o-mini").name)
+        assertEquals("o200k_base", TokenCounter.encodingForModel("o3-mini").name)
+        assertEquals("cl100k_base", TokenCounter.encodingForModel("gpt-4").name)
+        assertEquals("cl100k_base", TokenCounter.encodingForModel("claude-3-5-sonnet").name)
+        assertEquals("cl100k_base", TokenCounter.encodingForModel("ollama").name)
+    }
+}
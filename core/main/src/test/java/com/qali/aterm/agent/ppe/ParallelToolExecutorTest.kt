@@ -0,0 +1,202 @@
+package com.qali.aterm.agent.ppe
+
+import com.qali.aterm.agent.core.FunctionCall
+import com.qali.aterm.agent.tools.ToolResult
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.test.currentTime
+import kotlinx.coroutines.test.runTest
+import org.junit.Test
+import org.junit.Assert.*
+
+/**
+ * Unit tests for ParallelToolExecutor and ToolAccess
+ * Tests dependency ordering, per-class concurrency limits and result order
+ */
+class ParallelToolExecutorTest {
+
+    private val root = "/tmp/test-workspace"
+
+    private fun read(path: String) = FunctionCall(name = "read_file", args = mapOf("file_path" to path))
+    private fun write(path: String) = FunctionCall(name = "write_file", args = mapOf("file_path" to path, "content" to "x"))
+    private fun shell(command: String) = FunctionCall(name = "shell", args = mapOf("command" to command))
+
+    @Test
+    fun testResultsInSubmissionOrder() = runTest {
+        val calls = listOf(read("a.kt"), read("b.kt"), read("c.kt"))
+        val delays = mapOf("a.kt" to 300L, "b.kt" to 100L, "c.kt" to 200L)
+
+        val results = ParallelToolExecutor.executeInParallel(calls, root) { call ->
+            val path = call.args["file_path"] as String
+            delay(delays.getValue(path))
+            ToolResult(llmContent = path)
+        }
+
+        assertEquals(listOf("a.kt", "b.kt", "c.kt"), results.map { it.second.llmContent })
+        assertEquals(calls, results.map { it.first })
+        // All three reads overlap, so the turn takes as long as the slowest one
+        assertEquals(300L, currentTime)
+    }
+
+    @Test
+    fun testReadWaitsForWriteOfSameFile() = runTest {
+        val events = mutableListOf<String>()
+        val calls = listOf(write("src/Main.kt"), read("src/Main.kt"))
+
+        ParallelToolExecutor.executeInParallel(calls, root) { call ->
+            events.add("start ${call.name}")
+            delay(100)
+            events.add("end ${call.name}")
+            ToolResult(llmContent = "ok")
+        }
+
+        assertEquals(listOf("start write_file", "end write_file", "start read_file", "end read_file"), events)
+    }
+
+    @Test
+    fun testReadyCallDoesNotWaitForUnrelatedSlowCall() = runTest {
+        val startTimes = mutableMapOf<String, Long>()
+        val calls = listOf(
+            FunctionCall(name = "web_fetch", args = mapOf("url" to "https://example.com")),
+            write("b.kt"),
+            read("b.kt")
+        )
+
+        ParallelToolExecutor.executeInParallel(calls, root) { call ->
+            startTimes[call.name] = currentTime
+            delay(if (call.name == "web_fetch") 1000 else 100)
+            ToolResult(llmContent = "ok")
+        }
+
+        // The read depends only on the write, not on the slow fetch
+        assertEquals(100L, startTimes["read_file"])
+        assertEquals(1000L, currentTime)
+    }
+
+    @Test
+    fun testConcurrencyLimitPerResourceClass() = runTest {
+        var running = 0
+        var maxRunning = 0
+        val calls = listOf(shell("ls"), shell("cat a.txt"), shell("git status"), read("a.kt"))
+        val limits = mapOf(
+            ToolAccess.ResourceClass.SHELL to 1,
+            ToolAccess.ResourceClass.FILE_IO to 4,
+            ToolAccess.ResourceClass.NETWORK to 4
+        )
+
+        ParallelToolExecutor.executeInParallel(calls, root, limits) { call ->
+            if (call.name == "shell") {
+                running++
+                maxRunning = maxOf(maxRunning, running)
+            }
+            delay(100)
+            if (call.name == "shell") running--
+            ToolResult(llmContent = "ok")
+        }
+
+        assertEquals(1, maxRunning)
+        assertEquals(300L, currentTime)
+    }
+
+    @Test
+    fun testFailingCallDoesNotDropOthers() = runTest {
+        val calls = listOf(read("a.kt"), read("b.kt"))
+
+        val results = ParallelToolExecutor.executeInParallel(calls, root) { call ->
+            if (call.args["file_path"] == "a.kt") throw IllegalStateException("boom")
+            ToolResult(llmContent = "ok")
+        }
+
+        assertNotNull(results[0].second.error)
+        assertTrue(results[0].second.error!!.message.contains("boom"))
+        assertEquals("ok", results[1].second.llmContent)
+    }
+
+    @Test
+    fun testDependencies() {
+        val calls = listOf(
+            read("a.kt"),
+            read("b.kt"),
+            write("a.kt"),
+            shell("./gradlew build"),
+            read("c.kt")
+        )
+
+        val dependencies = ParallelToolExecutor.buildDependencies(calls, root)
+
+        assertEquals(emptyList<Int>(), dependencies[0])
+        assertEquals(emptyList<Int>(), dependencies[1])
+        assertEquals(listOf(0), dependencies[2])
+        // A mutating shell command is ordered after everything before it, and everything after it
+        assertEquals(listOf(0, 1, 2), dependencies[3])
+        assertEquals(listOf(3), dependencies[4])
+    }
+
+    @Test
+    fun testGroupForParallelExecution() {
+        val calls = listOf(read("a.kt"), write("a.kt"), read("b.kt"), read("a.kt"))
+
+        val groups = ParallelToolExecutor.groupForParallelExecution(calls, root)
+
+        assertEquals(listOf(listOf(calls[0], calls[2]), listOf(calls[1]), listOf(calls[3])), groups)
+    }
+
+    @Test
+    fun testReadOnlyShellCommands() {
+        assertTrue(ToolAccess.isReadOnlyCommand("ls -la src"))
+        assertTrue(ToolAccess.isReadOnlyCommand("grep -rn foo . | head -20"))
+        assertTrue(ToolAccess.isReadOnlyCommand("git status && git diff"))
+        assertFalse(ToolAccess.isReadOnlyCommand("echo hi > out.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git commit -m x"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -name '*.tmp' -delete"))
+        assertFalse(ToolAccess.isReadOnlyCommand("ls; rm -rf build"))
+        assertFalse(ToolAccess.isReadOnlyCommand("cat \$(rm x)"))
+        assertFalse(ToolAccess.isReadOnlyCommand("sort a.txt | uniq - out.txt"))
+    }
+
+    @Test
+    fun testBackgroundedAndSubstitutedCommands() {
+        assertFalse(ToolAccess.isReadOnlyCommand("echo x & rm -rf build"))
+        assertFalse(ToolAccess.isReadOnlyCommand("ls &rm x"))
+        assertTrue(ToolAccess.isReadOnlyCommand("ls src & cat a.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("diff <(rm x) a.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("cat a.txt | tee >(wc -l)"))
+    }
+
+    @Test
+    fun testFindWritingActions() {
+        assertTrue(ToolAccess.isReadOnlyCommand("find . -name '*.kt' -print"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -fprint list.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -fprint0 list.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -fprintf list.txt %p"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -fls list.txt"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -execdir rm {} +"))
+        assertFalse(ToolAccess.isReadOnlyCommand("find . -okdir rm {} ;"))
+    }
+
+    @Test
+    fun testReadOnlyGitCommands() {
+        assertTrue(ToolAccess.isReadOnlyCommand("git branch"))
+        assertTrue(ToolAccess.isReadOnlyCommand("git branch --list -v"))
+        assertTrue(ToolAccess.isReadOnlyCommand("git remote -v"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git branch feature"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git branch -D feature"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git remote add origin https://example.com/x.git"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git remote remove origin"))
+        assertFalse(ToolAccess.isReadOnlyCommand("git diff --output=changes.patch"))
+    }
+
+    @Test
+    fun testPathsOverlap() {
+        assertTrue(ToolAccess.pathsOverlap("/w/src", "/w/src/Main.kt"))
+        assertTrue(ToolAccess.pathsOverlap("/w/src/./Main.kt", "/w/src/Main.kt"))
+        assertFalse(ToolAccess.pathsOverlap("/w/src", "/w/src2/Main.kt"))
+        assertTrue(ToolAccess.pathsOverlap(ToolAccess.WORKSPACE, "/w/a"))
+        assertFalse(ToolAccess.pathsOverlap("@memory", "/w/a"))
+        // Relative and absolute paths cannot be compared without a workspace root
+        assertTrue(ToolAccess.pathsOverlap("a.kt", "/w/b.kt"))
+
+        val relative = ToolAccess.of(write("src/Main.kt"), "/w")
+        val absolute = ToolAccess.of(read("/w/src/Main.kt"), "/w")
+        assertTrue(relative.conflictsWith(absolute))
+    }
+}
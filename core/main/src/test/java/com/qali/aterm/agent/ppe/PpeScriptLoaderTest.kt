@@ -0,0 +1,151 @@
+package com.qali.aterm.agent.ppe
+
+import com.qali.aterm.agent.ppe.models.*
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.ByteArrayInputStream
+import java.io.ByteArrayOutputStream
+import java.io.DataInputStream
+import java.io.DataOutputStream
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for PpeScriptLoader and compiled PPE scripts
+ * Tests compiled templates and conditions, the binary store format and content-hash caching
+ */
+class PpeScriptLoaderTest {
+
+    private lateinit var tempDir: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("ppe-loader-test").toFile()
+        PpeScriptLoader.storeDir = File(tempDir, "store")
+        PpeScriptLoader.clearCache()
+    }
+
+    @After
+    fun tearDown() {
+        PpeScriptLoader.storeDir = null
+        PpeScriptLoader.clearCache()
+        tempDir.deleteRecursively()
+    }
+
+    @Test
+    fun testCompiledTemplateRendering() {
+        val variables = mapOf<String, Any>("user" to mapOf("name" to " bob "), "price" to "\$5")
+
+        assertEquals("Hi BOB, costs \$5 {{}}!", PpeTemplateEngine.render("Hi {{ user.name | trim | UPPER }}, costs {{price}} {{}}!", variables))
+        assertEquals("missing: []", PpeTemplateEngine.render("missing: [{{nothing.here}}]", variables))
+        assertEquals("plain text", PpeTemplateEngine.render("plain text", variables))
+        assertEquals(listOf("user.name", "price"), PpeTemplateEngine.extractVariables("{{user.name}} {{price|lower}} {{user.name}}"))
+        assertFalse(PpeTemplateEngine.hasVariables("no {variables}"))
+    }
+
+    @Test
+    fun testConditions() {
+        val variables = mapOf<String, Any>("count" to 3.0, "name" to "ppe", "flag" to "false", "nested" to mapOf("on" to true))
+
+        assertTrue(PpeCondition.of("count == 3").evaluate(variables))
+        assertTrue(PpeCondition.of("count != 4").evaluate(variables))
+        assertTrue(PpeCondition.of("name !== other").evaluate(variables))
+        assertFalse(PpeCondition.of("flag").evaluate(variables))
+        assertTrue(PpeCondition.of("!flag").evaluate(variables))
+        assertTrue(PpeCondition.of("nested.on").evaluate(variables))
+        assertFalse(PpeCondition.of("missing").evaluate(variables))
+        assertEquals(3.0, PpeCondition.expression("count").evaluate(variables))
+        assertEquals(true, PpeCondition.expression("true").evaluate(variables))
+    }
+
+    @Test
+    fun testCompiledScriptRoundTrip() {
+        val script = PpeScript(
+            parameters = mapOf("count" to 3, "ratio" to 0.5, "big" to (1L shl 40), "tags" to listOf("a", "b"), "nested" to mapOf("on" to true)),
+            input = listOf("question"),
+            turns = listOf(
+                PpeTurn(
+                    messages = listOf(
+                        PpeMessage("system", "You answer {{question | trim}}"),
+                        PpeMessage(
+                            role = "assistant",
+                            content = "[[ANSWER]] " + "long ".repeat(20000),
+                            hasAiPlaceholder = true,
+                            aiPlaceholderVar = "ANSWER",
+                            aiPlaceholderParams = mapOf("temperature" to 0.2),
+                            regexReplacements = listOf(PpeRegexReplacement("\\d+", "g", "N", groupIndex = 1, placeholder = "/\\d+/g:N:1"))
+                        )
+                    ),
+                    instructions = listOf(PpeInstruction("echo", mapOf("value" to "Got {{ANSWER}}"))),
+                    chainTo = "next",
+                    controlFlowBlocks = listOf(
+                        PpeControlFlowBlock(
+                            type = "if",
+                            condition = "count == 3",
+                            thenBlock = listOf(PpeInstruction("set", rawContent = "done=yes")),
+                            elseBlock = null
+                        ),
+                        PpeControlFlowBlock(type = "match", condition = "mode", cases = mapOf("fast" to emptyList<PpeInstruction>()))
+                    )
+                )
+            ),
+            metadata = mapOf("description" to "test"),
+            sourcePath = "/scripts/test.ai.yaml",
+            functions = listOf("fn body")
+        )
+
+        val compiled = PpeCompiledScript.compile(script)
+        assertTrue("You answer {{question | trim}}" in compiled.templates)
+        assertTrue("Got {{ANSWER}}" in compiled.templates)
+        assertEquals(setOf("count == 3"), compiled.conditions.keys)
+
+        val bytes = ByteArrayOutputStream().also { compiled.write(DataOutputStream(it)) }.toByteArray()
+        val read = PpeCompiledScript.read(DataInputStream(ByteArrayInputStream(bytes)))
+
+        assertEquals(script, read.script)
+        assertEquals(compiled.templates.keys, read.templates.keys)
+        val variables = mapOf<String, Any>("question" to "  why? ", "count" to 3.0)
+        assertEquals("You answer why?", read.templates.getValue("You answer {{question | trim}}").render(variables))
+        assertTrue(read.conditions.getValue("count == 3").evaluate(variables))
+    }
+
+    @Test
+    fun testLoaderStoresAndReusesCompiledScripts() {
+        val scriptFile = File(tempDir, "greet.ai.yaml")
+        scriptFile.writeText("parameters:\n  count: 3\n---\nsystem: Hello {{name}}\n")
+
+        val first = PpeScriptLoader.loadScript(scriptFile)
+        assertEquals(3, first.parameters["count"])
+        assertEquals("Hello {{name}}", first.turns.single().messages.single().content)
+        assertSame(first, PpeScriptLoader.loadScript(scriptFile.path))
+        assertEquals(1, File(tempDir, "store").listFiles()!!.count { it.name.endsWith(".bin") })
+
+        // A new process finds the compiled script on disk
+        PpeScriptLoader.clearCache()
+        val reloaded = PpeScriptLoader.loadScript(scriptFile)
+        assertEquals(first, reloaded)
+
+        // The same text elsewhere shares the compiled form but keeps its own path
+        val copy = File(tempDir, "copy.ai.yaml").apply { writeText(scriptFile.readText()) }
+        assertEquals(copy.absolutePath, PpeScriptLoader.loadScript(copy).sourcePath)
+        assertEquals(1, File(tempDir, "store").listFiles()!!.count { it.name.endsWith(".bin") })
+
+        scriptFile.writeText("parameters:\n  count: 4\n---\nsystem: Bye {{name}}\n")
+        val edited = PpeScriptLoader.loadScript(scriptFile)
+        assertEquals(4, edited.parameters["count"])
+        assertEquals("Bye {{name}}", edited.turns.single().messages.single().content)
+    }
+
+    @Test
+    fun testDamagedStoreIsIgnored() {
+        val scriptFile = File(tempDir, "greet.ai.yaml")
+        scriptFile.writeText("---\nuser: Hi\n")
+        val first = PpeScriptLoader.loadScript(scriptFile)
+        File(tempDir, "store").listFiles()!!.single().writeBytes(byteArrayOf(0x50, 0x50, 0x45, 0x43, 0, 0, 0, 1, 9))
+
+        PpeScriptLoader.clearCache()
+        assertEquals(first, PpeScriptLoader.loadScript(scriptFile))
+    }
+}
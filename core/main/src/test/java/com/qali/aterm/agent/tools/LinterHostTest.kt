@@ -0,0 +1,222 @@
+package com.qali.aterm.agent.tools
+
+import com.qali.aterm.ui.screens.terminal.RootfsCommand
+import kotlinx.coroutines.runBlocking
+import kotlinx.coroutines.withTimeout
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Assume.assumeTrue
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for LinterHost
+ * Tests the content and configuration keyed result cache, the server launch and languages without a server
+ */
+class LinterHostTest {
+
+    private lateinit var tempDir: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("linter-host-test").toFile()
+    }
+
+    @After
+    fun tearDown() {
+        LinterHost.launcher = defaultLauncher
+        tempDir.deleteRecursively()
+    }
+
+    private val defaultLauncher = LinterHost.launcher
+
+    /** Runs [command] on the host, with the workspace directory [rootfs] standing in for a rootfs */
+    private fun hostLaunch(rootfs: File, command: List<String>) =
+        RootfsCommand.Launch(command, listOf("PATH=${System.getenv("PATH")}"), rootfs)
+
+    private fun hasNode(): Boolean = try {
+        ProcessBuilder("node", "--version").start().waitFor() == 0
+    } catch (e: Exception) {
+        false
+    }
+
+    private fun error(message: String) = LinterError(
+        filePath = "",
+        lineNumber = 1,
+        column = 0,
+        message = message,
+        errorType = "error"
+    )
+
+    @Test
+    fun testCachedUntilContentChanges() = runBlocking {
+        val file = File(tempDir, "script.sh").apply { writeText("echo one\n") }
+        var runs = 0
+        val root = tempDir.absolutePath
+        val lint: suspend () -> LinterHost.Outcome = {
+            runs++
+            LinterHost.Outcome(listOf(error("run $runs")), complete = true)
+        }
+
+        val first = LinterHost.cached("bash", file, root, lint)
+        assertEquals(first, LinterHost.cached("bash", file, root, lint))
+        assertEquals(1, runs)
+
+        file.writeText("echo two\n")
+        assertEquals(listOf(error("run 2")), LinterHost.cached("bash", file, root, lint))
+        assertEquals(2, runs)
+    }
+
+    @Test
+    fun testIncompleteRunsAreNotCached() = runBlocking {
+        val file = File(tempDir, "main.py").apply { writeText("import os\n") }
+        val root = tempDir.absolutePath
+        var runs = 0
+        val timedOut: suspend () -> LinterHost.Outcome = {
+            runs++
+            LinterHost.Outcome(emptyList(), complete = false)
+        }
+
+        LinterHost.cached("python", file, root, timedOut)
+        LinterHost.cached("python", file, root, timedOut)
+        assertEquals(2, runs)
+
+        val found = LinterHost.cached("python", file, root) {
+            LinterHost.Outcome(listOf(error("unused import")), complete = true)
+        }
+        assertEquals(found, LinterHost.cached("python", file, root, timedOut))
+        assertEquals(2, runs)
+    }
+
+    @Test
+    fun testConfigChangeInvalidates() = runBlocking {
+        val src = File(tempDir, "src").apply { mkdirs() }
+        val file = File(src, "main.js").apply { writeText("let x = 1;\n") }
+        val root = tempDir.absolutePath
+        var runs = 0
+        val lint: suspend () -> LinterHost.Outcome = {
+            runs++
+            LinterHost.Outcome(emptyList(), complete = true)
+        }
+
+        LinterHost.cached("javascript", file, root, lint)
+        LinterHost.cached("javascript", file, root, lint)
+        assertEquals(1, runs)
+
+        // A configuration at the workspace root applies to files below it
+        File(tempDir, "eslint.config.js").writeText("module.exports = [];\n")
+        LinterHost.cached("javascript", file, root, lint)
+        assertEquals(2, runs)
+    }
+
+    @Test
+    fun testCacheKeysAreSeparate() = runBlocking {
+        val file = File(tempDir, "main.js").apply { writeText("let x = 1;\n") }
+        val root = tempDir.absolutePath
+        LinterHost.cached("javascript", file, root) { LinterHost.Outcome(listOf(error("javascript")), complete = true) }
+        val other = LinterHost.cached("typescript", file, root) {
+            LinterHost.Outcome(listOf(error("typescript")), complete = true)
+        }
+        assertEquals("typescript", other.single().message)
+    }
+
+    @Test
+    fun testNoServerForLanguage() = runBlocking {
+        val file = File(tempDir, "script.sh").apply { writeText("echo\n") }
+        assertNull(LinterHost.lint("bash", file, tempDir.absolutePath))
+    }
+
+    @Test
+    fun testServerLaunchedInRootfsWithRootfsPaths() = runBlocking {
+        val rootfs = File(tempDir, "rootfs")
+        val workspace = File(rootfs, "root/project").apply { mkdirs() }
+        val file = File(workspace, "main.py").apply { writeText("import os\n") }
+        var launched: List<String>? = null
+        var launchedIn: String? = null
+        LinterHost.launcher = { command, workspaceRoot ->
+            launched = command
+            launchedIn = workspaceRoot
+            // Echoes each path back the way the server reports a finding
+            hostLaunch(rootfs, listOf("sh", "-c", "while read p; do echo \"\$p:1:1: seen\"; echo ${LinterHost.DONE_MARKER}; done"))
+        }
+
+        val output = LinterHost.lint("python", file, workspace.absolutePath)
+
+        assertEquals(listOf("python3", "-u", "-c", LinterHost.PYTHON_SERVER), launched)
+        assertEquals(workspace.absolutePath, launchedIn)
+        assertEquals("/root/project/main.py:1:1: seen\n", output?.text)
+        assertTrue(output!!.complete)
+    }
+
+    @Test
+    fun testPartialRepliesAreMarked() = runBlocking {
+        val file = File(tempDir, "main.py").apply { writeText("import os\n") }
+        // Answers like the Python server without pyflakes
+        LinterHost.launcher = { _, _ ->
+            hostLaunch(tempDir, listOf("sh", "-c", "while read p; do echo ${LinterHost.PARTIAL_MARKER}; echo ${LinterHost.DONE_MARKER}; done"))
+        }
+
+        val reply = LinterHost.lint("python", file, tempDir.absolutePath)
+
+        assertEquals("", reply?.text)
+        assertFalse(reply!!.complete)
+    }
+
+    @Test
+    fun testServerReloadsAfterConfigChange() = runBlocking {
+        val src = File(tempDir, "src").apply { mkdirs() }
+        val file = File(src, "main.js").apply { writeText("let x = 1;\n") }
+        val root = tempDir.absolutePath
+        // Reports every line it was sent, answering only paths
+        LinterHost.launcher = { _, _ ->
+            hostLaunch(tempDir, listOf("sh", "-c",
+                "while read p; do echo \"\$p:1:1: got\"; case \"\$p\" in ${LinterHost.RELOAD_MARKER}) ;; *) echo ${LinterHost.DONE_MARKER};; esac; done"))
+        }
+
+        assertEquals("/src/main.js:1:1: got\n", LinterHost.lint("javascript", file, root)?.text)
+        assertEquals("/src/main.js:1:1: got\n", LinterHost.lint("javascript", file, root)?.text)
+
+        // A configuration added above the file is loaded again before linting it
+        File(tempDir, "eslint.config.js").writeText("module.exports = [];\n")
+        assertEquals(
+            "${LinterHost.RELOAD_MARKER}:1:1: got\n/src/main.js:1:1: got\n",
+            LinterHost.lint("javascript", file, root)?.text
+        )
+    }
+
+    @Test
+    fun testServerWithoutRootfsIsNotRetriedAtOnce() = runBlocking {
+        val file = File(tempDir, "main.py").apply { writeText("import os\n") }
+        var launches = 0
+        LinterHost.launcher = { _, _ ->
+            launches++
+            null
+        }
+
+        assertNull(LinterHost.lint("python", file, tempDir.absolutePath))
+        assertNull(LinterHost.lint("python", file, tempDir.absolutePath))
+        assertEquals(1, launches)
+    }
+
+    @Test
+    fun testNodeServerAnswersWhenESLintThrows() = runBlocking {
+        assumeTrue(hasNode())
+        // An ESLint that cannot be constructed, as with a broken install
+        File(tempDir, "node_modules/eslint").apply {
+            mkdirs()
+            File(this, "package.json").writeText("{\"name\": \"eslint\", \"main\": \"index.js\"}\n")
+            File(this, "index.js").writeText("exports.ESLint = class { constructor() { throw new Error('broken'); } };\n")
+        }
+        val first = File(tempDir, "a.js").apply { writeText("let a = 1;\n") }
+        val second = File(tempDir, "b.js").apply { writeText("let b = 2;\n") }
+        LinterHost.launcher = { command, _ -> hostLaunch(File("/"), command) }
+
+        // Each request is answered as unavailable instead of waiting for the request timeout
+        withTimeout(10_000) {
+            assertNull(LinterHost.lint("javascript", first, tempDir.absolutePath))
+            assertNull(LinterHost.lint("javascript", second, tempDir.absolutePath))
+        }
+    }
+}
@@ -0,0 +1,243 @@
+package com.qali.aterm.agent.tools
+
+import com.google.gson.JsonObject
+import com.google.gson.JsonParser
+import kotlinx.coroutines.async
+import kotlinx.coroutines.awaitAll
+import kotlinx.coroutines.runBlocking
+import kotlinx.coroutines.withTimeout
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.IOException
+import java.net.InetAddress
+import java.net.ServerSocket
+import java.net.Socket
+import java.util.Collections
+import java.util.concurrent.CountDownLatch
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.atomic.AtomicInteger
+
+/**
+ * Unit tests for McpClient and MCP tool declarations
+ * Tests the handshake, concurrent multiplexed calls, tool list caching, errors, cancellation
+ * and settings parsing against an in-process fake MCP server
+ */
+class McpClientTest {
+
+    /**
+     * Fake MCP server on a loopback socket. `slow` answers only after `fast` has been answered, so
+     * both are only answered if the client keeps them in flight together.
+     */
+    private class FakeServer {
+        private val listener = ServerSocket(0, 1, InetAddress.getLoopbackAddress())
+        val clientSocket = Socket(listener.inetAddress, listener.localPort)
+        private val socket = listener.accept()
+        val listCalls = AtomicInteger()
+        val notifications: MutableList<String> = Collections.synchronizedList(ArrayList())
+        private val fastAnswered = CountDownLatch(1)
+        private val writer = socket.getOutputStream().bufferedWriter()
+
+        fun start() {
+            Thread {
+                try {
+                    socket.getInputStream().bufferedReader().forEachLine { line -> handle(JsonParser.parseString(line).asJsonObject) }
+                } catch (e: IOException) {
+                }
+            }.apply {
+                isDaemon = true
+                start()
+            }
+        }
+
+        fun stop() {
+            socket.close()
+            listener.close()
+        }
+
+        fun send(message: String) {
+            synchronized(writer) {
+                writer.write(message + "\n")
+                writer.flush()
+            }
+        }
+
+        private fun handle(message: JsonObject) {
+            val method = message.get("method")?.asString
+            val id = message.get("id")
+            if (id == null) {
+                method?.let { notifications.add(it) }
+                return
+            }
+            if (method == null) return // Answer to our own ping
+            when (method) {
+                "initialize" -> reply(id.asLong, """{"protocolVersion":"2024-11-05","capabilities":{"tools":{}}}""")
+                "tools/list" -> {
+                    listCalls.incrementAndGet()
+                    val cursor = message.getAsJsonObject("params")?.get("cursor")?.asString
+                    if (cursor == null) {
+                        reply(id.asLong, """{"tools":[{"name":"fast","description":"Fast","inputSchema":{"type":"object","properties":{"text":{"type":"string","description":"Text"}},"required":["text"]}}],"nextCursor":"2"}""")
+                    } else {
+                        reply(id.asLong, """{"tools":[{"name":"slow","inputSchema":{"type":"object"}}]}""")
+                    }
+                }
+                "tools/call" -> {
+                    val params = message.getAsJsonObject("params")
+                    val text = params.getAsJsonObject("arguments")?.get("text")?.asString ?: ""
+                    when (params.get("name").asString) {
+                        "fast" -> {
+                            reply(id.asLong, """{"content":[{"type":"text","text":"fast $text"}]}""")
+                            fastAnswered.countDown()
+                        }
+                        "slow" -> Thread {
+                            fastAnswered.await(5, TimeUnit.SECONDS)
+                            reply(id.asLong, """{"content":[{"type":"text","text":"slow $text"}]}""")
+                        }.start()
+                        "broken" -> reply(id.asLong, """{"content":[{"type":"text","text":"bad input"}],"isError":true}""")
+                        "hang" -> {}
+                        else -> send("""{"jsonrpc":"2.0","id":$id,"error":{"code":-32602,"message":"Unknown tool"}}""")
+                    }
+                }
+                else -> send("""{"jsonrpc":"2.0","id":$id,"error":{"code":-32601,"message":"Method not found"}}""")
+            }
+        }
+
+        private fun reply(id: Long, result: String) {
+            send("""{"jsonrpc":"2.0","id":$id,"result":$result}""")
+        }
+    }
+
+    private lateinit var server: FakeServer
+    private lateinit var client: McpClient
+
+    @Before
+    fun setup() {
+        server = FakeServer()
+        client = McpClient(server.clientSocket.getInputStream(), server.clientSocket.getOutputStream())
+        server.start()
+    }
+
+    @After
+    fun tearDown() {
+        client.close()
+        server.stop()
+    }
+
+    private fun args(text: String) = JsonObject().apply { addProperty("text", text) }
+
+    @Test
+    fun testInitializeAndListTools() = runBlocking {
+        val info = client.initialize(5000)
+        assertEquals("2024-11-05", info.get("protocolVersion").asString)
+
+        val tools = client.listTools(5000)
+        assertEquals(listOf("fast", "slow"), tools.map { it.name })
+        assertEquals(2, server.listCalls.get())
+
+        // Cached until the server says the list changed
+        client.listTools(5000)
+        assertEquals(2, server.listCalls.get())
+        server.send("""{"jsonrpc":"2.0","method":"notifications/tools/list_changed"}""")
+        withTimeout(5000) {
+            while (true) {
+                client.listTools(5000)
+                if (server.listCalls.get() > 2) break
+                kotlinx.coroutines.delay(10)
+            }
+        }
+        assertTrue(server.notifications.contains("notifications/initialized"))
+    }
+
+    @Test
+    fun testConcurrentCallsShareTheConnection() = runBlocking {
+        client.initialize(5000)
+        // slow is only answered after fast, which is sent second
+        val results = listOf(
+            async { client.callTool("slow", args("a"), 5000) },
+            async { client.callTool("fast", args("b"), 5000) }
+        ).awaitAll()
+
+        assertEquals("slow a", McpToolInvocation.formatContent(results[0]))
+        assertEquals("fast b", McpToolInvocation.formatContent(results[1]))
+    }
+
+    @Test
+    fun testErrorsAndTimeouts() = runBlocking {
+        client.initialize(5000)
+
+        try {
+            client.callTool("missing", JsonObject(), 5000)
+            fail("Expected an MCP error")
+        } catch (e: McpClient.McpException) {
+            assertEquals(-32602, e.code)
+        }
+
+        val broken = client.callTool("broken", JsonObject(), 5000)
+        assertTrue(broken.get("isError").asBoolean)
+
+        try {
+            client.callTool("hang", JsonObject(), 100)
+            fail("Expected a timeout")
+        } catch (e: IOException) {
+            assertTrue(e.message!!.contains("timed out"))
+        }
+        withTimeout(5000) {
+            while ("notifications/cancelled" !in server.notifications) kotlinx.coroutines.delay(10)
+        }
+
+        // The connection still works after a timed out request
+        assertEquals("fast c", McpToolInvocation.formatContent(client.callTool("fast", args("c"), 5000)))
+    }
+
+    @Test
+    fun testServerPingIsAnswered() = runBlocking {
+        client.initialize(5000)
+        server.send("""{"jsonrpc":"2.0","id":"p1","method":"ping"}""")
+        // Non-JSON output from the server is ignored
+        server.send("server starting...")
+        assertEquals("fast d", McpToolInvocation.formatContent(client.callTool("fast", args("d"), 5000)))
+    }
+
+    @Test
+    fun testPendingRequestsFailWhenClosed() = runBlocking {
+        client.initialize(5000)
+        val call = async { client.callTool("hang", JsonObject(), 5000) }
+        kotlinx.coroutines.delay(50)
+        client.close()
+        try {
+            call.await()
+            fail("Expected the call to fail")
+        } catch (e: IOException) {
+            assertFalse(client.isOpen)
+        }
+    }
+
+    @Test
+    fun testToolDeclarationAndSettings() {
+        val tools = runBlocking {
+            client.initialize(5000)
+            client.listTools(5000)
+        }
+        val tool = McpTool.from("my server", tools[0], "/tmp")
+        assertEquals("mcp_my_server_fast", tool.name)
+        assertEquals(listOf("text"), tool.parameterSchema.required)
+        assertEquals("string", tool.parameterSchema.properties.getValue("text").type)
+
+        val params = tool.validateParams(mapOf("text" to "hi"))!!
+        assertEquals("my server", params.serverName)
+        assertEquals("fast", params.toolName)
+        assertEquals(mapOf("text" to "hi"), params.args)
+
+        val configs = McpServerManager.parseConfigs(
+            """{"theme":"dark","mcpServers":{
+                "files":{"command":"npx","args":["-y","server"],"env":{"A":"1"},"timeout":1000},
+                "db":{"socket":"/run/db.sock"},
+                "bad":{"url":"http://example"}}}"""
+        )
+        assertEquals(setOf("files", "db"), configs.keys)
+        assertEquals(listOf("-y", "server"), configs.getValue("files").args)
+        assertEquals(1000L, configs.getValue("files").timeoutMs)
+        assertEquals("/run/db.sock", configs.getValue("db").socket)
+    }
+}
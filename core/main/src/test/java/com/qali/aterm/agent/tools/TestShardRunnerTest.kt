@@ -0,0 +1,214 @@
+package com.qali.aterm.agent.tools
+
+import kotlinx.coroutines.runBlocking
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for TestShardRunner
+ * Tests discovery, dependency-aware cache keys, shard planning, report parsing and cached runs
+ */
+class TestShardRunnerTest {
+
+    private lateinit var tempDir: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("test-shard-test").toFile()
+    }
+
+    @After
+    fun tearDown() {
+        tempDir.deleteRecursively()
+    }
+
+    private fun write(path: String, text: String) {
+        File(tempDir, path).apply { parentFile?.mkdirs() }.writeText(text)
+    }
+
+    @Test
+    fun testDiscoverPytestUnits() {
+        write("tests/test_math.py", "")
+        write("pkg/util_test.py", "")
+        write("pkg/util.py", "")
+        write("venv/lib/test_vendor.py", "")
+        write(".hidden/test_hidden.py", "")
+
+        val units = TestShardRunner(tempDir, "pytest", null).discoverUnits()
+        assertEquals(listOf("pkg/util_test.py", "tests/test_math.py"), units)
+    }
+
+    @Test
+    fun testDiscoverJestUnits() {
+        write("src/sum.test.js", "")
+        write("src/__tests__/render.tsx", "")
+        write("src/sum.js", "")
+        write("node_modules/lib/lib.test.js", "")
+
+        val units = TestShardRunner(tempDir, "jest", null).discoverUnits()
+        assertEquals(listOf("src/__tests__/render.tsx", "src/sum.test.js"), units)
+    }
+
+    @Test
+    fun testPythonKeyFollowsImports() {
+        write("app/__init__.py", "")
+        write("app/core.py", "from .helpers import add\n")
+        write("app/helpers.py", "def add(a, b): return a + b\n")
+        write("app/unrelated.py", "X = 1\n")
+        write("tests/test_core.py", "from app.core import add\nimport os\n")
+
+        val before = TestShardRunner(tempDir, "pytest", null).unitKey("tests/test_core.py")
+        write("app/unrelated.py", "X = 2\n")
+        assertEquals(before, TestShardRunner(tempDir, "pytest", null).unitKey("tests/test_core.py"))
+
+        write("app/helpers.py", "def add(a, b): return b + a\n")
+        assertNotEquals(before, TestShardRunner(tempDir, "pytest", null).unitKey("tests/test_core.py"))
+    }
+
+    @Test
+    fun testJsKeyFollowsImportsAndConfig() {
+        write("package.json", "{\"devDependencies\": {\"jest\": \"^29\"}}")
+        write("src/sum.js", "module.exports = (a, b) => a + b;\n")
+        write("src/other.js", "")
+        write("src/sum.test.js", "const sum = require('./sum');\n")
+
+        val before = TestShardRunner(tempDir, "jest", null).unitKey("src/sum.test.js")
+        write("src/other.js", "changed")
+        assertEquals(before, TestShardRunner(tempDir, "jest", null).unitKey("src/sum.test.js"))
+
+        write("src/sum.js", "module.exports = (a, b) => b + a;\n")
+        val afterSource = TestShardRunner(tempDir, "jest", null).unitKey("src/sum.test.js")
+        assertNotEquals(before, afterSource)
+
+        write("package.json", "{\"devDependencies\": {\"jest\": \"^30\"}}")
+        assertNotEquals(afterSource, TestShardRunner(tempDir, "jest", null).unitKey("src/sum.test.js"))
+    }
+
+    @Test
+    fun testPlanShardsBalancesDurations() {
+        val runner = TestShardRunner(tempDir, "pytest", null)
+        val durations = mapOf("a" to 9000L, "b" to 5000L, "c" to 4000L, "d" to 1000L)
+        val shards = runner.planShards(listOf("a", "b", "c", "d"), durations, 2)
+
+        assertEquals(2, shards.size)
+        assertEquals(setOf(listOf("a", "d"), listOf("b", "c")), shards.toSet())
+        assertEquals(1, runner.planShards(listOf("a"), durations, 8).size)
+        assertTrue(runner.planShards(emptyList(), durations, 4).isEmpty())
+    }
+
+    @Test
+    fun testParseJUnitXml() {
+        val xml = """
+            <testsuite>
+              <testcase classname="tests.test_core" name="test_ok" file="tests/test_core.py" line="3" time="0.5"/>
+              <testcase classname="tests.test_core" name="test_bad" file="tests/test_core.py" line="7">
+                <failure message="assert 1 == 2">trace here</failure>
+              </testcase>
+              <testcase classname="tests.test_core" name="test_skip"><skipped message="later"/></testcase>
+            </testsuite>
+        """.trimIndent()
+
+        val cases = TestShardRunner.parseJUnitXml(xml)
+        assertEquals(3, cases.size)
+        assertEquals(TestShardRunner.Status.PASSED, cases[0].status)
+        assertEquals(500L, cases[0].durationMs)
+        assertEquals(TestShardRunner.Status.FAILED, cases[1].status)
+        assertEquals("assert 1 == 2", cases[1].message)
+        assertEquals("trace here", cases[1].stackTrace)
+        assertEquals(7, cases[1].line)
+        assertEquals(TestShardRunner.Status.SKIPPED, cases[2].status)
+    }
+
+    @Test
+    fun testParseJestJson() {
+        val json = """
+            {"testResults": [
+              {"name": "/p/src/sum.test.js", "status": "failed", "assertionResults": [
+                {"fullName": "sum adds", "status": "passed", "duration": 4, "failureMessages": []},
+                {"fullName": "sum fails", "status": "failed", "duration": null,
+                 "failureMessages": ["Error: expected 3\n    at sum.test.js:5"], "location": {"line": 5, "column": 3}}
+              ]},
+              {"name": "/p/src/broken.test.js", "status": "failed", "message": "SyntaxError: bad\nmore", "assertionResults": []}
+            ]}
+        """.trimIndent()
+
+        val cases = TestShardRunner.parseJestJson(json)
+        assertEquals(3, cases.size)
+        assertEquals(TestShardRunner.Status.PASSED, cases[0].status)
+        assertEquals(4L, cases[0].durationMs)
+        assertEquals("Error: expected 3", cases[1].message)
+        assertEquals(5, cases[1].line)
+        assertEquals(TestShardRunner.Status.FAILED, cases[2].status)
+        assertEquals("SyntaxError: bad", cases[2].message)
+    }
+
+    @Test
+    fun testRunCachesPassingFiles() = runBlocking {
+        write("tests/test_a.py", "def test_a(): pass\n")
+        write("tests/test_b.py", "def test_b(): assert False\n")
+        val commands = mutableListOf<String>()
+        // Stands in for pytest: writes a report where test_b fails
+        val execute: suspend (String) -> TestShardRunner.CommandOutput = { command ->
+            synchronized(commands) { commands.add(command) }
+            val report = Regex("""--junitxml='([^']+)'""").find(command)!!.groupValues[1]
+            val cases = listOf("a", "b").filter { "test_$it.py" in command }.joinToString("") { name ->
+                val body = if (name == "b") "<failure message=\"boom\"/>" else ""
+                "<testcase classname=\"tests.test_$name\" name=\"test_$name\" file=\"tests/test_$name.py\">$body</testcase>"
+            }
+            File(report).writeText("<testsuite>$cases</testsuite>")
+            TestShardRunner.CommandOutput("ran", 1)
+        }
+
+        val first = TestShardRunner(tempDir, "pytest", null).run(2, execute)!!
+        assertEquals(0, first.cachedUnits)
+        assertEquals(listOf("tests/test_a.py", "tests/test_b.py"), first.units.map { it.path })
+        assertEquals(2, commands.size)
+
+        commands.clear()
+        val second = TestShardRunner(tempDir, "pytest", null).run(2, execute)!!
+        assertEquals(1, second.cachedUnits)
+        assertEquals(1, commands.size)
+        assertTrue(commands.single().contains("test_b.py"))
+        assertEquals(TestShardRunner.Status.FAILED, second.units[1].cases.single().status)
+
+        write("tests/test_a.py", "def test_a(): assert True\n")
+        commands.clear()
+        val third = TestShardRunner(tempDir, "pytest", null).run(1, execute)!!
+        assertEquals(0, third.cachedUnits)
+        assertEquals(1, commands.size)
+    }
+
+    @Test
+    fun testRunWithoutReportsIsUnusable() = runBlocking {
+        write("test_a.py", "")
+        val result = TestShardRunner(tempDir, "pytest", null).run(1, { TestShardRunner.CommandOutput("python3: not found", 127) })
+        assertNull(result)
+    }
+
+    @Test
+    fun testFilesWithoutTestsFailOnlyWhenTheRunnerFailed() = runBlocking {
+        write("test_a.py", "def test_a(): pass\n")
+        write("test_empty.py", "# nothing yet\n")
+        // Stands in for pytest: only test_a has a test, and the run exits with [exitCode]
+        fun execute(exitCode: Int): suspend (String) -> TestShardRunner.CommandOutput = { command ->
+            val report = Regex("""--junitxml='([^']+)'""").find(command)!!.groupValues[1]
+            val cases = if ("test_a.py" in command) "<testcase classname=\"test_a\" name=\"test_a\" file=\"test_a.py\"/>" else ""
+            File(report).writeText("<testsuite>$cases</testsuite>")
+            TestShardRunner.CommandOutput("ran", exitCode)
+        }
+
+        val collected = TestShardRunner(tempDir, "pytest", null).run(1, execute(0))!!
+        val empty = collected.units.single { it.path == "test_empty.py" }
+        assertTrue(empty.cases.isEmpty())
+
+        // Interrupted, as pytest does after an error during collection
+        write("test_empty.py", "# still nothing\n")
+        val interrupted = TestShardRunner(tempDir, "pytest", null).run(1, execute(2))!!
+        val failed = interrupted.units.single { it.path == "test_empty.py" }
+        assertEquals(TestShardRunner.Status.FAILED, failed.cases.single().status)
+    }
+}
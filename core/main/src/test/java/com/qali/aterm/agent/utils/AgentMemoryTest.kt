@@ -0,0 +1,85 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for AgentMemory
+ * Tests the append-only log, ranked search and reloading after outside changes
+ */
+class AgentMemoryTest {
+
+    private lateinit var workspace: File
+
+    @Before
+    fun setup() {
+        workspace = Files.createTempDirectory("agent-memory-test").toFile()
+    }
+
+    @After
+    fun tearDown() {
+        workspace.deleteRecursively()
+    }
+
+    private val root: String
+        get() = workspace.absolutePath
+
+    private fun logLines(): List<String> = File(workspace, ".agent_memory.jsonl").readLines()
+
+    @Test
+    fun testAddAppendsOneLine() {
+        AgentMemory.addMemory("build", "Run ./gradlew assembleDebug to build", listOf("gradle"), workspaceRoot = root)
+        AgentMemory.addMemory("style", "Use four spaces for indentation", workspaceRoot = root)
+
+        assertEquals(2, logLines().size)
+        val entries = AgentMemory.loadMemory(root).entries
+        assertEquals(2, entries.size)
+        assertNotEquals(entries[0].id, entries[1].id)
+    }
+
+    @Test
+    fun testSearchRanksRelevantEntries() {
+        AgentMemory.addMemory("style", "Use four spaces for indentation", workspaceRoot = root)
+        AgentMemory.addMemory("build", "Run ./gradlew assembleDebug to build", listOf("gradle"), workspaceRoot = root)
+        AgentMemory.addMemory("test", "Unit tests live in core/main/src/test", workspaceRoot = root)
+
+        val results = AgentMemory.searchMemory("how do I build with gradle", root)
+        assertEquals("build", results.first().category)
+        assertTrue(AgentMemory.searchMemory("kubernetes", root).isEmpty())
+
+        val context = AgentMemory.getMemoryForContext(root, "indentation")
+        assertTrue(context.contains("four spaces"))
+        assertFalse(context.contains("assembleDebug"))
+    }
+
+    @Test
+    fun testReloadsWhenLogChangesOutside() {
+        AgentMemory.addMemory("build", "Run the build", workspaceRoot = root)
+        assertEquals(1, AgentMemory.loadMemory(root).entries.size)
+
+        val log = File(workspace, ".agent_memory.jsonl")
+        log.appendText(
+            "{\"id\":\"ext_1\",\"timestamp\":1,\"category\":\"deploy\",\"content\":\"Deploy with fastlane\",\"tags\":[]}\n" +
+                "{\"id\":\"ext_2\",\"timestamp\":2,\"categ"
+        )
+        log.setLastModified(log.lastModified() + 2000)
+
+        val entries = AgentMemory.loadMemory(root).entries
+        assertEquals(setOf("build", "deploy"), entries.map { it.category }.toSet())
+        assertEquals("deploy", AgentMemory.searchMemory("fastlane", root).single().category)
+    }
+
+    @Test
+    fun testSaveMemoryRewritesLog() {
+        repeat(3) { AgentMemory.addMemory("note", "note $it", workspaceRoot = root) }
+        val kept = AgentMemory.loadMemory(root).entries.take(1)
+        AgentMemory.saveMemory(AgentMemory.MemorySummary(kept, "", 1), root)
+
+        assertEquals(1, logLines().size)
+        assertEquals(kept, AgentMemory.loadMemory(root).entries)
+    }
+}
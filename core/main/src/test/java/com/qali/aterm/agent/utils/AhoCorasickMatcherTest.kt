@@ -0,0 +1,61 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.Assert.*
+import org.junit.Test
+import java.util.BitSet
+
+/**
+ * Unit tests for AhoCorasickMatcher
+ * Tests overlapping keywords, failure transitions and case folding
+ */
+class AhoCorasickMatcherTest {
+
+    private fun found(matcher: AhoCorasickMatcher, text: String): List<Int> {
+        val bits = BitSet()
+        matcher.findKeywords(text, into = bits)
+        return bits.stream().toArray().toList()
+    }
+
+    @Test
+    fun testOverlappingKeywords() {
+        val matcher = AhoCorasickMatcher(listOf("he", "she", "his", "hers"))
+        assertEquals(listOf(0, 1, 3), found(matcher, "ushers"))
+        assertEquals(listOf(2), found(matcher, "this"))
+        assertTrue(found(matcher, "xyz").isEmpty())
+    }
+
+    @Test
+    fun testFailureTransitions() {
+        // After "abab" the automaton has to fall back to "ab" to still find "abac"
+        val matcher = AhoCorasickMatcher(listOf("abac", "bac"))
+        assertEquals(listOf(1), found(matcher, "abbac"))
+        assertEquals(listOf(0, 1), found(matcher, "xababac"))
+    }
+
+    @Test
+    fun testRange() {
+        val matcher = AhoCorasickMatcher(listOf("error"))
+        val bits = BitSet()
+        assertFalse(matcher.findKeywords("an error here", 4, 7, bits))
+        assertTrue(matcher.findKeywords("an error here", 3, 8, bits))
+    }
+
+    @Test
+    fun testIgnoreCase() {
+        val matcher = AhoCorasickMatcher(listOf("Error:", "warning"), ignoreCase = true)
+        assertEquals(listOf(0, 1), found(matcher, "ERROR: WaRnInG"))
+        assertTrue(found(AhoCorasickMatcher(listOf("Error:")), "ERROR:").isEmpty())
+    }
+
+    @Test
+    fun testNonAsciiResetsMatch() {
+        val matcher = AhoCorasickMatcher(listOf("ab"))
+        assertTrue(found(matcher, "aéb").isEmpty())
+        assertEquals(listOf(0), found(matcher, "éab"))
+    }
+
+    @Test(expected = IllegalArgumentException::class)
+    fun testNonAsciiKeywordIsRejected() {
+        AhoCorasickMatcher(listOf("café"))
+    }
+}
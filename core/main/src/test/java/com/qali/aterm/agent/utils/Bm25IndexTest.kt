@@ -0,0 +1,80 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.Assert.*
+import org.junit.Test
+
+/**
+ * Unit tests for Bm25Index
+ * Tests tokenizing, ranking, field weights, replacement and removal
+ */
+class Bm25IndexTest {
+
+    private fun index(vararg documents: Pair<String, String>): Bm25Index<String> {
+        val index = Bm25Index<String>()
+        for ((key, text) in documents) index.put(key, listOf(text to 1f))
+        return index
+    }
+
+    @Test
+    fun testTokenize() {
+        assertEquals(
+            listOf("use", "gradle", "kts", "for", "builds"),
+            Bm25Index.tokenize("Use gradle.kts for builds, a-b!")
+        )
+    }
+
+    @Test
+    fun testRarerTermsRankHigher() {
+        val index = index(
+            "a" to "the project uses kotlin",
+            "b" to "the project uses gradle",
+            "c" to "the user prefers tabs"
+        )
+        val results = index.search("kotlin project", 10)
+        assertEquals("a", results.first().key)
+        assertEquals(setOf("a", "b"), results.map { it.key }.toSet())
+    }
+
+    @Test
+    fun testNoSharedTermsNoResults() {
+        val index = index("a" to "kotlin coroutines")
+        assertTrue(index.search("python", 10).isEmpty())
+        assertTrue(index.search("", 10).isEmpty())
+    }
+
+    @Test
+    fun testLimitKeepsBest() {
+        val index = Bm25Index<Int>()
+        for (i in 0 until 1000) index.put(i, listOf("note number $i" to 1f))
+        index.put(1000, listOf("deploy deploy script" to 1f))
+        index.put(1001, listOf("deploy" to 1f, "unrelated words padding here" to 1f))
+
+        val results = index.search("deploy", 1)
+        assertEquals(1, results.size)
+        assertEquals(1000, results.single().key)
+        assertEquals(listOf(1000, 1001), index.search("deploy", 5).map { it.key })
+    }
+
+    @Test
+    fun testWeightedFieldRanksHigher() {
+        val index = Bm25Index<String>()
+        index.put("body", listOf("testing notes" to 1f, "misc" to 2f))
+        index.put("tagged", listOf("other notes" to 1f, "testing" to 2f))
+        assertEquals("tagged", index.search("testing", 2).first().key)
+    }
+
+    @Test
+    fun testReplaceAndRemove() {
+        val index = index("a" to "kotlin", "b" to "java")
+        index.put("a", listOf("python" to 1f))
+        assertTrue(index.search("kotlin", 10).isEmpty())
+        assertEquals(listOf("a"), index.search("python", 10).map { it.key })
+
+        index.remove("b")
+        assertEquals(1, index.size)
+        assertTrue(index.search("java", 10).isEmpty())
+
+        index.put("c", listOf("java" to 1f))
+        assertEquals(listOf("c"), index.search("java", 10).map { it.key })
+    }
+}
@@ -0,0 +1,143 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.Assert.*
+import org.junit.Test
+import java.io.StringReader
+
+/**
+ * Unit tests for ErrorLogScanner
+ * Tests prefiltered signature matching, chunked input and line bookkeeping
+ */
+class ErrorLogScannerTest {
+
+    private val python = ErrorPatternLibrary.signatures(listOf("python"))
+
+    private val log = """
+        |Collecting requests
+        |Traceback (most recent call last):
+        |  File "/app/main.py", line 12, in <module>
+        |    import missing
+        |ModuleNotFoundError: No module named 'missing'
+        |""".trimMargin()
+
+    private fun describe(matches: List<ErrorLogScanner.Match>): List<String> {
+        return matches.map { "${it.lineNumber}:${it.signature.kind}:${it.signature.name}:${it.result.group()}" }
+    }
+
+    @Test
+    fun testMatchesOnTheirLines() {
+        val matches = ErrorLogScanner.scan(log, python)
+        val locations = matches.filter { it.signature.kind == ErrorSignatureSet.Kind.LOCATION }
+        assertTrue(locations.any { it.lineNumber == 3 && it.result.group(1) == "/app/main.py" && it.result.group(2) == "12" })
+        assertTrue(locations.any { it.lineNumber == 5 && it.result.group(1) == "missing" })
+
+        val types = matches.filter { it.signature.kind == ErrorSignatureSet.Kind.ERROR_TYPE }.map { it.signature.name }
+        assertEquals(listOf("ModuleNotFoundError"), types)
+    }
+
+    @Test
+    fun testChunkBoundariesDoNotMatter() {
+        val expected = describe(ErrorLogScanner.scan(log, python))
+        for (size in listOf(1, 3, 7, 64)) {
+            val matches = ArrayList<ErrorLogScanner.Match>()
+            val scanner = ErrorLogScanner(python) { matches.add(it) }
+            log.chunked(size).forEach { scanner.feed(it) }
+            scanner.finish()
+            assertEquals("chunk size $size", expected, describe(matches))
+        }
+    }
+
+    @Test
+    fun testLineOffsetsAndCarriageReturns() {
+        val text = "ok\r\n  File \"a.py\", line 3\r\n"
+        val match = ErrorLogScanner.scan(text, python).first { it.signature.kind == ErrorSignatureSet.Kind.LOCATION }
+        assertEquals(2, match.lineNumber)
+        assertEquals(4L, match.lineOffset)
+        assertEquals("  File \"a.py\", line 3", match.line)
+        assertEquals('F', text[(match.lineOffset + match.result.start()).toInt()])
+    }
+
+    @Test
+    fun testReader() {
+        val matches = ArrayList<ErrorLogScanner.Match>()
+        ErrorLogScanner(python) { matches.add(it) }.scan(StringReader(log))
+        assertEquals(describe(ErrorLogScanner.scan(log, python)), describe(matches))
+    }
+
+    @Test
+    fun testLinesWithoutLiteralsAreSkipped() {
+        val rust = ErrorPatternLibrary.signatures(listOf("rust"), ErrorSignatureSet.Kind.ERROR_TYPE)
+        val matches = ErrorLogScanner.scan("Compiling foo\nerror[E0425]: cannot find value\n", rust)
+        assertEquals(listOf("2:ERROR_TYPE:CompileError:error[E0425]: cannot find value"), describe(matches))
+    }
+
+    @Test
+    fun testRustLocationsSpanLines() {
+        val rustc = """
+            |   Compiling demo v0.1.0 (/home/user/demo)
+            |warning: unused variable: `y`
+            | --> src/util.rs:3:9
+            |  |
+            |3 |     let y = 5;
+            |  |         ^ help: if this is intentional, prefix it with an underscore: `_y`
+            |  |
+            |  = note: `#[warn(unused_variables)]` on by default
+            |
+            |error[E0308]: mismatched types
+            | --> src/main.rs:4:18
+            |  |
+            |4 |     let x: i32 = "hello";
+            |  |            ---   ^^^^^^^ expected `i32`, found `&str`
+            |  |            |
+            |  |            expected due to this
+            |
+            |For more information about this error, try `rustc --explain E0308`.
+            |error: could not compile `demo` (bin "demo") due to 1 previous error; 1 warning emitted
+            |""".trimMargin()
+        val rust = ErrorPatternLibrary.signatures(listOf("rust"), ErrorSignatureSet.Kind.LOCATION)
+        val matches = ErrorLogScanner.scan(rustc, rust)
+        val locations = matches.map { "${it.lineNumber}:${it.result.group(1)}:${it.result.group(2)}:${it.result.group(3)}:${it.result.group(4)}" }
+        assertEquals(
+            listOf("2:unused variable: `y`:src/util.rs:3:9", "10:mismatched types:src/main.rs:4:18"),
+            locations
+        )
+        val error = matches.last()
+        assertEquals('e', rustc[(error.lineOffset + error.result.start()).toInt()])
+    }
+
+    @Test
+    fun testTracebackSpansLines() {
+        val traceback = """
+            |Traceback (most recent call last):
+            |  File "/home/user/app/run.py", line 8, in <module>
+            |    main()
+            |  File "/home/user/app/run.py", line 5, in main
+            |    print(1 / 0)
+            |          ~~^~~
+            |ZeroDivisionError: division by zero
+            |""".trimMargin()
+        val matches = ErrorLogScanner.scan(traceback, python).filter { it.result.group().startsWith("Traceback") }
+        assertEquals(1, matches.size)
+        assertEquals(1, matches[0].lineNumber)
+        assertEquals("/home/user/app/run.py", matches[0].result.group(1))
+        assertEquals("8", matches[0].result.group(2))
+    }
+
+    @Test
+    fun testWindowsAreBounded() {
+        val filler = (1..ErrorLogScanner.WINDOW_LINES).joinToString("") { "frame $it\n" }
+        val text = "Traceback (most recent call last):\n$filler  File \"a.py\", line 3\n"
+        assertTrue(ErrorLogScanner.scan(text, python).none { it.result.group().startsWith("Traceback") })
+
+        val long = "Traceback (most recent call last):\n" + "x".repeat(ErrorLogScanner.WINDOW_CHARS) + "\n  File \"a.py\", line 3\n"
+        val matches = ErrorLogScanner.scan(long, python)
+        assertTrue(matches.none { it.result.group().startsWith("Traceback") })
+        assertTrue(matches.all { it.line.length <= "Traceback (most recent call last):".length + ErrorLogScanner.WINDOW_CHARS })
+    }
+
+    @Test
+    fun testSignatureSetsAreShared() {
+        assertSame(python, ErrorPatternLibrary.signatures(listOf("py")))
+        assertSame(ErrorPatternLibrary.getPatternsForLanguage("kotlin"), ErrorPatternLibrary.getPatternsForLanguage("java"))
+    }
+}
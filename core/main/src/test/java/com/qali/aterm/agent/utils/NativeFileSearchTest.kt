@@ -0,0 +1,77 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.Assert.*
+import org.junit.Test
+import java.io.File
+import java.util.regex.Pattern
+
+/**
+ * Unit tests for NativeFileSearch
+ * Tests extraction of the literal prefilter from regexes and the binary file check
+ */
+class NativeFileSearchTest {
+
+    @Test
+    fun testPlainLiteral() {
+        assertEquals("fun main", NativeFileSearch.requiredLiteral("fun main"))
+        assertEquals("a.b", NativeFileSearch.requiredLiteral("a\\.b"))
+        assertEquals("x+y*z", NativeFileSearch.requiredLiteral(Pattern.quote("x+y*z")))
+    }
+
+    @Test
+    fun testLongestRunIsChosen() {
+        assertEquals("ToolResult", NativeFileSearch.requiredLiteral("class \\w+ToolResult"))
+        assertEquals("import ", NativeFileSearch.requiredLiteral("^import .*Log$"))
+        assertEquals("Invocation(", NativeFileSearch.requiredLiteral("[A-Z]+Invocation\\("))
+    }
+
+    @Test
+    fun testOptionalCharactersAreDropped() {
+        assertEquals("colo", NativeFileSearch.requiredLiteral("colou?r"))
+        assertEquals("value", NativeFileSearch.requiredLiteral("values*"))
+        assertEquals("ab", NativeFileSearch.requiredLiteral("abc{0,2}"))
+        assertEquals("Test", NativeFileSearch.requiredLiteral("Tests?"))
+    }
+
+    @Test
+    fun testGroupsAreSkipped() {
+        assertEquals("fun ", NativeFileSearch.requiredLiteral("fun (get|set)Val"))
+        assertEquals("Value", NativeFileSearch.requiredLiteral("(get|set)?Value"))
+        assertEquals("Caused by", NativeFileSearch.requiredLiteral("(?:\\s+)Caused by(?=:)"))
+    }
+
+    @Test
+    fun testUnsupportedRegexes() {
+        assertNull(NativeFileSearch.requiredLiteral("foo|bar"))
+        assertNull(NativeFileSearch.requiredLiteral("(?i)error"))
+        assertNull(NativeFileSearch.requiredLiteral("x(?i:error)"))
+        assertNull(NativeFileSearch.requiredLiteral("(a)\\1"))
+        assertNull(NativeFileSearch.requiredLiteral("\\x41BC"))
+        assertNull(NativeFileSearch.requiredLiteral(".*"))
+    }
+
+    @Test
+    fun testFallsBackWithoutNativeLibrary() {
+        // libtermux is not loaded in unit tests
+        assertFalse(NativeFileSearch.isAvailable)
+        assertNull(NativeFileSearch.search(listOf("a.txt"), Pattern.compile("hello")))
+    }
+
+    @Test
+    fun testBinaryFilesLikeNativeSearch() {
+        val text = File.createTempFile("search", ".txt").apply { writeText("hello\n".repeat(3000)) }
+        val binary = File.createTempFile("search", ".bin").apply { writeBytes("hello".toByteArray() + 0.toByte() + "hello".toByteArray()) }
+        // Beyond the probed start, like in the native search
+        val lateNul = File.createTempFile("search", ".txt").apply { writeBytes(ByteArray(9000) { 'a'.code.toByte() } + 0.toByte()) }
+        try {
+            assertFalse(NativeFileSearch.isBinary(text))
+            assertTrue(NativeFileSearch.isBinary(binary))
+            assertFalse(NativeFileSearch.isBinary(lateNul))
+            assertTrue(NativeFileSearch.isBinary(File(text.path + ".missing")))
+        } finally {
+            text.delete()
+            binary.delete()
+            lateNul.delete()
+        }
+    }
+}
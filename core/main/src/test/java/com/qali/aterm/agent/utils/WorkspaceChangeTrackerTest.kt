@@ -0,0 +1,118 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for WorkspaceChangeTracker
+ * Tests generation tracking, per-path dependency checks, content-hash deduplication and reading
+ * inotify watches
+ */
+class WorkspaceChangeTrackerTest {
+
+    private lateinit var workspace: File
+    private lateinit var tracker: WorkspaceChangeTracker
+
+    @Before
+    fun setup() {
+        workspace = Files.createTempDirectory("tracker-test").toFile()
+        tracker = WorkspaceChangeTracker(workspace.path)
+    }
+
+    @After
+    fun tearDown() {
+        workspace.deleteRecursively()
+    }
+
+    private fun write(path: String, content: String) {
+        val file = File(workspace, path)
+        file.parentFile?.mkdirs()
+        file.writeText(content)
+        tracker.notifyChanged(file)
+    }
+
+    @Test
+    fun testUnchangedWorkspace() {
+        val since = tracker.generation
+        assertFalse(tracker.hasChangedSince(since) { true })
+    }
+
+    @Test
+    fun testChangeOnlyAffectsDependentEntries() {
+        val since = tracker.generation
+        write("src/Main.kt", "fun main() {}")
+
+        assertTrue(tracker.hasChangedSince(since) { it == "src/Main.kt" })
+        assertTrue(tracker.hasChangedSince(since) { it.endsWith(".kt") })
+        assertFalse(tracker.hasChangedSince(since) { it.endsWith(".py") })
+        assertFalse(tracker.hasChangedSince(tracker.generation) { true })
+    }
+
+    @Test
+    fun testRewriteWithSameContentIsNotAChange() {
+        write("README.md", "hello")
+        val since = tracker.generation
+
+        write("README.md", "hello")
+        assertEquals(since, tracker.generation)
+        assertFalse(tracker.hasChangedSince(since) { true })
+
+        write("README.md", "hello again")
+        assertTrue(tracker.hasChangedSince(since) { it == "README.md" })
+    }
+
+    @Test
+    fun testDeleteIsAChange() {
+        write("a.txt", "a")
+        val since = tracker.generation
+
+        val file = File(workspace, "a.txt")
+        file.delete()
+        tracker.notifyChanged(file)
+
+        assertTrue(tracker.hasChangedSince(since) { it == "a.txt" })
+    }
+
+    @Test
+    fun testFilesOutsideWorkspaceAreIgnored() {
+        val since = tracker.generation
+        val outside = File(workspace.parentFile, "outside-${System.nanoTime()}.txt")
+        try {
+            outside.writeText("x")
+            tracker.notifyChanged(outside)
+            assertEquals(since, tracker.generation)
+        } finally {
+            outside.delete()
+        }
+    }
+
+    @Test
+    fun testLostHistoryIsTreatedAsChanged() {
+        val since = tracker.generation
+        repeat(5000) { i -> tracker.onFileEvent("gone-$i.txt", WorkspaceChangeTracker.Kind.DELETED) }
+
+        // The oldest changes were dropped from the log, so nothing can be ruled out
+        assertTrue(tracker.hasChangedSince(since) { false })
+        assertFalse(tracker.hasChangedSince(tracker.generation - 1) { false })
+    }
+
+    @Test
+    fun testWatchedInodesFromFdinfo() {
+        val fdinfo = "pos:\t0\nflags:\t02004000\nmnt_id:\t15\n" +
+            "inotify wd:2 ino:1a2b sdev:fd00001 mask:fc6 ignored_mask:0 fhandle-bytes:8 fhandle-type:1 f_handle:2b1a0000\n" +
+            "inotify wd:1 ino:7 sdev:fd00001 mask:fc6 ignored_mask:0 fhandle-bytes:8 fhandle-type:1 f_handle:07000000\n"
+
+        assertEquals(setOf(0x1a2bL, 7L), WorkspaceChangeTracker.watchedInodes(fdinfo))
+        assertTrue(WorkspaceChangeTracker.watchedInodes("pos:\t0\nflags:\t02\n").isEmpty())
+    }
+
+    @Test
+    fun testTrackersForTheSameWorkspaceDiffer() {
+        // A tracker made again after release counts generations from zero, so caches tell them apart
+        assertNotEquals(tracker.id, WorkspaceChangeTracker(workspace.path).id)
+    }
+}
@@ -0,0 +1,162 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for WorkspaceFileIndex
+ * Tests directory queries, ignore handling, languages and the on-disk store
+ */
+class WorkspaceFileIndexTest {
+
+    private lateinit var tempDir: File
+    private lateinit var workspace: File
+    private lateinit var store: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("file-index-test").toFile()
+        workspace = File(tempDir, "workspace")
+        store = File(tempDir, "index/workspace.idx")
+        write("src/Main.kt", "fun main() {}")
+        write("src/util/strings.py", "x = 1")
+        write("README.md", "# readme")
+        write("app.log", "log line")
+        write("node_modules/left-pad/index.js", "module.exports = 1")
+    }
+
+    @After
+    fun tearDown() {
+        tempDir.deleteRecursively()
+    }
+
+    private fun write(path: String, content: String) {
+        val file = File(workspace, path)
+        file.parentFile?.mkdirs()
+        file.writeText(content)
+    }
+
+    private fun index(rescanAfterMs: Long = 60_000L) = WorkspaceFileIndex(workspace.path, null, store, rescanAfterMs)
+
+    @Test
+    fun testIgnoredFilesAreLeftOut() {
+        val paths = index().files().map { it.path }
+        assertEquals(listOf("README.md", "src/Main.kt", "src/util/strings.py"), paths)
+    }
+
+    @Test
+    fun testIncludeIgnoredListsIgnoredTrees() {
+        val paths = index().files(includeIgnored = true).map { it.path }
+        assertEquals(
+            listOf("README.md", "app.log", "node_modules/left-pad/index.js", "src/Main.kt", "src/util/strings.py"),
+            paths
+        )
+    }
+
+    @Test
+    fun testDirectoryQuery() {
+        val index = index()
+        assertEquals(listOf("src/Main.kt", "src/util/strings.py"), index.files("src").map { it.path })
+        assertEquals(listOf("src/util/strings.py"), index.files("./src/util/").map { it.path })
+        assertTrue(index.files("node_modules").isEmpty())
+        assertEquals(listOf("node_modules/left-pad/index.js"), index.files("node_modules/left-pad", includeIgnored = true).map { it.path })
+    }
+
+    @Test
+    fun testEntryMetadata() {
+        val entry = index().entry("src/Main.kt")
+        assertNotNull(entry)
+        assertEquals("kotlin", entry!!.language)
+        assertEquals(13L, entry.size)
+        assertFalse(entry.ignored)
+        assertEquals("python", WorkspaceFileIndex.languageOf("src/util/strings.py"))
+        assertNull(WorkspaceFileIndex.languageOf("LICENSE"))
+    }
+
+    @Test
+    fun testChangesAreSeen() {
+        val index = index(rescanAfterMs = 0)
+        assertEquals(3, index.files().size)
+
+        write("src/New.kt", "class New")
+        File(workspace, "README.md").delete()
+
+        assertEquals(listOf("src/Main.kt", "src/New.kt", "src/util/strings.py"), index.files().map { it.path })
+    }
+
+    @Test
+    fun testOnlyTheQueriedDirectoryIsWalked() {
+        val index = index()
+        assertEquals(listOf("src/Main.kt", "src/util/strings.py"), index.files("src").map { it.path })
+
+        write("src/New.kt", "class New")
+        write("docs/guide.md", "# guide")
+        // src was walked moments ago, docs never was
+        assertEquals(listOf("src/Main.kt", "src/util/strings.py"), index.files("src").map { it.path })
+        assertEquals(listOf("docs/guide.md"), index.files("docs").map { it.path })
+        // A single file is looked at directly
+        assertNotNull(index.entry("src/New.kt"))
+
+        index.invalidate()
+        assertEquals(listOf("src/Main.kt", "src/New.kt", "src/util/strings.py"), index.files("src").map { it.path })
+    }
+
+    @Test
+    fun testSkipHidden() {
+        write(".git/config", "[core]")
+        write(".secrets/key.txt", "key")
+        write("src/.generated/A.kt", "class A")
+        write("src/.env", "KEY=1")
+        write("node_modules/.bin/tool", "#!/bin/sh")
+        val index = index()
+
+        assertEquals(
+            listOf("README.md", "app.log", "node_modules/left-pad/index.js", "src/.env", "src/Main.kt", "src/util/strings.py"),
+            index.files(includeIgnored = true, skipHidden = true).map { it.path }
+        )
+        // Only directories below the one searched count
+        assertEquals(listOf("src/.generated/A.kt"), index.files("src/.generated", skipHidden = true).map { it.path })
+        val all = index.files(includeIgnored = true).map { it.path }
+        assertTrue(all.containsAll(listOf(".git/config", ".secrets/key.txt", "src/.generated/A.kt", "node_modules/.bin/tool")))
+
+        val outside = File(tempDir, "outside")
+        File(outside, ".hidden").mkdirs()
+        File(outside, ".hidden/a.txt").writeText("a")
+        File(outside, "b.txt").writeText("b")
+        val entries = WorkspaceFileIndex.filesUnder(workspace.path, outside, includeIgnored = true, skipHidden = true)
+        assertEquals(listOf("../outside/b.txt"), entries.map { it.path })
+    }
+
+    @Test
+    fun testContentHash() {
+        val index = index()
+        val hash = index.contentHash("src/Main.kt")
+        assertNotNull(hash)
+        assertEquals(hash, index.contentHash("src/Main.kt"))
+
+        write("src/Main.kt", "fun main() { println() }")
+        assertNotEquals(hash, index.contentHash("src/Main.kt"))
+        assertNull(index.contentHash("missing.kt"))
+    }
+
+    @Test
+    fun testStoreRoundTrip() {
+        index().files()
+        assertTrue(store.isFile)
+
+        val reloaded = index()
+        assertEquals(index().files(includeIgnored = true), reloaded.files(includeIgnored = true))
+    }
+
+    @Test
+    fun testHiddenDirectories() {
+        assertTrue(WorkspaceFileIndex.isInHiddenDirectory(".git/config"))
+        assertTrue(WorkspaceFileIndex.isInHiddenDirectory("src/.cache/a.kt"))
+        assertFalse(WorkspaceFileIndex.isInHiddenDirectory("src/.env"))
+        assertFalse(WorkspaceFileIndex.isInHiddenDirectory("src/Main.kt"))
+    }
+}
@@ -0,0 +1,94 @@
+package com.qali.aterm.agent.utils
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+
+/**
+ * Unit tests for WorkspaceTrigramIndex
+ * Tests candidate selection, case folding and incremental updates
+ */
+class WorkspaceTrigramIndexTest {
+
+    private lateinit var workspace: File
+    private lateinit var fileIndex: WorkspaceFileIndex
+    private lateinit var index: WorkspaceTrigramIndex
+
+    @Before
+    fun setup() {
+        workspace = Files.createTempDirectory("trigram-test").toFile()
+        write("src/Greeter.kt", "fun greet() = println(\"Hello, world\")")
+        write("src/Math.kt", "fun add(a: Int, b: Int) = a + b")
+        write("app.log", "Hello from the log")
+        fileIndex = WorkspaceFileIndex(workspace.path, null, null)
+        index = WorkspaceTrigramIndex(workspace.path, fileIndex, null)
+        index.sync()
+    }
+
+    @After
+    fun tearDown() {
+        workspace.deleteRecursively()
+    }
+
+    private fun write(path: String, content: String) {
+        val file = File(workspace, path)
+        file.parentFile?.mkdirs()
+        file.writeText(content)
+    }
+
+    private fun candidates(literal: String): List<String> {
+        val mayMatch = index.candidates(literal)!!
+        return fileIndex.files(includeIgnored = true).filter(mayMatch).map { it.path }
+    }
+
+    @Test
+    fun testOnlyFilesWithTheLiteralAreCandidates() {
+        assertEquals(2, index.indexedFileCount)
+        assertEquals(listOf("src/Greeter.kt"), candidates("println"))
+        assertEquals(listOf("src/Math.kt"), candidates("a + b"))
+    }
+
+    @Test
+    fun testCaseIsFolded() {
+        assertEquals(listOf("src/Greeter.kt"), candidates("PrintLn"))
+    }
+
+    @Test
+    fun testShortLiteralsDoNotFilter() {
+        assertNull(index.candidates("fu"))
+    }
+
+    @Test
+    fun testUnindexedFilesAreAlwaysCandidates() {
+        // Ignored files are not indexed
+        assertEquals(listOf("app.log", "src/Greeter.kt"), candidates("Hello"))
+    }
+
+    @Test
+    fun testChangedFilesAreCandidatesBeforeReindexing() {
+        write("src/Math.kt", "fun add(a: Int, b: Int) = println(a + b)")
+        assertEquals(listOf("src/Greeter.kt", "src/Math.kt"), candidates("println"))
+
+        index.sync()
+        assertEquals(listOf("src/Greeter.kt", "src/Math.kt"), candidates("println"))
+        assertEquals(listOf("src/Math.kt"), candidates("add("))
+    }
+
+    @Test
+    fun testDeletedFilesAreDropped() {
+        File(workspace, "src/Math.kt").delete()
+        index.sync()
+        assertEquals(1, index.indexedFileCount)
+        assertEquals(listOf("app.log"), candidates("a + b"))
+    }
+
+    @Test
+    fun testTrigramsDoNotSpanLines() {
+        assertEquals(2, WorkspaceTrigramIndex.trigramsOf("abcd".toByteArray()).size)
+        assertEquals(0, WorkspaceTrigramIndex.trigramsOf("ab\ncd".toByteArray()).size)
+        assertEquals(1, WorkspaceTrigramIndex.trigramsOf("aaaa".toByteArray()).size)
+    }
+}
@@ -0,0 +1,117 @@
+package com.qali.aterm.api
+
+import com.sun.net.httpserver.HttpServer
+import okhttp3.Request
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Before
+import org.junit.Test
+import java.net.InetSocketAddress
+import java.util.concurrent.CountDownLatch
+import java.util.concurrent.TimeUnit
+
+/**
+ * Unit tests for HttpClientProvider against a local HTTP stand-in server
+ * Tests connection reuse across derived clients, per-phase timings and pre-warming
+ */
+class HttpClientProviderTest {
+
+    private lateinit var server: HttpServer
+    private lateinit var baseUrl: String
+
+    @Before
+    fun setUp() {
+        server = HttpServer.create(InetSocketAddress("127.0.0.1", 0), 0)
+        server.createContext("/") { exchange ->
+            if (exchange.requestURI.path == "/slow") {
+                Thread.sleep(200)
+            }
+            if (exchange.requestMethod == "HEAD") {
+                exchange.sendResponseHeaders(200, -1)
+            } else {
+                val body = "ok".toByteArray()
+                exchange.sendResponseHeaders(200, body.size.toLong())
+                exchange.responseBody.use { it.write(body) }
+            }
+            exchange.close()
+        }
+        server.start()
+        baseUrl = "http://127.0.0.1:${server.address.port}"
+    }
+
+    @After
+    fun tearDown() {
+        server.stop(0)
+    }
+
+    private fun get(client: okhttp3.OkHttpClient, path: String): HttpClientProvider.RequestTiming {
+        client.newCall(Request.Builder().url("$baseUrl$path").build()).execute().use { response ->
+            assertEquals("ok", response.body!!.string())
+        }
+        return HttpClientProvider.recentTimings().last { it.url.startsWith("$baseUrl$path".substringBefore('?')) }
+    }
+
+    @Test
+    fun testConnectionIsReusedAcrossDerivedClients() {
+        val first = get(HttpClientProvider.newClient(readTimeoutSeconds = 5), "/first")
+        val second = get(HttpClientProvider.newClient(readTimeoutSeconds = 300), "/second")
+
+        assertFalse(first.connectionReused)
+        assertTrue(second.connectionReused)
+        assertEquals(0L, second.connectMs)
+        assertEquals("http/1.1", second.protocol)
+    }
+
+    @Test
+    fun testTimingPhases() {
+        val timing = get(HttpClientProvider.client, "/slow?key=secret")
+
+        assertTrue(timing.success)
+        assertEquals("GET", timing.method)
+        assertFalse(timing.url.contains("secret"))
+        assertTrue("ttfb ${timing.ttfbMs}ms", timing.ttfbMs >= 150)
+        assertTrue(timing.totalMs >= timing.ttfbMs)
+        assertEquals(0L, timing.tlsMs)
+    }
+
+    @Test
+    fun testTimingListenerAndFailedCall() {
+        val latch = CountDownLatch(1)
+        var reported: HttpClientProvider.RequestTiming? = null
+        val listener: (HttpClientProvider.RequestTiming) -> Unit = {
+            if (it.url.contains(":1/")) {
+                reported = it
+                latch.countDown()
+            }
+        }
+        HttpClientProvider.addTimingListener(listener)
+        try {
+            runCatching {
+                HttpClientProvider.newClient(connectTimeoutSeconds = 1)
+                    .newCall(Request.Builder().url("http://127.0.0.1:1/").build())
+                    .execute()
+            }
+            assertTrue(latch.await(5, TimeUnit.SECONDS))
+            assertFalse(reported!!.success)
+        } finally {
+            HttpClientProvider.removeTimingListener(listener)
+        }
+    }
+
+    @Test
+    fun testPrewarmOpensConnection() {
+        val latch = CountDownLatch(1)
+        val listener: (HttpClientProvider.RequestTiming) -> Unit = {
+            if (it.method == "HEAD" && it.url.startsWith(baseUrl)) latch.countDown()
+        }
+        HttpClientProvider.addTimingListener(listener)
+        try {
+            HttpClientProvider.prewarm("$baseUrl/v1/chat")
+            assertTrue(latch.await(5, TimeUnit.SECONDS))
+        } finally {
+            HttpClientProvider.removeTimingListener(listener)
+        }
+
+        assertTrue(get(HttpClientProvider.client, "/after-prewarm").connectionReused)
+    }
+}
@@ -0,0 +1,97 @@
+package com.qali.aterm.ui.screens.downloader
+
+import org.junit.Assert.*
+import org.junit.Test
+import java.io.ByteArrayOutputStream
+import java.util.zip.GZIPOutputStream
+
+/**
+ * Unit tests for StreamingTarExtractor
+ * Tests finding the end of a tar archive and decompressing gzip pushed in pieces
+ */
+class StreamingTarExtractorTest {
+
+    /** A ustar header for a file of [size] bytes */
+    private fun header(name: String, size: Int): ByteArray {
+        val block = ByteArray(512)
+        name.toByteArray().copyInto(block)
+        String.format("%011o", size).toByteArray().copyInto(block, 124)
+        block[156] = '0'.code.toByte()
+        "ustar".toByteArray().copyInto(block, 257)
+        return block
+    }
+
+    /** An archive of files with the given contents, padded and ended like tar does */
+    private fun archive(vararg files: ByteArray): ByteArray {
+        val out = ByteArrayOutputStream()
+        files.forEachIndexed { i, content ->
+            out.write(header("file$i", content.size))
+            out.write(content)
+            out.write(ByteArray((512 - content.size % 512) % 512))
+        }
+        out.write(ByteArray(10240 - out.size() % 10240))
+        return out.toByteArray()
+    }
+
+    private fun scan(bytes: ByteArray, length: Int = bytes.size, piece: Int = 1000): Boolean {
+        val scanner = TarEndScanner()
+        var off = 0
+        while (off < length) {
+            val n = minOf(piece, length - off)
+            scanner.update(bytes, off, n)
+            off += n
+        }
+        return scanner.sawEnd
+    }
+
+    @Test
+    fun testEndOfArchiveIsFound() {
+        val tar = archive("hello".toByteArray(), ByteArray(3000) { 'x'.code.toByte() })
+        assertTrue(scan(tar))
+        assertTrue(scan(tar, piece = 1))
+    }
+
+    @Test
+    fun testTruncatedArchiveHasNoEnd() {
+        val tar = archive("hello".toByteArray(), ByteArray(3000) { 'x'.code.toByte() })
+        // Cut within the second file
+        assertFalse(scan(tar, length = 512 * 4))
+    }
+
+    @Test
+    fun testZeroBlocksInsideFilesAreNotTheEnd() {
+        val tar = archive(ByteArray(4096))
+        // The contents of the one file are all zero blocks
+        assertFalse(scan(tar, length = 512 + 4096))
+        assertTrue(scan(tar))
+    }
+
+    @Test
+    fun testGzipPushedInPieces() {
+        val tar = archive("hello".toByteArray(), ByteArray(70000) { (it % 251).toByte() })
+        val compressed = ByteArrayOutputStream().also { out -> GZIPOutputStream(out).use { it.write(tar) } }.toByteArray()
+
+        for (piece in intArrayOf(1, 7, 4096, compressed.size)) {
+            val output = ByteArrayOutputStream()
+            val decoder = GzipStreamDecoder { b, off, len -> output.write(b, off, len) }
+            var off = 0
+            while (off < compressed.size) {
+                val n = minOf(piece, compressed.size - off)
+                decoder.update(compressed, off, n)
+                off += n
+            }
+            assertArrayEquals("pieces of $piece", tar, output.toByteArray())
+        }
+    }
+
+    @Test
+    fun testGzipHeaderWithFileName() {
+        // FNAME set, then "a.tar\0" before a stored deflate block holding "hi"
+        val stream = byteArrayOf(0x1f, 0x8b.toByte(), 8, 8, 0, 0, 0, 0, 0, 3) + "a.tar".toByteArray() + 0.toByte() +
+            byteArrayOf(1, 2, 0, 0xfd.toByte(), 0xff.toByte(), 'h'.code.toByte(), 'i'.code.toByte())
+        val output = ByteArrayOutputStream()
+        val decoder = GzipStreamDecoder { b, off, len -> output.write(b, off, len) }
+        stream.forEach { decoder.update(byteArrayOf(it), 0, 1) }
+        assertEquals("hi", output.toString())
+    }
+}
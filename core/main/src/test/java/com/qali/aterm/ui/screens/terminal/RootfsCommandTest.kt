@@ -0,0 +1,123 @@
+package com.qali.aterm.ui.screens.terminal
+
+import org.junit.After
+import org.junit.Assert.*
+import org.junit.Assume.assumeTrue
+import org.junit.Before
+import org.junit.Test
+import java.io.File
+import java.nio.file.Files
+import java.util.concurrent.TimeUnit
+
+/**
+ * Unit tests for RootfsCommand
+ * Tests the built launch, the choice of rootfs, path translation and the init-host script's exec mode
+ */
+class RootfsCommandTest {
+
+    private lateinit var tempDir: File
+    private lateinit var localDir: File
+
+    @Before
+    fun setup() {
+        tempDir = Files.createTempDirectory("rootfs-command-test").toFile()
+        localDir = File(tempDir, "local").apply { mkdirs() }
+    }
+
+    @After
+    fun tearDown() {
+        tempDir.deleteRecursively()
+    }
+
+    private fun rootfs(name: String) = File(localDir, name).apply { File(this, "bin").mkdirs() }
+
+    @Test
+    fun testLaunchRunsCommandThroughInitHost() {
+        val rootfs = rootfs("clones/agent1")
+        val workspace = File(rootfs, "root/project").apply { mkdirs() }
+        val hostInit = File(localDir, "bin/init-host")
+
+        val launch = RootfsCommand.build(
+            hostInit, listOf("ROOTFS_DIR=clones/agent1"), rootfs, listOf("python3", "-u", "-c", "pass"), workspace.path
+        )
+
+        assertEquals(listOf("/system/bin/sh", hostInit.absolutePath, "python3", "-u", "-c", "pass"), launch.command)
+        assertEquals(
+            listOf("ROOTFS_DIR=clones/agent1", "ATERM_EXEC=1", "ATERM_EXEC_DIR=/root/project"),
+            launch.environment
+        )
+        assertEquals("1", launch.processBuilder().environment()["ATERM_EXEC"])
+    }
+
+    @Test
+    fun testRootfsOfWorkspace() {
+        rootfs("alpine")
+        rootfs("clones/agent1")
+        File(localDir, "ubuntu").mkdirs()
+
+        assertEquals("alpine", RootfsCommand.rootfsDirName(localDir, "$localDir/alpine/root/project"))
+        assertEquals("alpine", RootfsCommand.rootfsDirName(localDir, "$localDir/alpine"))
+        assertEquals("clones/agent1", RootfsCommand.rootfsDirName(localDir, "$localDir/clones/agent1/root"))
+        // Not extracted, the app's own files and paths outside are in no rootfs
+        assertNull(RootfsCommand.rootfsDirName(localDir, "$localDir/ubuntu/root"))
+        assertNull(RootfsCommand.rootfsDirName(localDir, "$localDir/bin/init"))
+        assertNull(RootfsCommand.rootfsDirName(localDir, "$localDir/clones"))
+        assertNull(RootfsCommand.rootfsDirName(localDir, "/sdcard/project"))
+    }
+
+    @Test
+    fun testPathTranslation() {
+        val rootfs = rootfs("alpine")
+
+        assertEquals("/root/a.py", RootfsCommand.toRootfsPath(rootfs, "${rootfs.path}/root/a.py"))
+        assertEquals("/", RootfsCommand.toRootfsPath(rootfs, rootfs.path))
+        assertEquals("/sdcard/a.py", RootfsCommand.toRootfsPath(rootfs, "/sdcard/a.py"))
+
+        assertEquals("${rootfs.path}/run/db-mcp.sock", RootfsCommand.toHostPath(rootfs, "/run/db-mcp.sock"))
+        assertEquals("${rootfs.path}/tmp/x.sock", RootfsCommand.toHostPath(rootfs, "/dev/shm/x.sock"))
+        assertEquals("/sdcard/x.sock", RootfsCommand.toHostPath(rootfs, "/sdcard/x.sock"))
+        assertEquals("/data/data/app/x.sock", RootfsCommand.toHostPath(rootfs, "/data/data/app/x.sock"))
+        assertEquals("run/x.sock", RootfsCommand.toHostPath(rootfs, "run/x.sock"))
+    }
+
+    @Test
+    fun testInitHostExecModeRunsCommandUnderProot() {
+        val script = File("src/main/assets/init-host.sh")
+        assumeTrue(script.isFile && File("/bin/sh").canExecute())
+        val rootfs = rootfs("alpine")
+        File(rootfs, "bin/sh").createNewFile()
+        val workDir = File(tempDir, "work").apply { mkdirs() }
+        val argsFile = File(tempDir, "proot-args")
+        // Records its arguments, then runs the rootfs shell and its arguments on the host
+        File(localDir, "bin").mkdirs()
+        File(localDir, "bin/proot").apply {
+            writeText(
+                "#!/bin/sh\n" +
+                    "printf '%s\\0' \"\$@\" > '${argsFile.path}'\n" +
+                    "while [ \"\$#\" -gt 0 ] && [ \"\$1\" != \"-L\" ]; do shift; done\n" +
+                    "shift 2\n" +
+                    "exec /bin/sh \"\$@\"\n"
+            )
+            setExecutable(true)
+        }
+
+        val launch = RootfsCommand.build(
+            script,
+            listOf("PATH=/usr/bin:/bin", "PREFIX=${tempDir.path}", "ROOTFS_DIR=alpine", "ROOTFS_FILE=alpine.tar.gz", "LINKER="),
+            rootfs,
+            listOf("sh", "-c", "printf '%s|%s|%s' \"\$PWD\" \"\$HOME\" \"\$1\"", "sh", "argument"),
+            // Stands in for a rootfs path, which the fake proot cannot map
+            workDir.path
+        )
+        val process = launch.processBuilder().start()
+        process.outputStream.close()
+        val output = process.inputStream.bufferedReader().readText()
+        assertTrue(process.waitFor(30, TimeUnit.SECONDS))
+
+        assertEquals("${workDir.path}|/root|argument", output)
+        val prootArgs = argsFile.readText().split('\u0000').dropLast(1)
+        val root = prootArgs.indexOf("-r")
+        assertEquals(rootfs.path, prootArgs[root + 1])
+        assertEquals(listOf("/bin/sh", "-c"), prootArgs.subList(prootArgs.indexOf("-L") + 1, prootArgs.indexOf("-L") + 3))
+    }
+}
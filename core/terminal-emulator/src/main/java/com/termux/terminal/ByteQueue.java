@@ -7,11 +7,17 @@ final class ByteQueue {
     private int mHead;
     private int mStoredBytes;
     private boolean mOpen = true;
+    private long mFullStalls;
 
     public ByteQueue(int size) {
         mBuffer = new byte[size];
     }
 
+    /** The number of times a writer had to wait for the reader because the queue was full. */
+    public synchronized long getFullStalls() {
+        return mFullStalls;
+    }
+
     public synchronized void close() {
         mOpen = false;
         notify();
@@ -67,6 +73,7 @@ final class ByteQueue {
 
         synchronized (this) {
             while (lengthToWrite > 0) {
+                if (bufferLength == mStoredBytes && mOpen) mFullStalls++;
                 while (bufferLength == mStoredBytes && mOpen) {
                     try {
                         wait();
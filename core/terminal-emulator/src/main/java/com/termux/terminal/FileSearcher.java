@@ -0,0 +1,42 @@
+package com.termux.terminal;
+
+/**
+ * Native literal search over many files at once. C code is in jni/search.c.
+ * <p/>
+ * Files are read in large pieces and scanned on a small pool of threads for the rarest byte of the needle, so most of
+ * the data is only looked at by memchr(). They are not memory mapped, as another process truncating a mapped file
+ * would crash the app with SIGBUS. Files with a NUL byte in their first 8 KiB are treated as binary and skipped.
+ * Matching lines are handed to the {@link Listener} on the calling thread while the search continues, so callers can
+ * stop as soon as they have seen enough.
+ */
+public final class FileSearcher {
+
+    static {
+        System.loadLibrary("termux");
+    }
+
+    private FileSearcher() {
+    }
+
+    /** Receives matching lines. Lines of one file arrive in order, files are interleaved. */
+    public interface Listener {
+        /**
+         * @param fileIndex  Index of the file in the {@code paths} passed to {@link #search}.
+         * @param lineNumber One-based line number.
+         * @param line       The line without its line terminator.
+         * @return false to stop the search.
+         */
+        boolean onLine(int fileIndex, int lineNumber, byte[] line);
+    }
+
+    /**
+     * Report each line of {@code paths} that contains {@code needle}.
+     *
+     * @param ignoreCase Whether ASCII letters match regardless of case.
+     * @param maxLines   Stop after this many lines, or 0 for no limit.
+     * @param threads    Number of worker threads, clamped to [1, 8].
+     * @return the number of lines passed to the listener.
+     */
+    public static native int search(String[] paths, byte[] needle, boolean ignoreCase, int maxLines, int threads, Listener listener);
+
+}
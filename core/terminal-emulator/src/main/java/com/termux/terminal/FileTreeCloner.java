@@ -0,0 +1,33 @@
+package com.termux.terminal;
+
+import java.io.IOException;
+
+/**
+ * Native helpers for cloning a directory tree. C code is in jni/clone.c.
+ * <p/>
+ * Every regular file of the clone is a file of its own, never a hard link, so that writing it in place, truncating it
+ * or changing its mode or owner leaves the source alone. Files are reflinked where the filesystem supports it, which
+ * shares their data until either side writes, and copied otherwise.
+ */
+public final class FileTreeCloner {
+
+    static {
+        System.loadLibrary("termux");
+    }
+
+    private FileTreeCloner() {
+    }
+
+    /**
+     * Clone {@code source} into {@code target}, creating {@code target} if needed.
+     *
+     * @param skipPaths Paths relative to {@code source} (such as "var/cache") whose directories are cloned without the
+     *                  files in them.
+     * @return a two-element array with the number of files reflinked and the number of files copied.
+     */
+    public static native long[] cloneTree(String source, String target, String[] skipPaths) throws IOException;
+
+    /** Recursively delete {@code path} without following symbolic links. A missing path is not an error. */
+    public static native void removeTree(String path) throws IOException;
+
+}
@@ -1,5 +1,8 @@
 package com.termux.terminal;
 
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
 /**
  * Native methods for creating and managing pseudoterminal subprocesses. C code is in jni/termux.c.
  */
@@ -38,4 +41,47 @@ final class JNI {
     /** Close a file descriptor through the close(2) system call. */
     public static native void close(int fileDescriptor);
 
+    /** Size in bytes of the per-session I/O counters, kept in a direct buffer allocated by the caller. C code is in jni/pty_io.c. */
+    public static native int statsSize();
+
+    /**
+     * Read output of the process from the pty master, counting it in {@code stats}.
+     *
+     * @return the number of bytes read into the start of {@code buffer}, or -1 once the process side is closed.
+     */
+    public static native int read(int fd, byte[] buffer, ByteBuffer stats);
+
+    /** Write all of the given bytes to the pty master, counting them in {@code stats}. */
+    public static native void write(int fd, byte[] buffer, int offset, int count, ByteBuffer stats) throws IOException;
+
+    /** Record the time from the oldest unprocessed read to now, when its bytes have been passed to the emulator. */
+    public static native void markAppended(ByteBuffer stats);
+
+    /** Record the time from the oldest undrawn read to now, when a frame showing its bytes has been drawn. */
+    public static native void markFrameDrawn(ByteBuffer stats);
+
+    /**
+     * Copy the counters to {@code out}, of length {@link TerminalSessionStats#SNAPSHOT_LENGTH}.
+     *
+     * @return false if {@code stats} or {@code out} is too small.
+     */
+    public static native boolean snapshotStats(ByteBuffer stats, long[] out);
+
+    /**
+     * Record the output {@link #read(int, byte[], ByteBuffer)} counts in {@code stats} to an asciicast v2 file at
+     * {@code path}, replacing the recording so far if any. C code is in jni/pty_record.c.
+     */
+    public static native void startRecording(ByteBuffer stats, String path, int columns, int rows) throws IOException;
+
+    /** Record a resize of the terminal, if the output counted in {@code stats} is being recorded. */
+    public static native void recordResize(ByteBuffer stats, int columns, int rows);
+
+    /**
+     * Stop recording the output counted in {@code stats}. The file is finished in the background.
+     *
+     * @return the number of bytes of output dropped because the recording could not keep up, or -1 if there was no
+     * recording.
+     */
+    public static native long stopRecording(ByteBuffer stats);
+
 }
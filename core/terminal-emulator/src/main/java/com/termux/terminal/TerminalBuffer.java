@@ -19,6 +19,14 @@ public final class TerminalBuffer {
     private int mActiveTranscriptRows = 0;
     /** The index in the circular buffer where the visible screen starts. */
     private int mScreenFirstRow = 0;
+    /** The number of rows which have scrolled into the transcript so far, to find the rows new since a snapshot. */
+    private long mScrolledRows;
+    /** Changed when rows already in the transcript are rewritten or dropped other than by scrolling. */
+    private int mTranscriptGeneration;
+    /** Transcript rows compressed by {@link #compactTranscript()}, whose places in {@link #mLines} are null. */
+    private CompactedTranscript mCompactedTranscript;
+    /** Segments of a compacted transcript beyond which {@link #compactTranscript()} merges them. */
+    private static final int MAX_COMPACTED_SEGMENTS = 16;
 
     /**
      * Create a transcript screen.
@@ -60,6 +68,9 @@ public final class TerminalBuffer {
     public String getSelectedText(int selX1, int selY1, int selX2, int selY2, boolean joinBackLines, boolean joinFullLines) {
         final StringBuilder builder = new StringBuilder();
         final int columns = mColumns;
+        // Read compacted rows without expanding them, as this may be called from other threads than the main one
+        final CompactedTranscript compacted = mCompactedTranscript;
+        TerminalRow[][] compactedRows = null;
 
         if (selY1 < -getActiveTranscriptRows()) selY1 = -getActiveTranscriptRows();
         if (selY2 >= mScreenRows) selY2 = mScreenRows - 1;
@@ -102,6 +113,10 @@ public final class TerminalBuffer {
             }
             
             TerminalRow lineObject = mLines[internalRow];
+            if (lineObject == null && compacted != null) {
+                if (compactedRows == null) compactedRows = compacted.newInflatedRows();
+                lineObject = compacted.rowAt(compactedRows, row, mScrolledRows);
+            }
             // Allocate line if null to prevent NullPointerException
             if (lineObject == null) {
                 lineObject = allocateFullLineIfNecessary(internalRow);
@@ -125,7 +140,8 @@ public final class TerminalBuffer {
             char[] line = lineObject.mText;
             int lastPrintingCharIndex = -1;
             int i;
-            boolean rowLineWrap = getLineWrap(row);
+            // Not getLineWrap(row), which does not see compacted rows
+            boolean rowLineWrap = lineObject.mLineWrap;
             if (rowLineWrap && endX == columns) {
                 // If the line was wrapped, we shouldn't lose trailing space:
                 lastPrintingCharIndex = x2Index - 1;
@@ -291,6 +307,8 @@ public final class TerminalBuffer {
      * @param cursor     An int[2] containing the (column, row) cursor location.
      */
     public void resize(int newColumns, int newRows, int newTotalRows, int[] cursor, long currentStyle, boolean altScreen) {
+        expandTranscript();
+        mTranscriptGeneration++;
         // newRows > mTotalRows should not normally happen since mTotalRows is TRANSCRIPT_ROWS (10000):
         if (newColumns == mColumns && newRows <= mTotalRows) {
             // Fast resize where just the rows changed.
@@ -485,6 +503,7 @@ public final class TerminalBuffer {
         mScreenFirstRow = (mScreenFirstRow + 1) % mTotalRows;
         // Note that the history has grown if not already full:
         if (mActiveTranscriptRows < mTotalRows - mScreenRows) mActiveTranscriptRows++;
+        mScrolledRows++;
 
         // Blank the newly revealed line above the bottom margin:
         int blankRow = externalToInternalRow(bottomMargin - 1);
@@ -583,6 +602,219 @@ public final class TerminalBuffer {
             Arrays.fill(mLines, mScreenFirstRow - mActiveTranscriptRows, mScreenFirstRow, null);
         }
         mActiveTranscriptRows = 0;
+        mCompactedTranscript = null;
+        mTranscriptGeneration++;
+    }
+
+    long getScrolledRows() {
+        return mScrolledRows;
+    }
+
+    int getTranscriptGeneration() {
+        return mTranscriptGeneration;
+    }
+
+    /** Copies of count rows starting at the external row, which the caller may hand to another thread. */
+    TerminalRow[] copyRows(int externalRow, int count) {
+        final CompactedTranscript compacted = mCompactedTranscript;
+        TerminalRow[][] compactedRows = null;
+        TerminalRow[] rows = new TerminalRow[count];
+        for (int i = 0; i < count; i++) {
+            TerminalRow line = mLines[externalToInternalRow(externalRow + i)];
+            if (line == null && compacted != null) {
+                // Freshly inflated, so not shared with the buffer
+                if (compactedRows == null) compactedRows = compacted.newInflatedRows();
+                line = compacted.rowAt(compactedRows, externalRow + i, mScrolledRows);
+                if (line != null) {
+                    rows[i] = line;
+                    continue;
+                }
+            }
+            rows[i] = (line == null) ? new TerminalRow(mColumns, TextStyle.NORMAL) : line.copy();
+        }
+        return rows;
+    }
+
+    /**
+     * Replace the transcript and screen with restored rows, which must have {@link #mColumns} columns. Only the last
+     * transcript rows that fit are kept.
+     */
+    void restoreRows(TerminalRow[] transcript, TerminalRow[] screen) {
+        if (screen.length != mScreenRows)
+            throw new IllegalArgumentException("screen.length=" + screen.length + ", mScreenRows=" + mScreenRows);
+        int transcriptRows = Math.min(transcript.length, mTotalRows - mScreenRows);
+        Arrays.fill(mLines, null);
+        System.arraycopy(transcript, transcript.length - transcriptRows, mLines, 0, transcriptRows);
+        System.arraycopy(screen, 0, mLines, transcriptRows, mScreenRows);
+        mActiveTranscriptRows = mScreenFirstRow = transcriptRows;
+        mCompactedTranscript = null;
+        mTranscriptGeneration++;
+    }
+
+    /** An estimate of the heap memory taken by the rows of this buffer, compacted ones included. */
+    public long getAllocatedBytes() {
+        long bytes = 16 + 4L * mLines.length;
+        for (TerminalRow line : mLines)
+            if (line != null) bytes += line.getAllocatedBytes();
+        CompactedTranscript compacted = mCompactedTranscript;
+        if (compacted != null) bytes += compacted.getAllocatedBytes();
+        return bytes;
+    }
+
+    public boolean isTranscriptCompacted() {
+        return mCompactedTranscript != null;
+    }
+
+    /**
+     * Compress the transcript to free the memory of its rows, for a session which nobody is looking at. Output keeps
+     * scrolling into the transcript uncompressed, and {@link #getSelectedText} reads compacted rows without expanding
+     * them. Calling this again only compresses the rows which scrolled in since, as a segment of their own, unless
+     * there are {@link #MAX_COMPACTED_SEGMENTS} segments already, which are then merged into one. Must be called on the
+     * main thread, and {@link #expandTranscript()} before the transcript is shown again.
+     *
+     * @return an estimate of the bytes freed.
+     */
+    public long compactTranscript() {
+        final int transcriptRows = mActiveTranscriptRows;
+        if (transcriptRows == 0) return 0;
+        CompactedTranscript compacted = mCompactedTranscript;
+        int newRows = transcriptRows;
+        if (compacted != null) {
+            compacted = compacted.withoutSegmentsBefore(-transcriptRows, mScrolledRows);
+            newRows = (int) Math.min(mScrolledRows - compacted.getScrolledRows(), transcriptRows);
+            if (newRows == 0) {
+                mCompactedTranscript = compacted;
+                return 0;
+            }
+            if (newRows == transcriptRows) {
+                compacted = null;
+            } else if (compacted.mSegments.length >= MAX_COMPACTED_SEGMENTS) {
+                expandTranscript();
+                compacted = null;
+                newRows = transcriptRows;
+            }
+        }
+
+        long bytesBefore = getAllocatedBytes();
+        TerminalRow[] rows = new TerminalRow[newRows];
+        for (int i = 0; i < newRows; i++) {
+            TerminalRow line = mLines[externalToInternalRow(i - newRows)];
+            rows[i] = (line == null) ? new TerminalRow(mColumns, TextStyle.NORMAL) : line;
+        }
+        CompactedSegment segment = new CompactedSegment(TerminalSnapshot.deflateRows(rows, mColumns), newRows, mColumns, mScrolledRows);
+        mCompactedTranscript = (compacted == null) ? new CompactedTranscript(new CompactedSegment[]{segment}) : compacted.with(segment);
+        for (int i = 0; i < newRows; i++)
+            mLines[externalToInternalRow(i - newRows)] = null;
+        return bytesBefore - getAllocatedBytes();
+    }
+
+    /** Bring back the rows compressed by {@link #compactTranscript()} which are still in the transcript. */
+    public void expandTranscript() {
+        CompactedTranscript compacted = mCompactedTranscript;
+        if (compacted == null) return;
+        mCompactedTranscript = null;
+        for (CompactedSegment segment : compacted.mSegments) {
+            if (segment.externalRow(segment.mRows - 1, mScrolledRows) < -mActiveTranscriptRows) continue;
+            TerminalRow[] rows = segment.inflate();
+            for (int i = 0; i < rows.length; i++) {
+                long externalRow = segment.externalRow(i, mScrolledRows);
+                if (externalRow >= -mActiveTranscriptRows) mLines[externalToInternalRow((int) externalRow)] = rows[i];
+            }
+        }
+    }
+
+    /**
+     * Rows compressed together by one {@link #compactTranscript()} call. Rows only enter the transcript by scrolling
+     * while compacted, as everything else expands it first, so the compacted rows are where that many scrolls moved
+     * them.
+     */
+    private static final class CompactedSegment {
+
+        final byte[] mData;
+        final int mRows, mColumns;
+        /** {@link #mScrolledRows} when compacting, when the compacted rows were the last transcript rows. */
+        final long mScrolledRows;
+
+        CompactedSegment(byte[] data, int rows, int columns, long scrolledRows) {
+            mData = data;
+            mRows = rows;
+            mColumns = columns;
+            mScrolledRows = scrolledRows;
+        }
+
+        TerminalRow[] inflate() {
+            return TerminalSnapshot.inflateRows(mData, mRows, mColumns);
+        }
+
+        /** The external row where the compacted row with the given index is now. */
+        long externalRow(int index, long scrolledRows) {
+            return index - mRows - (scrolledRows - mScrolledRows);
+        }
+
+        /** The index of the compacted row now at an external row, or -1 if no row of this segment is there. */
+        int indexAt(int externalRow, long scrolledRows) {
+            long index = externalRow + mRows + (scrolledRows - mScrolledRows);
+            return (index >= 0 && index < mRows) ? (int) index : -1;
+        }
+
+    }
+
+    /**
+     * The transcript as compressed by {@link #compactTranscript()}, in segments from oldest to newest which cover
+     * adjacent rows. Never changed once made, so that other threads may read it while the main thread replaces it.
+     */
+    private static final class CompactedTranscript {
+
+        final CompactedSegment[] mSegments;
+
+        CompactedTranscript(CompactedSegment[] segments) {
+            mSegments = segments;
+        }
+
+        /** {@link #mScrolledRows} when the newest segment was compacted. */
+        long getScrolledRows() {
+            return mSegments[mSegments.length - 1].mScrolledRows;
+        }
+
+        long getAllocatedBytes() {
+            long bytes = 16 + 4L * mSegments.length;
+            for (CompactedSegment segment : mSegments) bytes += 32 + segment.mData.length;
+            return bytes;
+        }
+
+        CompactedTranscript with(CompactedSegment segment) {
+            CompactedSegment[] segments = Arrays.copyOf(mSegments, mSegments.length + 1);
+            segments[mSegments.length] = segment;
+            return new CompactedTranscript(segments);
+        }
+
+        /** This transcript without the segments whose rows all scrolled above the given external row. */
+        CompactedTranscript withoutSegmentsBefore(int firstExternalRow, long scrolledRows) {
+            int dropped = 0;
+            while (dropped < mSegments.length - 1) {
+                CompactedSegment segment = mSegments[dropped];
+                if (segment.externalRow(segment.mRows - 1, scrolledRows) >= firstExternalRow) break;
+                dropped++;
+            }
+            return (dropped == 0) ? this : new CompactedTranscript(Arrays.copyOfRange(mSegments, dropped, mSegments.length));
+        }
+
+        /** Room for the rows of each segment, which {@link #rowAt} inflates when first needed. */
+        TerminalRow[][] newInflatedRows() {
+            return new TerminalRow[mSegments.length][];
+        }
+
+        /** The compacted row at an external row, or null if no compacted row is there. */
+        TerminalRow rowAt(TerminalRow[][] inflated, int externalRow, long scrolledRows) {
+            for (int i = mSegments.length - 1; i >= 0; i--) {
+                int index = mSegments[i].indexAt(externalRow, scrolledRows);
+                if (index < 0) continue;
+                if (inflated[i] == null) inflated[i] = mSegments[i].inflate();
+                return inflated[i][index];
+            }
+            return null;
+        }
+
     }
 
 }
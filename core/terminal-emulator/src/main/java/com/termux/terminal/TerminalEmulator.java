@@ -265,6 +265,9 @@ public final class TerminalEmulator {
     /** If automatic scrolling of terminal is disabled */
     private boolean mAutoScrollDisabled;
 
+    /** Counts calls which may have changed what is shown, for {@link TerminalSnapshotWriter} to skip idle sessions. */
+    private long mChangeCount;
+
     private byte mUtf8ToFollow, mUtf8Index;
     private final byte[] mUtf8InputBuffer = new byte[4];
     private int mLastEmittedCodePoint = -1;
@@ -352,6 +355,33 @@ public final class TerminalEmulator {
         return mScreen == mAltBuffer;
     }
 
+    TerminalBuffer getMainBuffer() {
+        return mMainBuffer;
+    }
+
+    /** An estimate of the heap memory taken by both screens and the transcript. */
+    public long getAllocatedBytes() {
+        return mMainBuffer.getAllocatedBytes() + mAltBuffer.getAllocatedBytes();
+    }
+
+    /** See {@link TerminalBuffer#compactTranscript()}. */
+    public long compactTranscript() {
+        return mMainBuffer.compactTranscript();
+    }
+
+    /** See {@link TerminalBuffer#expandTranscript()}. */
+    public void expandTranscript() {
+        mMainBuffer.expandTranscript();
+    }
+
+    public boolean isTranscriptCompacted() {
+        return mMainBuffer.isTranscriptCompacted();
+    }
+
+    long getChangeCount() {
+        return mChangeCount;
+    }
+
     private int getTerminalTranscriptRows(Integer transcriptRows) {
         if (transcriptRows == null || transcriptRows < TERMINAL_TRANSCRIPT_ROWS_MIN || transcriptRows > TERMINAL_TRANSCRIPT_ROWS_MAX)
             return DEFAULT_TERMINAL_TRANSCRIPT_ROWS;
@@ -414,6 +444,7 @@ public final class TerminalEmulator {
     }
 
     private void resizeScreen() {
+        mChangeCount++;
         final int[] cursor = {mCursorCol, mCursorRow};
         int newTotalRows = (mScreen == mAltBuffer) ? mRows : mMainBuffer.mTotalRows;
         mScreen.resize(mColumns, mRows, newTotalRows, cursor, getStyle(), isAlternateBufferActive());
@@ -498,8 +529,11 @@ public final class TerminalEmulator {
      * @param length the number of bytes in the array to process
      */
     public void append(byte[] buffer, int length) {
+        final long traceStart = Tracer.now();
+        mChangeCount++;
         for (int i = 0; i < length; i++)
             processByte(buffer[i]);
+        Tracer.complete("emulator.append", traceStart, length);
     }
 
     private void processByte(byte byteToProcess) {
@@ -1710,7 +1744,18 @@ public final class TerminalEmulator {
                 break;
             case 'b': // Repeat the preceding graphic character Ps times (REP).
                 if (mLastEmittedCodePoint == -1) break;
-                final int numRepeat = getArg0(1);
+                int numRepeat = getArg0(1);
+                final int repeatedWidth = WcWidth.width(mLastEmittedCodePoint);
+                if (!isDecsetInternalBitSet(DECSET_BIT_AUTOWRAP) || repeatedWidth <= 0) {
+                    // The cursor stops at the right margin, or does not move at all for a combining character.
+                    numRepeat = Math.min(numRepeat, mColumns);
+                } else {
+                    // Past a screenful only whole rows of the same character scroll by, so skip those, which leaves
+                    // the screen and the cursor as repeating all of them would.
+                    final int perRow = Math.max(1, (mRightMargin - mLeftMargin) / repeatedWidth);
+                    final int screenful = perRow * mRows;
+                    if (numRepeat > screenful) numRepeat = screenful + (numRepeat - screenful) % perRow;
+                }
                 for (int i = 0; i < numRepeat; i++) emitCodePoint(mLastEmittedCodePoint);
                 break;
             case 'c': // Primary Device Attributes (http://www.vt100.net/docs/vt510-rm/DA1) if argument is missing or zero.
@@ -2565,6 +2610,49 @@ public final class TerminalEmulator {
 
         mColors.reset();
         mSession.onColorsChanged();
+        mChangeCount++;
+    }
+
+    /**
+     * Take a snapshot of the main screen, which is what comes back when a full screen program such as an editor exits,
+     * with the given number of the latest transcript rows. While the alternate screen is active the cursor saved when
+     * switching to it is taken.
+     */
+    TerminalSnapshot takeSnapshot(boolean full, int transcriptRows) {
+        TerminalBuffer buffer = mMainBuffer;
+        boolean alternate = isAlternateBufferActive();
+        int cursorRow = alternate ? mSavedStateMain.mSavedCursorRow : mCursorRow;
+        int cursorCol = alternate ? mSavedStateMain.mSavedCursorCol : mCursorCol;
+        boolean[] tabStops = Arrays.copyOf(mTabStop, buffer.mColumns);
+        return new TerminalSnapshot(full, buffer.mColumns, buffer.mScreenRows,
+            Math.min(cursorRow, buffer.mScreenRows - 1), Math.min(cursorCol, buffer.mColumns - 1), mCurrentDecSetFlags,
+            tabStops, mColors.mCurrentColors.clone(), mTitle,
+            buffer.copyRows(-transcriptRows, transcriptRows), buffer.copyRows(0, buffer.mScreenRows));
+    }
+
+    /**
+     * Show a snapshot taken by an earlier process in this new emulator, reflowed to its size. Modes set for the program
+     * that is gone, such as mouse tracking, bracketed paste, application keys and scrolling margins, are not restored
+     * since a new program is attached, and the cursor is moved to a new line for its output.
+     */
+    public void restoreSnapshot(TerminalSnapshot snapshot) {
+        if (isAlternateBufferActive()) throw new IllegalStateException("Restoring into the alternate screen");
+        final int columns = mColumns, rows = mRows;
+        resize(snapshot.mColumns, snapshot.mRows, mCellWidthPixels, mCellHeightPixels);
+        mMainBuffer.restoreRows(snapshot.mTranscript, snapshot.mScreen);
+        System.arraycopy(snapshot.mTabStops, 0, mTabStop, 0, mColumns);
+        setDecsetinternalBit(DECSET_BIT_REVERSE_VIDEO, (snapshot.mDecSetFlags & DECSET_BIT_REVERSE_VIDEO) != 0);
+        setDecsetinternalBit(DECSET_BIT_AUTOWRAP, (snapshot.mDecSetFlags & DECSET_BIT_AUTOWRAP) != 0);
+        System.arraycopy(snapshot.mColors, 0, mColors.mCurrentColors, 0, TextStyle.NUM_INDEXED_COLORS);
+        mSession.onColorsChanged();
+        setTitle(snapshot.mTitle);
+        setCursorRowCol(snapshot.mCursorRow, snapshot.mCursorCol);
+        if (mCursorCol > 0) {
+            mCursorCol = 0;
+            doLinefeed();
+        }
+        resize(columns, rows, mCellWidthPixels, mCellHeightPixels);
+        mChangeCount++;
     }
 
     public String getSelectedText(int x1, int y1, int x2, int y2) {
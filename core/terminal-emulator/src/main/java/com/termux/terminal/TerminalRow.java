@@ -37,6 +37,9 @@ public final class TerminalRow {
      */
     private static final int MAX_COMBINING_CHARACTERS_PER_COLUMN = 15;
 
+    /** Object headers and fields of a row and its two arrays, besides the array contents. */
+    private static final int OVERHEAD_BYTES = 80;
+
     /** The number of columns in this terminal row. */
     private final int mColumns;
     /** The text filling this terminal row. */
@@ -49,6 +52,15 @@ public final class TerminalRow {
     final long[] mStyle;
     /** If this row might contain chars with width != 1, used for deactivating fast path */
     boolean mHasNonOneWidthOrSurrogateChars;
+    /**
+     * A position reached by an earlier scan of {@link #mText} in {@link #setChar(int, int, long)}: the chars before
+     * {@link #mScanCharIndex} take up {@link #mScanColumn} columns. Later scans for columns at or after it start there,
+     * which keeps writing wide or combining chars left to right linear in the row length instead of quadratic. Changes
+     * to mText must leave the chars before mScanCharIndex alone or move the position back.
+     */
+    private int mScanColumn, mScanCharIndex;
+    /** A column which holds {@link #MAX_COMBINING_CHARACTERS_PER_COLUMN} combining chars, or -1. */
+    private int mSaturatedColumn = -1;
 
     /** Construct a blank row (containing only whitespace, ' ') with a specified style. */
     public TerminalRow(int columns, long style) {
@@ -58,15 +70,51 @@ public final class TerminalRow {
         clear(style);
     }
 
+    /** Construct a row from its contents, as copied by {@link #copy()} or read by {@link TerminalSnapshot}. */
+    TerminalRow(int columns, char[] text, int spaceUsed, long[] style, boolean lineWrap, boolean hasNonOneWidthOrSurrogateChars) {
+        mColumns = columns;
+        mText = text;
+        mSpaceUsed = (short) spaceUsed;
+        mStyle = style;
+        mLineWrap = lineWrap;
+        mHasNonOneWidthOrSurrogateChars = hasNonOneWidthOrSurrogateChars;
+    }
+
+    /** A copy of this row which later changes to either of them do not affect. */
+    TerminalRow copy() {
+        return new TerminalRow(mColumns, mText.clone(), mSpaceUsed, mStyle.clone(), mLineWrap, mHasNonOneWidthOrSurrogateChars);
+    }
+
     /** NOTE: The sourceX2 is exclusive. */
     public void copyInterval(TerminalRow line, int sourceX1, int sourceX2, int destinationX) {
+        if (!mHasNonOneWidthOrSurrogateChars && !line.mHasNonOneWidthOrSurrogateChars) {
+            // One char per column on both sides, so this is a plain array copy, also when copying within this row.
+            System.arraycopy(line.mText, sourceX1, mText, destinationX, sourceX2 - sourceX1);
+            System.arraycopy(line.mStyle, sourceX1, mStyle, destinationX, sourceX2 - sourceX1);
+            return;
+        }
         mHasNonOneWidthOrSurrogateChars |= line.mHasNonOneWidthOrSurrogateChars;
         final int x1 = line.findStartOfColumn(sourceX1);
         final int x2 = line.findStartOfColumn(sourceX2);
         boolean startingFromSecondHalfOfWideChar = (sourceX1 > 0 && line.wideDisplayCharacterStartingAt(sourceX1 - 1));
-        final char[] sourceChars = (this == line) ? Arrays.copyOf(line.mText, line.mText.length) : line.mText;
+        // When copying within this row, snapshot just the copied interval as it is overwritten while copying.
+        final char[] sourceChars;
+        final int sourceCharsOffset;
+        final long[] sourceStyles;
+        final int sourceStylesOffset;
+        if (this == line) {
+            sourceChars = Arrays.copyOfRange(mText, x1, x2);
+            sourceCharsOffset = x1;
+            sourceStyles = Arrays.copyOfRange(mStyle, sourceX1, sourceX2);
+            sourceStylesOffset = sourceX1;
+        } else {
+            sourceChars = line.mText;
+            sourceCharsOffset = 0;
+            sourceStyles = line.mStyle;
+            sourceStylesOffset = 0;
+        }
         int latestNonCombiningWidth = 0;
-        for (int i = x1; i < x2; i++) {
+        for (int i = x1 - sourceCharsOffset; i < x2 - sourceCharsOffset; i++) {
             char sourceChar = sourceChars[i];
             int codePoint = Character.isHighSurrogate(sourceChar) ? Character.toCodePoint(sourceChar, sourceChars[++i]) : sourceChar;
             if (startingFromSecondHalfOfWideChar) {
@@ -80,7 +128,7 @@ public final class TerminalRow {
                 sourceX1 += latestNonCombiningWidth;
                 latestNonCombiningWidth = w;
             }
-            setChar(destinationX, codePoint, line.getStyle(sourceX1));
+            setChar(destinationX, codePoint, sourceStyles[sourceX1 - sourceStylesOffset]);
         }
     }
 
@@ -88,12 +136,30 @@ public final class TerminalRow {
         return mSpaceUsed;
     }
 
+    /** An estimate of the heap memory taken by this row. */
+    public long getAllocatedBytes() {
+        return OVERHEAD_BYTES + 2L * mText.length + 8L * mStyle.length;
+    }
+
     /** Note that the column may end of second half of wide character. */
     public int findStartOfColumn(int column) {
         if (column == mColumns) return getSpaceUsed();
+        if (!mHasNonOneWidthOrSurrogateChars) return column;
+        return findStartOfColumn(column, 0, 0, false);
+    }
+
+    /**
+     * Like {@link #findStartOfColumn(int)}, but starting from and updating the position of the previous scan. Only
+     * for use while writing to this row, as transcript readers on other threads use the uncached variant.
+     */
+    private int findStartOfColumnFromScanPosition(int column) {
+        if (column == mColumns) return getSpaceUsed();
+        if (!mHasNonOneWidthOrSurrogateChars) return column;
+        return mScanColumn <= column ? findStartOfColumn(column, mScanColumn, mScanCharIndex, true) : findStartOfColumn(column, 0, 0, true);
+    }
 
-        int currentColumn = 0;
-        int currentCharIndex = 0;
+    /** Scan for the start of column from a position where the chars before currentCharIndex take up currentColumn. */
+    private int findStartOfColumn(int column, int currentColumn, int currentCharIndex, boolean updateScanPosition) {
         while (true) { // 0<2 1 < 2
             int newCharIndex = currentCharIndex;
             char c = mText[newCharIndex++]; // cci=1, cci=2
@@ -117,9 +183,17 @@ public final class TerminalRow {
                             break;
                         }
                     }
+                    if (updateScanPosition) {
+                        mScanColumn = column;
+                        mScanCharIndex = newCharIndex;
+                    }
                     return newCharIndex;
                 } else if (currentColumn > column) {
                     // Wide column going past end.
+                    if (updateScanPosition) {
+                        mScanColumn = currentColumn - wcwidth;
+                        mScanCharIndex = currentCharIndex;
+                    }
                     return currentCharIndex;
                 }
             }
@@ -128,7 +202,13 @@ public final class TerminalRow {
     }
 
     private boolean wideDisplayCharacterStartingAt(int column) {
-        for (int currentCharIndex = 0, currentColumn = 0; currentCharIndex < mSpaceUsed; ) {
+        if (!mHasNonOneWidthOrSurrogateChars) return false;
+        int currentCharIndex = 0, currentColumn = 0;
+        if (mScanColumn <= column) {
+            currentColumn = mScanColumn;
+            currentCharIndex = mScanCharIndex;
+        }
+        while (currentCharIndex < mSpaceUsed) {
             char c = mText[currentCharIndex++];
             int codePoint = Character.isHighSurrogate(c) ? Character.toCodePoint(c, mText[currentCharIndex++]) : c;
             int wcwidth = WcWidth.width(codePoint);
@@ -146,6 +226,8 @@ public final class TerminalRow {
         Arrays.fill(mStyle, style);
         mSpaceUsed = (short) mColumns;
         mHasNonOneWidthOrSurrogateChars = false;
+        mScanColumn = mScanCharIndex = 0;
+        mSaturatedColumn = -1;
     }
 
     // https://github.com/steven676/Android-Terminal-Emulator/commit/9a47042620bec87617f0b4f5d50568535668fe26
@@ -169,6 +251,10 @@ public final class TerminalRow {
 
         final boolean newIsCombining = newCodePointDisplayWidth <= 0;
 
+        // Floods of combining chars into a full column are dropped without scanning the row.
+        if (newIsCombining && columnToSet == mSaturatedColumn) return;
+        final int requestedColumn = columnToSet;
+
         boolean wasExtraColForWideChar = (columnToSet > 0) && wideDisplayCharacterStartingAt(columnToSet - 1);
 
         if (newIsCombining) {
@@ -183,24 +269,32 @@ public final class TerminalRow {
         }
 
         char[] text = mText;
-        final int oldStartOfColumnIndex = findStartOfColumn(columnToSet);
+        final int oldStartOfColumnIndex = findStartOfColumnFromScanPosition(columnToSet);
+        final int scanColumn = mScanColumn, scanCharIndex = mScanCharIndex;
         final int oldCodePointDisplayWidth = WcWidth.width(text, oldStartOfColumnIndex);
 
         // Get the number of elements in the mText array this column uses now
         int oldCharactersUsedForColumn;
         if (columnToSet + oldCodePointDisplayWidth < mColumns) {
-            int oldEndOfColumnIndex = findStartOfColumn(columnToSet + oldCodePointDisplayWidth);
+            int oldEndOfColumnIndex = findStartOfColumnFromScanPosition(columnToSet + oldCodePointDisplayWidth);
             oldCharactersUsedForColumn = oldEndOfColumnIndex - oldStartOfColumnIndex;
         } else {
             // Last character.
             oldCharactersUsedForColumn = mSpaceUsed - oldStartOfColumnIndex;
         }
+        // Everything from oldStartOfColumnIndex on may change below, the chars before it stay.
+        mScanColumn = scanColumn;
+        mScanCharIndex = scanCharIndex;
 
         // If MAX_COMBINING_CHARACTERS_PER_COLUMN already exist in column, then ignore adding additional combining characters.
         if (newIsCombining) {
             int combiningCharsCount = WcWidth.zeroWidthCharsCount(mText, oldStartOfColumnIndex, oldStartOfColumnIndex + oldCharactersUsedForColumn);
-            if (combiningCharsCount >= MAX_COMBINING_CHARACTERS_PER_COLUMN)
+            if (combiningCharsCount >= MAX_COMBINING_CHARACTERS_PER_COLUMN) {
+                mSaturatedColumn = requestedColumn;
                 return;
+            }
+        } else {
+            mSaturatedColumn = -1;
         }
 
         // Find how many chars this column will need
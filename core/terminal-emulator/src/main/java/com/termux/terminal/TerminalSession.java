@@ -8,12 +8,8 @@ import android.system.Os;
 import android.system.OsConstants;
 
 import java.io.File;
-import java.io.FileDescriptor;
-import java.io.FileInputStream;
-import java.io.FileOutputStream;
 import java.io.IOException;
-import java.io.InputStream;
-import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
 import java.util.UUID;
 
@@ -47,6 +43,8 @@ public final class TerminalSession extends TerminalOutput {
      * writing to the {@link #mTerminalFileDescriptor}.
      */
     final ByteQueue mTerminalToProcessIOQueue = new ByteQueue(4096);
+    /** I/O counters and latency histograms, updated natively by the I/O threads, see {@link #getIoStats()}. */
+    private final ByteBuffer mIoStats = ByteBuffer.allocateDirect(JNI.statsSize());
     /** Buffer to write translate code points into utf8 before writing to mTerminalToProcessIOQueue */
     private final byte[] mUtf8InputBuffer = new byte[5];
 
@@ -78,6 +76,10 @@ public final class TerminalSession extends TerminalOutput {
     private final String[] mArgs;
     private final String[] mEnv;
     private final Integer mTranscriptRows;
+    /** Shown by the emulator when it is created, see {@link #setRestoredSnapshot(TerminalSnapshot)}. */
+    private TerminalSnapshot mRestoredSnapshot;
+    /** The file output is recorded to, or will be once the emulator is initialized, see {@link #startRecording(File)}. */
+    private File mRecordingFile;
 
 
     private static final String LOG_TAG = "TerminalSession";
@@ -118,12 +120,21 @@ public final class TerminalSession extends TerminalOutput {
         return mIsVisible;
     }
 
+    /**
+     * Show a snapshot of a session from before the process was killed instead of an empty screen. The shell is new, the
+     * snapshot only brings back the screen and transcript. Must be called before the emulator is initialized.
+     */
+    public void setRestoredSnapshot(TerminalSnapshot snapshot) {
+        mRestoredSnapshot = snapshot;
+    }
+
     /** Inform the attached pty of the new size and reflow or initialize the emulator. */
     public void updateSize(int columns, int rows, int cellWidthPixels, int cellHeightPixels) {
         if (mEmulator == null) {
             initializeEmulator(columns, rows, cellWidthPixels, cellHeightPixels);
         } else {
             JNI.setPtyWindowSize(mTerminalFileDescriptor, rows, columns, cellWidthPixels, cellHeightPixels);
+            JNI.recordResize(mIoStats, columns, rows);
             mEmulator.resize(columns, rows, cellWidthPixels, cellHeightPixels);
         }
     }
@@ -141,24 +152,42 @@ public final class TerminalSession extends TerminalOutput {
      */
     public void initializeEmulator(int columns, int rows, int cellWidthPixels, int cellHeightPixels) {
         mEmulator = new TerminalEmulator(this, columns, rows, cellWidthPixels, cellHeightPixels, mTranscriptRows, mClient);
+        if (mRestoredSnapshot != null) {
+            final long traceStart = Tracer.now();
+            mEmulator.restoreSnapshot(mRestoredSnapshot);
+            Tracer.complete("session.restoreSnapshot", traceStart, mRestoredSnapshot.getTranscriptRows());
+            mRestoredSnapshot = null;
+        }
+
+        if (mRecordingFile != null) {
+            try {
+                JNI.startRecording(mIoStats, mRecordingFile.getPath(), columns, rows);
+            } catch (IOException e) {
+                Logger.logStackTraceWithMessage(mClient, LOG_TAG, "Failed starting recording to " + mRecordingFile, e);
+                mRecordingFile = null;
+            }
+        }
 
         int[] processId = new int[1];
         mTerminalFileDescriptor = JNI.createSubprocess(mShellPath, mCwd, mArgs, mEnv, processId, rows, columns, cellWidthPixels, cellHeightPixels);
         mShellPid = processId[0];
         mClient.setTerminalShellPid(this, mShellPid);
 
-        final FileDescriptor terminalFileDescriptorWrapped = wrapFileDescriptor(mTerminalFileDescriptor, mClient);
+        final int terminalFileDescriptor = mTerminalFileDescriptor;
 
         new Thread("TermSessionInputReader[pid=" + mShellPid + "]") {
             @Override
             public void run() {
-                try (InputStream termIn = new FileInputStream(terminalFileDescriptorWrapped)) {
+                try {
                     final byte[] buffer = new byte[4096];
                     while (true) {
-                        int read = termIn.read(buffer);
+                        int read = JNI.read(terminalFileDescriptor, buffer, mIoStats);
                         if (read == -1) return;
+                        // From the read returning to the bytes being queued, which waits while the queue is full
+                        final long traceStart = Tracer.now();
                         if (!mProcessToTerminalIOQueue.write(buffer, 0, read)) return;
                         mMainThreadHandler.sendEmptyMessage(MSG_NEW_INPUT);
+                        Tracer.complete("pty.read", traceStart, read);
                     }
                 } catch (Exception e) {
                     // Ignore, just shutting down.
@@ -170,11 +199,13 @@ public final class TerminalSession extends TerminalOutput {
             @Override
             public void run() {
                 final byte[] buffer = new byte[4096];
-                try (FileOutputStream termOut = new FileOutputStream(terminalFileDescriptorWrapped)) {
+                try {
                     while (true) {
                         int bytesToWrite = mTerminalToProcessIOQueue.read(buffer, true);
                         if (bytesToWrite == -1) return;
-                        termOut.write(buffer, 0, bytesToWrite);
+                        final long traceStart = Tracer.now();
+                        JNI.write(terminalFileDescriptor, buffer, 0, bytesToWrite, mIoStats);
+                        Tracer.complete("pty.write", traceStart, bytesToWrite);
                     }
                 } catch (IOException e) {
                     // Ignore.
@@ -235,6 +266,43 @@ public final class TerminalSession extends TerminalOutput {
         write(mUtf8InputBuffer, 0, bufferPosition);
     }
 
+    /** A snapshot of the I/O counters and latency histograms of this session. */
+    public TerminalSessionStats getIoStats() {
+        long[] snapshot = new long[TerminalSessionStats.SNAPSHOT_LENGTH];
+        JNI.snapshotStats(mIoStats, snapshot);
+        return new TerminalSessionStats(snapshot, mProcessToTerminalIOQueue.getFullStalls());
+    }
+
+    /**
+     * Record the output of the process with its timing to an asciicast v2 file, which asciinema and other players
+     * replay, until {@link #stopRecording()} or the process exits. The output is recorded natively as it is read, so it
+     * does not slow the session down; if the disk falls behind, output is dropped from the recording instead. A
+     * recording started after the emulator was initialized does not hold the screen from before.
+     */
+    public void startRecording(File file) throws IOException {
+        if (mEmulator != null) JNI.startRecording(mIoStats, file.getPath(), mEmulator.mColumns, mEmulator.mRows);
+        mRecordingFile = file;
+    }
+
+    /** Stop the recording started by {@link #startRecording(File)}, if any. The file is finished in the background. */
+    public void stopRecording() {
+        if (mRecordingFile == null) return;
+        long droppedBytes = JNI.stopRecording(mIoStats);
+        if (droppedBytes > 0)
+            Logger.logWarn(mClient, LOG_TAG, "Recording to " + mRecordingFile + " dropped " + droppedBytes + " bytes of output");
+        mRecordingFile = null;
+    }
+
+    /** The file output is recorded to, or null if it is not recorded. */
+    public File getRecordingFile() {
+        return mRecordingFile;
+    }
+
+    /** Called by the view after drawing a frame of this session, to measure output latency up to the screen. */
+    public void onFrameDrawn() {
+        if (mEmulator != null) JNI.markFrameDrawn(mIoStats);
+    }
+
     public TerminalEmulator getEmulator() {
         return mEmulator;
     }
@@ -272,6 +340,7 @@ public final class TerminalSession extends TerminalOutput {
         mTerminalToProcessIOQueue.close();
         mProcessToTerminalIOQueue.close();
         JNI.close(mTerminalFileDescriptor);
+        stopRecording();
     }
 
     @Override
@@ -333,25 +402,6 @@ public final class TerminalSession extends TerminalOutput {
         return null;
     }
 
-    private static FileDescriptor wrapFileDescriptor(int fileDescriptor, TerminalSessionClient client) {
-        FileDescriptor result = new FileDescriptor();
-        try {
-            Field descriptorField;
-            try {
-                descriptorField = FileDescriptor.class.getDeclaredField("descriptor");
-            } catch (NoSuchFieldException e) {
-                // For desktop java:
-                descriptorField = FileDescriptor.class.getDeclaredField("fd");
-            }
-            descriptorField.setAccessible(true);
-            descriptorField.set(result, fileDescriptor);
-        } catch (NoSuchFieldException | IllegalAccessException | IllegalArgumentException e) {
-            Logger.logStackTraceWithMessage(client, LOG_TAG, "Error accessing FileDescriptor#descriptor private field", e);
-            System.exit(1);
-        }
-        return result;
-    }
-
     @SuppressLint("HandlerLeak")
     class MainThreadHandler extends Handler {
 
@@ -362,7 +412,10 @@ public final class TerminalSession extends TerminalOutput {
             int bytesRead = mProcessToTerminalIOQueue.read(mReceiveBuffer, false);
             if (bytesRead > 0) {
                 mEmulator.append(mReceiveBuffer, bytesRead);
+                JNI.markAppended(mIoStats);
+                final long traceStart = Tracer.now();
                 notifyScreenUpdate();
+                Tracer.complete("session.notifyScreenUpdate", traceStart);
             }
 
             if (msg.what == MSG_PROCESS_EXITED) {
@@ -0,0 +1,103 @@
+package com.termux.terminal;
+
+import java.util.Locale;
+
+/**
+ * A snapshot of the I/O counters of a {@link TerminalSession}, which are maintained natively in jni/pty_io.c.
+ * <p>
+ * Latencies are kept in log-linear histograms of microseconds like HdrHistogram's: every power of two is split in
+ * eight buckets, so a reported percentile is at most 12.5% above the true value.
+ */
+public final class TerminalSessionStats {
+
+    static final int SUB_BUCKET_BITS = 3;
+    static final int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static final int HISTOGRAM_BUCKETS = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    private static final int SNAPSHOT_COUNTERS = 4;
+    static final int SNAPSHOT_LENGTH = SNAPSHOT_COUNTERS + 2 * HISTOGRAM_BUCKETS;
+
+    /** Bytes read from the process. */
+    public final long bytesIn;
+    /** Bytes written to the process. */
+    public final long bytesOut;
+    /** read(2) calls that returned output. */
+    public final long reads;
+    /** write(2) calls. */
+    public final long writes;
+    /** Times the reader thread had to wait because the emulator had not consumed earlier output yet. */
+    public final long queueFullStalls;
+    /** Microseconds from reading output to passing it to the emulator, by histogram bucket. */
+    public final long[] readToAppend;
+    /** Microseconds from reading output to drawing a frame containing it, by histogram bucket. */
+    public final long[] readToFrame;
+
+    TerminalSessionStats(long[] snapshot, long queueFullStalls) {
+        this.bytesIn = snapshot[0];
+        this.bytesOut = snapshot[1];
+        this.reads = snapshot[2];
+        this.writes = snapshot[3];
+        this.queueFullStalls = queueFullStalls;
+        this.readToAppend = new long[HISTOGRAM_BUCKETS];
+        this.readToFrame = new long[HISTOGRAM_BUCKETS];
+        System.arraycopy(snapshot, SNAPSHOT_COUNTERS, readToAppend, 0, HISTOGRAM_BUCKETS);
+        System.arraycopy(snapshot, SNAPSHOT_COUNTERS + HISTOGRAM_BUCKETS, readToFrame, 0, HISTOGRAM_BUCKETS);
+    }
+
+    public double getAverageReadSize() {
+        return reads == 0 ? 0 : (double) bytesIn / reads;
+    }
+
+    /** The histogram bucket of a value, as computed by histogram_bucket() in jni/pty_io.c. */
+    static int bucketIndex(long micros) {
+        if (micros > 0xFFFFFFFFL) micros = 0xFFFFFFFFL;
+        if (micros < SUB_BUCKETS) return (int) micros;
+        int magnitude = 63 - Long.numberOfLeadingZeros(micros);
+        int shift = magnitude - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + (int) ((micros >> shift) - SUB_BUCKETS);
+    }
+
+    /** The largest value counted in {@code bucket}. */
+    static long bucketUpperBound(int bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+        int shift = bucket / SUB_BUCKETS - 1;
+        long mantissa = SUB_BUCKETS + bucket % SUB_BUCKETS;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    public static long count(long[] histogram) {
+        long count = 0;
+        for (long bucket : histogram) count += bucket;
+        return count;
+    }
+
+    /** An upper bound of the given percentile (0 to 100) of {@code histogram}, or 0 if it is empty. */
+    public static long percentile(long[] histogram, double percentile) {
+        long count = count(histogram);
+        if (count == 0) return 0;
+        long target = Math.max(1, (long) Math.ceil(percentile * count / 100));
+        long seen = 0;
+        for (int i = 0; i < histogram.length; i++) {
+            seen += histogram[i];
+            if (seen >= target) return bucketUpperBound(i);
+        }
+        return bucketUpperBound(histogram.length - 1);
+    }
+
+    /** A human readable summary, one counter or histogram per line. */
+    public String format() {
+        StringBuilder builder = new StringBuilder();
+        builder.append(String.format(Locale.ROOT, "bytes in: %d in %d reads (%.1f bytes/read)%n", bytesIn, reads, getAverageReadSize()));
+        builder.append(String.format(Locale.ROOT, "bytes out: %d in %d writes%n", bytesOut, writes));
+        builder.append(String.format(Locale.ROOT, "queue full stalls: %d%n", queueFullStalls));
+        appendHistogram(builder, "read to append", readToAppend);
+        appendHistogram(builder, "read to frame", readToFrame);
+        return builder.toString();
+    }
+
+    private static void appendHistogram(StringBuilder builder, String name, long[] histogram) {
+        builder.append(String.format(Locale.ROOT, "%s (us): n=%d p50=%d p90=%d p99=%d p99.9=%d max=%d%n", name, count(histogram),
+            percentile(histogram, 50), percentile(histogram, 90), percentile(histogram, 99), percentile(histogram, 99.9),
+            percentile(histogram, 100)));
+    }
+
+}
@@ -0,0 +1,249 @@
+package com.termux.terminal;
+
+import java.io.BufferedInputStream;
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.EOFException;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.zip.CRC32;
+import java.util.zip.Deflater;
+import java.util.zip.DeflaterOutputStream;
+import java.util.zip.InflaterInputStream;
+
+/**
+ * The main screen of a {@link TerminalEmulator} with its transcript, cursor, modes, colors and title, as saved by
+ * {@link TerminalSnapshotWriter} so that a session can be shown again after the process has been killed.
+ * <p>
+ * A snapshot file is a header followed by records, each holding a deflated snapshot behind its length and CRC32. The
+ * first record is full, later ones only carry the transcript rows added since the record before, so that a session
+ * printing output costs the new rows and the screen per record instead of the whole transcript. A record cut short by
+ * the process dying while writing it is ignored by {@link #read(File)}.
+ */
+public final class TerminalSnapshot {
+
+    private static final int MAGIC = 0x54534e50; // "TSNP"
+    private static final int VERSION = 1;
+    /** More than the largest transcript deflates to, so that a damaged length is not allocated. */
+    private static final int MAX_RECORD_BYTES = 64 << 20;
+
+    private static final int ROW_LINE_WRAP = 1;
+    private static final int ROW_NON_ONE_WIDTH_OR_SURROGATE_CHARS = 1 << 1;
+
+    /** If {@link #mTranscript} is the whole transcript and not just the rows added since the previous snapshot. */
+    final boolean mFull;
+    final int mColumns, mRows;
+    final int mCursorRow, mCursorCol;
+    final int mDecSetFlags;
+    final boolean[] mTabStops;
+    final int[] mColors;
+    final String mTitle;
+    /** Transcript rows, oldest first. */
+    final TerminalRow[] mTranscript;
+    final TerminalRow[] mScreen;
+
+    TerminalSnapshot(boolean full, int columns, int rows, int cursorRow, int cursorCol, int decSetFlags, boolean[] tabStops,
+                     int[] colors, String title, TerminalRow[] transcript, TerminalRow[] screen) {
+        mFull = full;
+        mColumns = columns;
+        mRows = rows;
+        mCursorRow = cursorRow;
+        mCursorCol = cursorCol;
+        mDecSetFlags = decSetFlags;
+        mTabStops = tabStops;
+        mColors = colors;
+        mTitle = title;
+        mTranscript = transcript;
+        mScreen = screen;
+    }
+
+    public int getTranscriptRows() {
+        return mTranscript.length;
+    }
+
+    /**
+     * Read the state saved in a snapshot file, with the transcript rows of all its records joined.
+     *
+     * @return the snapshot, or null if the file holds no complete record.
+     * @throws IOException if the file cannot be read or is not a snapshot file of this version.
+     */
+    public static TerminalSnapshot read(File file) throws IOException {
+        try (DataInputStream in = new DataInputStream(new BufferedInputStream(new FileInputStream(file)))) {
+            if (in.readInt() != MAGIC || in.readInt() != VERSION) throw new IOException("Not a snapshot file: " + file);
+
+            List<TerminalRow> transcript = new ArrayList<>();
+            TerminalSnapshot last = null;
+            while (true) {
+                byte[] record = readRecord(in);
+                if (record == null) break;
+                TerminalSnapshot snapshot = decode(record);
+                if (!snapshot.mFull && (last == null || last.mColumns != snapshot.mColumns)) break;
+                if (snapshot.mFull) transcript.clear();
+                transcript.addAll(Arrays.asList(snapshot.mTranscript));
+                last = snapshot;
+            }
+            if (last == null) return null;
+            return new TerminalSnapshot(true, last.mColumns, last.mRows, last.mCursorRow, last.mCursorCol, last.mDecSetFlags,
+                last.mTabStops, last.mColors, last.mTitle, transcript.toArray(new TerminalRow[0]), last.mScreen);
+        }
+    }
+
+    /** The header that starts a snapshot file. */
+    static byte[] encodeHeader() throws IOException {
+        ByteArrayOutputStream bytes = new ByteArrayOutputStream(8);
+        DataOutputStream out = new DataOutputStream(bytes);
+        out.writeInt(MAGIC);
+        out.writeInt(VERSION);
+        return bytes.toByteArray();
+    }
+
+    /** This snapshot as a record to append to a snapshot file. */
+    byte[] encodeRecord() throws IOException {
+        ByteArrayOutputStream payload = new ByteArrayOutputStream(8192);
+        Deflater deflater = new Deflater(Deflater.BEST_SPEED);
+        try (DataOutputStream out = new DataOutputStream(new DeflaterOutputStream(payload, deflater, 8192))) {
+            encode(out);
+        } finally {
+            deflater.end();
+        }
+
+        byte[] compressed = payload.toByteArray();
+        CRC32 crc = new CRC32();
+        crc.update(compressed, 0, compressed.length);
+        ByteArrayOutputStream record = new ByteArrayOutputStream(compressed.length + 8);
+        DataOutputStream out = new DataOutputStream(record);
+        out.writeInt(compressed.length);
+        out.writeInt((int) crc.getValue());
+        out.write(compressed);
+        return record.toByteArray();
+    }
+
+    private void encode(DataOutputStream out) throws IOException {
+        out.writeBoolean(mFull);
+        out.writeInt(mColumns);
+        out.writeInt(mRows);
+        out.writeInt(mCursorRow);
+        out.writeInt(mCursorCol);
+        out.writeInt(mDecSetFlags);
+        for (boolean tabStop : mTabStops) out.writeBoolean(tabStop);
+        out.writeInt(mColors.length);
+        for (int color : mColors) out.writeInt(color);
+        out.writeBoolean(mTitle != null);
+        if (mTitle != null) out.writeUTF(mTitle);
+        out.writeInt(mTranscript.length);
+        for (TerminalRow row : mTranscript) encodeRow(out, row, mColumns);
+        for (TerminalRow row : mScreen) encodeRow(out, row, mColumns);
+    }
+
+    /** Rows deflated in the encoding of snapshot files, which {@link TerminalBuffer} also compacts transcripts with. */
+    static byte[] deflateRows(TerminalRow[] rows, int columns) {
+        ByteArrayOutputStream bytes = new ByteArrayOutputStream(8192);
+        Deflater deflater = new Deflater(Deflater.BEST_SPEED);
+        try (DataOutputStream out = new DataOutputStream(new DeflaterOutputStream(bytes, deflater, 8192))) {
+            for (TerminalRow row : rows) encodeRow(out, row, columns);
+        } catch (IOException e) {
+            throw new IllegalStateException(e); // Not thrown when writing to memory
+        } finally {
+            deflater.end();
+        }
+        return bytes.toByteArray();
+    }
+
+    static TerminalRow[] inflateRows(byte[] data, int count, int columns) {
+        TerminalRow[] rows = new TerminalRow[count];
+        try (DataInputStream in = new DataInputStream(new InflaterInputStream(new ByteArrayInputStream(data)))) {
+            for (int i = 0; i < count; i++) rows[i] = decodeRow(in, columns);
+        } catch (IOException e) {
+            throw new IllegalStateException("Rows deflated by deflateRows() failed to inflate", e);
+        }
+        return rows;
+    }
+
+    /** Rows as flags, text and run-length encoded styles, which mostly repeat along a row. */
+    private static void encodeRow(DataOutputStream out, TerminalRow row, int columns) throws IOException {
+        int flags = (row.mLineWrap ? ROW_LINE_WRAP : 0) | (row.mHasNonOneWidthOrSurrogateChars ? ROW_NON_ONE_WIDTH_OR_SURROGATE_CHARS : 0);
+        out.writeByte(flags);
+        int spaceUsed = row.getSpaceUsed();
+        out.writeShort(spaceUsed);
+        for (int i = 0; i < spaceUsed; i++) out.writeChar(row.mText[i]);
+        long[] styles = row.mStyle;
+        for (int column = 0; column < columns; ) {
+            long style = styles[column];
+            int run = 1;
+            while (column + run < columns && styles[column + run] == style) run++;
+            out.writeShort(run);
+            out.writeLong(style);
+            column += run;
+        }
+    }
+
+    /** The payload of the next record, or null at the end of the file or at a record cut short or damaged. */
+    private static byte[] readRecord(DataInputStream in) throws IOException {
+        try {
+            int length = in.readInt();
+            int checksum = in.readInt();
+            if (length <= 0 || length > MAX_RECORD_BYTES) return null;
+            byte[] payload = new byte[length];
+            in.readFully(payload);
+            CRC32 crc = new CRC32();
+            crc.update(payload, 0, length);
+            return ((int) crc.getValue() == checksum) ? payload : null;
+        } catch (EOFException e) {
+            return null;
+        }
+    }
+
+    private static TerminalSnapshot decode(byte[] record) throws IOException {
+        try (DataInputStream in = new DataInputStream(new InflaterInputStream(new ByteArrayInputStream(record)))) {
+            boolean full = in.readBoolean();
+            int columns = in.readInt();
+            int rows = in.readInt();
+            if (columns < 2 || rows < 2 || columns > Short.MAX_VALUE || rows > Short.MAX_VALUE)
+                throw new IOException("Invalid snapshot size: " + columns + "x" + rows);
+            int cursorRow = in.readInt();
+            int cursorCol = in.readInt();
+            int decSetFlags = in.readInt();
+            boolean[] tabStops = new boolean[columns];
+            for (int i = 0; i < columns; i++) tabStops[i] = in.readBoolean();
+            int[] colors = new int[in.readInt()];
+            if (colors.length != TextStyle.NUM_INDEXED_COLORS) throw new IOException("Invalid color count: " + colors.length);
+            for (int i = 0; i < colors.length; i++) colors[i] = in.readInt();
+            String title = in.readBoolean() ? in.readUTF() : null;
+            int transcriptRows = in.readInt();
+            if (transcriptRows < 0 || transcriptRows > TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MAX)
+                throw new IOException("Invalid transcript rows: " + transcriptRows);
+            TerminalRow[] transcript = new TerminalRow[transcriptRows];
+            for (int i = 0; i < transcriptRows; i++) transcript[i] = decodeRow(in, columns);
+            TerminalRow[] screen = new TerminalRow[rows];
+            for (int i = 0; i < rows; i++) screen[i] = decodeRow(in, columns);
+            return new TerminalSnapshot(full, columns, rows, cursorRow, cursorCol, decSetFlags, tabStops, colors, title, transcript, screen);
+        }
+    }
+
+    private static TerminalRow decodeRow(DataInputStream in, int columns) throws IOException {
+        int flags = in.readUnsignedByte();
+        boolean hasNonOneWidthOrSurrogateChars = (flags & ROW_NON_ONE_WIDTH_OR_SURROGATE_CHARS) != 0;
+        int spaceUsed = in.readShort();
+        if (spaceUsed < 0 || (!hasNonOneWidthOrSurrogateChars && spaceUsed != columns))
+            throw new IOException("Invalid row length: " + spaceUsed);
+        // Leave the spare capacity a new row has, so that the first wide char written does not reallocate
+        char[] text = new char[Math.max(spaceUsed, columns + columns / 2)];
+        for (int i = 0; i < spaceUsed; i++) text[i] = in.readChar();
+        Arrays.fill(text, spaceUsed, text.length, ' ');
+        long[] styles = new long[columns];
+        for (int column = 0; column < columns; ) {
+            int run = in.readShort();
+            if (run <= 0 || column + run > columns) throw new IOException("Invalid style run: " + run);
+            Arrays.fill(styles, column, column + run, in.readLong());
+            column += run;
+        }
+        return new TerminalRow(columns, text, spaceUsed, styles, (flags & ROW_LINE_WRAP) != 0, hasNonOneWidthOrSurrogateChars);
+    }
+
+}
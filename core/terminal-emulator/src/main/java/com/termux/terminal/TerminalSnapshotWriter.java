@@ -0,0 +1,102 @@
+package com.termux.terminal;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.util.concurrent.atomic.AtomicBoolean;
+
+/**
+ * Keeps a {@link TerminalSnapshot} file of one session up to date. Snapshots are taken on the main thread with
+ * {@link #takeSnapshot(TerminalEmulator)}, which only copies the rows to write, and written on one background thread
+ * with {@link #write(TerminalSnapshot)} in the order they were taken.
+ */
+public final class TerminalSnapshotWriter {
+
+    /** Appended records are folded into a new full record once they are larger than this and than the full one. */
+    private static final int MIN_COMPACTION_BYTES = 64 * 1024;
+
+    private final File mFile;
+
+    // Main thread:
+    private TerminalEmulator mEmulator;
+    private long mChangeCount;
+    private long mScrolledRows;
+    private int mTranscriptGeneration;
+
+    /** Set by the writer thread when the file needs to be rewritten from a full snapshot. */
+    private final AtomicBoolean mNeedsFullSnapshot = new AtomicBoolean(true);
+
+    // Writer thread:
+    private long mFullBytes, mAppendedBytes;
+    /** If a write failed, after which appended records would leave a gap in the transcript until a full one. */
+    private boolean mFailed;
+
+    public TerminalSnapshotWriter(File file) {
+        mFile = file;
+    }
+
+    public File getFile() {
+        return mFile;
+    }
+
+    /**
+     * Take the snapshot to write next, which only holds the transcript rows added since the last one unless the
+     * transcript changed otherwise. Must be called on the main thread.
+     *
+     * @return the snapshot, or null if the emulator has not changed since the last one.
+     */
+    public TerminalSnapshot takeSnapshot(TerminalEmulator emulator) {
+        long changeCount = emulator.getChangeCount();
+        if (emulator == mEmulator && changeCount == mChangeCount && !mNeedsFullSnapshot.get()) return null;
+
+        TerminalBuffer buffer = emulator.getMainBuffer();
+        long newRows = buffer.getScrolledRows() - mScrolledRows;
+        boolean full = mNeedsFullSnapshot.getAndSet(false) || emulator != mEmulator
+            || buffer.getTranscriptGeneration() != mTranscriptGeneration || newRows > buffer.getActiveTranscriptRows();
+
+        mEmulator = emulator;
+        mChangeCount = changeCount;
+        mScrolledRows = buffer.getScrolledRows();
+        mTranscriptGeneration = buffer.getTranscriptGeneration();
+        return emulator.takeSnapshot(full, full ? buffer.getActiveTranscriptRows() : (int) newRows);
+    }
+
+    /** Write a snapshot from {@link #takeSnapshot(TerminalEmulator)}. Must be called on one background thread. */
+    public void write(TerminalSnapshot snapshot) throws IOException {
+        if (mFailed && !snapshot.mFull) return;
+        try {
+            byte[] record = snapshot.encodeRecord();
+            if (snapshot.mFull) {
+                File temporaryFile = new File(mFile.getPath() + ".tmp");
+                try (FileOutputStream out = new FileOutputStream(temporaryFile)) {
+                    out.write(TerminalSnapshot.encodeHeader());
+                    out.write(record);
+                }
+                if (!temporaryFile.renameTo(mFile)) throw new IOException("Failed renaming " + temporaryFile + " to " + mFile);
+                mFullBytes = record.length;
+                mAppendedBytes = 0;
+            } else {
+                if (!mFile.exists()) throw new IOException("Snapshot file to append to is gone: " + mFile);
+                try (FileOutputStream out = new FileOutputStream(mFile, true)) {
+                    out.write(record);
+                }
+                mAppendedBytes += record.length;
+                if (mAppendedBytes > Math.max(mFullBytes, MIN_COMPACTION_BYTES)) mNeedsFullSnapshot.set(true);
+            }
+            mFailed = false;
+        } catch (IOException e) {
+            mFailed = true;
+            mNeedsFullSnapshot.set(true);
+            throw e;
+        }
+    }
+
+    /** Delete the snapshot file, for a session which was closed. Must be called on the writer thread. */
+    public void delete() {
+        mFailed = true;
+        mNeedsFullSnapshot.set(true);
+        //noinspection ResultOfMethodCallIgnored
+        mFile.delete();
+    }
+
+}
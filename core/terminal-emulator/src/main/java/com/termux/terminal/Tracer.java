@@ -0,0 +1,282 @@
+package com.termux.terminal;
+
+import java.io.IOException;
+import java.io.Writer;
+import java.util.Map;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.atomic.AtomicLongArray;
+
+/**
+ * Span and counter tracing into a fixed-size ring buffer, exported in the Chrome trace event format
+ * that chrome://tracing and Perfetto open.
+ * <p>
+ * Tracing is off until {@link #setEnabled(boolean)}; while off, {@link #now()} returns 0 and every
+ * recording call returns at once, so call sites cost one volatile read. While on, recording an event
+ * claims a slot with one atomic increment and writes a few array elements without allocating. The
+ * buffer keeps the most recent {@link #DEFAULT_CAPACITY} events; older ones are overwritten.
+ * <p>
+ * A span is recorded when it ends, from the start time returned by {@link #now()}:
+ * <pre>
+ * long start = Tracer.now();
+ * ...
+ * Tracer.complete("emulator.append", start, length);
+ * </pre>
+ * Names should be constants, as they are stored by reference.
+ */
+public final class Tracer {
+
+    public static final int DEFAULT_CAPACITY = 1 << 15;
+
+    private static final byte PHASE_COMPLETE = 0;
+    private static final byte PHASE_ASYNC = 1;
+    private static final byte PHASE_COUNTER = 2;
+
+    private static volatile boolean sEnabled;
+    private static volatile Buffer sBuffer;
+
+    private Tracer() {
+    }
+
+    /** Parallel arrays indexed by slot; a slot's sequence is zero while it is being written. */
+    private static final class Buffer {
+        final int mMask;
+        final AtomicLong mNext = new AtomicLong();
+        final AtomicLongArray mSequence;
+        final String[] mNames;
+        final String[] mDetails;
+        final byte[] mPhases;
+        final long[] mStarts;
+        final long[] mDurations;
+        final long[] mValues;
+        final long[] mThreads;
+
+        Buffer(int capacity) {
+            mMask = capacity - 1;
+            mSequence = new AtomicLongArray(capacity);
+            mNames = new String[capacity];
+            mDetails = new String[capacity];
+            mPhases = new byte[capacity];
+            mStarts = new long[capacity];
+            mDurations = new long[capacity];
+            mValues = new long[capacity];
+            mThreads = new long[capacity];
+        }
+    }
+
+    /** Start or stop recording. The buffer is allocated the first time tracing is enabled. */
+    public static synchronized void setEnabled(boolean enabled) {
+        if (enabled && sBuffer == null) sBuffer = new Buffer(DEFAULT_CAPACITY);
+        sEnabled = enabled;
+    }
+
+    public static boolean isEnabled() {
+        return sEnabled;
+    }
+
+    /** Drop recorded events and record into a new buffer of {@code capacity} events, a power of two. */
+    static synchronized void reset(int capacity) {
+        if (Integer.bitCount(capacity) != 1) throw new IllegalArgumentException("Capacity must be a power of two: " + capacity);
+        sBuffer = new Buffer(capacity);
+    }
+
+    /** Drop recorded events. */
+    public static synchronized void clear() {
+        if (sBuffer != null) sBuffer = new Buffer(sBuffer.mMask + 1);
+    }
+
+    /** Start time for a span, or 0 if tracing is off. */
+    public static long now() {
+        return sEnabled ? System.nanoTime() : 0;
+    }
+
+    /** Record a span on the current thread that started at {@code start}. */
+    public static void complete(String name, long start) {
+        if (start != 0) record(PHASE_COMPLETE, name, null, start, 0);
+    }
+
+    /** Record a span on the current thread with a numeric argument, such as a byte count. */
+    public static void complete(String name, long start, long value) {
+        if (start != 0) record(PHASE_COMPLETE, name, null, start, value);
+    }
+
+    /** Record a span on the current thread with a text argument, such as a tool name. */
+    public static void complete(String name, long start, String detail) {
+        if (start != 0) record(PHASE_COMPLETE, name, detail, start, 0);
+    }
+
+    /**
+     * Record a span that may have moved between threads or overlap others on the same thread, as a
+     * suspended coroutine does. It is shown on its own track.
+     */
+    public static void completeAsync(String name, long start, String detail) {
+        if (start != 0) record(PHASE_ASYNC, name, detail, start, 0);
+    }
+
+    /** Record the current value of counter {@code name}. */
+    public static void counter(String name, long value) {
+        if (sEnabled) record(PHASE_COUNTER, name, null, System.nanoTime(), value);
+    }
+
+    private static void record(byte phase, String name, String detail, long start, long value) {
+        Buffer buffer = sBuffer;
+        if (buffer == null) return;
+        long end = phase == PHASE_COUNTER ? start : System.nanoTime();
+        long sequence = buffer.mNext.getAndIncrement();
+        int slot = (int) (sequence & buffer.mMask);
+        buffer.mSequence.set(slot, 0);
+        buffer.mNames[slot] = name;
+        buffer.mDetails[slot] = detail;
+        buffer.mPhases[slot] = phase;
+        buffer.mStarts[slot] = start;
+        buffer.mDurations[slot] = end - start;
+        buffer.mValues[slot] = value;
+        buffer.mThreads[slot] = Thread.currentThread().getId();
+        buffer.mSequence.lazySet(slot, sequence + 1);
+    }
+
+    /** Number of events currently held in the buffer. */
+    public static int size() {
+        Buffer buffer = sBuffer;
+        if (buffer == null) return 0;
+        return (int) Math.min(buffer.mNext.get(), buffer.mMask + 1);
+    }
+
+    /**
+     * Write the recorded events as a Chrome trace JSON object. Recording may continue meanwhile;
+     * events overwritten while they are being read are left out.
+     *
+     * @param pid the process id to attribute the events to
+     */
+    public static void writeChromeTrace(Writer out, int pid) throws IOException {
+        Buffer buffer = sBuffer;
+        out.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        boolean first = true;
+
+        for (Map.Entry<Thread, StackTraceElement[]> entry : Thread.getAllStackTraces().entrySet()) {
+            Thread thread = entry.getKey();
+            if (!first) out.write(',');
+            first = false;
+            out.write("\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + thread.getId() + ",\"args\":{\"name\":");
+            writeString(out, thread.getName());
+            out.write("}}");
+        }
+
+        if (buffer != null) {
+            long end = buffer.mNext.get();
+            long begin = Math.max(0, end - (buffer.mMask + 1));
+            StringBuilder event = new StringBuilder(128);
+            for (long sequence = begin; sequence < end; sequence++) {
+                int slot = (int) (sequence & buffer.mMask);
+                if (buffer.mSequence.get(slot) != sequence + 1) continue;
+                String name = buffer.mNames[slot];
+                String detail = buffer.mDetails[slot];
+                byte phase = buffer.mPhases[slot];
+                long start = buffer.mStarts[slot];
+                long duration = buffer.mDurations[slot];
+                long value = buffer.mValues[slot];
+                long thread = buffer.mThreads[slot];
+                if (buffer.mSequence.get(slot) != sequence + 1) continue;
+
+                event.setLength(0);
+                switch (phase) {
+                    case PHASE_COMPLETE:
+                        appendEvent(event, name, "X", start, pid, thread);
+                        event.append(",\"dur\":");
+                        appendMicros(event, duration);
+                        appendArgs(event, detail, value);
+                        event.append('}');
+                        break;
+                    case PHASE_ASYNC:
+                        appendEvent(event, name, "b", start, pid, thread);
+                        event.append(",\"cat\":\"async\",\"id\":").append(sequence);
+                        appendArgs(event, detail, value);
+                        event.append("},\n");
+                        appendEvent(event, name, "e", start + duration, pid, thread);
+                        event.append(",\"cat\":\"async\",\"id\":").append(sequence).append('}');
+                        break;
+                    default:
+                        appendEvent(event, name, "C", start, pid, thread);
+                        event.append(",\"args\":{\"value\":").append(value).append("}}");
+                        break;
+                }
+                if (!first) out.write(',');
+                first = false;
+                out.write('\n');
+                out.append(event);
+            }
+        }
+        out.write("\n]}\n");
+        out.flush();
+    }
+
+    private static void appendEvent(StringBuilder event, String name, String phase, long nanos, int pid, long thread) {
+        event.append("{\"name\":");
+        appendString(event, name);
+        event.append(",\"ph\":\"").append(phase).append("\",\"ts\":");
+        appendMicros(event, nanos);
+        event.append(",\"pid\":").append(pid).append(",\"tid\":").append(thread);
+    }
+
+    private static void appendArgs(StringBuilder event, String detail, long value) {
+        if (detail == null && value == 0) return;
+        event.append(",\"args\":{");
+        if (detail != null) {
+            event.append("\"detail\":");
+            appendString(event, detail);
+            if (value != 0) event.append(',');
+        }
+        if (value != 0) event.append("\"value\":").append(value);
+        event.append('}');
+    }
+
+    /** Chrome traces are in microseconds; keep the nanosecond part as a fraction. */
+    private static void appendMicros(StringBuilder event, long nanos) {
+        if (nanos < 0) {
+            event.append('-');
+            nanos = -nanos;
+        }
+        event.append(nanos / 1000).append('.');
+        long fraction = nanos % 1000;
+        if (fraction < 100) event.append('0');
+        if (fraction < 10) event.append('0');
+        event.append(fraction);
+    }
+
+    private static void writeString(Writer out, String value) throws IOException {
+        StringBuilder builder = new StringBuilder(value.length() + 2);
+        appendString(builder, value);
+        out.append(builder);
+    }
+
+    private static void appendString(StringBuilder builder, String value) {
+        builder.append('"');
+        for (int i = 0; i < value.length(); i++) {
+            char c = value.charAt(i);
+            switch (c) {
+                case '"':
+                    builder.append("\\\"");
+                    break;
+                case '\\':
+                    builder.append("\\\\");
+                    break;
+                case '\n':
+                    builder.append("\\n");
+                    break;
+                case '\r':
+                    builder.append("\\r");
+                    break;
+                case '\t':
+                    builder.append("\\t");
+                    break;
+                default:
+                    if (c < 0x20) {
+                        builder.append(String.format("\\u%04x", (int) c));
+                    } else {
+                        builder.append(c);
+                    }
+            }
+        }
+        builder.append('"');
+    }
+
+}
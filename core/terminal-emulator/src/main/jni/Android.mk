@@ -1,5 +1,5 @@
 LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 LOCAL_MODULE:= libtermux
-LOCAL_SRC_FILES:= termux.c
+LOCAL_SRC_FILES:= termux.c pty_spawn.c clone.c search.c pty_io.c pty_record.c
 include $(BUILD_SHARED_LIBRARY)
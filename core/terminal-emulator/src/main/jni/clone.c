@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <jni.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <linux/fs.h>
+#endif
+
+#define TERMUX_UNUSED(x) x __attribute__((__unused__))
+#define COPY_BUFFER_SIZE (128 * 1024)
+
+/**
+ * State shared by one clone_tree() walk. Every regular file gets its own inode in the clone, so writing a file in place
+ * never reaches the source. A reflink is tried first, sharing the data blocks until either side writes; once the
+ * filesystem refuses one the rest of the walk copies bytes.
+ */
+struct clone_state {
+    char path[PATH_MAX];
+    char const* const* skip_paths;
+    int skip_path_count;
+    bool reflinks_allowed;
+    long reflinked;
+    long copied;
+    char* buffer;
+};
+
+static void throw_io_exception(JNIEnv* env, char const* what, char const* path, int error)
+{
+    char message[PATH_MAX + 128];
+    snprintf(message, sizeof(message), "%s(\"%s\"): %s", what, path, strerror(error));
+    jclass exClass = (*env)->FindClass(env, "java/io/IOException");
+    (*env)->ThrowNew(env, exClass, message);
+}
+
+/** Whether the relative path (or one of its parents) was listed as a tree whose files are left out of the clone. */
+static bool is_skip_path(struct clone_state const* state)
+{
+    for (int i = 0; i < state->skip_path_count; i++) {
+        char const* prefix = state->skip_paths[i];
+        size_t len = strlen(prefix);
+        if (strncmp(state->path, prefix, len) == 0 && (state->path[len] == '\0' || state->path[len] == '/')) return true;
+    }
+    return false;
+}
+
+static int copy_file(struct clone_state* state, int src_dir, int dst_dir, char const* name, struct stat const* st)
+{
+    int in = openat(src_dir, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (in < 0) return errno;
+    int out = openat(dst_dir, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st->st_mode & 07777);
+    if (out < 0) {
+        int error = errno;
+        close(in);
+        return error;
+    }
+
+    int result = 0;
+#ifdef FICLONE
+    if (state->reflinks_allowed) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            state->reflinked++;
+            goto done;
+        }
+        state->reflinks_allowed = false;
+    }
+#endif
+    state->copied++;
+    for (;;) {
+        ssize_t n = read(in, state->buffer, COPY_BUFFER_SIZE);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            result = errno;
+            break;
+        }
+        for (ssize_t written = 0; written < n;) {
+            ssize_t w = write(out, state->buffer + written, (size_t) (n - written));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                result = errno;
+                goto done;
+            }
+            written += w;
+        }
+    }
+done:
+    close(in);
+    if (close(out) != 0 && result == 0) result = errno;
+    return result;
+}
+
+static int clone_dir(struct clone_state* state, int src_dir, int dst_dir, bool skip_files)
+{
+    int src_fd = dup(src_dir);
+    if (src_fd < 0) return errno;
+    DIR* dir = fdopendir(src_fd);
+    if (dir == NULL) {
+        int error = errno;
+        close(src_fd);
+        return error;
+    }
+
+    size_t path_len = strlen(state->path);
+    int result = 0;
+    struct dirent* entry;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        char const* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        if (path_len + strlen(name) + 2 >= sizeof(state->path)) {
+            result = ENAMETOOLONG;
+            break;
+        }
+        snprintf(state->path + path_len, sizeof(state->path) - path_len, "%s%s", path_len ? "/" : "", name);
+
+        struct stat st;
+        if (fstatat(src_dir, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            result = errno;
+            break;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (mkdirat(dst_dir, name, (st.st_mode & 07777) | S_IRWXU) != 0 && errno != EEXIST) {
+                result = errno;
+                break;
+            }
+            int child_src = openat(src_dir, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            int child_dst = openat(dst_dir, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (child_src < 0 || child_dst < 0) {
+                result = errno;
+            } else {
+                // mkdirat() applies the umask, which would drop modes such as the 1777 of /tmp
+                fchmod(child_dst, (st.st_mode & 07777) | S_IRWXU);
+                result = clone_dir(state, child_src, child_dst, skip_files || is_skip_path(state));
+            }
+            if (child_src >= 0) close(child_src);
+            if (child_dst >= 0) close(child_dst);
+        } else if (S_ISLNK(st.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t len = readlinkat(src_dir, name, target, sizeof(target) - 1);
+            if (len < 0) {
+                result = errno;
+                break;
+            }
+            target[len] = '\0';
+            if (symlinkat(target, dst_dir, name) != 0 && errno != EEXIST) result = errno;
+        } else if (S_ISREG(st.st_mode)) {
+            if (skip_files) continue;
+            // Never a hard link: a shared inode would carry in-place writes, truncation, chmod and chown to the source
+            result = copy_file(state, src_dir, dst_dir, name, &st);
+            if (result == EEXIST) result = 0;
+        } else if (S_ISFIFO(st.st_mode)) {
+            if (mkfifoat(dst_dir, name, st.st_mode & 07777) != 0 && errno != EEXIST) result = errno;
+        }
+        // Sockets and device nodes are not cloned: proot binds /dev from the host anyway.
+    }
+
+    // On failure the path is left pointing at the offending entry so the caller can report it.
+    if (result == 0) state->path[path_len] = '\0';
+    closedir(dir);
+    return result;
+}
+
+JNIEXPORT jlongArray JNICALL Java_com_termux_terminal_FileTreeCloner_cloneTree(
+        JNIEnv* env,
+        jclass TERMUX_UNUSED(clazz),
+        jstring source,
+        jstring target,
+        jobjectArray skipPaths)
+{
+    struct clone_state state = { .path = "", .reflinks_allowed = true, .reflinked = 0, .copied = 0 };
+
+    jsize count = skipPaths ? (*env)->GetArrayLength(env, skipPaths) : 0;
+    char** skip = count > 0 ? (char**) calloc((size_t) count, sizeof(char*)) : NULL;
+    for (int i = 0; skip != NULL && i < count; i++) {
+        jstring path_java_string = (jstring) (*env)->GetObjectArrayElement(env, skipPaths, i);
+        char const* path_utf8 = (*env)->GetStringUTFChars(env, path_java_string, NULL);
+        skip[i] = strdup(path_utf8);
+        (*env)->ReleaseStringUTFChars(env, path_java_string, path_utf8);
+        (*env)->DeleteLocalRef(env, path_java_string);
+    }
+    state.skip_paths = (char const* const*) skip;
+    state.skip_path_count = count;
+    state.buffer = malloc(COPY_BUFFER_SIZE);
+
+    char const* source_utf8 = (*env)->GetStringUTFChars(env, source, NULL);
+    char const* target_utf8 = (*env)->GetStringUTFChars(env, target, NULL);
+
+    int result = 0;
+    int src_dir = -1;
+    bool allocated = state.buffer != NULL && (count == 0 || skip != NULL);
+    for (int i = 0; allocated && i < count; i++) allocated = skip[i] != NULL;
+    if (!allocated) {
+        throw_io_exception(env, "malloc", target_utf8, ENOMEM);
+        result = -1;
+    } else if ((src_dir = open(source_utf8, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+        throw_io_exception(env, "open", source_utf8, errno);
+        result = -1;
+    } else if (mkdir(target_utf8, 0700) != 0 && errno != EEXIST) {
+        throw_io_exception(env, "mkdir", target_utf8, errno);
+        result = -1;
+    } else {
+        int dst_dir = open(target_utf8, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dst_dir < 0) {
+            throw_io_exception(env, "open", target_utf8, errno);
+            result = -1;
+        } else {
+            result = clone_dir(&state, src_dir, dst_dir, false);
+            if (result != 0) throw_io_exception(env, "clone", state.path, result);
+            close(dst_dir);
+        }
+    }
+    if (src_dir >= 0) close(src_dir);
+
+    (*env)->ReleaseStringUTFChars(env, source, source_utf8);
+    (*env)->ReleaseStringUTFChars(env, target, target_utf8);
+    for (int i = 0; skip != NULL && i < count; i++) free(skip[i]);
+    free(skip);
+    free(state.buffer);
+
+    if (result != 0) return NULL;
+    jlongArray stats = (*env)->NewLongArray(env, 2);
+    jlong values[2] = { state.reflinked, state.copied };
+    (*env)->SetLongArrayRegion(env, stats, 0, 2, values);
+    return stats;
+}
+
+static int remove_dir_contents(int dir_fd)
+{
+    int fd = dup(dir_fd);
+    if (fd < 0) return errno;
+    DIR* dir = fdopendir(fd);
+    if (dir == NULL) {
+        int error = errno;
+        close(fd);
+        return error;
+    }
+
+    int result = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char const* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        if (unlinkat(dir_fd, name, 0) == 0) continue;
+        if (errno != EISDIR && errno != EPERM) {
+            if (errno != ENOENT && result == 0) result = errno;
+            continue;
+        }
+        // Directories copied from a read-only tree keep their mode, so make them writable before emptying them.
+        fchmodat(dir_fd, name, S_IRWXU, 0);
+        int child = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        if (child < 0) {
+            if (result == 0) result = errno;
+            continue;
+        }
+        int child_result = remove_dir_contents(child);
+        close(child);
+        if (child_result != 0 && result == 0) result = child_result;
+        if (unlinkat(dir_fd, name, AT_REMOVEDIR) != 0 && result == 0) result = errno;
+    }
+    closedir(dir);
+    return result;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_FileTreeCloner_removeTree(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jstring path)
+{
+    char const* path_utf8 = (*env)->GetStringUTFChars(env, path, NULL);
+    int dir_fd = open(path_utf8, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+    if (dir_fd < 0) {
+        if (errno != ENOENT) throw_io_exception(env, "open", path_utf8, errno);
+    } else {
+        chmod(path_utf8, S_IRWXU);
+        int result = remove_dir_contents(dir_fd);
+        close(dir_fd);
+        if (result != 0) {
+            throw_io_exception(env, "remove", path_utf8, result);
+        } else if (rmdir(path_utf8) != 0) {
+            throw_io_exception(env, "rmdir", path_utf8, errno);
+        }
+    }
+    (*env)->ReleaseStringUTFChars(env, path, path_utf8);
+}
@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <jni.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pty_record.h"
+
+#define TERMUX_UNUSED(x) x __attribute__((__unused__))
+// Same size as the Java side's buffers, so one read() never has to be split
+#define READ_CHUNK 4096
+
+// Log-linear histogram buckets as in HdrHistogram: values below 2^SUB_BUCKET_BITS each get a bucket, above that every
+// power of two is split in 2^SUB_BUCKET_BITS buckets, so a bucket is at most 12.5% wide. Values are microseconds and
+// are clamped to 2^32 - 1 (about 71 minutes). Must match TerminalSessionStats.java.
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+/**
+ * Counters of one session, kept in a direct ByteBuffer owned by the Java TerminalSession so that its lifetime follows
+ * the session without explicit freeing. The reader thread, the writer thread and the main thread update it
+ * concurrently, so every field is atomic. The layout of the first fields is the layout of the snapshot.
+ */
+struct pty_stats {
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    atomic_uint_fast64_t reads;
+    atomic_uint_fast64_t writes;
+    // CLOCK_MONOTONIC time of the oldest read whose bytes have not yet been appended, or drawn; 0 if there is none
+    atomic_int_fast64_t pending_append_ns;
+    atomic_int_fast64_t pending_frame_ns;
+    atomic_uint_fast64_t read_to_append[HISTOGRAM_BUCKETS];
+    atomic_uint_fast64_t read_to_frame[HISTOGRAM_BUCKETS];
+    // The recording of the output, if any, and the number of threads using it, which must be none when it is closed
+    _Atomic(struct pty_record*) record;
+    atomic_int record_users;
+};
+
+#define SNAPSHOT_COUNTERS 4
+#define SNAPSHOT_LENGTH (SNAPSHOT_COUNTERS + 2 * HISTOGRAM_BUCKETS)
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int histogram_bucket(uint64_t micros)
+{
+    if (micros > UINT32_MAX) micros = UINT32_MAX;
+    if (micros < SUB_BUCKETS) return (int) micros;
+    int magnitude = 63 - __builtin_clzll(micros);
+    int shift = magnitude - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int) ((micros >> shift) - SUB_BUCKETS);
+}
+
+static void histogram_record(atomic_uint_fast64_t* histogram, int64_t nanos)
+{
+    if (nanos < 0) nanos = 0;
+    atomic_fetch_add_explicit(&histogram[histogram_bucket((uint64_t) nanos / 1000)], 1, memory_order_relaxed);
+}
+
+static struct pty_stats* get_stats(JNIEnv* env, jobject buffer)
+{
+    if (buffer == NULL) return NULL;
+    if ((*env)->GetDirectBufferCapacity(env, buffer) < (jlong) sizeof(struct pty_stats)) return NULL;
+    return (struct pty_stats*) (*env)->GetDirectBufferAddress(env, buffer);
+}
+
+/** Replace the recording of a session, waiting until no thread uses the one replaced, which is returned. */
+static struct pty_record* swap_record(struct pty_stats* stats, struct pty_record* record)
+{
+    struct pty_record* previous = atomic_exchange(&stats->record, record);
+    // A thread which took the previous recording before the exchange only copies into its ring, so this is short
+    while (atomic_load(&stats->record_users) != 0) sched_yield();
+    return previous;
+}
+
+static void throw_io_exception(JNIEnv* env, char const* message)
+{
+    jclass exClass = (*env)->FindClass(env, "java/io/IOException");
+    (*env)->ThrowNew(env, exClass, message);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_statsSize(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz))
+{
+    return (jint) sizeof(struct pty_stats);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_read(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint fd, jbyteArray buffer, jobject statsBuffer)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    jsize length = (*env)->GetArrayLength(env, buffer);
+    char chunk[READ_CHUNK];
+    if (length > READ_CHUNK) length = READ_CHUNK;
+
+    ssize_t count;
+    do {
+        count = read(fd, chunk, (size_t) length);
+    } while (count < 0 && errno == EINTR);
+    // The master side reports EIO once the last slave descriptor is closed, which is the end of output
+    if (count <= 0) return -1;
+
+    (*env)->SetByteArrayRegion(env, buffer, 0, (jsize) count, (jbyte const*) chunk);
+    if (stats) {
+        // The recording is a tee of the same chunk, handed to its writer thread without going through Java
+        atomic_fetch_add(&stats->record_users, 1);
+        struct pty_record* record = atomic_load(&stats->record);
+        if (record) pty_record_output(record, chunk, (size_t) count);
+        atomic_fetch_sub(&stats->record_users, 1);
+
+        atomic_fetch_add_explicit(&stats->bytes_in, (uint_fast64_t) count, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->reads, 1, memory_order_relaxed);
+        int_fast64_t none = 0;
+        atomic_compare_exchange_strong(&stats->pending_append_ns, &none, monotonic_ns());
+    }
+    return (jint) count;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_write(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint fd, jbyteArray buffer, jint offset, jint count, jobject statsBuffer)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    char chunk[READ_CHUNK];
+    while (count > 0) {
+        jint run = count < READ_CHUNK ? count : READ_CHUNK;
+        (*env)->GetByteArrayRegion(env, buffer, offset, run, (jbyte*) chunk);
+        if ((*env)->ExceptionCheck(env)) return;
+        jint written = 0;
+        while (written < run) {
+            ssize_t result = write(fd, chunk + written, (size_t) (run - written));
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                throw_io_exception(env, strerror(errno));
+                return;
+            }
+            written += (jint) result;
+            if (stats) atomic_fetch_add_explicit(&stats->writes, 1, memory_order_relaxed);
+        }
+        if (stats) atomic_fetch_add_explicit(&stats->bytes_out, (uint_fast64_t) run, memory_order_relaxed);
+        offset += run;
+        count -= run;
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_markAppended(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats) return;
+    int_fast64_t read_ns = atomic_exchange(&stats->pending_append_ns, 0);
+    if (read_ns == 0) return;
+    histogram_record(stats->read_to_append, monotonic_ns() - read_ns);
+    // The frame latency is measured from the same read, unless an earlier read is still waiting to be drawn
+    int_fast64_t none = 0;
+    atomic_compare_exchange_strong(&stats->pending_frame_ns, &none, read_ns);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_markFrameDrawn(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats) return;
+    int_fast64_t read_ns = atomic_exchange(&stats->pending_frame_ns, 0);
+    if (read_ns != 0) histogram_record(stats->read_to_frame, monotonic_ns() - read_ns);
+}
+
+JNIEXPORT jboolean JNICALL Java_com_termux_terminal_JNI_snapshotStats(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer, jlongArray out)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats || (*env)->GetArrayLength(env, out) < SNAPSHOT_LENGTH) return JNI_FALSE;
+
+    jlong values[SNAPSHOT_LENGTH];
+    values[0] = (jlong) atomic_load_explicit(&stats->bytes_in, memory_order_relaxed);
+    values[1] = (jlong) atomic_load_explicit(&stats->bytes_out, memory_order_relaxed);
+    values[2] = (jlong) atomic_load_explicit(&stats->reads, memory_order_relaxed);
+    values[3] = (jlong) atomic_load_explicit(&stats->writes, memory_order_relaxed);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        values[SNAPSHOT_COUNTERS + i] = (jlong) atomic_load_explicit(&stats->read_to_append[i], memory_order_relaxed);
+        values[SNAPSHOT_COUNTERS + HISTOGRAM_BUCKETS + i] = (jlong) atomic_load_explicit(&stats->read_to_frame[i], memory_order_relaxed);
+    }
+    (*env)->SetLongArrayRegion(env, out, 0, SNAPSHOT_LENGTH, values);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_startRecording(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer, jstring path, jint columns, jint rows)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats) {
+        throw_io_exception(env, "Invalid stats buffer");
+        return;
+    }
+    char const* path_utf8 = (*env)->GetStringUTFChars(env, path, NULL);
+    if (!path_utf8) return;
+    char const* error = NULL;
+    struct pty_record* record = pty_record_open(path_utf8, columns, rows, &error);
+    int saved_errno = errno;
+    (*env)->ReleaseStringUTFChars(env, path, path_utf8);
+    if (!record) {
+        char message[256];
+        snprintf(message, sizeof(message), "%s failed: %s", error, strerror(saved_errno));
+        throw_io_exception(env, message);
+        return;
+    }
+    struct pty_record* previous = swap_record(stats, record);
+    if (previous) pty_record_close(previous);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_recordResize(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer, jint columns, jint rows)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats) return;
+    atomic_fetch_add(&stats->record_users, 1);
+    struct pty_record* record = atomic_load(&stats->record);
+    if (record) pty_record_resize(record, columns, rows);
+    atomic_fetch_sub(&stats->record_users, 1);
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_JNI_stopRecording(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jobject statsBuffer)
+{
+    struct pty_stats* stats = get_stats(env, statsBuffer);
+    if (!stats) return -1;
+    struct pty_record* record = swap_record(stats, NULL);
+    return record ? (jlong) pty_record_close(record) : -1;
+}
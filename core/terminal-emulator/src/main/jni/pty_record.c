@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pty_record.h"
+
+// Output waiting to be written. Once the writer is this far behind, new output is dropped instead of waited for.
+#define RING_BYTES (1 << 20)
+// Longest event; longer output is split. Same size as a read of the session, so that is never split.
+#define MAX_EVENT_BYTES 4096
+// Formatted events are written in blocks of this size, or when the writer runs out of events
+#define OUT_BYTES (64 * 1024)
+// The longest expansion of one byte of output in JSON, \u00XX
+#define MAX_ESCAPED_BYTES 6
+
+enum event_type { EVENT_OUTPUT = 'o', EVENT_RESIZE = 'r' };
+
+struct event_header {
+    int64_t time_ns;
+    uint32_t length;
+    uint32_t type;
+};
+
+struct pty_record {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    int fd;
+    int64_t start_ns;
+
+    // Guarded by lock: events as a header followed by its payload. Positions only grow, the ring index is modulo.
+    uint64_t head;
+    uint64_t tail;
+    bool closing;
+    uint64_t dropped_bytes;
+    char ring[RING_BYTES];
+
+    // Writer thread only:
+    bool failed;
+    size_t out_length;
+    char out[OUT_BYTES];
+    // The start of a UTF-8 sequence which the next output event completes
+    size_t partial_length;
+    unsigned char partial[3];
+};
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void ring_put(struct pty_record* record, void const* data, size_t length)
+{
+    size_t start = (size_t) (record->head % RING_BYTES);
+    size_t first = RING_BYTES - start < length ? RING_BYTES - start : length;
+    memcpy(record->ring + start, data, first);
+    memcpy(record->ring, (char const*) data + first, length - first);
+    record->head += length;
+}
+
+static void ring_get(struct pty_record* record, void* data, size_t length)
+{
+    size_t start = (size_t) (record->tail % RING_BYTES);
+    size_t first = RING_BYTES - start < length ? RING_BYTES - start : length;
+    memcpy(data, record->ring + start, first);
+    memcpy((char*) data + first, record->ring, length - first);
+    record->tail += length;
+}
+
+static void push_event(struct pty_record* record, enum event_type type, int64_t time_ns, char const* data, size_t length)
+{
+    struct event_header header = { time_ns, (uint32_t) length, (uint32_t) type };
+    pthread_mutex_lock(&record->lock);
+    if (RING_BYTES - (record->head - record->tail) < sizeof(header) + length) {
+        record->dropped_bytes += length;
+    } else {
+        // The writer only sleeps on an empty ring
+        bool was_empty = record->head == record->tail;
+        ring_put(record, &header, sizeof(header));
+        ring_put(record, data, length);
+        if (was_empty) pthread_cond_signal(&record->wake);
+    }
+    pthread_mutex_unlock(&record->lock);
+}
+
+static void out_flush(struct pty_record* record)
+{
+    size_t written = 0;
+    while (!record->failed && written < record->out_length) {
+        ssize_t result = write(record->fd, record->out + written, record->out_length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            // Keep draining the ring so the reader never notices, but write nothing more
+            record->failed = true;
+        } else {
+            written += (size_t) result;
+        }
+    }
+    record->out_length = 0;
+}
+
+static void out_reserve(struct pty_record* record, size_t length)
+{
+    if (record->out_length + length > OUT_BYTES) out_flush(record);
+}
+
+static void out_append(struct pty_record* record, char const* data, size_t length)
+{
+    out_reserve(record, length);
+    memcpy(record->out + record->out_length, data, length);
+    record->out_length += length;
+}
+
+/** Length of the valid UTF-8 sequence at s, 0 if it is invalid or -1 if it is valid but cut short. */
+static int utf8_sequence_length(unsigned char const* s, size_t available)
+{
+    unsigned char c = s[0];
+    unsigned char min = 0x80, max = 0xBF;
+    int length;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        // No overlong forms and no surrogates
+        if (c == 0xE0) min = 0xA0;
+        else if (c == 0xED) max = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        // No overlong forms and nothing above U+10FFFF
+        if (c == 0xF0) min = 0x90;
+        else if (c == 0xF4) max = 0x8F;
+    } else {
+        return 0;
+    }
+    for (int i = 1; i < length; i++) {
+        if ((size_t) i >= available) return -1;
+        if (s[i] < min || s[i] > max) return 0;
+        min = 0x80;
+        max = 0xBF;
+    }
+    return length;
+}
+
+/**
+ * Append output as the contents of a JSON string. Invalid UTF-8 becomes U+FFFD as asciicast data must be text, and a
+ * sequence cut at the end is kept for the next output event since reads split characters anywhere.
+ */
+static void out_append_json_text(struct pty_record* record, unsigned char const* data, size_t length)
+{
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = data[i];
+        out_reserve(record, MAX_ESCAPED_BYTES);
+        char* out = record->out + record->out_length;
+        if (c >= 0x80) {
+            int sequence = utf8_sequence_length(data + i, length - i);
+            if (sequence < 0) {
+                record->partial_length = length - i;
+                memcpy(record->partial, data + i, record->partial_length);
+                return;
+            } else if (sequence == 0) {
+                memcpy(out, "\\ufffd", 6);
+                record->out_length += 6;
+                i++;
+            } else {
+                memcpy(out, data + i, (size_t) sequence);
+                record->out_length += (size_t) sequence;
+                i += (size_t) sequence;
+            }
+            continue;
+        }
+
+        size_t escaped;
+        switch (c) {
+            case '"': escaped = 2; memcpy(out, "\\\"", 2); break;
+            case '\\': escaped = 2; memcpy(out, "\\\\", 2); break;
+            case '\n': escaped = 2; memcpy(out, "\\n", 2); break;
+            case '\r': escaped = 2; memcpy(out, "\\r", 2); break;
+            case '\t': escaped = 2; memcpy(out, "\\t", 2); break;
+            case '\b': escaped = 2; memcpy(out, "\\b", 2); break;
+            case '\f': escaped = 2; memcpy(out, "\\f", 2); break;
+            default:
+                if (c < 0x20) {
+                    static char const hex[] = "0123456789abcdef";
+                    memcpy(out, "\\u00", 4);
+                    out[4] = hex[c >> 4];
+                    out[5] = hex[c & 0xF];
+                    escaped = 6;
+                } else {
+                    out[0] = (char) c;
+                    escaped = 1;
+                }
+                break;
+        }
+        record->out_length += escaped;
+        i++;
+    }
+}
+
+static void format_event(struct pty_record* record, struct event_header const* header, unsigned char* payload)
+{
+    char prefix[64];
+    double seconds = (double) (header->time_ns - record->start_ns) / 1e9;
+    int prefix_length = snprintf(prefix, sizeof(prefix), "[%.6f, \"%c\", \"", seconds < 0 ? 0 : seconds, (char) header->type);
+    out_append(record, prefix, (size_t) prefix_length);
+
+    unsigned char* text = payload;
+    size_t text_length = header->length;
+    if (header->type == EVENT_OUTPUT && record->partial_length > 0) {
+        // The payload buffer has room in front for the partial sequence
+        text -= record->partial_length;
+        memcpy(text, record->partial, record->partial_length);
+        text_length += record->partial_length;
+        record->partial_length = 0;
+    }
+    out_append_json_text(record, text, text_length);
+    out_append(record, "\"]\n", 3);
+}
+
+static void* writer_thread(void* arg)
+{
+    struct pty_record* record = arg;
+    unsigned char buffer[sizeof(((struct pty_record*) 0)->partial) + MAX_EVENT_BYTES];
+    unsigned char* payload = buffer + sizeof(record->partial);
+
+    pthread_mutex_lock(&record->lock);
+    while (true) {
+        if (record->head == record->tail && !record->closing) {
+            // Out of events: write what is formatted, so the file is never far behind the session, then sleep
+            pthread_mutex_unlock(&record->lock);
+            out_flush(record);
+            pthread_mutex_lock(&record->lock);
+            while (record->head == record->tail && !record->closing)
+                pthread_cond_wait(&record->wake, &record->lock);
+        }
+        if (record->head == record->tail) break;
+
+        struct event_header header;
+        ring_get(record, &header, sizeof(header));
+        ring_get(record, payload, header.length);
+        pthread_mutex_unlock(&record->lock);
+        format_event(record, &header, payload);
+        pthread_mutex_lock(&record->lock);
+    }
+    pthread_mutex_unlock(&record->lock);
+
+    out_flush(record);
+    close(record->fd);
+    pthread_cond_destroy(&record->wake);
+    pthread_mutex_destroy(&record->lock);
+    free(record);
+    return NULL;
+}
+
+struct pty_record* pty_record_open(char const* path, int columns, int rows, char const** error)
+{
+    struct pty_record* record = calloc(1, sizeof(struct pty_record));
+    if (record == NULL) {
+        *error = "calloc()";
+        return NULL;
+    }
+    record->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (record->fd < 0) {
+        *error = "open()";
+        free(record);
+        return NULL;
+    }
+    record->start_ns = monotonic_ns();
+    pthread_mutex_init(&record->lock, NULL);
+    pthread_cond_init(&record->wake, NULL);
+
+    // Written by the thread with the first events
+    record->out_length = (size_t) snprintf(record->out, OUT_BYTES,
+            "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %lld, \"env\": {\"TERM\": \"xterm-256color\"}}\n",
+            columns, rows, (long long) time(NULL));
+
+    int result = pthread_create(&record->thread, NULL, writer_thread, record);
+    if (result != 0) {
+        int saved_errno = result;
+        close(record->fd);
+        unlink(path);
+        pthread_cond_destroy(&record->wake);
+        pthread_mutex_destroy(&record->lock);
+        free(record);
+        errno = saved_errno;
+        *error = "pthread_create()";
+        return NULL;
+    }
+    pthread_detach(record->thread);
+    return record;
+}
+
+void pty_record_output(struct pty_record* record, char const* data, size_t length)
+{
+    int64_t now = monotonic_ns();
+    while (length > 0) {
+        size_t run = length < MAX_EVENT_BYTES ? length : MAX_EVENT_BYTES;
+        push_event(record, EVENT_OUTPUT, now, data, run);
+        data += run;
+        length -= run;
+    }
+}
+
+void pty_record_resize(struct pty_record* record, int columns, int rows)
+{
+    char size[32];
+    int length = snprintf(size, sizeof(size), "%dx%d", columns, rows);
+    push_event(record, EVENT_RESIZE, monotonic_ns(), size, (size_t) length);
+}
+
+uint64_t pty_record_close(struct pty_record* record)
+{
+    pthread_mutex_lock(&record->lock);
+    record->closing = true;
+    uint64_t dropped = record->dropped_bytes;
+    pthread_cond_signal(&record->wake);
+    pthread_mutex_unlock(&record->lock);
+    return dropped;
+}
@@ -0,0 +1,36 @@
+#ifndef TERMUX_PTY_RECORD_H
+#define TERMUX_PTY_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A recording of the output of a pseudoterminal as an asciicast v2 file, which asciinema and other players replay.
+ * The reader thread hands over its buffer with pty_record_output(), which only copies it into a ring buffer; a thread
+ * of the recording formats and writes the events, so a slow disk makes the recording drop output rather than stall
+ * the reader. Does not depend on JNI so that tools outside the app can record the same way.
+ */
+struct pty_record;
+
+/**
+ * Create the file at path and start a recording of a terminal of the given size.
+ *
+ * Returns the recording, or NULL and points *error at a static description of what failed, with errno set.
+ */
+struct pty_record* pty_record_open(char const* path, int columns, int rows, char const** error);
+
+/** Record output read from the pseudoterminal now. Called by one reader thread at a time. */
+void pty_record_output(struct pty_record* record, char const* data, size_t length);
+
+/** Record that the terminal was resized. */
+void pty_record_resize(struct pty_record* record, int columns, int rows);
+
+/**
+ * Stop recording. Output recorded so far is written and the file closed by the thread of the recording, which frees
+ * it, so this does not wait for the disk. No other call may use the recording any more.
+ *
+ * Returns the number of bytes of output which were dropped because the disk could not keep up.
+ */
+uint64_t pty_record_close(struct pty_record* record);
+
+#endif
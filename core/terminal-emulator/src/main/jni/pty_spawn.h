@@ -0,0 +1,22 @@
+#ifndef TERMUX_PTY_SPAWN_H
+#define TERMUX_PTY_SPAWN_H
+
+/**
+ * Open a pseudoterminal of the given size and run cmd in a new session with the pseudoterminal as its controlling
+ * terminal and standard streams. Does not depend on JNI so that tools outside the app can spawn the same way.
+ *
+ * Returns the master file descriptor and stores the process id of the child in *pProcessId, or returns -1 and points
+ * *error at a static description of what failed.
+ */
+int pty_spawn(char const* cmd,
+        char const* cwd,
+        char* const argv[],
+        char** envp,
+        int* pProcessId,
+        int rows,
+        int columns,
+        int cell_width,
+        int cell_height,
+        char const** error);
+
+#endif
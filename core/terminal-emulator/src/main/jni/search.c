@@ -0,0 +1,442 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <jni.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TERMUX_UNUSED(x) x __attribute__((__unused__))
+#define MAX_SEARCH_THREADS 8
+// Like grep, a NUL byte near the start of a file marks it as binary
+#define BINARY_PROBE_SIZE 8192
+// Files are read in pieces of this size, grown only for longer lines
+#define READ_BUFFER_SIZE (256 * 1024)
+
+/** A line containing the needle, queued by a worker until the JNI thread hands it to Java. */
+struct line_match {
+    struct line_match* next;
+    int file;
+    int line_number;
+    size_t length;
+    char line[];
+};
+
+/**
+ * State shared by the workers of one search. Workers take files by index from next_file, so a large file only
+ * occupies one thread while the others continue with the rest.
+ */
+struct search_job {
+    char** paths;
+    int path_count;
+    unsigned char const* needle;
+    size_t needle_length;
+    bool ignore_case;
+    // Offset in the needle of the byte that is scanned for, see rare_byte_offset()
+    size_t rare_offset;
+    int max_lines;
+
+    atomic_int next_file;
+    atomic_int line_count;
+    atomic_bool stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    struct line_match* head;
+    struct line_match* tail;
+    int running;
+};
+
+static unsigned char to_lower(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char) (c + 'a' - 'A') : c;
+}
+
+/**
+ * Rough frequency rank of a byte in source code, lower is rarer. Scanning for the rarest byte of the needle keeps
+ * memchr() in its fast path and leaves few candidates to verify.
+ */
+static int byte_frequency(unsigned char c)
+{
+    if (c == ' ' || c == 'e' || c == 't' || c == 'a' || c == 'o' || c == 'i' || c == 'n' || c == 's' || c == 'r') return 6;
+    if (c >= 'a' && c <= 'z') return 5;
+    if (c == '\t' || c == '(' || c == ')' || c == '.' || c == ',' || c == ';' || c == '_' || c == '=') return 4;
+    if (c >= 'A' && c <= 'Z') return 3;
+    if (c >= '0' && c <= '9') return 2;
+    if (c < 0x80) return 1;
+    return 0;
+}
+
+static size_t rare_byte_offset(unsigned char const* needle, size_t length)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < length; i++) {
+        if (byte_frequency(needle[i]) < byte_frequency(needle[best])) best = i;
+    }
+    return best;
+}
+
+static bool matches_at(struct search_job const* job, unsigned char const* p)
+{
+    if (!job->ignore_case) return memcmp(p, job->needle, job->needle_length) == 0;
+    for (size_t i = 0; i < job->needle_length; i++) {
+        if (to_lower(p[i]) != job->needle[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * Find the next occurrence of the needle in [from, end). The rare byte is located with memchr (vectorised in bionic
+ * and glibc) and only those positions are compared in full. For case-insensitive searches of a letter both cases are
+ * scanned, keeping the next position of each so neither is searched twice.
+ */
+static unsigned char const* find_needle(struct search_job const* job, unsigned char const* from, unsigned char const* end)
+{
+    size_t offset = job->rare_offset;
+    size_t tail = job->needle_length - offset;
+    if ((size_t) (end - from) < job->needle_length) return NULL;
+
+    unsigned char lower = job->needle[offset];
+    unsigned char upper = lower;
+    if (job->ignore_case && lower >= 'a' && lower <= 'z') upper = (unsigned char) (lower - 'a' + 'A');
+
+    unsigned char const* scan = from + offset;
+    unsigned char const* scan_end = end - tail + 1;
+    unsigned char const* next_lower = NULL;
+    unsigned char const* next_upper = NULL;
+    while (scan < scan_end) {
+        if (next_lower == NULL || next_lower < scan) {
+            next_lower = memchr(scan, lower, (size_t) (scan_end - scan));
+            if (next_lower == NULL) next_lower = scan_end;
+        }
+        unsigned char const* candidate = next_lower;
+        if (upper != lower) {
+            if (next_upper == NULL || next_upper < scan) {
+                next_upper = memchr(scan, upper, (size_t) (scan_end - scan));
+                if (next_upper == NULL) next_upper = scan_end;
+            }
+            if (next_upper < candidate) candidate = next_upper;
+        }
+        if (candidate >= scan_end) return NULL;
+        if (matches_at(job, candidate - offset)) return candidate - offset;
+        scan = candidate + 1;
+    }
+    return NULL;
+}
+
+static void queue_match(struct search_job* job, int file, int line_number, unsigned char const* start, size_t length)
+{
+    struct line_match* match = malloc(sizeof(struct line_match) + length);
+    if (match == NULL) return;
+    match->next = NULL;
+    match->file = file;
+    match->line_number = line_number;
+    match->length = length;
+    memcpy(match->line, start, length);
+
+    pthread_mutex_lock(&job->lock);
+    if (job->tail) job->tail->next = match;
+    else job->head = match;
+    job->tail = match;
+    pthread_cond_signal(&job->changed);
+    pthread_mutex_unlock(&job->lock);
+}
+
+/**
+ * Queue every line of the buffer that contains the needle, at most once per line. The buffer holds whole lines, the
+ * first of which has the given number; returns the number of the line following the buffer.
+ */
+static int scan_buffer(struct search_job* job, int file, unsigned char const* data, size_t size, int line_number)
+{
+    unsigned char const* end = data + size;
+    unsigned char const* counted = data;
+    unsigned char const* p = data;
+
+    while (!atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        unsigned char const* hit = find_needle(job, p, end);
+        if (hit == NULL) break;
+
+        unsigned char const* line_start = hit;
+        while (line_start > p && line_start[-1] != '\n') line_start--;
+        unsigned char const* line_end = memchr(hit, '\n', (size_t) (end - hit));
+        if (line_end == NULL) line_end = end;
+
+        // Line numbers are counted lazily, only up to lines that matched
+        while (counted < line_start) {
+            unsigned char const* newline = memchr(counted, '\n', (size_t) (line_start - counted));
+            if (newline == NULL) break;
+            line_number++;
+            counted = newline + 1;
+        }
+
+        size_t length = (size_t) (line_end - line_start);
+        if (length > 0 && line_start[length - 1] == '\r') length--;
+        queue_match(job, file, line_number, line_start, length);
+
+        if (job->max_lines > 0 && atomic_fetch_add(&job->line_count, 1) + 1 >= job->max_lines) {
+            atomic_store(&job->stop, true);
+            return line_number;
+        }
+        if (line_end == end) {
+            counted = end;
+            break;
+        }
+        p = line_end + 1;
+        counted = p;
+        line_number++;
+    }
+
+    while (counted < end) {
+        unsigned char const* newline = memchr(counted, '\n', (size_t) (end - counted));
+        if (newline == NULL) break;
+        line_number++;
+        counted = newline + 1;
+    }
+    return line_number;
+}
+
+static ssize_t read_fully(int fd, unsigned char* buffer, size_t count)
+{
+    size_t done = 0;
+    while (done < count) {
+        ssize_t n = read(fd, buffer + done, count - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return done > 0 ? (ssize_t) done : -1;
+        if (n == 0) break;
+        done += (size_t) n;
+    }
+    return (ssize_t) done;
+}
+
+/**
+ * Read the file in pieces rather than memory mapping it: a mapped file truncated by another process, such as an
+ * editor saving it, raises SIGBUS on access, while read() just ends early. Each piece is cut after its last newline and
+ * the partial line is carried over to the next one.
+ */
+static void search_file(struct search_job* job, int file)
+{
+    // Without O_NONBLOCK opening a FIFO would wait for a writer; anything but a regular file is skipped below
+    int fd = open(job->paths[file], O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || (size_t) st.st_size < job->needle_length) {
+        close(fd);
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t capacity = (size_t) st.st_size < READ_BUFFER_SIZE ? (size_t) st.st_size + 1 : READ_BUFFER_SIZE;
+    unsigned char* buffer = malloc(capacity);
+    if (buffer == NULL) {
+        close(fd);
+        return;
+    }
+
+    size_t kept = 0;
+    int line_number = 1;
+    bool first = true;
+    bool eof = false;
+    while (!eof && !atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        if (kept == capacity) {
+            // A line longer than the buffer
+            unsigned char* grown = realloc(buffer, capacity * 2);
+            if (grown == NULL) break;
+            buffer = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read_fully(fd, buffer + kept, capacity - kept);
+        if (n < 0) break;
+        eof = kept + (size_t) n < capacity;
+        size_t filled = kept + (size_t) n;
+
+        if (first) {
+            first = false;
+            if (memchr(buffer, 0, filled < BINARY_PROBE_SIZE ? filled : BINARY_PROBE_SIZE) != NULL) break;
+        }
+
+        size_t complete = filled;
+        if (!eof) {
+            unsigned char const* last_newline = memrchr(buffer, '\n', filled);
+            if (last_newline == NULL) {
+                kept = filled;
+                continue;
+            }
+            complete = (size_t) (last_newline - buffer) + 1;
+        }
+        if (complete > 0) line_number = scan_buffer(job, file, buffer, complete, line_number);
+        kept = filled - complete;
+        memmove(buffer, buffer + complete, kept);
+    }
+    free(buffer);
+    close(fd);
+}
+
+static void* search_worker(void* arg)
+{
+    struct search_job* job = arg;
+    while (!atomic_load(&job->stop)) {
+        int file = atomic_fetch_add(&job->next_file, 1);
+        if (file >= job->path_count) break;
+        search_file(job, file);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->running--;
+    pthread_cond_signal(&job->changed);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+static void free_paths(char** paths, int count)
+{
+    for (int i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+}
+
+static jint throw_out_of_memory(JNIEnv* env, char const* message)
+{
+    jclass exClass = (*env)->FindClass(env, "java/lang/OutOfMemoryError");
+    (*env)->ThrowNew(env, exClass, message);
+    return -1;
+}
+
+static void free_matches(struct line_match* match)
+{
+    while (match) {
+        struct line_match* next = match->next;
+        free(match);
+        match = next;
+    }
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_FileSearcher_search(
+        JNIEnv* env,
+        jclass TERMUX_UNUSED(clazz),
+        jobjectArray paths,
+        jbyteArray needle,
+        jboolean ignoreCase,
+        jint maxLines,
+        jint threads,
+        jobject listener)
+{
+    jclass listener_class = (*env)->GetObjectClass(env, listener);
+    jmethodID on_line = (*env)->GetMethodID(env, listener_class, "onLine", "(II[B)Z");
+    if (on_line == NULL) return -1;
+
+    jsize needle_length = (*env)->GetArrayLength(env, needle);
+    if (needle_length == 0) {
+        jclass exClass = (*env)->FindClass(env, "java/lang/IllegalArgumentException");
+        (*env)->ThrowNew(env, exClass, "Empty needle");
+        return -1;
+    }
+
+    unsigned char* needle_bytes = malloc((size_t) needle_length);
+    if (needle_bytes == NULL) return throw_out_of_memory(env, "malloc() of the needle");
+
+    struct search_job job = { .ignore_case = ignoreCase, .max_lines = maxLines };
+    job.path_count = (*env)->GetArrayLength(env, paths);
+    job.paths = calloc((size_t) job.path_count + 1, sizeof(char*));
+    if (job.paths == NULL) {
+        free(needle_bytes);
+        return throw_out_of_memory(env, "calloc() of the paths");
+    }
+    for (int i = 0; i < job.path_count; i++) {
+        jstring path_java_string = (jstring) (*env)->GetObjectArrayElement(env, paths, i);
+        char const* path_utf8 = (*env)->GetStringUTFChars(env, path_java_string, NULL);
+        // Null only when out of memory, with an OutOfMemoryError pending
+        if (path_utf8 == NULL) {
+            free_paths(job.paths, i);
+            free(needle_bytes);
+            return -1;
+        }
+        job.paths[i] = strdup(path_utf8);
+        (*env)->ReleaseStringUTFChars(env, path_java_string, path_utf8);
+        (*env)->DeleteLocalRef(env, path_java_string);
+        if (job.paths[i] == NULL) {
+            free_paths(job.paths, i);
+            free(needle_bytes);
+            return throw_out_of_memory(env, "strdup() of a path");
+        }
+    }
+
+    (*env)->GetByteArrayRegion(env, needle, 0, needle_length, (jbyte*) needle_bytes);
+    if (job.ignore_case) {
+        for (jsize i = 0; i < needle_length; i++) needle_bytes[i] = to_lower(needle_bytes[i]);
+    }
+    job.needle = needle_bytes;
+    job.needle_length = (size_t) needle_length;
+    job.rare_offset = rare_byte_offset(needle_bytes, job.needle_length);
+    atomic_init(&job.next_file, 0);
+    atomic_init(&job.line_count, 0);
+    atomic_init(&job.stop, false);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+
+    int thread_count = threads < 1 ? 1 : (threads > MAX_SEARCH_THREADS ? MAX_SEARCH_THREADS : threads);
+    if (thread_count > job.path_count) thread_count = job.path_count;
+    pthread_t workers[MAX_SEARCH_THREADS];
+    int started = 0;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_mutex_lock(&job.lock);
+        job.running++;
+        pthread_mutex_unlock(&job.lock);
+        if (pthread_create(&workers[started], NULL, search_worker, &job) != 0) {
+            pthread_mutex_lock(&job.lock);
+            job.running--;
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+        started++;
+    }
+    // Without any worker thread the search still runs, on this thread
+    if (started == 0 && job.path_count > 0) {
+        job.running = 1;
+        search_worker(&job);
+    }
+
+    // Hand matches to Java as they arrive; the listener can stop the search by returning false
+    jint delivered = 0;
+    bool listening = true;
+    for (;;) {
+        pthread_mutex_lock(&job.lock);
+        while (job.head == NULL && job.running > 0) pthread_cond_wait(&job.changed, &job.lock);
+        struct line_match* batch = job.head;
+        job.head = job.tail = NULL;
+        bool done = job.running == 0;
+        pthread_mutex_unlock(&job.lock);
+
+        for (struct line_match* match = batch; match && listening; match = match->next) {
+            // Workers racing past the limit may have queued a few lines too many
+            if (job.max_lines > 0 && delivered >= job.max_lines) break;
+            jbyteArray line = (*env)->NewByteArray(env, (jsize) match->length);
+            if (line == NULL) {
+                listening = false;
+                atomic_store(&job.stop, true);
+                break;
+            }
+            (*env)->SetByteArrayRegion(env, line, 0, (jsize) match->length, (jbyte const*) match->line);
+            jboolean more = (*env)->CallBooleanMethod(env, listener, on_line, match->file, match->line_number, line);
+            (*env)->DeleteLocalRef(env, line);
+            delivered++;
+            if ((*env)->ExceptionCheck(env) || !more) {
+                listening = false;
+                atomic_store(&job.stop, true);
+                break;
+            }
+        }
+        free_matches(batch);
+        if (done) break;
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    free_matches(job.head);
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+    free_paths(job.paths, job.path_count);
+    free(needle_bytes);
+    return delivered;
+}
@@ -1,8 +1,4 @@
-#include <dirent.h>
-#include <fcntl.h>
 #include <jni.h>
-#include <signal.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -10,10 +6,9 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include "pty_spawn.h"
+
 #define TERMUX_UNUSED(x) x __attribute__((__unused__))
-#ifdef __APPLE__
-# define LACKS_PTSNAME_R
-#endif
 
 static int throw_runtime_exception(JNIEnv* env, char const* message)
 {
@@ -33,85 +28,10 @@ static int create_subprocess(JNIEnv* env,
         jint cell_width,
         jint cell_height)
 {
-    int ptm = open("/dev/ptmx", O_RDWR | O_CLOEXEC);
-    if (ptm < 0) return throw_runtime_exception(env, "Cannot open /dev/ptmx");
-
-#ifdef LACKS_PTSNAME_R
-    char* devname;
-#else
-    char devname[64];
-#endif
-    if (grantpt(ptm) || unlockpt(ptm) ||
-#ifdef LACKS_PTSNAME_R
-            (devname = ptsname(ptm)) == NULL
-#else
-            ptsname_r(ptm, devname, sizeof(devname))
-#endif
-       ) {
-        return throw_runtime_exception(env, "Cannot grantpt()/unlockpt()/ptsname_r() on /dev/ptmx");
-    }
-
-    // Enable UTF-8 mode and disable flow control to prevent Ctrl+S from locking up the display.
-    struct termios tios;
-    tcgetattr(ptm, &tios);
-    tios.c_iflag |= IUTF8;
-    tios.c_iflag &= ~(IXON | IXOFF);
-    tcsetattr(ptm, TCSANOW, &tios);
-
-    /** Set initial winsize. */
-    struct winsize sz = { .ws_row = (unsigned short) rows, .ws_col = (unsigned short) columns, .ws_xpixel = (unsigned short) (columns * cell_width), .ws_ypixel = (unsigned short) (rows * cell_height)};
-    ioctl(ptm, TIOCSWINSZ, &sz);
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        return throw_runtime_exception(env, "Fork failed");
-    } else if (pid > 0) {
-        *pProcessId = (int) pid;
-        return ptm;
-    } else {
-        // Clear signals which the Android java process may have blocked:
-        sigset_t signals_to_unblock;
-        sigfillset(&signals_to_unblock);
-        sigprocmask(SIG_UNBLOCK, &signals_to_unblock, 0);
-
-        close(ptm);
-        setsid();
-
-        int pts = open(devname, O_RDWR);
-        if (pts < 0) exit(-1);
-
-        dup2(pts, 0);
-        dup2(pts, 1);
-        dup2(pts, 2);
-
-        DIR* self_dir = opendir("/proc/self/fd");
-        if (self_dir != NULL) {
-            int self_dir_fd = dirfd(self_dir);
-            struct dirent* entry;
-            while ((entry = readdir(self_dir)) != NULL) {
-                int fd = atoi(entry->d_name);
-                if (fd > 2 && fd != self_dir_fd) close(fd);
-            }
-            closedir(self_dir);
-        }
-
-        clearenv();
-        if (envp) for (; *envp; ++envp) putenv(*envp);
-
-        if (chdir(cwd) != 0) {
-            char* error_message;
-            // No need to free asprintf()-allocated memory since doing execvp() or exit() below.
-            if (asprintf(&error_message, "chdir(\"%s\")", cwd) == -1) error_message = "chdir()";
-            perror(error_message);
-            fflush(stderr);
-        }
-        execvp(cmd, argv);
-        // Show terminal output about failing exec() call:
-        char* error_message;
-        if (asprintf(&error_message, "exec(\"%s\")", cmd) == -1) error_message = "exec()";
-        perror(error_message);
-        _exit(1);
-    }
+    char const* error;
+    int ptm = pty_spawn(cmd, cwd, argv, envp, pProcessId, rows, columns, cell_width, cell_height, &error);
+    if (ptm < 0) return throw_runtime_exception(env, error);
+    return ptm;
 }
 
 JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_createSubprocess(
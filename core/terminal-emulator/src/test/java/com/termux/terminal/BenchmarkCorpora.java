@@ -0,0 +1,286 @@
+package com.termux.terminal;
+
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.IOException;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.util.Arrays;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.Random;
+
+/**
+ * Byte streams for {@link TerminalBenchmark}, shaped like the output of real programs. They are generated from a
+ * fixed seed so every run feeds the emulator the same bytes.
+ */
+final class BenchmarkCorpora {
+
+	private static final String ESC = "\033";
+	private static final String CSI = ESC + "[";
+
+	private BenchmarkCorpora() {
+	}
+
+	/** Every corpus by name, each about {@code size} bytes long. */
+	static Map<String, byte[]> all(int size) {
+		Map<String, byte[]> corpora = new LinkedHashMap<>();
+		corpora.put("ascii-log", asciiLog(size));
+		corpora.put("ansi-compiler", ansiCompilerOutput(size));
+		corpora.put("utf8-cjk-emoji", utf8CjkEmoji(size));
+		corpora.put("vim-redraw", vimRedraw(size));
+		corpora.put("htop-redraw", htopRedraw(size));
+		corpora.put("tmux-redraw", tmuxRedraw(size));
+		corpora.put("escape-flood", escapeFlood(size));
+		return corpora;
+	}
+
+	/**
+	 * The output of the asciicast recordings in a directory, as recorded with TerminalSession.startRecording(), by file
+	 * name. Resizes are left out, the emulator stays at the size of the benchmark.
+	 */
+	static Map<String, byte[]> recordings(File directory) throws IOException {
+		Map<String, byte[]> corpora = new LinkedHashMap<>();
+		File[] files = directory.listFiles((dir, name) -> name.endsWith(".cast"));
+		if (files == null) return corpora;
+		Arrays.sort(files);
+		for (File file : files) {
+			Builder b = new Builder();
+			List<String> lines = Files.readAllLines(file.toPath(), StandardCharsets.UTF_8);
+			// The first line is the header, then one event per line: [time, "o", "output"]
+			for (String line : lines.subList(Math.min(1, lines.size()), lines.size())) {
+				int start = line.indexOf(", \"o\", \"");
+				if (start >= 0) b.append(decodeJsonString(line, start + 8));
+			}
+			if (b.size() > 0) corpora.put(file.getName(), b.bytes());
+		}
+		return corpora;
+	}
+
+	/** The contents of the JSON string starting after the opening quote at {@code start}. */
+	private static String decodeJsonString(String json, int start) {
+		StringBuilder text = new StringBuilder();
+		for (int i = start; i < json.length(); i++) {
+			char c = json.charAt(i);
+			if (c == '"') break;
+			if (c != '\\') {
+				text.append(c);
+				continue;
+			}
+			char escaped = json.charAt(++i);
+			switch (escaped) {
+				case 'b': text.append('\b'); break;
+				case 'f': text.append('\f'); break;
+				case 'n': text.append('\n'); break;
+				case 'r': text.append('\r'); break;
+				case 't': text.append('\t'); break;
+				case 'u':
+					text.append((char) Integer.parseInt(json.substring(i + 1, i + 5), 16));
+					i += 4;
+					break;
+				default: text.append(escaped); break;
+			}
+		}
+		return text.toString();
+	}
+
+	private static final class Builder {
+		final ByteArrayOutputStream out = new ByteArrayOutputStream();
+		final StringBuilder text = new StringBuilder();
+
+		Builder append(String value) {
+			text.append(value);
+			if (text.length() >= 4096) flush();
+			return this;
+		}
+
+		Builder append(int value) {
+			return append(Integer.toString(value));
+		}
+
+		Builder append(char value) {
+			return append(String.valueOf(value));
+		}
+
+		void flush() {
+			byte[] bytes = text.toString().getBytes(StandardCharsets.UTF_8);
+			out.write(bytes, 0, bytes.length);
+			text.setLength(0);
+		}
+
+		int size() {
+			return out.size() + text.length();
+		}
+
+		byte[] bytes() {
+			flush();
+			return out.toByteArray();
+		}
+	}
+
+	/** Plain log lines, the common case of build and server output. */
+	static byte[] asciiLog(int size) {
+		Random random = new Random(1);
+		String[] levels = {"INFO", "DEBUG", "WARN", "INFO", "INFO", "ERROR"};
+		Builder b = new Builder();
+		for (int line = 0; b.size() < size; line++) {
+			b.append("2024-05-01 12:").append(10 + line / 6000 % 50).append(':').append(10 + line / 100 % 50).append('.')
+				.append(100 + random.nextInt(900)).append(' ').append(levels[random.nextInt(levels.length)])
+				.append(" [worker-").append(random.nextInt(16)).append("] Processed request id=")
+				.append(Long.toHexString(random.nextLong())).append(" path=/api/v1/items/").append(random.nextInt(100000))
+				.append(" in ").append(random.nextInt(500)).append("ms\r\n");
+		}
+		return b.bytes();
+	}
+
+	/** Compiler diagnostics with bold, 16, 256 and true colour attributes as gcc, clang and rustc print them. */
+	static byte[] ansiCompilerOutput(int size) {
+		Random random = new Random(2);
+		Builder b = new Builder();
+		while (b.size() < size) {
+			int line = 1 + random.nextInt(2000);
+			int column = 1 + random.nextInt(80);
+			boolean error = random.nextInt(3) == 0;
+			b.append(CSI + "1m" + CSI + "Ksrc/module_").append(random.nextInt(40)).append(".c:").append(line).append(':')
+				.append(column).append(":" + CSI + "m" + CSI + "K ")
+				.append(error ? CSI + "1;31m" + CSI + "Kerror: " : CSI + "1;35m" + CSI + "Kwarning: ")
+				.append(CSI + "m" + CSI + "Kunused variable '" + CSI + "01m" + CSI + "Kvalue_").append(random.nextInt(100))
+				.append(CSI + "m" + CSI + "K' [" + CSI + "38;5;").append(random.nextInt(256)).append("m-Wunused-variable")
+				.append(CSI + "m]\r\n");
+			b.append("  ").append(line).append(" |     int " + CSI + "38;2;").append(random.nextInt(256)).append(';')
+				.append(random.nextInt(256)).append(';').append(random.nextInt(256)).append("mvalue_").append(random.nextInt(100))
+				.append(CSI + "0m = compute(" + CSI + "48;5;").append(random.nextInt(256)).append("margument" + CSI + "49m);\r\n");
+			b.append("      |         " + CSI + "1;32m^~~~~~~~~" + CSI + "m\r\n");
+		}
+		return b.bytes();
+	}
+
+	/** Wide CJK characters, emoji with variation selectors and ZWJ sequences, and combining accents. */
+	static byte[] utf8CjkEmoji(int size) {
+		Random random = new Random(3);
+		String[] words = {"终端模拟器", "日本語のテキスト", "한국어 문장", "😀", "👍🏽", "👨‍👩‍👧", "❤️", "été", "cafe\u0301", "a\u0308\u0304", "ñandú", "Ελληνικά", "русский"};
+		Builder b = new Builder();
+		int column = 0;
+		while (b.size() < size) {
+			String word = words[random.nextInt(words.length)];
+			b.append(word).append(" ");
+			column += word.length() * 2 + 1;
+			if (column > 70) {
+				b.append("\r\n");
+				column = 0;
+			}
+		}
+		return b.bytes();
+	}
+
+	/** Full-screen editor redraws: absolute positioning, erase in line, scroll regions and reverse index. */
+	static byte[] vimRedraw(int size) {
+		Random random = new Random(4);
+		Builder b = new Builder();
+		b.append(CSI + "?1049h" + CSI + "?25l");
+		while (b.size() < size) {
+			b.append(CSI + "1;23r");
+			for (int row = 1; row <= 23; row++) {
+				b.append(CSI).append(row).append(";1H" + CSI + "K" + CSI + "33m").append(String.format(Locale.ROOT, "%4d ", row + random.nextInt(1000)))
+					.append(CSI + "m" + CSI + "38;5;81mstatic " + CSI + "38;5;149mint" + CSI + "m function_").append(random.nextInt(500))
+					.append("(" + CSI + "38;5;208mconst char" + CSI + "m *argument) {");
+			}
+			// Scroll up and down as when moving the cursor past the window
+			b.append(CSI + "23;1H\n\n\n" + CSI + "1;1H" + ESC + "M" + ESC + "M");
+			b.append(CSI + "r" + CSI + "24;1H" + CSI + "7m-- INSERT --" + CSI + "27m" + CSI + "K" + CSI + "24;60H")
+				.append(random.nextInt(1000)).append(',').append(random.nextInt(80)).append("  Top");
+		}
+		b.append(CSI + "?25h" + CSI + "?1049l");
+		return b.bytes();
+	}
+
+	/** Process monitor frames: per-cell foreground and background colours on every row. */
+	static byte[] htopRedraw(int size) {
+		Random random = new Random(5);
+		Builder b = new Builder();
+		b.append(CSI + "?1049h" + CSI + "H" + CSI + "2J");
+		while (b.size() < size) {
+			for (int cpu = 0; cpu < 4; cpu++) {
+				b.append(CSI).append(cpu + 1).append(";3H" + CSI + "36m").append(cpu).append(CSI + "39m[");
+				int used = random.nextInt(30);
+				for (int i = 0; i < 30; i++) {
+					b.append(i < used ? CSI + "32m|" : " ");
+				}
+				b.append(CSI + "90m").append(used * 3).append("%" + CSI + "39m]");
+			}
+			for (int row = 6; row <= 24; row++) {
+				b.append(CSI).append(row).append(";1H" + CSI + "48;5;").append(row == 6 ? 22 : 0).append('m')
+					.append(String.format(Locale.ROOT, "%6d root      20   0 %6dM %5dM S %4.1f  0.%d  0:%02d.%02d ", 1000 + random.nextInt(30000),
+						random.nextInt(9000), random.nextInt(900), random.nextFloat() * 100, random.nextInt(10),
+						random.nextInt(60), random.nextInt(100)))
+					.append(CSI + "38;5;").append(random.nextInt(256)).append("m/usr/bin/process --flag=").append(random.nextInt(100))
+					.append(CSI + "m" + CSI + "K");
+			}
+		}
+		b.append(CSI + "?1049l");
+		return b.bytes();
+	}
+
+	/** Multiplexer output: a status line, a scroll region above it and inserted and deleted lines. */
+	static byte[] tmuxRedraw(int size) {
+		Random random = new Random(6);
+		Builder b = new Builder();
+		b.append(CSI + "?1049h" + CSI + "H" + CSI + "2J");
+		while (b.size() < size) {
+			b.append(CSI + "1;23r" + CSI + "23;1H");
+			for (int i = 0; i < 5; i++) {
+				b.append("\r\n$ make -j8 target_").append(random.nextInt(100)).append(CSI + "K");
+			}
+			b.append(CSI + "5;1H" + CSI + "2L" + CSI + "10;1H" + CSI + "3M" + CSI + "12;5H" + CSI + "4@" + CSI + "2P");
+			b.append(CSI + "r" + ESC + "7" + CSI + "24;1H" + CSI + "30;42m[0] 0:bash* 1:vim- 2:htop" + CSI + "K" + CSI + "24;60H")
+				.append(String.format(Locale.ROOT, "%02d:%02d 01-May-24", random.nextInt(24), random.nextInt(60))).append(CSI + "m" + ESC + "8");
+		}
+		b.append(CSI + "?1049l");
+		return b.bytes();
+	}
+
+	/** Sequences that stress the parser rather than the screen: long parameter lists, OSC and DCS strings, junk. */
+	static byte[] escapeFlood(int size) {
+		Random random = new Random(7);
+		Builder b = new Builder();
+		while (b.size() < size) {
+			switch (random.nextInt(7)) {
+				case 0: {
+					b.append(CSI);
+					int count = 1 + random.nextInt(40);
+					for (int i = 0; i < count; i++) b.append(random.nextInt(110)).append(';');
+					b.append("m");
+					break;
+				}
+				case 1: {
+					b.append(ESC + "]0;");
+					int length = random.nextInt(300);
+					for (int i = 0; i < length; i++) b.append((char) ('a' + random.nextInt(26)));
+					b.append("\007");
+					break;
+				}
+				case 2:
+					b.append(ESC + "P$q\"p" + ESC + "\\");
+					break;
+				case 3:
+					b.append(CSI).append(random.nextInt(100)).append(';').append(random.nextInt(100)).append('H');
+					break;
+				case 4:
+					b.append(CSI + "?").append(random.nextInt(2100)).append(random.nextBoolean() ? "h" : "l");
+					break;
+				case 5:
+					b.append(ESC).append((char) ('0' + random.nextInt(79)));
+					break;
+				default:
+					b.append((char) random.nextInt(32));
+					break;
+			}
+		}
+		// Leave the terminal in a state where plain text works again
+		b.append(ESC + "c");
+		return b.bytes();
+	}
+
+}
@@ -51,4 +51,31 @@ public class ByteQueueTest extends TestCase {
 		assertEquals(0, q.read(new byte[128], false));
 	}
 
+	public void testFullStallsAreCounted() throws Exception {
+		final ByteQueue q = new ByteQueue(4);
+		assertTrue(q.write(new byte[]{1, 2, 3}, 0, 3));
+		assertEquals(0, q.getFullStalls());
+
+		Thread writer = new Thread() {
+			@Override
+			public void run() {
+				q.write(new byte[]{4, 5, 6}, 0, 3);
+			}
+		};
+		writer.start();
+		while (q.getFullStalls() == 0) Thread.sleep(1);
+
+		byte[] arr = new byte[6];
+		int read = 0;
+		while (read < 6) {
+			byte[] chunk = new byte[6 - read];
+			int count = q.read(chunk, true);
+			System.arraycopy(chunk, 0, arr, read, count);
+			read += count;
+		}
+		writer.join();
+		assertArrayEquals(new byte[]{1, 2, 3, 4, 5, 6}, arr);
+		assertEquals(1, q.getFullStalls());
+	}
+
 }
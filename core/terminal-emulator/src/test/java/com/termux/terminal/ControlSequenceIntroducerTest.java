@@ -48,6 +48,20 @@ public class ControlSequenceIntroducerTest extends TerminalTestCase {
 		withTerminalSized(5, 2).enterString("abcde\033[2G\033[2b\n").assertLinesAre("aeede", "     ");
 	}
 
+	/** A long REP ends with the cursor where repeating every character would leave it. */
+	public void testLongRepeat() {
+		String row = String.valueOf(new char[80]).replace('\0', 'b');
+		// 10001 characters are 125 rows and one more character
+		withTerminalSized(80, 24).enterString("ab\033[9999b").assertCursorAt(23, 1);
+		assertLineIs(22, row);
+		assertLineIs(23, "b" + row.replace('b', ' ').substring(1));
+
+		// Without autowrap the cursor stays in the last column
+		withTerminalSized(80, 24).enterString("\033[?7la\033[9999b").assertCursorAt(0, 79);
+		assertLineIs(0, row.replace('b', 'a'));
+		assertLineIs(1, row.replace('b', ' '));
+	}
+
 	/** CSI 3 J  Clear scrollback (xterm, libvte; non-standard). */
 	public void testCsi3J() {
 		withTerminalSized(3, 2).enterString("a\r\nb\r\nc\r\nd");
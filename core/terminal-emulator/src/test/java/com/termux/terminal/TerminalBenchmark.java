@@ -0,0 +1,238 @@
+package com.termux.terminal;
+
+import junit.framework.TestCase;
+
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.io.OutputStreamWriter;
+import java.io.Writer;
+import java.lang.reflect.Method;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.Properties;
+import java.util.TreeMap;
+
+/**
+ * Throughput and allocation benchmarks of the emulator, fed with {@link BenchmarkCorpora}.
+ * <p>
+ * Normal test runs only check that every benchmark runs. The measurements are taken with
+ * <pre>
+ * ./gradlew :core:terminal-emulator:testDebugUnitTest --tests '*TerminalBenchmark*' -PterminalBenchmark
+ * </pre>
+ * and compared with the baseline in src/test/benchmark-baseline.properties: a benchmark fails if its throughput
+ * dropped or its allocations grew by more than a quarter, and the comparison fails if there is no baseline. Add
+ * {@code -PterminalBenchmarkUpdate} to write the new results as the baseline instead. Numbers depend on the machine,
+ * so a baseline is only compared on the machine that recorded it: on pull requests the Terminal Benchmark workflow in
+ * .github/workflows/terminalBenchmark.yml records one from the base commit and then compares the pull request with
+ * it on the same runner.
+ * <p>
+ * The corpora are synthetic, generated to resemble the output of the named programs rather than captured from them.
+ * <p>
+ * Add {@code -PterminalBenchmarkRecordings=<directory>} to also measure appending the output of the session
+ * recordings in that directory, which have no baseline.
+ */
+public class TerminalBenchmark extends TestCase {
+
+	private static final boolean ENABLED = Boolean.getBoolean("terminal.benchmark");
+	private static final boolean UPDATE_BASELINE = Boolean.getBoolean("terminal.benchmark.update");
+	private static final String BASELINE_PATH = System.getProperty("terminal.benchmark.baseline");
+	private static final String RECORDINGS_PATH = System.getProperty("terminal.benchmark.recordings", "");
+
+	private static final int CORPUS_SIZE = 1 << 20;
+	private static final int SMOKE_CORPUS_SIZE = 1 << 14;
+	private static final long WARMUP_NANOS = 1_000_000_000L;
+	private static final long MEASURE_NANOS = 3_000_000_000L;
+	private static final double TOLERANCE = 0.25;
+	private static final double MB = 1 << 20;
+
+	/** Bytes allocated by the current thread, through HotSpot's ThreadMXBean, which android.jar does not declare. */
+	private static final Object THREAD_MX_BEAN;
+	private static final Method GET_THREAD_ALLOCATED_BYTES;
+
+	static {
+		Object bean = null;
+		Method method = null;
+		try {
+			bean = Class.forName("java.lang.management.ManagementFactory").getMethod("getThreadMXBean").invoke(null);
+			method = Class.forName("com.sun.management.ThreadMXBean").getMethod("getThreadAllocatedBytes", long.class);
+		} catch (Exception e) {
+			// Not a HotSpot JVM, allocations are not reported
+		}
+		THREAD_MX_BEAN = bean;
+		GET_THREAD_ALLOCATED_BYTES = method;
+	}
+
+	private static long allocatedBytes() {
+		if (GET_THREAD_ALLOCATED_BYTES == null) return -1;
+		try {
+			return (Long) GET_THREAD_ALLOCATED_BYTES.invoke(THREAD_MX_BEAN, Thread.currentThread().getId());
+		} catch (Exception e) {
+			return -1;
+		}
+	}
+
+	/** The result of one benchmark, per unit of work: a MB of input or one operation. */
+	static final class Result {
+		final String name;
+		final String unit;
+		final double throughput;
+		final double allocatedPerUnit;
+
+		Result(String name, String unit, double throughput, double allocatedPerUnit) {
+			this.name = name;
+			this.unit = unit;
+			this.throughput = throughput;
+			this.allocatedPerUnit = allocatedPerUnit;
+		}
+
+		@Override
+		public String toString() {
+			return String.format(Locale.ROOT, "%-24s %12.2f %s/s %14.0f bytes allocated/%s", name, throughput, unit,
+				allocatedPerUnit, unit);
+		}
+	}
+
+	interface Operation {
+		void run();
+	}
+
+	/** Run {@code operation} repeatedly for a while after warming up; each run does {@code unitsPerRun} units. */
+	private static Result measure(String name, String unit, double unitsPerRun, long warmupNanos, long measureNanos, Operation operation) {
+		long warmupEnd = System.nanoTime() + warmupNanos;
+		do {
+			operation.run();
+		} while (System.nanoTime() < warmupEnd);
+
+		int runs = 0;
+		long allocatedBefore = allocatedBytes();
+		long start = System.nanoTime();
+		long elapsed;
+		do {
+			operation.run();
+			runs++;
+			elapsed = System.nanoTime() - start;
+		} while (elapsed < measureNanos || runs < 5);
+		long allocatedAfter = allocatedBytes();
+
+		double units = runs * unitsPerRun;
+		double allocated = allocatedBefore < 0 ? -1 : (allocatedAfter - allocatedBefore) / units;
+		return new Result(name, unit, units / (elapsed / 1e9), allocated);
+	}
+
+	private static TerminalEmulator newEmulator(int columns, int rows, int transcriptRows) {
+		return new TerminalEmulator(new TerminalTestCase.MockTerminalOutput(), columns, rows,
+			TerminalTestCase.INITIAL_CELL_WIDTH_PIXELS, TerminalTestCase.INITIAL_CELL_HEIGHT_PIXELS, transcriptRows, null);
+	}
+
+	/** Feed {@code corpus} in the chunks TerminalSession reads. */
+	private static void appendInChunks(TerminalEmulator emulator, byte[] corpus, byte[] chunk) {
+		for (int offset = 0; offset < corpus.length; offset += chunk.length) {
+			int length = Math.min(chunk.length, corpus.length - offset);
+			System.arraycopy(corpus, offset, chunk, 0, length);
+			emulator.append(chunk, length);
+		}
+	}
+
+	private static List<Result> runAll(int corpusSize, long warmupNanos, long measureNanos) throws IOException {
+		List<Result> results = new ArrayList<>();
+		final byte[] chunk = new byte[4096];
+
+		Map<String, byte[]> corpora = BenchmarkCorpora.all(corpusSize);
+		for (Map.Entry<String, byte[]> recording : BenchmarkCorpora.recordings(new File(RECORDINGS_PATH)).entrySet())
+			corpora.put("recording-" + recording.getKey(), recording.getValue());
+		for (Map.Entry<String, byte[]> entry : corpora.entrySet()) {
+			final byte[] corpus = entry.getValue();
+			final TerminalEmulator emulator = newEmulator(80, 24, 2000);
+			results.add(measure("append/" + entry.getKey(), "MB", corpus.length / MB, warmupNanos, measureNanos,
+				() -> appendInChunks(emulator, corpus, chunk)));
+		}
+
+		// Reflow of a full transcript of wrapped and unwrapped lines
+		final TerminalEmulator resized = newEmulator(80, 24, 2000);
+		byte[] log = BenchmarkCorpora.asciiLog(corpusSize);
+		appendInChunks(resized, log, chunk);
+		final int[][] sizes = {{120, 40}, {50, 30}, {80, 24}};
+		results.add(measure("resize/reflow", "op", sizes.length, warmupNanos, measureNanos, () -> {
+			for (int[] size : sizes)
+				resized.resize(size[0], size[1], TerminalTestCase.INITIAL_CELL_WIDTH_PIXELS, TerminalTestCase.INITIAL_CELL_HEIGHT_PIXELS);
+		}));
+
+		final TerminalEmulator selected = newEmulator(80, 24, 2000);
+		appendInChunks(selected, BenchmarkCorpora.utf8CjkEmoji(corpusSize), chunk);
+		final TerminalBuffer screen = selected.getScreen();
+		results.add(measure("getSelectedText/transcript", "op", 1, warmupNanos, measureNanos,
+			() -> screen.getSelectedText(0, -screen.getActiveTranscriptRows(), selected.mColumns, selected.mRows)));
+
+		return results;
+	}
+
+	/** Every benchmark runs on small inputs; the numbers are not looked at. */
+	public void testBenchmarksRun() throws IOException {
+		List<Result> results = runAll(SMOKE_CORPUS_SIZE, 0, 0);
+		int recordings = BenchmarkCorpora.recordings(new File(RECORDINGS_PATH)).size();
+		assertEquals(BenchmarkCorpora.all(SMOKE_CORPUS_SIZE).size() + recordings + 2, results.size());
+		for (Result result : results) assertTrue(result.name, result.throughput > 0);
+	}
+
+	public void testAgainstBaseline() throws IOException {
+		if (!ENABLED) return;
+
+		List<Result> results = runAll(CORPUS_SIZE, WARMUP_NANOS, MEASURE_NANOS);
+		for (Result result : results) System.out.println(result);
+
+		File baselineFile = BASELINE_PATH == null ? null : new File(BASELINE_PATH);
+		if (UPDATE_BASELINE) {
+			assertNotNull("terminal.benchmark.baseline is not set", baselineFile);
+			writeBaseline(baselineFile, results);
+			System.out.println("Baseline written to " + baselineFile);
+			return;
+		}
+		if (baselineFile == null || !baselineFile.isFile()) {
+			fail("No baseline to compare with at " + baselineFile + ", record one with -PterminalBenchmarkUpdate"
+				+ " or the Terminal Benchmark workflow");
+		}
+
+		Properties baseline = new Properties();
+		try (InputStream in = new FileInputStream(baselineFile)) {
+			baseline.load(in);
+		}
+		List<String> regressions = new ArrayList<>();
+		for (Result result : results) {
+			String throughput = baseline.getProperty(result.name + ".throughput");
+			if (throughput != null && result.throughput < Double.parseDouble(throughput) * (1 - TOLERANCE)) {
+				regressions.add(String.format(Locale.ROOT, "%s: %.2f %s/s, baseline %s", result.name, result.throughput, result.unit, throughput));
+			}
+			String allocated = baseline.getProperty(result.name + ".allocated");
+			// A little slack so that benchmarks allocating next to nothing do not fail on noise
+			if (allocated != null && result.allocatedPerUnit >= 0
+				&& result.allocatedPerUnit > Double.parseDouble(allocated) * (1 + TOLERANCE) + 1024) {
+				regressions.add(String.format(Locale.ROOT, "%s: %.0f bytes allocated/%s, baseline %s", result.name,
+					result.allocatedPerUnit, result.unit, allocated));
+			}
+		}
+		if (!regressions.isEmpty()) fail("Benchmark regressions:\n" + String.join("\n", regressions));
+	}
+
+	private static void writeBaseline(File file, List<Result> results) throws IOException {
+		Map<String, String> values = new TreeMap<>();
+		for (Result result : results) {
+			values.put(result.name + ".throughput", String.format(Locale.ROOT, "%.2f", result.throughput));
+			if (result.allocatedPerUnit >= 0)
+				values.put(result.name + ".allocated", String.format(Locale.ROOT, "%.0f", result.allocatedPerUnit));
+		}
+		try (Writer out = new OutputStreamWriter(new FileOutputStream(file), StandardCharsets.UTF_8)) {
+			out.write("# Written by TerminalBenchmark with -PterminalBenchmarkUpdate, see its documentation.\n");
+			out.write("# Throughput is per second, allocations in bytes per MB of input or per operation.\n");
+			for (Map.Entry<String, String> entry : values.entrySet()) {
+				out.write(entry.getKey() + "=" + entry.getValue() + "\n");
+			}
+		}
+	}
+
+}
@@ -0,0 +1,83 @@
+package com.termux.terminal;
+
+import junit.framework.TestCase;
+
+import java.nio.charset.StandardCharsets;
+import java.util.Map;
+import java.util.Random;
+
+/**
+ * Inputs which used to take super-linear time in the emulator, and a short fixed-seed run of random mutations of the
+ * benchmark corpora, checked against the time budget of {@link TerminalEmulatorFuzzer}.
+ */
+public class TerminalEmulatorFuzzTest extends TestCase {
+
+	private static final int SIZE = 64 * 1024;
+
+	private static byte[] repeat(String prefix, String unit, int size) {
+		StringBuilder builder = new StringBuilder(prefix);
+		while (builder.length() < size) builder.append(unit);
+		return builder.toString().getBytes(StandardCharsets.UTF_8);
+	}
+
+	private static void assertFast(String name, byte[] input) {
+		// Once to compile the code paths, then timed
+		TerminalEmulatorFuzzer.nanosPerByte(input);
+		long nanosPerByte = TerminalEmulatorFuzzer.nanosPerByte(input);
+		assertTrue(name + " took " + nanosPerByte + " ns per byte", nanosPerByte <= TerminalEmulatorFuzzer.DEFAULT_MAX_NANOS_PER_BYTE);
+	}
+
+	public void testCombiningFloodInOneColumn() {
+		assertFast("combining flood", repeat("\033[80Ga", "\u0308", SIZE));
+	}
+
+	public void testCombiningFloodOverFullRows() {
+		StringBuilder column = new StringBuilder("a");
+		for (int i = 0; i < 20; i++) column.append("\u0301");
+		assertFast("combining rows", repeat("", column.toString(), SIZE));
+	}
+
+	public void testRepeatedCombiningCharacter() {
+		assertFast("combining REP", repeat("a\u0308", "\033[9999b", SIZE));
+	}
+
+	public void testInsertCharactersInWideRow() {
+		StringBuilder wideRow = new StringBuilder();
+		for (int i = 0; i < 40; i++) wideRow.append("\u4e2d");
+		assertFast("wide ICH", repeat(wideRow + "\r", "\033[@\033[P", SIZE));
+	}
+
+	public void testLongOscAndDeviceControlStrings() {
+		assertFast("OSC", repeat("\033]0;", "x", SIZE));
+		assertFast("DCS", repeat("\033P", "x", SIZE));
+	}
+
+	public void testRandomMutations() {
+		Random random = new Random(47);
+		Map<String, byte[]> corpora = BenchmarkCorpora.all(SIZE);
+		byte[][] sources = corpora.values().toArray(new byte[0][]);
+		for (int i = 0; i < 50; i++) {
+			byte[] input = sources[random.nextInt(sources.length)].clone();
+			int mutations = 1 + random.nextInt(64);
+			for (int m = 0; m < mutations; m++) {
+				int position = random.nextInt(input.length);
+				switch (random.nextInt(3)) {
+					case 0:
+						input[position] = (byte) random.nextInt(256);
+						break;
+					case 1:
+						input[position] = 033;
+						break;
+					default:
+						// Copy a slice elsewhere, like fuzzers splice inputs
+						int length = random.nextInt(256);
+						int target = random.nextInt(input.length);
+						length = Math.min(length, Math.min(input.length - position, input.length - target));
+						System.arraycopy(input, position, input, target, length);
+				}
+			}
+			TerminalEmulatorFuzzer.fuzzerTestOneInput(input);
+		}
+	}
+
+}
@@ -0,0 +1,47 @@
+package com.termux.terminal;
+
+/**
+ * Fuzz target feeding arbitrary bytes to {@link TerminalEmulator#append(byte[], int)}, in the format of the
+ * coverage-guided JVM fuzzer Jazzer (https://github.com/CodeIntelligenceTesting/jazzer):
+ * <pre>
+ * ./gradlew :core:terminal-emulator:compileDebugUnitTestJavaWithJavac
+ * jazzer --cp=build/intermediates/javac/debug/classes:build/intermediates/javac/debugUnitTest/classes \
+ *     --target_class=com.termux.terminal.TerminalEmulatorFuzzer -max_len=65536
+ * </pre>
+ * Besides exceptions, an input is reported when processing it takes longer per byte than
+ * {@code -Dterminal.fuzz.maxNanosPerByte}, so that output which could hang the UI thread is found. Inputs found this
+ * way belong in {@link TerminalEmulatorFuzzTest} once the slow path has a cap.
+ */
+public final class TerminalEmulatorFuzzer {
+
+	/** 50 us per byte is 200 ms for one 4 KiB read from the process, a visible hang of the UI thread. */
+	static final long DEFAULT_MAX_NANOS_PER_BYTE = 50_000;
+	private static final long MAX_NANOS_PER_BYTE = Long.getLong("terminal.fuzz.maxNanosPerByte", DEFAULT_MAX_NANOS_PER_BYTE);
+	/** Shorter inputs are timed too imprecisely to judge. */
+	static final int MIN_TIMED_LENGTH = 1024;
+
+	private TerminalEmulatorFuzzer() {
+	}
+
+	public static void fuzzerTestOneInput(byte[] data) {
+		long nanosPerByte = nanosPerByte(data);
+		if (data.length >= MIN_TIMED_LENGTH && nanosPerByte > MAX_NANOS_PER_BYTE) {
+			throw new AssertionError("Slow input: " + nanosPerByte + " ns per byte over " + data.length + " bytes");
+		}
+	}
+
+	/** Process data in a new 80x24 terminal in the chunks TerminalSession reads and return the time per byte. */
+	static long nanosPerByte(byte[] data) {
+		TerminalEmulator emulator = new TerminalEmulator(new TerminalTestCase.MockTerminalOutput(), 80, 24,
+			TerminalTestCase.INITIAL_CELL_WIDTH_PIXELS, TerminalTestCase.INITIAL_CELL_HEIGHT_PIXELS, 2000, null);
+		byte[] chunk = new byte[4096];
+		long start = System.nanoTime();
+		for (int offset = 0; offset < data.length; offset += chunk.length) {
+			int length = Math.min(chunk.length, data.length - offset);
+			System.arraycopy(data, offset, chunk, 0, length);
+			emulator.append(chunk, length);
+		}
+		return data.length == 0 ? 0 : (System.nanoTime() - start) / data.length;
+	}
+
+}
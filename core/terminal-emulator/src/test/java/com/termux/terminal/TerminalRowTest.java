@@ -404,6 +404,30 @@ public class TerminalRowTest extends TestCase {
 		// }
 	}
 
+	public void testCombiningFloodIsCapped() {
+		row.setChar(0, ONE_JAVA_CHAR_DISPLAY_WIDTH_TWO_1, 0);
+		row.setChar(2, 'a', 0);
+		for (int i = 0; i < 100; i++) row.setChar(2, DIARESIS_CODEPOINT, 0);
+		// The wide char takes one java char for two columns, 'a' is followed by at most 15 combining chars
+		assertEquals(79 + 15, row.getSpaceUsed());
+		// A new base char takes combining chars again
+		row.setChar(2, 'b', 0);
+		row.setChar(2, DIARESIS_CODEPOINT, 0);
+		assertEquals(79 + 1, row.getSpaceUsed());
+		assertLineStartsWith(ONE_JAVA_CHAR_DISPLAY_WIDTH_TWO_1, 'b', DIARESIS_CODEPOINT, ' ');
+	}
+
+	public void testCopyIntervalWithinRowKeepsStyles() {
+		row.setChar(0, 'a', 1);
+		row.setChar(1, ONE_JAVA_CHAR_DISPLAY_WIDTH_TWO_1, 2);
+		row.setChar(3, 'b', 3);
+		row.copyInterval(row, 0, 4, 1);
+		assertLineStartsWith('a', 'a', ONE_JAVA_CHAR_DISPLAY_WIDTH_TWO_1, 'b');
+		assertEquals(1, row.getStyle(1));
+		assertEquals(2, row.getStyle(2));
+		assertEquals(3, row.getStyle(4));
+	}
+
 	public void testNormalization() {
 		// int lowerCaseN = 0x006E;
 		// int combiningTilde = 0x0303;
@@ -0,0 +1,61 @@
+package com.termux.terminal;
+
+import junit.framework.TestCase;
+
+public class TerminalSessionStatsTest extends TestCase {
+
+	public void testBucketsAreContiguous() {
+		assertEquals(240, TerminalSessionStats.HISTOGRAM_BUCKETS);
+		for (int bucket = 0; bucket < TerminalSessionStats.HISTOGRAM_BUCKETS; bucket++) {
+			long upper = TerminalSessionStats.bucketUpperBound(bucket);
+			assertEquals(bucket, TerminalSessionStats.bucketIndex(upper));
+			if (bucket + 1 < TerminalSessionStats.HISTOGRAM_BUCKETS)
+				assertEquals(bucket + 1, TerminalSessionStats.bucketIndex(upper + 1));
+		}
+		assertEquals(TerminalSessionStats.HISTOGRAM_BUCKETS - 1, TerminalSessionStats.bucketIndex(Long.MAX_VALUE));
+	}
+
+	public void testBucketPrecision() {
+		long[] values = {0, 7, 8, 15, 16, 1000, 12345, 999999, 4000000000L};
+		for (long value : values) {
+			long upper = TerminalSessionStats.bucketUpperBound(TerminalSessionStats.bucketIndex(value));
+			assertTrue(upper >= value);
+			assertTrue(upper - value <= value / 8);
+		}
+	}
+
+	public void testSnapshotAndPercentiles() {
+		long[] snapshot = new long[TerminalSessionStats.SNAPSHOT_LENGTH];
+		snapshot[0] = 8192;
+		snapshot[1] = 10;
+		snapshot[2] = 4;
+		snapshot[3] = 2;
+		int appendOffset = 4;
+		// 90 appends within 5us, 10 at about a millisecond
+		snapshot[appendOffset + TerminalSessionStats.bucketIndex(5)] = 90;
+		snapshot[appendOffset + TerminalSessionStats.bucketIndex(1000)] = 10;
+		int frameOffset = appendOffset + TerminalSessionStats.HISTOGRAM_BUCKETS;
+		snapshot[frameOffset + TerminalSessionStats.bucketIndex(16000)] = 3;
+
+		TerminalSessionStats stats = new TerminalSessionStats(snapshot, 7);
+		assertEquals(8192, stats.bytesIn);
+		assertEquals(10, stats.bytesOut);
+		assertEquals(2048.0, stats.getAverageReadSize());
+		assertEquals(7, stats.queueFullStalls);
+
+		assertEquals(100, TerminalSessionStats.count(stats.readToAppend));
+		assertEquals(5, TerminalSessionStats.percentile(stats.readToAppend, 50));
+		assertEquals(5, TerminalSessionStats.percentile(stats.readToAppend, 90));
+		long p99 = TerminalSessionStats.percentile(stats.readToAppend, 99);
+		assertTrue(p99 >= 1000 && p99 <= 1125);
+		long frame = TerminalSessionStats.percentile(stats.readToFrame, 50);
+		assertTrue(frame >= 16000 && frame <= 18000);
+		assertEquals(0, TerminalSessionStats.percentile(new long[TerminalSessionStats.HISTOGRAM_BUCKETS], 50));
+
+		String text = stats.format();
+		assertTrue(text.contains("bytes in: 8192 in 4 reads (2048.0 bytes/read)"));
+		assertTrue(text.contains("queue full stalls: 7"));
+		assertTrue(text.contains("read to append (us): n=100 p50=5 p90=5"));
+	}
+
+}
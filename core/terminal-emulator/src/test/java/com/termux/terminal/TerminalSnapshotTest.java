@@ -0,0 +1,116 @@
+package com.termux.terminal;
+
+import java.io.File;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+
+public class TerminalSnapshotTest extends TerminalTestCase {
+
+	private File mFile;
+	private TerminalSnapshotWriter mWriter;
+
+	@Override
+	protected void setUp() throws Exception {
+		super.setUp();
+		mFile = File.createTempFile("terminal", ".snapshot");
+		mWriter = new TerminalSnapshotWriter(mFile);
+	}
+
+	@Override
+	protected void tearDown() throws Exception {
+		//noinspection ResultOfMethodCallIgnored
+		mFile.delete();
+		super.tearDown();
+	}
+
+	private TerminalSnapshot writeSnapshot() throws IOException {
+		TerminalSnapshot snapshot = mWriter.takeSnapshot(mTerminal);
+		assertNotNull(snapshot);
+		mWriter.write(snapshot);
+		return snapshot;
+	}
+
+	/** Replace the terminal with a new one of the given size showing the snapshot file. */
+	private void restore(int columns, int rows) throws IOException {
+		TerminalSnapshot snapshot = TerminalSnapshot.read(mFile);
+		assertNotNull(snapshot);
+		withTerminalSized(columns, rows);
+		mTerminal.restoreSnapshot(snapshot);
+		assertInvariants();
+	}
+
+	public void testRoundTripThroughAppendedRecord() throws IOException {
+		withTerminalSized(5, 3).enterString("\033]0;title\007" + "11111222223333344444\r\n");
+		assertHistoryStartsWith("22222", "11111");
+		assertTrue(writeSnapshot().mFull);
+
+		enterString("\033[31m55555\033[m66666");
+		TerminalSnapshot appended = writeSnapshot();
+		assertFalse(appended.mFull);
+		assertEquals(1, appended.getTranscriptRows());
+
+		restore(5, 3);
+		// The cursor was in the middle of a line, so output of the new shell starts on the next one
+		assertLinesAre("55555", "66666", "     ");
+		assertHistoryStartsWith("44444", "33333", "22222", "11111");
+		assertLineWraps(true, false, false);
+		assertCursorAt(2, 0);
+		assertEquals("title", mTerminal.getTitle());
+		assertEquals(1, TextStyle.decodeForeColor(getStyleAt(0, 0)));
+		assertEquals(TextStyle.COLOR_INDEX_FOREGROUND, TextStyle.decodeForeColor(getStyleAt(1, 0)));
+	}
+
+	public void testNoSnapshotWhileUnchanged() throws IOException {
+		withTerminalSized(5, 3).enterString("a");
+		writeSnapshot();
+		assertNull(mWriter.takeSnapshot(mTerminal));
+		enterString("b");
+		assertNotNull(mWriter.takeSnapshot(mTerminal));
+	}
+
+	public void testClearedTranscriptIsWrittenInFull() throws IOException {
+		withTerminalSized(5, 3).enterString("1\r\n2\r\n3\r\n4\r\n");
+		writeSnapshot();
+		// RIS clears the transcript, which appended records cannot express
+		enterString("\033c5\r\n");
+		TerminalSnapshot snapshot = writeSnapshot();
+		assertTrue(snapshot.mFull);
+		assertEquals(0, snapshot.getTranscriptRows());
+
+		restore(5, 3);
+		assertLinesAre("5    ", "     ", "     ");
+		assertEquals(0, mTerminal.getScreen().getActiveTranscriptRows());
+	}
+
+	public void testRecordCutShortIsIgnored() throws IOException {
+		withTerminalSized(5, 3).enterString("11111\r\n");
+		writeSnapshot();
+		enterString("22222");
+		writeSnapshot();
+		try (RandomAccessFile file = new RandomAccessFile(mFile, "rw")) {
+			file.setLength(file.length() - 3);
+		}
+
+		restore(5, 3);
+		assertLinesAre("11111", "     ", "     ");
+		assertCursorAt(1, 0);
+	}
+
+	public void testRestoreReflowsAndKeepsOnlyDisplayModes() throws IOException {
+		withTerminalSized(6, 4).enterString("\033[?5h\033[?1h\033[?1000h\033[?2004h" + "abcdef\r\n\u4e2d\u4e2dxy\r\nline3\r\n");
+		writeSnapshot();
+
+		restore(4, 5);
+		assertLinesAre("\u4e2d\u4e2d", "xy  ", "line", "3   ", "    ");
+		assertHistoryStartsWith("ef  ", "abcd");
+		assertLineWraps(true, false, true, false, false);
+		assertCursorAt(4, 0);
+		// Modes of the program that is gone are not restored
+		assertTrue(mTerminal.isReverseVideo());
+		assertFalse(mTerminal.isCursorKeysApplicationMode());
+		assertFalse(mTerminal.isMouseTrackingActive());
+		mTerminal.paste("x");
+		assertEquals("x", mOutput.getOutputAndClear());
+	}
+
+}
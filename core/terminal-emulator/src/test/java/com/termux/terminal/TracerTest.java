@@ -0,0 +1,85 @@
+package com.termux.terminal;
+
+import junit.framework.TestCase;
+
+import java.io.StringWriter;
+import java.nio.charset.StandardCharsets;
+
+public class TracerTest extends TestCase {
+
+	@Override
+	protected void setUp() throws Exception {
+		super.setUp();
+		Tracer.setEnabled(false);
+		Tracer.reset(16);
+	}
+
+	@Override
+	protected void tearDown() throws Exception {
+		Tracer.setEnabled(false);
+		Tracer.reset(Tracer.DEFAULT_CAPACITY);
+		super.tearDown();
+	}
+
+	private static String export() throws Exception {
+		StringWriter out = new StringWriter();
+		Tracer.writeChromeTrace(out, 42);
+		return out.toString();
+	}
+
+	public void testDisabledRecordsNothing() throws Exception {
+		long start = Tracer.now();
+		assertEquals(0, start);
+		Tracer.complete("span", start, 10);
+		Tracer.counter("counter", 1);
+		assertEquals(0, Tracer.size());
+		assertFalse(export().contains("\"span\""));
+	}
+
+	public void testEventsAreExported() throws Exception {
+		Tracer.setEnabled(true);
+		Tracer.complete("append", Tracer.now(), 4096);
+		Tracer.completeAsync("api.call", Tracer.now(), "model \"x\"");
+		Tracer.counter("bytes", 7);
+		assertEquals(3, Tracer.size());
+
+		String trace = export();
+		assertTrue(trace.startsWith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+		assertTrue(trace.trim().endsWith("]}"));
+		assertTrue(trace.contains("{\"name\":\"append\",\"ph\":\"X\","));
+		assertTrue(trace.contains("\"pid\":42,\"tid\":" + Thread.currentThread().getId()));
+		assertTrue(trace.contains("\"args\":{\"value\":4096}"));
+		assertTrue(trace.contains("{\"name\":\"api.call\",\"ph\":\"b\","));
+		assertTrue(trace.contains("{\"name\":\"api.call\",\"ph\":\"e\","));
+		assertTrue(trace.contains("\"args\":{\"detail\":\"model \\\"x\\\"\"}"));
+		assertTrue(trace.contains("{\"name\":\"bytes\",\"ph\":\"C\","));
+		assertTrue(trace.contains("\"name\":\"thread_name\""));
+	}
+
+	public void testRingKeepsNewestEvents() throws Exception {
+		Tracer.setEnabled(true);
+		for (int i = 0; i < 40; i++)
+			Tracer.counter("c", i + 1);
+		assertEquals(16, Tracer.size());
+
+		String trace = export();
+		assertFalse(trace.contains("\"value\":24}"));
+		assertTrue(trace.contains("\"value\":25}"));
+		assertTrue(trace.contains("\"value\":40}"));
+
+		Tracer.clear();
+		assertEquals(0, Tracer.size());
+	}
+
+	public void testEmulatorAppendIsTraced() throws Exception {
+		Tracer.setEnabled(true);
+		TerminalEmulator emulator = new TerminalEmulator(new TerminalTestCase.MockTerminalOutput(), 80, 24, 10, 20, 100, null);
+		byte[] bytes = "hello".getBytes(StandardCharsets.UTF_8);
+		emulator.append(bytes, bytes.length);
+
+		String trace = export();
+		assertTrue(trace.contains("{\"name\":\"emulator.append\",\"ph\":\"X\","));
+		assertTrue(trace.contains("\"args\":{\"value\":5}"));
+	}
+
+}
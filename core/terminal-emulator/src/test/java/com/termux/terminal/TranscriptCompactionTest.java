@@ -0,0 +1,120 @@
+package com.termux.terminal;
+
+import java.util.Locale;
+
+public class TranscriptCompactionTest extends TerminalTestCase {
+
+	/** Output numbered lines from first to last, exclusive, each filling a row of five columns. */
+	private TerminalTestCase enterLines(int first, int last) {
+		StringBuilder builder = new StringBuilder();
+		for (int i = first; i < last; i++) builder.append(String.format(Locale.US, "%-5d\r\n", i));
+		return enterString(builder.toString());
+	}
+
+	private static String row(int line) {
+		return String.format(Locale.US, "%-5d", line);
+	}
+
+	public void testCompactAndExpand() {
+		withTerminalSized(5, 3).enterString("\033[31m11111\033[m\r\n22222\r\n33333\r\n44444\r\n");
+		String transcript = mTerminal.getScreen().getTranscriptText();
+		long allocated = mTerminal.getAllocatedBytes();
+
+		long freed = mTerminal.compactTranscript();
+		assertTrue(freed > 0);
+		assertEquals(allocated - freed, mTerminal.getAllocatedBytes());
+		assertTrue(mTerminal.isTranscriptCompacted());
+		// Reading the transcript leaves it compacted
+		assertEquals(transcript, mTerminal.getScreen().getTranscriptText());
+		assertTrue(mTerminal.isTranscriptCompacted());
+		assertEquals(0, mTerminal.compactTranscript());
+
+		mTerminal.expandTranscript();
+		assertFalse(mTerminal.isTranscriptCompacted());
+		assertInvariants();
+		assertHistoryStartsWith("22222", "11111");
+		assertLineWraps(false, false, false);
+		assertEquals(1, TextStyle.decodeForeColor(getStyleAt(-2, 0)));
+		assertEquals(TextStyle.COLOR_INDEX_FOREGROUND, TextStyle.decodeForeColor(getStyleAt(-1, 0)));
+	}
+
+	public void testOutputWhileCompacted() {
+		withTerminalSized(5, 3).enterLines(0, 6);
+		mTerminal.compactTranscript();
+		enterLines(6, 9);
+		assertEquals("0    \n1    \n2    \n3    \n4    \n5    \n6    \n7    \n8", mTerminal.getScreen().getTranscriptText());
+
+		// Compacting again takes in the rows scrolled in meanwhile
+		assertTrue(mTerminal.compactTranscript() > 0);
+		mTerminal.expandTranscript();
+		assertInvariants();
+		assertHistoryStartsWith(row(6), row(5), row(4), row(3), row(2), row(1), row(0));
+		assertLinesAre(row(7), row(8), "     ");
+	}
+
+	public void testCompactOnlyNewRows() {
+		withTerminalSized(5, 3).enterLines(0, 6);
+		mTerminal.compactTranscript();
+
+		// The one new row is compressed on its own
+		enterLines(6, 7);
+		assertTrue(mTerminal.compactTranscript() > 0);
+		assertEquals(0, mTerminal.compactTranscript());
+		assertEquals("0    \n1    \n2    \n3    \n4    \n5    \n6", mTerminal.getScreen().getTranscriptText());
+
+		// Many passes get merged
+		for (int i = 7; i < 30; i++) {
+			enterLines(i, i + 1);
+			mTerminal.compactTranscript();
+		}
+		mTerminal.expandTranscript();
+		assertInvariants();
+		assertHistoryStartsWith(row(27), row(26), row(25));
+		assertLineIs(-28, row(0));
+	}
+
+	public void testCompactedLineWraps() {
+		withTerminalSized(5, 3).enterString("0123456789\r\nA\r\nB\r\nC\r\n");
+		String transcript = mTerminal.getScreen().getTranscriptText();
+		assertEquals("0123456789\nA\nB\nC", transcript);
+
+		mTerminal.compactTranscript();
+		assertEquals(transcript, mTerminal.getScreen().getTranscriptText());
+		mTerminal.expandTranscript();
+		assertEquals(transcript, mTerminal.getScreen().getTranscriptText());
+		assertInvariants();
+	}
+
+	public void testCompactedRowsDropOffFullTranscript() {
+		mTerminal = new TerminalEmulator(mOutput, 5, 3, INITIAL_CELL_WIDTH_PIXELS, INITIAL_CELL_HEIGHT_PIXELS,
+			TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MIN, null);
+		int transcriptRows = TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MIN - 3;
+		enterLines(0, 130);
+		assertEquals(transcriptRows, mTerminal.getScreen().getActiveTranscriptRows());
+		mTerminal.compactTranscript();
+
+		enterLines(130, 140);
+		assertTrue(mTerminal.getScreen().getTranscriptText().startsWith(row(41) + "\n" + row(42) + "\n"));
+		mTerminal.expandTranscript();
+		assertInvariants();
+		assertEquals(transcriptRows, mTerminal.getScreen().getActiveTranscriptRows());
+		assertLineIs(-transcriptRows, row(41));
+		assertLineIs(-11, row(127));
+		assertLineIs(-10, row(128));
+		assertLineIs(-1, row(137));
+	}
+
+	public void testResizeExpandsTranscript() {
+		withTerminalSized(5, 3).enterLines(0, 4);
+		mTerminal.compactTranscript();
+		resize(5, 2);
+		assertFalse(mTerminal.isTranscriptCompacted());
+		assertHistoryStartsWith(row(2), row(1), row(0));
+
+		mTerminal.compactTranscript();
+		enterString("\033c");
+		assertFalse(mTerminal.isTranscriptCompacted());
+		assertEquals(0, mTerminal.getScreen().getActiveTranscriptRows());
+	}
+
+}
@@ -0,0 +1,234 @@
+// Benchmark of the PTY layer: spawning a process, echo round trips and output throughput, measured through the same
+// pty_spawn() the app uses. Runs on Linux and Android (adb shell) and prints JSON to stdout, so that numbers from
+// before and after a change can be compared. Build and run from this directory with:
+//
+//   cc -std=c11 -O2 -Wall -Wextra -I../../main/jni -o pty_bench pty_bench.c ../../main/jni/pty_spawn.c
+//   ./pty_bench [-n iterations] [-b throughput_bytes] > result.json
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pty_spawn.h"
+
+#define ROWS 24
+#define COLUMNS 80
+#define TIMEOUT_MS 10000
+
+static char path_env[] = "PATH=/usr/local/bin:/usr/bin:/bin:/system/bin";
+static char term_env[] = "TERM=xterm-256color";
+static char* child_env[] = { path_env, term_env, NULL };
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void die(char const* what)
+{
+    fprintf(stderr, "pty_bench: %s: %s\n", what, errno ? strerror(errno) : "failed");
+    exit(1);
+}
+
+static int spawn(char* const argv[], int* pid)
+{
+    char const* error;
+    int ptm = pty_spawn(argv[0], "/", argv, child_env, pid, ROWS, COLUMNS, 8, 16, &error);
+    if (ptm < 0) die(error);
+    return ptm;
+}
+
+/** Wait for the master to become readable; the child exiting also makes it readable. */
+static void wait_readable(int ptm)
+{
+    struct pollfd pfd = { .fd = ptm, .events = POLLIN };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+    if (ready == 0) {
+        errno = ETIMEDOUT;
+        die("waiting for output");
+    }
+    if (ready < 0) die("poll");
+}
+
+/** Read until the child closes the slave side, which Linux reports as EIO on the master. */
+static void drain_and_reap(int ptm, int pid)
+{
+    char buffer[4096];
+    for (;;) {
+        wait_readable(ptm);
+        ssize_t n = read(ptm, buffer, sizeof(buffer));
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        break;
+    }
+    close(ptm);
+    waitpid(pid, NULL, 0);
+}
+
+/** Put the terminal in raw mode, so that bytes reach the child and its output unchanged. */
+static void make_raw(int ptm)
+{
+    struct termios tios;
+    if (tcgetattr(ptm, &tios) != 0) die("tcgetattr");
+    cfmakeraw(&tios);
+    if (tcsetattr(ptm, TCSANOW, &tios) != 0) die("tcsetattr");
+}
+
+static int compare_doubles(void const* a, void const* b)
+{
+    double x = *(double const*) a, y = *(double const*) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double const* sorted, int count, double p)
+{
+    int index = (int) (p / 100 * count + 0.999999) - 1;
+    if (index < 0) index = 0;
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+static void print_latencies(char const* name, double* samples, int count)
+{
+    qsort(samples, count, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    printf("  \"%s\": {\"samples\": %d, \"mean\": %.1f, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f},\n",
+            name, count, sum / count, samples[0], percentile(samples, count, 50), percentile(samples, count, 90),
+            percentile(samples, count, 99), samples[count - 1]);
+}
+
+/** Microseconds from forking to the first byte of output of a short-lived process. */
+static void bench_spawn(double* samples, int iterations)
+{
+    char* argv[] = { "echo", "ready", NULL };
+    char buffer[64];
+    for (int i = 0; i < iterations; i++) {
+        int pid;
+        double start = now_us();
+        int ptm = spawn(argv, &pid);
+        wait_readable(ptm);
+        if (read(ptm, buffer, sizeof(buffer)) <= 0) die("reading first output");
+        samples[i] = now_us() - start;
+        drain_and_reap(ptm, pid);
+    }
+}
+
+/** Microseconds for a byte written to the master to be read back by cat and written to the master again. */
+static void bench_echo(double* samples, int iterations)
+{
+    char* argv[] = { "cat", NULL };
+    int pid;
+    int ptm = spawn(argv, &pid);
+    make_raw(ptm);
+    for (int i = 0; i < iterations; i++) {
+        char key = (char) ('a' + i % 26), echoed;
+        double start = now_us();
+        if (write(ptm, &key, 1) != 1) die("writing keystroke");
+        ssize_t n;
+        do {
+            wait_readable(ptm);
+            n = read(ptm, &echoed, 1);
+        } while (n < 0 && errno == EINTR);
+        if (n != 1) die("reading echo");
+        samples[i] = now_us() - start;
+        if (echoed != key) {
+            errno = 0;
+            die("echo returned a different byte");
+        }
+    }
+    // EOF in raw mode has to go through a signal; cat has no state worth a clean exit
+    kill(pid, SIGKILL);
+    drain_and_reap(ptm, pid);
+}
+
+/** Output throughput of a process writing total bytes as fast as it can, read with buffers of buffer_size. */
+static void bench_throughput(long total, size_t buffer_size, int last)
+{
+    char count[32];
+    snprintf(count, sizeof(count), "%ld", total);
+    char* argv[] = { "head", "-c", count, "/dev/zero", NULL };
+    char* buffer = malloc(buffer_size);
+    if (!buffer) die("malloc");
+
+    int pid;
+    int ptm = spawn(argv, &pid);
+    long received = 0, reads = 0;
+    double first = 0, last_read = 0;
+    for (;;) {
+        wait_readable(ptm);
+        ssize_t n = read(ptm, buffer, buffer_size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        last_read = now_us();
+        if (received == 0) first = last_read;
+        received += n;
+        reads++;
+    }
+    close(ptm);
+    waitpid(pid, NULL, 0);
+    free(buffer);
+
+    // Timed from the first byte so that spawning does not count
+    double seconds = (last_read - first) / 1e6;
+    printf("    {\"read_size\": %zu, \"bytes\": %ld, \"reads\": %ld, \"average_read\": %.1f, \"seconds\": %.4f, \"mb_per_s\": %.1f}%s\n",
+            buffer_size, received, reads, reads ? (double) received / reads : 0, seconds,
+            seconds > 0 ? received / seconds / (1 << 20) : 0, last ? "" : ",");
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 200;
+    long throughput_bytes = 64L << 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:")) != -1) {
+        switch (opt) {
+            case 'n': iterations = atoi(optarg); break;
+            case 'b': throughput_bytes = atol(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-b throughput_bytes]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (iterations <= 0 || throughput_bytes <= 0) {
+        fprintf(stderr, "pty_bench: iterations and bytes must be positive\n");
+        return 2;
+    }
+
+    double* samples = malloc(iterations * sizeof(double));
+    if (!samples) die("malloc");
+
+    struct utsname system;
+    uname(&system);
+    printf("{\n  \"system\": {\"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\"},\n",
+            system.sysname, system.release, system.machine);
+
+    bench_spawn(samples, iterations);
+    print_latencies("spawn_to_first_output_us", samples, iterations);
+    bench_echo(samples, iterations);
+    print_latencies("echo_round_trip_us", samples, iterations);
+
+    size_t const read_sizes[] = { 256, 1024, 4096, 16384, 65536 };
+    int const read_size_count = sizeof(read_sizes) / sizeof(read_sizes[0]);
+    printf("  \"throughput\": [\n");
+    for (int i = 0; i < read_size_count; i++) {
+        bench_throughput(throughput_bytes, read_sizes[i], i == read_size_count - 1);
+    }
+    printf("  ]\n}\n");
+
+    free(samples);
+    return 0;
+}
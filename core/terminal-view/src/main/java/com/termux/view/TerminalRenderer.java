@@ -9,6 +9,7 @@ import com.termux.terminal.TerminalBuffer;
 import com.termux.terminal.TerminalEmulator;
 import com.termux.terminal.TerminalRow;
 import com.termux.terminal.TextStyle;
+import com.termux.terminal.Tracer;
 import com.termux.terminal.WcWidth;
 
 /**
@@ -62,6 +63,13 @@ public final class TerminalRenderer {
     /** Render the terminal to a canvas with at a specified row scroll, and an optional rectangular selection. */
     public final void render(TerminalEmulator mEmulator, Canvas canvas, int topRow,
                              int selectionY1, int selectionY2, int selectionX1, int selectionX2) {
+        final long traceStart = Tracer.now();
+        renderFrame(mEmulator, canvas, topRow, selectionY1, selectionY2, selectionX1, selectionX2);
+        Tracer.complete("renderer.render", traceStart);
+    }
+
+    private void renderFrame(TerminalEmulator mEmulator, Canvas canvas, int topRow,
+                             int selectionY1, int selectionY2, int selectionX1, int selectionX2) {
         final boolean reverseVideo = mEmulator.isReverseVideo();
         final int endRow = topRow + mEmulator.mRows;
         final int columns = mEmulator.mColumns;
@@ -295,6 +295,9 @@ public final class TerminalView extends View {
         mEmulator = null;
         mCombiningAccent = 0;
 
+        // The transcript of a session in the background may have been compacted to save memory
+        if (session.getEmulator() != null) session.getEmulator().expandTranscript();
+
         updateSize();
 
         // Wait with enabling the scrollbar until we have a terminal to get scroll position from.
@@ -1015,6 +1018,7 @@ public final class TerminalView extends View {
             }
 
             mRenderer.render(mEmulator, canvas, mTopRow, sel[0], sel[1], sel[2], sel[3]);
+            if (mTermSession != null) mTermSession.onFrameDrawn();
 
             // render the text selection handles
             renderTextSelection();